@@ -0,0 +1,65 @@
+/**
+ * @file alloc.c
+ * @brief Allocation counters.
+ *
+ * With BENCH_COUNT_ALLOCATIONS the program must be linked with
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=strdup so every
+ * call to those functions (from the engine as well as the benchmarks)
+ * goes through the wrappers below. Frees are not counted.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bench.h"
+
+static uint64_t allocations;
+static uint64_t allocated_bytes;
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+
+static void count_allocation(size_t size) {
+  __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&allocated_bytes, size, __ATOMIC_RELAXED);
+}
+
+void *__wrap_malloc(size_t size) {
+  count_allocation(size);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  count_allocation(count * size);
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  count_allocation(size);
+  return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *s) {
+  size_t size = 1;
+  while (s[size - 1])
+    size++;
+  count_allocation(size);
+  return __real_strdup(s);
+}
+
+int bench_counts_allocations(void) { return 1; }
+
+#else
+
+int bench_counts_allocations(void) { return 0; }
+
+#endif
+
+uint64_t bench_allocations(void) { return __atomic_load_n(&allocations, __ATOMIC_RELAXED); }
+
+uint64_t bench_allocated_bytes(void) {
+  return __atomic_load_n(&allocated_bytes, __ATOMIC_RELAXED);
+}
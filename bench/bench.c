@@ -0,0 +1,191 @@
+/**
+ * @file bench.c
+ * @brief Benchmark harness: timing, percentiles and JSON output.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+struct BenchHarness {
+  BenchOptions options;
+  size_t printed; // results printed so far, for the separating commas
+};
+
+struct Bench {
+  BenchHarness *harness;
+  const char *name;
+  char params[256];
+  uint64_t *samples; // latency of every operation, in ns
+  size_t count;
+  size_t capacity;
+  uint64_t started; // start of the current operation
+  uint64_t busy;    // sum of the operation latencies
+  uint64_t items;
+  uint64_t op_allocations; // counters when the current operation started
+  uint64_t op_bytes;
+  uint64_t allocations; // made by the timed operations
+  uint64_t bytes;
+  int untracked; // allocations happen in another process
+  const char *error;
+};
+
+uint64_t bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t bench_random(uint64_t *state) {
+  uint64_t x = *state ? *state : 0x9E3779B97F4A7C15u;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 0x2545F4914F6CDD1Du;
+}
+
+BenchHarness *bench_harness_create(const BenchOptions *options) {
+  BenchHarness *h = calloc(1, sizeof(BenchHarness));
+  if (!h)
+    return NULL;
+  h->options = *options;
+  printf("[");
+  fflush(stdout);
+  return h;
+}
+
+void bench_harness_destroy(BenchHarness *h) {
+  if (!h)
+    return;
+  printf("%s]\n", h->printed ? "\n" : "");
+  free(h);
+}
+
+const BenchOptions *bench_options(const BenchHarness *h) { return &h->options; }
+
+int bench_selected(const BenchHarness *h, const char *name) {
+  return !h->options.filter || strstr(name, h->options.filter) != NULL;
+}
+
+Bench *bench_begin(BenchHarness *h, const char *name, const char *params_fmt, ...) {
+  if (!bench_selected(h, name))
+    return NULL;
+  Bench *b = calloc(1, sizeof(Bench));
+  if (!b)
+    return NULL;
+  b->harness = h;
+  b->name = name;
+  if (params_fmt) {
+    va_list args;
+    va_start(args, params_fmt);
+    vsnprintf(b->params, sizeof(b->params), params_fmt, args);
+    va_end(args);
+  }
+  fprintf(stderr, "bench %s {%s}\n", name, b->params);
+  return b;
+}
+
+void bench_op_start(Bench *b) {
+  b->op_allocations = bench_allocations();
+  b->op_bytes = bench_allocated_bytes();
+  b->started = bench_now_ns();
+}
+
+void bench_op_stop(Bench *b, uint64_t items) {
+  uint64_t latency = bench_now_ns() - b->started;
+  // Only the timed operations count, not the setup between them
+  b->allocations += bench_allocations() - b->op_allocations;
+  b->bytes += bench_allocated_bytes() - b->op_bytes;
+  if (b->count == b->capacity) {
+    size_t cap = b->capacity ? b->capacity * 2 : 1024;
+    uint64_t *samples = realloc(b->samples, cap * sizeof(uint64_t));
+    if (!samples) {
+      bench_fail(b, "out of memory recording samples");
+      return;
+    }
+    b->samples = samples;
+    b->capacity = cap;
+  }
+  b->samples[b->count++] = latency;
+  b->busy += latency;
+  b->items += items;
+}
+
+void bench_fail(Bench *b, const char *message) {
+  if (!b->error)
+    b->error = message;
+}
+
+void bench_untracked_allocations(Bench *b) { b->untracked = 1; }
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static uint64_t percentile(const uint64_t *sorted, size_t count, double p) {
+  if (count == 0)
+    return 0;
+  size_t rank = (size_t)(p / 100.0 * (double)count + 0.5);
+  if (rank < 1)
+    rank = 1;
+  if (rank > count)
+    rank = count;
+  return sorted[rank - 1];
+}
+
+static void print_json_string(const char *s) {
+  putchar('"');
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      printf("\\%c", *s);
+    else if ((unsigned char)*s < 0x20)
+      printf("\\u%04x", (unsigned char)*s);
+    else
+      putchar(*s);
+  }
+  putchar('"');
+}
+
+void bench_end(Bench *b) {
+  if (!b)
+    return;
+  qsort(b->samples, b->count, sizeof(uint64_t), compare_u64);
+  double seconds = (double)b->busy / 1e9;
+
+  BenchHarness *h = b->harness;
+  printf("%s\n  {\"benchmark\": ", h->printed++ ? "," : "");
+  print_json_string(b->name);
+  printf(", \"params\": {%s}, \"ops\": %zu, \"items\": %llu, \"seconds\": %.6f", b->params,
+         b->count, (unsigned long long)b->items, seconds);
+  printf(", \"ops_per_sec\": %.1f, \"items_per_sec\": %.1f",
+         seconds > 0 ? b->count / seconds : 0.0, seconds > 0 ? b->items / seconds : 0.0);
+  printf(", \"latency_ns\": {\"min\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, "
+         "\"p999\": %llu, \"max\": %llu}",
+         (unsigned long long)(b->count ? b->samples[0] : 0),
+         (unsigned long long)percentile(b->samples, b->count, 50),
+         (unsigned long long)percentile(b->samples, b->count, 90),
+         (unsigned long long)percentile(b->samples, b->count, 99),
+         (unsigned long long)percentile(b->samples, b->count, 99.9),
+         (unsigned long long)(b->count ? b->samples[b->count - 1] : 0));
+  if (bench_counts_allocations() && !b->untracked)
+    printf(", \"allocations\": %llu, \"allocations_per_op\": %.2f, \"bytes_allocated\": %llu",
+           (unsigned long long)b->allocations,
+           b->count ? (double)b->allocations / b->count : 0.0, (unsigned long long)b->bytes);
+  else
+    printf(", \"allocations\": null, \"allocations_per_op\": null, \"bytes_allocated\": null");
+  if (b->error) {
+    printf(", \"error\": ");
+    print_json_string(b->error);
+  }
+  printf("}");
+  fflush(stdout);
+
+  free(b->samples);
+  free(b);
+}
@@ -0,0 +1,121 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file bench.h
+ * @brief Micro-benchmark harness emitting machine-readable results.
+ *
+ * A benchmark times each operation it performs between bench_op_start and
+ * bench_op_stop; when it ends, one JSON object is printed with
+ *
+ * - the parameters it ran with
+ * - ops and items per second over the measured operations
+ * - latency percentiles of a single operation, in nanoseconds
+ * - heap allocations and bytes requested by the timed operations
+ *
+ * All objects are printed as one JSON array on stdout; progress goes to stderr.
+ *
+ * Allocations are counted by wrapping malloc, calloc, realloc and strdup at
+ * link time (see the bench target of the Makefile). When the linker cannot
+ * wrap symbols they are reported as null.
+ *
+ * Example usage:
+ * @code{.c}
+ *   Bench *b = bench_begin(h, "set_add", "\"n\": %zu", n);
+ *   for (size_t i = 0; i < n; i++) {
+ *     bench_op_start(b);
+ *     set_add(s, &values[i]);
+ *     bench_op_stop(b, 1);
+ *   }
+ *   bench_end(b);
+ * @endcode
+ */
+
+typedef struct BenchHarness BenchHarness;
+typedef struct Bench Bench;
+
+typedef struct {
+  int quick;            /** Smaller sizes, for a fast smoke run */
+  const char *filter;   /** Only run benchmarks whose name contains this (NULL runs all) */
+  int server_port;      /** Port of the server spawned by the server benchmarks */
+} BenchOptions;
+
+/**
+ * @brief Start a run; prints the opening of the results array.
+ */
+BenchHarness *bench_harness_create(const BenchOptions *options);
+
+/**
+ * @brief Close the results array and destroy the harness.
+ */
+void bench_harness_destroy(BenchHarness *h);
+
+const BenchOptions *bench_options(const BenchHarness *h);
+
+/**
+ * @brief Whether a benchmark called `name` is selected by the filter.
+ */
+int bench_selected(const BenchHarness *h, const char *name);
+
+/**
+ * @brief Start a benchmark.
+ *
+ * @param name Benchmark name (e.g. "relation_join").
+ * @param params_fmt printf format of the members of its "params" object
+ *                   (e.g. "\"n\": %zu"), or NULL for none.
+ * @return The benchmark, or NULL when the filter skips it or on error.
+ */
+Bench *bench_begin(BenchHarness *h, const char *name, const char *params_fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * @brief Start timing one operation.
+ */
+void bench_op_start(Bench *b);
+
+/**
+ * @brief Stop timing the current operation, which processed `items` items.
+ */
+void bench_op_stop(Bench *b, uint64_t items);
+
+/**
+ * @brief Record a failure; the result is still printed, with "error" set.
+ */
+void bench_fail(Bench *b, const char *message);
+
+/**
+ * @brief Report allocations as null: the work happens outside this process.
+ */
+void bench_untracked_allocations(Bench *b);
+
+/**
+ * @brief Print the result and destroy the benchmark.
+ */
+void bench_end(Bench *b);
+
+/**
+ * @brief Monotonic clock in nanoseconds.
+ */
+uint64_t bench_now_ns(void);
+
+/* Allocation counters (alloc.c), which only move when allocations are counted */
+
+int bench_counts_allocations(void);
+uint64_t bench_allocations(void);
+uint64_t bench_allocated_bytes(void);
+
+/**
+ * @brief Deterministic pseudo-random numbers (xorshift64*).
+ */
+uint64_t bench_random(uint64_t *state);
+
+/* Benchmark groups (one per source file) */
+
+void bench_core(BenchHarness *h);
+void bench_infinite(BenchHarness *h);
+void bench_server(BenchHarness *h);
+
+#endif // BENCH_H
@@ -0,0 +1,213 @@
+/**
+ * @file core.c
+ * @brief Benchmarks of sets, relation ingest and finite joins.
+ */
+#include <stdlib.h>
+
+#include "attribute.h"
+#include "bench.h"
+#include "join.h"
+#include "relation.h"
+#include "set.h"
+#include "tuple.h"
+
+static int compare_ints(const void *a, const void *b) {
+  int x = *(const int *)a, y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+static int *shuffled_ints(size_t n, uint64_t seed) {
+  int *values = malloc((n ? n : 1) * sizeof(int));
+  if (!values)
+    return NULL;
+  for (size_t i = 0; i < n; i++)
+    values[i] = (int)i;
+  for (size_t i = n; i > 1; i--) {
+    size_t j = bench_random(&seed) % i;
+    int tmp = values[i - 1];
+    values[i - 1] = values[j];
+    values[j] = tmp;
+  }
+  return values;
+}
+
+// One set_add per operation while the set grows from 0 to n elements
+static void bench_set_add(BenchHarness *h, size_t n) {
+  Bench *b = bench_begin(h, "set_add", "\"n\": %zu", n);
+  if (!b)
+    return;
+  int *values = shuffled_ints(n, n);
+  Set *s = set_create(compare_ints, NULL);
+  if (!values || !s) {
+    bench_fail(b, "setup failed");
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      bench_op_start(b);
+      set_add(s, &values[i]);
+      bench_op_stop(b, 1);
+    }
+  }
+  bench_end(b);
+  set_destroy(s);
+  free(values);
+}
+
+// Lookups of present (hit) or absent (miss) values in a set of n elements
+static void bench_set_contains(BenchHarness *h, size_t n, size_t lookups, int hit) {
+  Bench *b = bench_begin(h, "set_contains", "\"n\": %zu, \"hit\": %s", n, hit ? "true" : "false");
+  if (!b)
+    return;
+  int *values = shuffled_ints(n, n + 1);
+  void **elements = malloc((n ? n : 1) * sizeof(void *));
+  Set *s = set_create(compare_ints, NULL);
+  for (size_t i = 0; values && elements && i < n; i++)
+    elements[i] = &values[i];
+  if (!values || !elements || !s || set_add_batch(s, elements, n) < 0) {
+    bench_fail(b, "setup failed");
+  } else {
+    uint64_t seed = 42;
+    for (size_t i = 0; i < lookups; i++) {
+      int key = (int)(bench_random(&seed) % (n ? n : 1)) + (hit ? 0 : (int)n);
+      bench_op_start(b);
+      if (set_contains(s, &key) != hit)
+        bench_fail(b, "wrong lookup result");
+      bench_op_stop(b, 1);
+    }
+  }
+  bench_end(b);
+  set_destroy(s);
+  free(elements);
+  free(values);
+}
+
+static Tuple *keyed_tuple(int id, int key) {
+  Tuple *t = tuple_create();
+  int *id_value = malloc(sizeof(int));
+  int *key_value = malloc(sizeof(int));
+  *id_value = id;
+  *key_value = key;
+  tuple_add_attribute(t, attribute_create("id", ATTR_INT, id_value));
+  tuple_add_attribute(t, attribute_create("k", ATTR_INT, key_value));
+  return t;
+}
+
+// Tuples are built before the clock starts; only the insertion is timed
+static void bench_relation_add_tuple(BenchHarness *h, size_t n) {
+  Bench *b = bench_begin(h, "relation_add_tuple", "\"n\": %zu", n);
+  if (!b)
+    return;
+  Relation *r = relation_create("R");
+  for (size_t i = 0; i < n; i++) {
+    Tuple *t = keyed_tuple((int)i, (int)(i % 100));
+    bench_op_start(b);
+    if (relation_add_tuple(r, t) < 0)
+      bench_fail(b, "insert failed");
+    bench_op_stop(b, 1);
+  }
+  bench_end(b);
+  relation_destroy(r);
+}
+
+static void bench_relation_add_tuples(BenchHarness *h, size_t n, size_t reps) {
+  Bench *b = bench_begin(h, "relation_add_tuples", "\"n\": %zu", n);
+  if (!b)
+    return;
+  Tuple **tuples = malloc(n * sizeof(Tuple *));
+  for (size_t rep = 0; tuples && rep < reps; rep++) {
+    Relation *r = relation_create("R");
+    for (size_t i = 0; i < n; i++)
+      tuples[i] = keyed_tuple((int)i, (int)(i % 100));
+    bench_op_start(b);
+    if (relation_add_tuples(r, tuples, n) < 0)
+      bench_fail(b, "insert failed");
+    bench_op_stop(b, n);
+    relation_destroy(r);
+  }
+  if (!tuples)
+    bench_fail(b, "setup failed");
+  bench_end(b);
+  free(tuples);
+}
+
+static int key_equal(Tuple *left, Tuple *right, void *userdata) {
+  (void)userdata;
+  Attribute *a = tuple_find_attribute(left, "k");
+  Attribute *b = tuple_find_attribute(right, "k");
+  return a && b && *(int *)a->value == *(int *)b->value;
+}
+
+// n tuples with keys drawn uniformly from `distinct` values
+static Relation *keyed_relation(const char *name, size_t n, size_t distinct, uint64_t seed) {
+  Relation *r = relation_create(name);
+  Tuple **tuples = malloc((n ? n : 1) * sizeof(Tuple *));
+  if (!r || !tuples) {
+    free(tuples);
+    relation_destroy(r);
+    return NULL;
+  }
+  for (size_t i = 0; i < n; i++)
+    tuples[i] = keyed_tuple((int)i, (int)(bench_random(&seed) % distinct));
+  relation_add_tuples(r, tuples, n);
+  free(tuples);
+  return r;
+}
+
+// Equi-join of two n-tuple relations where a pair matches with probability `selectivity`
+static void bench_join(BenchHarness *h, const char *name, size_t n, double selectivity,
+                       size_t reps, int hashed) {
+  Bench *b = bench_begin(h, name, "\"n\": %zu, \"selectivity\": %g", n, selectivity);
+  if (!b)
+    return;
+  size_t distinct = (size_t)(1.0 / selectivity + 0.5);
+  Relation *left = keyed_relation("L", n, distinct, 1);
+  Relation *right = keyed_relation("R", n, distinct, 2);
+  const char *on[] = {"k"};
+  for (size_t rep = 0; left && right && rep < reps; rep++) {
+    bench_op_start(b);
+    Relation *joined = hashed ? relation_hash_join(left, right, on, 1, NULL, "J")
+                              : relation_join(left, right, key_equal, NULL, "J");
+    bench_op_stop(b, n * n);
+    if (!joined)
+      bench_fail(b, "join failed");
+    relation_destroy(joined);
+  }
+  if (!left || !right)
+    bench_fail(b, "setup failed");
+  bench_end(b);
+  relation_destroy(left);
+  relation_destroy(right);
+}
+
+void bench_core(BenchHarness *h) {
+  int quick = bench_options(h)->quick;
+  size_t set_sizes[] = {1024, 4096, 16384};
+  size_t set_count = quick ? 2 : 3;
+  for (size_t i = 0; i < set_count; i++)
+    bench_set_add(h, set_sizes[i]);
+  for (size_t i = 0; i < set_count; i++) {
+    bench_set_contains(h, set_sizes[i], quick ? 1000 : 10000, 1);
+    bench_set_contains(h, set_sizes[i], quick ? 1000 : 10000, 0);
+  }
+
+  size_t ingest_sizes[] = {1024, 4096, 16384};
+  for (size_t i = 0; i < set_count; i++) {
+    bench_relation_add_tuple(h, ingest_sizes[i]);
+    bench_relation_add_tuples(h, ingest_sizes[i], quick ? 3 : 10);
+  }
+
+  // The nested-loop join inserts every result with relation_add_tuple, which
+  // is linear in the result size; combinations producing more than
+  // JOIN_MAX_RESULTS expected rows would measure that instead of the join.
+  const double JOIN_MAX_RESULTS = 20000;
+  size_t join_sizes[] = {100, 300, 1000};
+  double selectivities[] = {0.001, 0.01, 0.1};
+  for (size_t i = 0; i < (quick ? 2u : 3u); i++) {
+    for (size_t j = 0; j < 3; j++) {
+      size_t n = join_sizes[i];
+      if ((double)n * n * selectivities[j] > JOIN_MAX_RESULTS)
+        continue;
+      bench_join(h, "relation_join", n, selectivities[j], quick ? 2 : 5, 0);
+      bench_join(h, "relation_hash_join", n, selectivities[j], quick ? 2 : 5, 1);
+    }
+  }
+}
@@ -0,0 +1,129 @@
+/**
+ * @file infinite.c
+ * @brief Benchmarks of generators and infinite join enumeration.
+ */
+#include <stdlib.h>
+
+#include "arithmetic_relations.h"
+#include "batch.h"
+#include "bench.h"
+#include "join.h"
+#include "primitive_relations.h"
+#include "scheduler.h"
+
+#define GENERATOR_BATCH_ROWS 1024
+
+// One tuple generated (and destroyed) per operation
+static void bench_generator(BenchHarness *h, const char *generator, TupleGeneratorFn fn,
+                            size_t count) {
+  Bench *b = bench_begin(h, "generator", "\"generator\": \"%s\", \"tuples\": %zu", generator,
+                         count);
+  if (!b)
+    return;
+  for (size_t i = 0; i < count; i++) {
+    bench_op_start(b);
+    Tuple *t = fn(i, NULL);
+    tuple_destroy(t);
+    bench_op_stop(b, 1);
+  }
+  bench_end(b);
+}
+
+// One batch of GENERATOR_BATCH_ROWS rows per operation
+static void bench_batch_generator(BenchHarness *h, size_t rows) {
+  Bench *b = bench_begin(h, "batch_generator", "\"generator\": \"natural\", \"rows\": %zu", rows);
+  if (!b)
+    return;
+  const char *names[] = {"n"};
+  AttributeType types[] = {ATTR_INT};
+  ColumnBatch *batch = column_batch_create(names, types, 1, GENERATOR_BATCH_ROWS);
+  for (size_t start = 0; batch && start < rows; start += GENERATOR_BATCH_ROWS) {
+    column_batch_clear(batch);
+    bench_op_start(b);
+    size_t n = natural_batch_generator(start, GENERATOR_BATCH_ROWS, batch, NULL);
+    bench_op_stop(b, n);
+  }
+  if (!batch)
+    bench_fail(b, "setup failed");
+  bench_end(b);
+  column_batch_destroy(batch);
+}
+
+static int int_value(Tuple *t, const char *name) {
+  Attribute *a = tuple_find_attribute(t, name);
+  return a ? *(int *)a->value : 0;
+}
+
+static int naturals_equal(Tuple *left, Tuple *right, void *userdata) {
+  (void)userdata;
+  return int_value(left, "n") == int_value(right, "n");
+}
+
+// About one pair in 200 matches, scattered over the Cantor order
+static int naturals_sparse(Tuple *left, Tuple *right, void *userdata) {
+  (void)userdata;
+  int a = int_value(left, "n"), b = int_value(right, "n");
+  return a < b && (a * 31 + b) % 97 == 0;
+}
+
+// Build N ⋈ N, iterate its first `prefix` tuples and destroy it: one operation
+static void bench_infinite_join(BenchHarness *h, const char *predicate_name,
+                                JoinPredicateFn predicate, size_t prefix, Scheduler *scheduler,
+                                size_t reps) {
+  Bench *b = bench_begin(h, "infinite_join_prefix",
+                         "\"predicate\": \"%s\", \"prefix\": %zu, \"threads\": %u", predicate_name,
+                         prefix, scheduler ? scheduler_threads(scheduler) : 0);
+  if (!b)
+    return;
+  InfiniteRelation *left = infinite_relation_create("N1", natural_generator, NULL);
+  InfiniteRelation *right = infinite_relation_create("N2", natural_generator, NULL);
+  for (size_t rep = 0; left && right && rep < reps; rep++) {
+    bench_op_start(b);
+    InfiniteRelation *joined = infinite_relation_join_parallel(
+        left, right, predicate, NULL, "J", cardinality_infinite(CARD_ALEPH_0), scheduler);
+    InfiniteRelationIterator *it = joined ? infinite_relation_iterator_create(joined) : NULL;
+    size_t produced = 0;
+    for (; it && produced < prefix; produced++) {
+      Tuple *t = infinite_relation_iterator_next(it);
+      if (!t)
+        break;
+      tuple_destroy(t);
+    }
+    infinite_relation_iterator_destroy(it);
+    infinite_relation_destroy(joined);
+    bench_op_stop(b, produced);
+    if (produced < prefix)
+      bench_fail(b, "join ended early");
+  }
+  if (!left || !right)
+    bench_fail(b, "setup failed");
+  bench_end(b);
+  infinite_relation_destroy(left);
+  infinite_relation_destroy(right);
+}
+
+void bench_infinite(BenchHarness *h) {
+  int quick = bench_options(h)->quick;
+  size_t tuples = quick ? 20000 : 200000;
+  bench_generator(h, "natural", natural_generator, tuples);
+  bench_generator(h, "successor", successor_generator, tuples);
+  bench_generator(h, "addition", addition_generator, tuples);
+  bench_generator(h, "multiplication", multiplication_generator, tuples);
+  bench_batch_generator(h, tuples * 10);
+
+  // Equality matches only on the diagonal, so a prefix of K needs about 2K²
+  // pairs; the sparse predicate needs about 200 pairs per match.
+  Scheduler *scheduler = bench_selected(h, "infinite_join_prefix") ? scheduler_create(0) : NULL;
+  size_t reps = quick ? 2 : 5;
+  size_t equal_prefixes[] = {100, 300, 600};
+  size_t sparse_prefixes[] = {500, 2000, 5000};
+  for (size_t i = 0; i < (quick ? 2u : 3u); i++) {
+    bench_infinite_join(h, "equal", naturals_equal, equal_prefixes[i], NULL, reps);
+    bench_infinite_join(h, "sparse", naturals_sparse, sparse_prefixes[i], NULL, reps);
+    if (scheduler) {
+      bench_infinite_join(h, "equal", naturals_equal, equal_prefixes[i], scheduler, reps);
+      bench_infinite_join(h, "sparse", naturals_sparse, sparse_prefixes[i], scheduler, reps);
+    }
+  }
+  scheduler_destroy(scheduler);
+}
@@ -0,0 +1,653 @@
+/**
+ * @file loadgen.c
+ * @brief Load generator for the XML socket server (see `make loadgen`).
+ *
+ * Every connection runs on its own thread and drives a weighted mix of
+ * CREATE_RELATION, ADD_TUPLE, QUERY_RELATION and LIST_RELATIONS requests.
+ *
+ * - Closed loop (no --rate): a connection sends its next request as soon as
+ *   a response frees a slot (--pipeline requests in flight, default 1).
+ * - Open loop (--rate R): requests are scheduled at fixed intervals, R per
+ *   second over all connections, and sent on schedule while fewer than
+ *   --pipeline are in flight.
+ *
+ * Latency is measured from the time a request was *intended* to be sent, so
+ * when the server stalls, the requests the schedule could not send count the
+ * whole stall instead of being silently postponed (coordinated omission).
+ * The service time, from the actual send, is reported alongside. In closed
+ * loop the intended time is the send time, so the two coincide.
+ *
+ * Results are printed as one JSON object on stdout.
+ */
+#define _GNU_SOURCE // memmem, ppoll
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "xml_server.h"
+
+#define RESPONSE_END "</response>\n"
+#define RESPONSE_END_LEN (sizeof(RESPONSE_END) - 1)
+#define WRITE_RELATION "LoadGenWrites"
+#define READ_RELATION "LoadGenReads"
+
+/*
+ * Log-linear latency histogram: values below 2^HISTOGRAM_BITS nanoseconds
+ * are exact; above, every power of two is split into 2^(HISTOGRAM_BITS - 1)
+ * buckets, so a recorded value is off by less than 1/64.
+ */
+#define HISTOGRAM_BITS 7
+#define HISTOGRAM_HALF (1u << (HISTOGRAM_BITS - 1))
+#define HISTOGRAM_BUCKETS ((1u << HISTOGRAM_BITS) + (64 - HISTOGRAM_BITS + 1) * HISTOGRAM_HALF)
+
+typedef struct {
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  uint64_t total;
+  uint64_t max;
+  double sum;
+} Histogram;
+
+static size_t histogram_index(uint64_t v) {
+  if (v < (1u << HISTOGRAM_BITS))
+    return (size_t)v;
+  int msb = 63 - __builtin_clzll(v);
+  int shift = msb - (HISTOGRAM_BITS - 1);
+  return (1u << HISTOGRAM_BITS) + (size_t)(shift - 1) * HISTOGRAM_HALF +
+         (size_t)((v >> shift) - HISTOGRAM_HALF);
+}
+
+// Midpoint of the values a bucket holds
+static uint64_t histogram_value(size_t index) {
+  if (index < (1u << HISTOGRAM_BITS))
+    return index;
+  size_t rest = index - (1u << HISTOGRAM_BITS);
+  int shift = (int)(rest / HISTOGRAM_HALF) + 1;
+  uint64_t low = (uint64_t)(rest % HISTOGRAM_HALF + HISTOGRAM_HALF) << shift;
+  return low + ((1ull << shift) >> 1);
+}
+
+static void histogram_record(Histogram *h, uint64_t v) {
+  h->counts[histogram_index(v)]++;
+  h->total++;
+  h->sum += (double)v;
+  if (v > h->max)
+    h->max = v;
+}
+
+static void histogram_merge(Histogram *into, const Histogram *from) {
+  for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    into->counts[i] += from->counts[i];
+  into->total += from->total;
+  into->sum += from->sum;
+  if (from->max > into->max)
+    into->max = from->max;
+}
+
+static uint64_t histogram_percentile(const Histogram *h, double p) {
+  if (h->total == 0)
+    return 0;
+  uint64_t rank = (uint64_t)(p / 100.0 * (double)h->total + 0.5);
+  if (rank < 1)
+    rank = 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= rank) {
+      uint64_t v = histogram_value(i);
+      return v < h->max ? v : h->max;
+    }
+  }
+  return h->max;
+}
+
+typedef enum { REQ_CREATE, REQ_ADD, REQ_QUERY, REQ_LIST, REQ_KINDS } RequestKind;
+
+static const char *const kind_names[REQ_KINDS] = {"CREATE_RELATION", "ADD_TUPLE",
+                                                  "QUERY_RELATION", "LIST_RELATIONS"};
+static const char *const kind_keys[REQ_KINDS] = {"create", "add", "query", "list"};
+
+typedef struct {
+  const char *host;
+  int port;
+  unsigned connections;
+  double rate;     // requests per second over all connections; 0 for closed loop
+  double duration; // seconds measured
+  double warmup;   // seconds run before measuring
+  double drain;    // seconds to wait for responses after the run
+  unsigned pipeline;
+  unsigned weights[REQ_KINDS];
+  size_t read_size; // tuples in READ_RELATION
+  int spawn;        // start a server in a child process
+} LoadOptions;
+
+typedef struct {
+  uint64_t intended;
+  uint64_t sent;
+  RequestKind kind;
+} InFlight;
+
+typedef struct {
+  const LoadOptions *options;
+  unsigned index;
+  uint64_t start; // shared start of the schedule
+  uint64_t measure_from;
+  uint64_t stop;
+  Histogram latency[REQ_KINDS]; // from the intended send time
+  Histogram service[REQ_KINDS]; // from the actual send time
+  uint64_t sent;
+  uint64_t errors;     // responses with status error
+  uint64_t unanswered; // still in flight when the drain timed out
+  uint64_t late_sends; // sends more than one interval behind schedule
+  int failed;
+} Connection;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t next_random(uint64_t *state) {
+  uint64_t x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 0x2545F4914F6CDD1Du;
+}
+
+static int connect_server(const char *host, int port) {
+  char service[16];
+  snprintf(service, sizeof(service), "%d", port);
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM}, *addrs;
+  if (getaddrinfo(host, service, &hints, &addrs) != 0)
+    return -1;
+  int fd = -1;
+  for (struct addrinfo *a = addrs; a && fd < 0; a = a->ai_next) {
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) < 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addrs);
+  if (fd >= 0) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  return fd;
+}
+
+static int send_all(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    data += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static int format_request(char *out, size_t size, RequestKind kind, unsigned conn, uint64_t seq) {
+  switch (kind) {
+  case REQ_CREATE:
+    return snprintf(out, size,
+                    "<request><command>CREATE_RELATION</command>"
+                    "<name>LoadGen_%u_%llu</name></request>",
+                    conn, (unsigned long long)seq);
+  case REQ_ADD:
+    return snprintf(out, size,
+                    "<request><command>ADD_TUPLE</command><relation>" WRITE_RELATION
+                    "</relation><attributes><attribute><name>id</name><type>int</type>"
+                    "<value>%llu</value></attribute><attribute><name>conn</name>"
+                    "<type>int</type><value>%u</value></attribute></attributes></request>",
+                    (unsigned long long)(seq % 2000000000u), conn);
+  case REQ_QUERY:
+    return snprintf(out, size,
+                    "<request><command>QUERY_RELATION</command><relation>" READ_RELATION
+                    "</relation></request>");
+  default:
+    return snprintf(out, size, "<request><command>LIST_RELATIONS</command></request>");
+  }
+}
+
+// Receive buffer of a connection; responses are consumed as they complete
+typedef struct {
+  char *data;
+  size_t size;
+  size_t capacity;
+  size_t scanned; // bytes known not to end a response
+} Inbox;
+
+// Read what is available; returns -1 on error or when the server closed
+static int inbox_fill(Inbox *in, int fd) {
+  if (in->capacity - in->size < 65536) {
+    size_t cap = in->capacity ? in->capacity * 2 : 262144;
+    char *grown = realloc(in->data, cap);
+    if (!grown)
+      return -1;
+    in->data = grown;
+    in->capacity = cap;
+  }
+  ssize_t n = recv(fd, in->data + in->size, in->capacity - in->size, 0);
+  if (n < 0 && errno == EINTR)
+    return 0;
+  if (n <= 0)
+    return -1;
+  in->size += (size_t)n;
+  return 0;
+}
+
+// Pop one complete response; `*error` tells whether its status is error
+static int inbox_next(Inbox *in, int *error) {
+  size_t from = in->scanned > RESPONSE_END_LEN ? in->scanned - RESPONSE_END_LEN : 0;
+  char *end = memmem(in->data + from, in->size - from, RESPONSE_END, RESPONSE_END_LEN);
+  if (!end) {
+    in->scanned = in->size;
+    return 0;
+  }
+  size_t len = (size_t)(end - in->data) + RESPONSE_END_LEN;
+  size_t head = len < 256 ? len : 256; // the status comes first
+  *error = memmem(in->data, head, "<status>error</status>", 22) != NULL;
+  memmove(in->data, in->data + len, in->size - len);
+  in->size -= len;
+  in->scanned = 0;
+  return 1;
+}
+
+static RequestKind pick_kind(const LoadOptions *o, uint64_t *rng) {
+  unsigned total = 0;
+  for (int k = 0; k < REQ_KINDS; k++)
+    total += o->weights[k];
+  unsigned r = (unsigned)(next_random(rng) % total);
+  for (int k = 0; k < REQ_KINDS; k++) {
+    if (r < o->weights[k])
+      return (RequestKind)k;
+    r -= o->weights[k];
+  }
+  return REQ_LIST;
+}
+
+static void *connection_main(void *arg) {
+  Connection *c = (Connection *)arg;
+  const LoadOptions *o = c->options;
+  int fd = connect_server(o->host, o->port);
+  InFlight *ring = calloc(o->pipeline, sizeof(InFlight));
+  Inbox in = {0};
+  if (fd < 0 || !ring) {
+    c->failed = 1;
+    free(ring);
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+
+  uint64_t t0 = now_ns();
+  if (t0 < c->start) {
+    struct timespec pause = {.tv_sec = (time_t)((c->start - t0) / 1000000000u),
+                             .tv_nsec = (long)((c->start - t0) % 1000000000u)};
+    nanosleep(&pause, NULL);
+  }
+
+  // Open loop: connection i sends at start + (i + k * connections) / rate
+  uint64_t interval = o->rate > 0 ? (uint64_t)(1e9 * o->connections / o->rate) : 0;
+  uint64_t next = c->start + (o->rate > 0 ? interval * c->index / o->connections : 0);
+  uint64_t rng = 0x9E3779B97F4A7C15u ^ ((uint64_t)c->index << 32 | 1);
+  size_t head = 0, count = 0;
+  uint64_t seq = 0;
+  uint64_t drain_end = c->stop + (uint64_t)(o->drain * 1e9);
+  char request[512];
+
+  for (;;) {
+    uint64_t t = now_ns();
+    int sending = t < c->stop;
+    if (!sending && (count == 0 || t >= drain_end))
+      break;
+
+    // Send everything that is due while there is room in flight
+    while (sending && count < o->pipeline && (interval == 0 || next <= t)) {
+      RequestKind kind = pick_kind(o, &rng);
+      int len = format_request(request, sizeof(request), kind, c->index, seq++);
+      uint64_t sent = now_ns();
+      uint64_t intended = interval ? next : sent;
+      if (interval && sent - intended > interval)
+        c->late_sends++;
+      if (send_all(fd, request, (size_t)len) < 0) {
+        c->failed = 1;
+        goto done;
+      }
+      ring[(head + count++) % o->pipeline] = (InFlight){intended, sent, kind};
+      c->sent++;
+      if (interval)
+        next += interval;
+      t = now_ns();
+    }
+
+    // Wait for a response, or until the next send is due
+    uint64_t until = drain_end;
+    if (sending)
+      until = interval && count < o->pipeline && next < c->stop ? next : c->stop;
+    uint64_t wait = until > t ? until - t : 0;
+    struct timespec timeout = {.tv_sec = (time_t)(wait / 1000000000u),
+                               .tv_nsec = (long)(wait % 1000000000u)};
+    struct pollfd p = {.fd = fd, .events = POLLIN};
+    int ready = ppoll(&p, 1, &timeout, NULL);
+    if (ready < 0 && errno != EINTR) {
+      c->failed = 1;
+      break;
+    }
+    if (ready <= 0)
+      continue;
+    if (inbox_fill(&in, fd) < 0) {
+      c->failed = 1;
+      break;
+    }
+    int error;
+    while (count > 0 && inbox_next(&in, &error)) {
+      uint64_t received = now_ns();
+      InFlight f = ring[head];
+      head = (head + 1) % o->pipeline;
+      count--;
+      if (f.intended < c->measure_from)
+        continue;
+      histogram_record(&c->latency[f.kind], received - f.intended);
+      histogram_record(&c->service[f.kind], received - f.sent);
+      if (error)
+        c->errors++;
+    }
+  }
+
+done:
+  c->unanswered = count;
+  free(in.data);
+  free(ring);
+  close(fd);
+  return NULL;
+}
+
+// Send one request and wait for its response
+static int request(int fd, Inbox *in, const char *xml) {
+  if (send_all(fd, xml, strlen(xml)) < 0)
+    return -1;
+  int error;
+  while (!inbox_next(in, &error))
+    if (inbox_fill(in, fd) < 0)
+      return -1;
+  return error ? -1 : 0;
+}
+
+// Create the relations the mix uses and fill the one queries read
+static int prepare_schema(const LoadOptions *o) {
+  int fd = -1;
+  // A freshly spawned server needs a moment to bind
+  for (int attempt = 0; fd < 0 && attempt < 200; attempt++) {
+    fd = connect_server(o->host, o->port);
+    if (fd < 0) {
+      struct timespec pause = {.tv_sec = 0, .tv_nsec = 10000000};
+      nanosleep(&pause, NULL);
+    }
+  }
+  if (fd < 0)
+    return -1;
+  Inbox in = {0};
+  char xml[512];
+  // The relations may exist from an earlier run against the same server
+  request(fd, &in, "<request><command>CREATE_RELATION</command><name>" WRITE_RELATION
+                   "</name></request>");
+  int status = 0;
+  if (request(fd, &in, "<request><command>CREATE_RELATION</command><name>" READ_RELATION
+                       "</name></request>") == 0) {
+    for (size_t i = 0; i < o->read_size && status == 0; i++) {
+      snprintf(xml, sizeof(xml),
+               "<request><command>ADD_TUPLE</command><relation>" READ_RELATION
+               "</relation><attributes><attribute><name>id</name><type>int</type>"
+               "<value>%zu</value></attribute><attribute><name>name</name><type>string</type>"
+               "<value>row%zu</value></attribute></attributes></request>",
+               i, i);
+      status = request(fd, &in, xml);
+    }
+  }
+  free(in.data);
+  close(fd);
+  return status;
+}
+
+static void print_histogram(const char *key, const Histogram *h) {
+  printf("\"%s\": {\"count\": %llu, \"mean\": %.0f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, "
+         "\"p999\": %llu, \"p9999\": %llu, \"max\": %llu}",
+         key, (unsigned long long)h->total, h->total ? h->sum / (double)h->total : 0.0,
+         (unsigned long long)histogram_percentile(h, 50),
+         (unsigned long long)histogram_percentile(h, 90),
+         (unsigned long long)histogram_percentile(h, 99),
+         (unsigned long long)histogram_percentile(h, 99.9),
+         (unsigned long long)histogram_percentile(h, 99.99), (unsigned long long)h->max);
+}
+
+static int parse_mix(const char *spec, unsigned weights[REQ_KINDS]) {
+  memset(weights, 0, REQ_KINDS * sizeof(unsigned));
+  char *copy = strdup(spec), *save = NULL;
+  if (!copy)
+    return -1;
+  int status = 0;
+  for (char *item = strtok_r(copy, ",", &save); item && status == 0;
+       item = strtok_r(NULL, ",", &save)) {
+    char *eq = strchr(item, '=');
+    status = -1;
+    for (int k = 0; eq && k < REQ_KINDS; k++) {
+      if ((size_t)(eq - item) == strlen(kind_keys[k]) &&
+          strncmp(item, kind_keys[k], (size_t)(eq - item)) == 0) {
+        weights[k] = (unsigned)strtoul(eq + 1, NULL, 10);
+        status = 0;
+      }
+    }
+  }
+  free(copy);
+  unsigned total = 0;
+  for (int k = 0; k < REQ_KINDS; k++)
+    total += weights[k];
+  return status == 0 && total > 0 ? 0 : -1;
+}
+
+static void usage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --host HOST         server address (default 127.0.0.1)\n"
+          "  --port PORT         server port (default 8080)\n"
+          "  --spawn             start a server on PORT for the run\n"
+          "  --connections N     concurrent connections (default 1)\n"
+          "  --rate R            open loop at R requests/s in total (default: closed loop)\n"
+          "  --pipeline P        requests in flight per connection (default 1)\n"
+          "  --duration S        seconds measured (default 10)\n"
+          "  --warmup S          seconds run before measuring (default 1)\n"
+          "  --drain S           seconds to wait for late responses (default 5)\n"
+          "  --mix SPEC          weights, e.g. add=60,query=10,list=25,create=5 (the default)\n"
+          "  --read-size N       tuples in the relation queries read (default 100)\n",
+          program);
+}
+
+static pid_t spawn_server(int port) {
+  pid_t pid = fork();
+  if (pid != 0)
+    return pid;
+  if (!freopen("/dev/null", "w", stdout))
+    _exit(1);
+  log_set_level(LOG_LEVEL_ERROR);
+  ServerOptions options = {.port = port, .wal_path = NULL, .snapshot_path = NULL};
+  _exit(start_server(&options));
+}
+
+int main(int argc, char *argv[]) {
+  LoadOptions o = {.host = "127.0.0.1",
+                   .port = 8080,
+                   .connections = 1,
+                   .rate = 0,
+                   .duration = 10,
+                   .warmup = 1,
+                   .drain = 5,
+                   .pipeline = 1,
+                   .read_size = 100,
+                   .spawn = 0};
+  parse_mix("add=60,query=10,list=25,create=5", o.weights);
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i], *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (strcmp(arg, "--spawn") == 0) {
+      o.spawn = 1;
+      continue;
+    }
+    if (!value) {
+      usage(argv[0]);
+      return 2;
+    }
+    i++;
+    if (strcmp(arg, "--host") == 0) {
+      o.host = value;
+    } else if (strcmp(arg, "--port") == 0) {
+      o.port = atoi(value);
+    } else if (strcmp(arg, "--connections") == 0) {
+      o.connections = (unsigned)atoi(value);
+    } else if (strcmp(arg, "--rate") == 0) {
+      o.rate = atof(value);
+    } else if (strcmp(arg, "--pipeline") == 0) {
+      o.pipeline = (unsigned)atoi(value);
+    } else if (strcmp(arg, "--duration") == 0) {
+      o.duration = atof(value);
+    } else if (strcmp(arg, "--warmup") == 0) {
+      o.warmup = atof(value);
+    } else if (strcmp(arg, "--drain") == 0) {
+      o.drain = atof(value);
+    } else if (strcmp(arg, "--read-size") == 0) {
+      o.read_size = (size_t)atol(value);
+    } else if (strcmp(arg, "--mix") == 0) {
+      if (parse_mix(value, o.weights) < 0) {
+        fprintf(stderr, "loadgen: invalid mix '%s'\n", value);
+        return 2;
+      }
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (o.connections == 0 || o.pipeline == 0 || o.duration <= 0 || o.rate < 0) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  pid_t server = -1;
+  if (o.spawn) {
+    fflush(stdout);
+    server = spawn_server(o.port);
+    if (server < 0) {
+      fprintf(stderr, "loadgen: could not start the server\n");
+      return 1;
+    }
+  }
+  int status = 1;
+  Connection *conns = calloc(o.connections, sizeof(Connection));
+  pthread_t *threads = calloc(o.connections, sizeof(pthread_t));
+  if (!conns || !threads) {
+    fprintf(stderr, "loadgen: out of memory\n");
+    goto out;
+  }
+  if (prepare_schema(&o) < 0) {
+    fprintf(stderr, "loadgen: could not prepare the schema on %s:%d\n", o.host, o.port);
+    goto out;
+  }
+
+  // The schedule starts shortly after every thread is up
+  uint64_t start = now_ns() + 50000000u;
+  unsigned started = 0;
+  for (unsigned i = 0; i < o.connections; i++) {
+    conns[i] = (Connection){.options = &o,
+                            .index = i,
+                            .start = start,
+                            .measure_from = start + (uint64_t)(o.warmup * 1e9),
+                            .stop = start + (uint64_t)((o.warmup + o.duration) * 1e9)};
+    if (pthread_create(&threads[i], NULL, connection_main, &conns[i]) != 0)
+      break;
+    started++;
+  }
+  for (unsigned i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+
+  Histogram *latency = calloc(REQ_KINDS + 1, sizeof(Histogram));
+  Histogram *service = calloc(REQ_KINDS + 1, sizeof(Histogram));
+  if (!latency || !service) {
+    free(latency);
+    free(service);
+    goto out;
+  }
+  uint64_t sent = 0, errors = 0, unanswered = 0, late = 0;
+  unsigned failed = o.connections - started;
+  for (unsigned i = 0; i < started; i++) {
+    for (int k = 0; k < REQ_KINDS; k++) {
+      histogram_merge(&latency[k], &conns[i].latency[k]);
+      histogram_merge(&service[k], &conns[i].service[k]);
+      histogram_merge(&latency[REQ_KINDS], &conns[i].latency[k]);
+      histogram_merge(&service[REQ_KINDS], &conns[i].service[k]);
+    }
+    sent += conns[i].sent;
+    errors += conns[i].errors;
+    unanswered += conns[i].unanswered;
+    late += conns[i].late_sends;
+    failed += (unsigned)conns[i].failed;
+  }
+
+  const Histogram *all = &latency[REQ_KINDS];
+  printf("{\"mode\": \"%s\", \"connections\": %u, \"pipeline\": %u, \"target_rate\": %.1f, "
+         "\"duration\": %.3f, \"warmup\": %.3f,\n",
+         o.rate > 0 ? "open" : "closed", o.connections, o.pipeline, o.rate, o.duration, o.warmup);
+  printf(" \"requests\": %llu, \"throughput\": %.1f, \"sent\": %llu, \"errors\": %llu, "
+         "\"unanswered\": %llu, \"late_sends\": %llu, \"failed_connections\": %u,\n ",
+         (unsigned long long)all->total, (double)all->total / o.duration,
+         (unsigned long long)sent, (unsigned long long)errors, (unsigned long long)unanswered,
+         (unsigned long long)late, failed);
+  print_histogram("latency_ns", all);
+  printf(",\n ");
+  print_histogram("service_ns", &service[REQ_KINDS]);
+  printf(",\n \"commands\": {");
+  for (int k = 0; k < REQ_KINDS; k++) {
+    printf("%s\n  \"%s\": {", k ? "," : "", kind_names[k]);
+    print_histogram("latency_ns", &latency[k]);
+    printf(", ");
+    print_histogram("service_ns", &service[k]);
+    printf("}");
+  }
+  printf("}}\n");
+
+  fprintf(stderr, "%s loop, %u connection(s): %.1f req/s, p50 %.3f ms, p99 %.3f ms, p999 %.3f ms\n",
+          o.rate > 0 ? "open" : "closed", o.connections, (double)all->total / o.duration,
+          histogram_percentile(all, 50) / 1e6, histogram_percentile(all, 99) / 1e6,
+          histogram_percentile(all, 99.9) / 1e6);
+  if (unanswered > 0)
+    fprintf(stderr, "loadgen: %llu request(s) unanswered after the drain period\n",
+            (unsigned long long)unanswered);
+  free(latency);
+  free(service);
+  status = failed ? 1 : 0;
+
+out:
+  free(conns);
+  free(threads);
+  if (server > 0) {
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+  }
+  return status;
+}
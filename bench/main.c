@@ -0,0 +1,47 @@
+/**
+ * @file main.c
+ * @brief Entry point of the benchmark suite (see `make bench`).
+ *
+ * algebra-bench [--quick] [--filter NAME] [--port PORT]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "log.h"
+
+static void usage(const char *program) {
+  fprintf(stderr, "usage: %s [--quick] [--filter NAME] [--port PORT]\n", program);
+  fprintf(stderr, "  --quick        smaller sizes, for a fast smoke run\n");
+  fprintf(stderr, "  --filter NAME  only run benchmarks whose name contains NAME\n");
+  fprintf(stderr, "  --port PORT    port of the server spawned for server_* (default 18080)\n");
+}
+
+int main(int argc, char *argv[]) {
+  BenchOptions options = {.quick = 0, .filter = NULL, .server_port = 18080};
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--quick") == 0) {
+      options.quick = 1;
+    } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      options.filter = argv[++i];
+    } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+      options.server_port = atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  // Engine warnings would only add noise to the timings
+  log_set_level(LOG_LEVEL_ERROR);
+
+  BenchHarness *h = bench_harness_create(&options);
+  if (!h)
+    return 1;
+  bench_core(h);
+  bench_infinite(h);
+  bench_server(h);
+  bench_harness_destroy(h);
+  return 0;
+}
@@ -0,0 +1,234 @@
+/**
+ * @file server.c
+ * @brief Request rates of the XML server against a local client.
+ *
+ * The server runs in a child process on an in-memory schema, so its
+ * allocations are not counted. One client connection sends requests and
+ * waits for each response (round-trip latency), or sends them in pipelined
+ * batches (throughput).
+ */
+#define _GNU_SOURCE // memmem
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "log.h"
+#include "xml_server.h"
+
+#define SERVER_RESPONSE_END "</response>\n"
+#define SERVER_PIPELINE_DEPTH 32
+
+typedef struct {
+  int fd;
+  char *buffer; // responses received but not consumed yet
+  size_t size;
+  size_t capacity;
+} Client;
+
+// The server is stopped with SIGTERM; exiting normally lets profiling
+// runtimes (make pgo) write what the server did
+static void exit_on_signal(int signo) { exit(128 + signo); }
+
+static pid_t spawn_server(int port) {
+  pid_t pid = fork();
+  if (pid != 0)
+    return pid;
+  signal(SIGTERM, exit_on_signal);
+  // Keep the startup banner and request logs out of the results
+  if (!freopen("/dev/null", "w", stdout))
+    _exit(1);
+  log_set_level(LOG_LEVEL_ERROR);
+  ServerOptions options = {.port = port, .wal_path = NULL, .snapshot_path = NULL};
+  _exit(start_server(&options));
+}
+
+static int client_connect(Client *c, int port) {
+  memset(c, 0, sizeof(Client));
+  struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(port)};
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  // The server needs a moment to bind
+  for (int attempt = 0; attempt < 200; attempt++) {
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->fd < 0)
+      return -1;
+    if (connect(c->fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+      int one = 1;
+      setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      return 0;
+    }
+    close(c->fd);
+    struct timespec pause = {.tv_sec = 0, .tv_nsec = 10000000};
+    nanosleep(&pause, NULL);
+  }
+  c->fd = -1;
+  return -1;
+}
+
+static void client_close(Client *c) {
+  if (c->fd >= 0)
+    close(c->fd);
+  free(c->buffer);
+}
+
+static int client_send(Client *c, const char *data, size_t len) {
+  size_t sent = 0;
+  while (sent < len) {
+    ssize_t n = send(c->fd, data + sent, len - sent, 0);
+    if (n <= 0)
+      return -1;
+    sent += (size_t)n;
+  }
+  return 0;
+}
+
+// Read until `count` complete responses were consumed
+static int client_receive(Client *c, size_t count) {
+  size_t end_len = strlen(SERVER_RESPONSE_END);
+  while (count > 0) {
+    char *end = c->size ? memmem(c->buffer, c->size, SERVER_RESPONSE_END, end_len) : NULL;
+    if (end) {
+      size_t consumed = (size_t)(end - c->buffer) + end_len;
+      memmove(c->buffer, c->buffer + consumed, c->size - consumed);
+      c->size -= consumed;
+      count--;
+      continue;
+    }
+    if (c->capacity - c->size < 4096) {
+      size_t cap = c->capacity ? c->capacity * 2 : 65536;
+      char *grown = realloc(c->buffer, cap);
+      if (!grown)
+        return -1;
+      c->buffer = grown;
+      c->capacity = cap;
+    }
+    ssize_t n = recv(c->fd, c->buffer + c->size, c->capacity - c->size, 0);
+    if (n <= 0)
+      return -1;
+    c->size += (size_t)n;
+  }
+  return 0;
+}
+
+static int format_add_tuple(char *out, size_t size, const char *relation, int id) {
+  return snprintf(out, size,
+                  "<request><command>ADD_TUPLE</command><relation>%s</relation><attributes>"
+                  "<attribute><name>id</name><type>int</type><value>%d</value></attribute>"
+                  "<attribute><name>name</name><type>string</type><value>user%d</value>"
+                  "</attribute></attributes></request>",
+                  relation, id, id);
+}
+
+static int request(Client *c, const char *xml) {
+  return client_send(c, xml, strlen(xml)) < 0 || client_receive(c, 1) < 0 ? -1 : 0;
+}
+
+// Round trips of ADD_TUPLE into a relation that grows to `count` tuples
+static void bench_add_tuple(BenchHarness *h, Client *c, size_t count) {
+  Bench *b = bench_begin(h, "server_add_tuple", "\"requests\": %zu, \"pipeline\": 1", count);
+  if (!b)
+    return;
+  bench_untracked_allocations(b);
+  char xml[512];
+  for (size_t i = 0; i < count && c->fd >= 0; i++) {
+    format_add_tuple(xml, sizeof(xml), "Users", (int)i);
+    bench_op_start(b);
+    int status = request(c, xml);
+    bench_op_stop(b, 1);
+    if (status < 0) {
+      bench_fail(b, "request failed");
+      break;
+    }
+  }
+  bench_end(b);
+}
+
+// ADD_TUPLE sent SERVER_PIPELINE_DEPTH at a time; one operation is one batch
+static void bench_add_tuple_pipelined(BenchHarness *h, Client *c, size_t count) {
+  Bench *b = bench_begin(h, "server_add_tuple", "\"requests\": %zu, \"pipeline\": %d", count,
+                         SERVER_PIPELINE_DEPTH);
+  if (!b)
+    return;
+  bench_untracked_allocations(b);
+  if (request(c, "<request><command>CREATE_RELATION</command><name>Batched</name></request>") < 0)
+    bench_fail(b, "CREATE_RELATION failed");
+  char *batch = malloc(SERVER_PIPELINE_DEPTH * 512);
+  for (size_t i = 0; batch && i < count; i += SERVER_PIPELINE_DEPTH) {
+    size_t len = 0, n = 0;
+    for (; n < SERVER_PIPELINE_DEPTH && i + n < count; n++)
+      len += (size_t)format_add_tuple(batch + len, 512, "Batched", (int)(i + n));
+    bench_op_start(b);
+    int status = client_send(c, batch, len) < 0 || client_receive(c, n) < 0 ? -1 : 0;
+    bench_op_stop(b, n);
+    if (status < 0) {
+      bench_fail(b, "request failed");
+      break;
+    }
+  }
+  if (!batch)
+    bench_fail(b, "setup failed");
+  free(batch);
+  bench_end(b);
+}
+
+// Round trips of a read-only request
+static void bench_read(BenchHarness *h, Client *c, const char *command, const char *xml,
+                       size_t count) {
+  Bench *b = bench_begin(h, "server_read", "\"command\": \"%s\", \"requests\": %zu", command,
+                         count);
+  if (!b)
+    return;
+  bench_untracked_allocations(b);
+  for (size_t i = 0; i < count; i++) {
+    bench_op_start(b);
+    int status = request(c, xml);
+    bench_op_stop(b, 1);
+    if (status < 0) {
+      bench_fail(b, "request failed");
+      break;
+    }
+  }
+  bench_end(b);
+}
+
+void bench_server(BenchHarness *h) {
+  if (!bench_selected(h, "server_add_tuple") && !bench_selected(h, "server_read"))
+    return;
+  int quick = bench_options(h)->quick;
+  int port = bench_options(h)->server_port;
+  size_t count = quick ? 1000 : 10000;
+
+  fflush(stdout);
+  pid_t server = spawn_server(port);
+  if (server < 0) {
+    fprintf(stderr, "bench: could not start the server\n");
+    return;
+  }
+  Client c;
+  if (client_connect(&c, port) < 0) {
+    fprintf(stderr, "bench: could not connect to the server on port %d\n", port);
+  } else if (request(&c, "<request><command>CREATE_RELATION</command><name>Users</name>"
+                         "</request>") < 0) {
+    fprintf(stderr, "bench: CREATE_RELATION failed\n");
+  } else {
+    bench_add_tuple(h, &c, count);
+    bench_add_tuple_pipelined(h, &c, count);
+    bench_read(h, &c, "LIST_RELATIONS",
+               "<request><command>LIST_RELATIONS</command></request>", count);
+    // Users holds the tuples added above; a query returns all of them
+    bench_read(h, &c, "QUERY_RELATION",
+               "<request><command>QUERY_RELATION</command><relation>Users</relation></request>",
+               quick ? 20 : 100);
+  }
+  client_close(&c);
+  kill(server, SIGTERM);
+  waitpid(server, NULL, 0);
+}
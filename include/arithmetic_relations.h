@@ -57,9 +57,27 @@ Tuple *division_generator(size_t n, void *userdata);
  */
 void cantor_to_integer_pair(size_t n, int64_t *x, int64_t *y);
 
+/**
+ * Density estimates (DensityFn) for the arithmetic relations: the fraction of
+ * the first `prefix` enumerated tuples satisfying `attribute op constant`.
+ * Operands and the results of ADD and SUB are estimated in closed form from
+ * the shape of the Cantor enumeration, e.g. about 1 / sqrt(2 * prefix) of
+ * ADD has result = k for small k. MUL and DIV results return -1 (unknown),
+ * so infinite_relation_density samples them.
+ */
+double addition_density(size_t prefix, const char *attribute, CompareOp op,
+                        const Attribute *constant, void *userdata);
+double subtraction_density(size_t prefix, const char *attribute, CompareOp op,
+                           const Attribute *constant, void *userdata);
+double multiplication_density(size_t prefix, const char *attribute, CompareOp op,
+                              const Attribute *constant, void *userdata);
+double division_density(size_t prefix, const char *attribute, CompareOp op,
+                        const Attribute *constant, void *userdata);
+
 /**
  * Create standard arithmetic relations as infinite relations.
- * These can be used directly in joins with other relations.
+ * These can be used directly in joins with other relations, and carry the
+ * density estimates above.
  */
 InfiniteRelation *create_addition_relation(void);
 InfiniteRelation *create_subtraction_relation(void);
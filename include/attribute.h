@@ -2,9 +2,13 @@
 #define ATTRIBUTE_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 typedef enum { ATTR_INT, ATTR_RATIONAL, ATTR_STRING, ATTR_SET, ATTR_UNKNOWN } AttributeType;
 
+/** Comparison operators of selection conditions */
+typedef enum { CMP_EQ, CMP_NE, CMP_LT, CMP_LE, CMP_GT, CMP_GE } CompareOp;
+
 typedef struct {
   char *name;
   AttributeType type;
@@ -14,4 +18,11 @@ typedef struct {
 Attribute *attribute_create(const char *name, AttributeType type, void *value);
 void attribute_destroy(Attribute *attr);
 void attribute_print(const Attribute *attr);
+Attribute *attribute_copy(const Attribute *attr);
+int attribute_equals(const Attribute *a, const Attribute *b);
+uint64_t attribute_hash(const Attribute *attr);
+int attribute_value_equals(const Attribute *a, const Attribute *b);
+uint64_t attribute_value_hash(const Attribute *attr);
+int attribute_value_compare(const Attribute *a, const Attribute *b, int *result);
+int compare_op_holds(CompareOp op, int cmp);
 #endif // ATTRIBUTE_H
@@ -0,0 +1,135 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "attribute.h"
+#include "tuple.h"
+
+/**
+ * @file batch.h
+ * @brief Columnar tuple batches and the typed kernels that work on them.
+ *
+ * A ColumnBatch holds up to `capacity` rows as one typed array per
+ * attribute, plus a selection vector listing the rows that are still live.
+ * Kernels loop over those arrays directly, so filtering or hashing a batch
+ * costs no function-pointer call or attribute-name lookup per tuple.
+ *
+ * Rows are converted from and back to Tuples only at the edges of a plan.
+ */
+
+#define BATCH_CAPACITY 1024
+
+/**
+ * One attribute of a batch. Only ATTR_INT, ATTR_RATIONAL and ATTR_STRING
+ * columns are supported.
+ */
+typedef struct {
+  char *name;
+  AttributeType type;
+  void *values;   /** int[], double[] or char *[] (strings owned) depending on `type` */
+  uint8_t *valid; /** 0 where the row lacks the attribute */
+  int borrowed;   /** Arrays belong to another batch and are not freed */
+} ColumnVector;
+
+typedef struct ColumnBatch {
+  ColumnVector *columns;
+  size_t column_count;
+  size_t rows;        /** Physical rows filled */
+  size_t capacity;    /** Physical rows allocated */
+  uint32_t *selection; /** Live rows, ascending */
+  size_t selected;    /** Entries in `selection` */
+} ColumnBatch;
+
+/**
+ * @brief Create an empty batch with the given heading.
+ * @return The batch, or NULL on failure (including unsupported column types).
+ */
+ColumnBatch *column_batch_create(const char *const *names, const AttributeType *types,
+                                 size_t column_count, size_t capacity);
+
+/**
+ * @brief Create an empty batch whose heading is the attributes of `t`.
+ */
+ColumnBatch *column_batch_create_for_tuple(const Tuple *t, size_t capacity);
+
+/**
+ * @brief Create an empty batch with the same heading as `b` (names optionally prefixed).
+ */
+ColumnBatch *column_batch_create_like(const ColumnBatch *b, const char *prefix,
+                                      size_t capacity);
+
+void column_batch_destroy(ColumnBatch *b);
+
+/**
+ * @brief Drop every row (owned strings are freed).
+ */
+void column_batch_clear(ColumnBatch *b);
+
+/**
+ * @brief Grow the physical capacity to at least `capacity` rows.
+ * @return 0 on success, -1 on error.
+ */
+int column_batch_reserve(ColumnBatch *b, size_t capacity);
+
+/**
+ * @return Index of the column called `name`, or -1.
+ */
+int column_batch_find(const ColumnBatch *b, const char *name);
+
+/**
+ * @brief Append a tuple as a new selected row (attributes are copied).
+ *
+ * Attributes outside the heading are ignored; missing ones are marked invalid.
+ *
+ * @return 0 on success, -1 if the batch is full or memory runs out.
+ */
+int column_batch_append_tuple(ColumnBatch *b, Tuple *t);
+
+/**
+ * @brief Append an empty (all invalid) selected row.
+ * @return Index of the new row, or -1 if the batch is full.
+ */
+long column_batch_append_row(ColumnBatch *b);
+
+/**
+ * @brief Copy every column of `src` row `src_row` into `dst` row `dst_row`,
+ *        starting at column `dst_first` (column types must match).
+ * @return 0 on success, -1 if memory runs out.
+ */
+int column_batch_copy_values(ColumnBatch *dst, size_t dst_row, size_t dst_first,
+                             const ColumnBatch *src, size_t src_row);
+
+/**
+ * @brief Build a tuple from one physical row.
+ */
+Tuple *column_batch_row_to_tuple(const ColumnBatch *b, size_t row);
+
+/**
+ * @brief Whether two rows hold equal values in the given columns.
+ */
+int column_batch_rows_equal(const ColumnBatch *a, size_t row_a, const int *cols_a,
+                            const ColumnBatch *b, size_t row_b, const int *cols_b,
+                            size_t count);
+
+/* Kernels: each takes the live rows `sel[0..n)` and writes the surviving rows to
+   `out` (which may alias `sel`), returning how many survived. */
+
+size_t batch_select_int(const int *values, const uint8_t *valid, CompareOp op, int constant,
+                        const uint32_t *sel, size_t n, uint32_t *out);
+size_t batch_select_double(const double *values, const uint8_t *valid, CompareOp op,
+                           double constant, const uint32_t *sel, size_t n, uint32_t *out);
+size_t batch_select_string(char *const *values, const uint8_t *valid, CompareOp op,
+                           const char *constant, const uint32_t *sel, size_t n, uint32_t *out);
+
+/**
+ * @brief Hash column `c` for the rows `sel[0..n)` into `hashes[0..n)`.
+ *
+ * With `combine` set the column hash is mixed into the existing values, so
+ * calling it once per column hashes whole rows. Invalid entries hash alike.
+ */
+void batch_hash_column(const ColumnVector *c, const uint32_t *sel, size_t n, uint64_t *hashes,
+                       int combine);
+
+#endif // BATCH_H
@@ -0,0 +1,130 @@
+#ifndef BATCH_OPERATOR_H
+#define BATCH_OPERATOR_H
+
+#include <stddef.h>
+
+#include "batch.h"
+#include "infinite_relation.h"
+#include "operator.h"
+#include "predicate.h"
+#include "relation.h"
+
+/**
+ * @file batch_operator.h
+ * @brief Vectorized (batch-at-a-time) query operators.
+ *
+ * Batch operators follow the open/next/close protocol of operator.h, but
+ * next returns a ColumnBatch of up to BATCH_CAPACITY rows instead of one
+ * tuple. The batch belongs to the operator that produced it and stays valid
+ * until the next call to next or close; a consumer may narrow its selection
+ * vector but must not otherwise modify it. Returned batches always have at
+ * least one selected row.
+ *
+ * Batch columns hold ATTR_INT, ATTR_RATIONAL and ATTR_STRING values; other
+ * attributes are dropped when tuples enter a batch plan.
+ */
+
+typedef struct BatchOperator BatchOperator;
+
+typedef struct {
+  const char *name; /** Operator kind, e.g. "BatchScan" */
+  int (*open)(BatchOperator *op);
+  const ColumnBatch *(*next)(BatchOperator *op);
+  void (*close)(BatchOperator *op);
+  void (*destroy)(BatchOperator *op); /** Release the operator-specific state */
+} BatchOperatorVTable;
+
+struct BatchOperator {
+  const BatchOperatorVTable *vtable;
+  void *state;
+  BatchOperator *left;  /** First (or only) input, NULL for leaves */
+  BatchOperator *right; /** Second input of binary operators */
+};
+
+/**
+ * @brief Prepare an operator (and its inputs) to produce batches.
+ * @return 0 on success, -1 on error.
+ */
+int batch_operator_open(BatchOperator *op);
+
+/**
+ * @brief Produce the next batch (owned by the operator), or NULL at the end.
+ */
+const ColumnBatch *batch_operator_next(BatchOperator *op);
+
+/**
+ * @brief Release what open acquired. The operator may be opened again.
+ */
+void batch_operator_close(BatchOperator *op);
+
+/**
+ * @brief Destroy an operator and its inputs. Safe to pass NULL.
+ */
+void batch_operator_destroy(BatchOperator *op);
+
+/**
+ * @brief Run a plan to completion and collect its selected rows into a new relation.
+ *
+ * Opens, drains and closes `op` (but does not destroy it).
+ *
+ * @return The relation, or NULL on error.
+ */
+Relation *batch_collect(BatchOperator *op, const char *name);
+
+/**
+ * @brief Adapt a batch plan to the tuple-at-a-time interface (takes ownership of `op`).
+ */
+Operator *operator_from_batches(BatchOperator *op);
+
+/* Leaves */
+
+/**
+ * @brief Scan a finite relation in batches; the heading is that of its first tuple.
+ */
+BatchOperator *batch_scan(const Relation *r);
+
+/**
+ * @brief Scan the first `limit` tuples of an infinite relation.
+ *
+ * Uses the relation's BatchGeneratorFn when it has one and falls back to
+ * calling its TupleGeneratorFn once per row otherwise.
+ */
+BatchOperator *batch_generator_scan(InfiniteRelation *r, size_t limit);
+
+/* Unary operators (ownership of `child` is taken, also on failure) */
+
+/**
+ * @brief Keep the rows where `column` op `constant` holds.
+ *
+ * Rows lacking the column never qualify. An ATTR_INT column compared with
+ * an ATTR_RATIONAL constant (or the reverse) is compared as double.
+ */
+BatchOperator *batch_filter(BatchOperator *child, const char *column, CompareOp op,
+                            const Attribute *constant);
+
+/**
+ * @brief Keep the rows satisfying a finished predicate (see predicate_select_batch).
+ *
+ * The predicate is borrowed and must outlive the operator.
+ */
+BatchOperator *batch_filter_predicate(BatchOperator *child, Predicate *predicate);
+
+/**
+ * @brief Keep only the named columns, eliminating duplicate rows.
+ *
+ * The output borrows the child's column arrays, so projecting costs a hash
+ * per row rather than a copy.
+ */
+BatchOperator *batch_project(BatchOperator *child, const char **columns, size_t count);
+
+/* Binary operators (ownership of both inputs is taken, also on failure) */
+
+/**
+ * @brief Equi-join on `left_column` = `right_column`; the right input is buffered on open.
+ *
+ * Output columns are prefixed left_/right_, as with tuple_merge.
+ */
+BatchOperator *batch_hash_join(BatchOperator *left, BatchOperator *right,
+                               const char *left_column, const char *right_column);
+
+#endif // BATCH_OPERATOR_H
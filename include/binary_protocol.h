@@ -0,0 +1,90 @@
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include <stddef.h>
+
+#include "schema.h"
+#include "wire.h"
+
+/**
+ * @file binary_protocol.h
+ * @brief Compact binary protocol served alongside the XML protocol.
+ *
+ * A client selects the binary protocol by sending the 4-byte magic
+ * `RAB1` as the first bytes of the connection; anything else is treated as XML.
+ * After the magic, every request and response is a frame:
+ *
+ *   u32 payload_length | payload
+ *
+ * Request payloads start with a u32 request id chosen by the client and a
+ * u8 opcode (see BinaryOpcode):
+ * - CREATE_RELATION: string name
+ * - ADD_TUPLE:       string relation, u16 count, count × (string name, value)
+ * - QUERY_RELATION:  string relation
+ * - LIST_RELATIONS:  (empty)
+ * - CHECKPOINT:      (empty)
+ * - LOAD_RELATION:   string relation, string path (relative to the server's load directory)
+ * - EVALUATE:        string expression (syntax in expression_parser.h)
+ *
+ * Response payloads start with the request id, a u8 status (see BinaryStatus)
+ * and a string message, followed by an opcode-specific body:
+ * - QUERY_RELATION: string name, u64 cardinality, u16 columns,
+ *                   columns × (string name, u8 tag), u64 rows,
+ *                   rows × columns × value
+ * - EVALUATE:       the result relation, encoded as for QUERY_RELATION
+ * - LIST_RELATIONS: u32 count, count × (string name, u64 size)
+ * - LOAD_RELATION:  u64 rows loaded, u64 rows rejected
+ *
+ * Strings and values use the encoding in wire.h. The query heading is sent
+ * once and rows carry only the tagged values, in heading order.
+ *
+ * Clients may pipeline: several frames can be sent without waiting, and the
+ * responses come back in request order tagged with the request ids.
+ */
+
+#define BINARY_PROTOCOL_MAGIC "RAB1"
+#define BINARY_PROTOCOL_MAGIC_LEN 4
+#define BINARY_MAX_FRAME (64u * 1024u * 1024u)
+
+typedef enum {
+  BIN_OP_CREATE_RELATION = 1,
+  BIN_OP_ADD_TUPLE = 2,
+  BIN_OP_QUERY_RELATION = 3,
+  BIN_OP_LIST_RELATIONS = 4,
+  BIN_OP_CHECKPOINT = 5,
+  BIN_OP_LOAD_RELATION = 6,
+  BIN_OP_EVALUATE = 7
+} BinaryOpcode;
+
+typedef enum { BIN_STATUS_OK = 0, BIN_STATUS_ERROR = 1 } BinaryStatus;
+
+/**
+ * @brief Execute one binary request payload against the schema.
+ *
+ * Appends a complete response frame (length prefix included) to `response`.
+ *
+ * @return 0 on success, -1 if the response could not be allocated.
+ */
+int binary_process_request(Schema *schema, const unsigned char *payload, size_t len,
+                           WireBuffer *response);
+
+/**
+ * @brief Answer a request payload with an error, without executing it.
+ *
+ * Used when the mutations of a batch could not be made durable and were
+ * undone after the requests had been processed.
+ *
+ * @return 0 on success, -1 if the response could not be allocated.
+ */
+int binary_reject_request(const unsigned char *payload, size_t len, const char *message,
+                          WireBuffer *response);
+
+/**
+ * @brief Size of the frame at the start of `data`, including its length prefix.
+ *
+ * @return Frame size if the whole frame is available, 0 if more bytes are
+ *         needed, -1 if the declared length exceeds BINARY_MAX_FRAME.
+ */
+long binary_frame_size(const unsigned char *data, size_t avail);
+
+#endif // BINARY_PROTOCOL_H
@@ -57,4 +57,28 @@ void cardinality_print(Cardinality c);
  */
 Cardinality cardinality_product(Cardinality a, Cardinality b);
 
+/**
+ * @brief Compute the cardinality of a union.
+ *
+ * With an infinite input: the larger infinite type. Two finite inputs give
+ * the other count when one is empty and unknown otherwise (it depends on
+ * how many tuples they share).
+ */
+Cardinality cardinality_union(Cardinality a, Cardinality b);
+
+/**
+ * @brief Compute the cardinality of an intersection.
+ *
+ * Empty when either input is empty, unknown otherwise.
+ */
+Cardinality cardinality_intersection(Cardinality a, Cardinality b);
+
+/**
+ * @brief Compute the cardinality of a difference (a minus b).
+ *
+ * Empty when a is, a when b is empty, and a when a is infinite and b finite
+ * (removing finitely many elements keeps an infinite cardinal); unknown otherwise.
+ */
+Cardinality cardinality_difference(Cardinality a, Cardinality b);
+
 #endif // CARDINALITY_H
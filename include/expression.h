@@ -0,0 +1,183 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <stddef.h>
+
+#include "attribute.h"
+#include "cardinality.h"
+#include "operator.h"
+#include "relation.h"
+
+/**
+ * @file expression.h
+ * @brief Relational algebra expression trees, their optimizer and compiler.
+ *
+ * An Expression describes a query instead of running it, so the engine can
+ * rewrite it before execution. The operators are:
+ *
+ * - scan(R): the tuples of a finite relation (heading taken from its first tuple)
+ * - σ (select): keep tuples satisfying one comparison; conjunctions are
+ *   written as stacked selections
+ * - π (project): keep the named attributes, eliminating duplicates
+ * - ρ (rename): rename one attribute
+ * - ⋈ (join): natural join on the attributes both sides share; the result
+ *   has the union of both headings, without prefixes
+ * - × (product): every pair of tuples; headings should be disjoint
+ * - ∪ (union) and − (difference)
+ * - ÷ (divide): the quotient attributes of the dividend whose tuples pair
+ *   them with every divisor tuple, compared on the divisor attributes
+ *
+ * Because ⋈ keeps attribute names unchanged it is commutative and
+ * associative, which is what lets the optimizer reorder joins.
+ *
+ * Constructors take ownership of their child expressions, also on failure.
+ */
+
+typedef enum {
+  EXPR_SCAN,
+  EXPR_SELECT,
+  EXPR_PROJECT,
+  EXPR_RENAME,
+  EXPR_JOIN,
+  EXPR_PRODUCT,
+  EXPR_UNION,
+  EXPR_DIFFERENCE,
+  EXPR_DIVIDE
+} ExpressionKind;
+
+/**
+ * A selection comparison: `attribute op constant`, or `attribute op other`
+ * when `constant` is NULL.
+ */
+typedef struct {
+  char *attribute;
+  CompareOp op;
+  Attribute *constant;
+  char *other;
+} Condition;
+
+typedef struct Expression Expression;
+
+struct Expression {
+  ExpressionKind kind;
+  Expression *left;         /** Only child of σ, π and ρ; first input of binary operators */
+  Expression *right;        /** Second input of binary operators */
+  const Relation *relation; /** EXPR_SCAN (not owned) */
+  Condition condition;      /** EXPR_SELECT */
+  char **names;             /** EXPR_PROJECT attributes; EXPR_RENAME {from, to};
+                                EXPR_DIVIDE quotient then divisor attributes */
+  size_t name_count;
+  size_t quotient_count; /** EXPR_DIVIDE: names[0..quotient_count) form the quotient */
+};
+
+/* Construction */
+
+Expression *expression_scan(const Relation *r);
+
+/**
+ * @brief σ attribute op constant (the constant is copied).
+ */
+Expression *expression_select(Expression *child, const char *attribute, CompareOp op,
+                              const Attribute *constant);
+
+/**
+ * @brief σ attribute op other, comparing two attributes of the same tuple.
+ */
+Expression *expression_select_attributes(Expression *child, const char *attribute, CompareOp op,
+                                         const char *other);
+
+Expression *expression_project(Expression *child, const char **names, size_t count);
+Expression *expression_rename(Expression *child, const char *from, const char *to);
+Expression *expression_join(Expression *left, Expression *right);
+Expression *expression_product(Expression *left, Expression *right);
+Expression *expression_union(Expression *left, Expression *right);
+Expression *expression_difference(Expression *left, Expression *right);
+
+/**
+ * @brief dividend ÷ divisor, keeping `quotient` and matching on `divisor_attrs`.
+ *
+ * Fails (returning NULL) if an attribute is in both lists.
+ */
+Expression *expression_divide(Expression *dividend, Expression *divisor, const char **quotient,
+                              size_t quotient_count, const char **divisor_attrs,
+                              size_t divisor_count);
+
+/**
+ * @brief Destroy an expression tree. Safe to pass NULL.
+ */
+void expression_destroy(Expression *e);
+
+/* Planning */
+
+/**
+ * @brief Estimate the number of tuples an expression produces.
+ *
+ * Scans use the relation's Cardinality. Selections and joins use the
+ * statistics of the scanned relations (statistics.h) when they have them:
+ * a join on shared attributes produces |L| |R| / max(distinct(L.a), distinct(R.a)).
+ * Without statistics, selections apply fixed selectivities (1/10 for
+ * equality, 1/3 for ranges) and joins are assumed to produce about as many
+ * tuples as their larger input. Infinite inputs propagate through
+ * cardinality_product.
+ */
+Cardinality expression_estimate(const Expression *e);
+
+/**
+ * @brief Rewrite an expression into an equivalent, cheaper one (takes ownership).
+ *
+ * Rules, applied in order:
+ * - selections are pushed towards the scans, through ρ, π, ∪, − and into
+ *   the join inputs that hold their attributes
+ * - chains of joins are reordered greedily, starting from the smallest
+ *   estimated input and preferring inputs that share attributes with what
+ *   has been joined so far (the smaller side becomes the hash join build side)
+ * - projections are pushed into join inputs so only needed attributes are buffered
+ * - projections onto every attribute of their input, or directly under
+ *   another projection, are removed
+ *
+ * @return The optimized expression (possibly `e` itself), or NULL on error
+ *         (in which case `e` has been destroyed).
+ */
+Expression *expression_optimize(Expression *e);
+
+/**
+ * @brief Compile an expression into an operator pipeline.
+ *
+ * The plan refers to the expression's conditions, so `e` must outlive it.
+ */
+Operator *expression_compile(const Expression *e);
+
+/**
+ * @brief Compile and run an expression, collecting the result into a new relation.
+ */
+Relation *expression_evaluate(const Expression *e, const char *name);
+
+/**
+ * @brief Run an expression like expression_evaluate while profiling every operator.
+ *
+ * The report has one line per operator, indented by depth and labelled
+ * with the arguments of the expression node it came from, e.g.
+ *
+ *   NaturalJoin rows_in=300 rows_out=120 loops=1 time=0.412ms self=0.151ms ...
+ *     Select (= city "Lisbon") rows_in=100 rows_out=20 loops=1 ... predicate_calls=100
+ *       Scan People rows_in=0 rows_out=100 loops=1 ...
+ *
+ * (see operator_profile_report for the fields).
+ *
+ * @param report Set to the report (free it), or NULL on error.
+ * @return The result relation, or NULL on error.
+ */
+Relation *expression_evaluate_analyze(const Expression *e, const char *name, char **report);
+
+/**
+ * @brief Render an expression in the S-expression syntax of expression_parser.h.
+ * @return A newly allocated string, or NULL on error.
+ */
+char *expression_to_string(const Expression *e);
+
+/**
+ * @brief Print an expression to stdout.
+ */
+void expression_print(const Expression *e);
+
+#endif // EXPRESSION_H
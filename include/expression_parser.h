@@ -0,0 +1,62 @@
+#ifndef EXPRESSION_PARSER_H
+#define EXPRESSION_PARSER_H
+
+#include <stddef.h>
+
+#include "expression.h"
+#include "predicate.h"
+#include "schema.h"
+
+/**
+ * @file expression_parser.h
+ * @brief Text syntax for algebra expressions (used by the EVALUATE command).
+ *
+ * Expressions are S-expressions:
+ *
+ *   (scan R)
+ *   (select CONDITION E)       CONDITION: (OP A B) or (and CONDITION ...)
+ *   (project (A ...) E)
+ *   (rename FROM TO E)
+ *   (join E E)  (product E E)  (union E E)  (difference E E)
+ *   (divide (A ...) (B ...) E E)   quotient attributes A, divisor attributes B
+ *
+ * OP is one of = != < <= > >= or eq ne lt le gt ge (the word forms avoid
+ * `<` inside XML). An operand is an attribute name, an integer, a rational
+ * (written with a decimal point or exponent) or a double-quoted string with
+ * \" and \\ escapes. At least one operand of a comparison must be an
+ * attribute. Relation names are resolved in the schema.
+ *
+ * Example: (project (name) (select (and (ge age 18) (= city "Lisbon")) (join (scan P) (scan A))))
+ */
+
+/**
+ * @brief Parse an expression.
+ *
+ * @param schema Schema resolving the relations of scans.
+ * @param text Expression text (need not be NUL-terminated).
+ * @param len Length of the text.
+ * @param error Receives a message when parsing fails (may be NULL).
+ * @param error_size Size of `error`.
+ * @return The expression, or NULL on error.
+ */
+Expression *expression_parse(Schema *schema, const char *text, size_t len, char *error,
+                             size_t error_size);
+
+/**
+ * @brief Parse a predicate (see predicate.h) for the SELECT command.
+ *
+ * Predicates extend the conditions of `select`:
+ *
+ *   PREDICATE: (OP TERM TERM) | (and PREDICATE ...) | (or PREDICATE ...) | (not PREDICATE)
+ *   TERM: an operand as above, or (ARITH TERM TERM ...) with ARITH one of
+ *         + - * / or add sub mul div, folded to the left
+ *
+ * Unlike in `select`, both operands of a comparison may be constants.
+ *
+ * Example: (or (lt age 18) (and (not (= city "Lisbon")) (ge (* income 12) 50000)))
+ *
+ * @return The finished predicate, or NULL on error (with a message in `error`).
+ */
+Predicate *predicate_parse(const char *text, size_t len, char *error, size_t error_size);
+
+#endif // EXPRESSION_PARSER_H
@@ -3,12 +3,22 @@
 
 #include "arithmetic_relations.h"
 #include "attribute.h"
+#include "batch.h"
+#include "batch_operator.h"
 #include "cardinality.h"
+#include "expression.h"
+#include "index.h"
 #include "infinite_relation.h"
 #include "join.h"
+#include "loader.h"
+#include "metrics.h"
+#include "operator.h"
+#include "predicate.h"
 #include "primitive_relations.h"
 #include "relation.h"
+#include "scheduler.h"
 #include "set.h"
+#include "statistics.h"
 #include "tuple.h"
 
 #ifdef __cplusplus
@@ -22,14 +32,24 @@ extern void set_destroy(Set *set);
 extern int set_add(Set *set, void *elem);
 extern int set_remove(Set *set, const void *elem);
 extern int set_contains(const Set *set, const void *elem);
+extern int set_add_batch(Set *set, void *const *elems, size_t count);
 extern size_t set_size(const Set *set);
 extern void set_foreach(const Set *set, SetIterFn fn, void *userdata);
+extern void set_iter_init(const Set *set, SetIter *it);
+extern void *set_iter_next(SetIter *it);
 
 /* Attribute operations */
 
 extern Attribute *attribute_create(const char *name, AttributeType type, void *value);
 extern void attribute_destroy(Attribute *attr);
 extern void attribute_print(const Attribute *attr);
+extern Attribute *attribute_copy(const Attribute *attr);
+extern int attribute_equals(const Attribute *a, const Attribute *b);
+extern uint64_t attribute_hash(const Attribute *attr);
+extern int attribute_value_equals(const Attribute *a, const Attribute *b);
+extern uint64_t attribute_value_hash(const Attribute *attr);
+extern int attribute_value_compare(const Attribute *a, const Attribute *b, int *result);
+extern int compare_op_holds(CompareOp op, int cmp);
 
 /* Tuple operations */
 
@@ -39,6 +59,10 @@ extern int tuple_add_attribute(Tuple *t, Attribute *attr);
 extern void tuple_print(const Tuple *t);
 extern Attribute *tuple_find_attribute(Tuple *t, const char *name);
 extern int tuple_equals(Tuple *a, Tuple *b);
+extern Tuple *tuple_copy(const Tuple *t);
+extern uint64_t tuple_hash(const Tuple *t);
+extern int tuple_heading_equals(const Tuple *a, const Tuple *b);
+extern int tuple_heading_disjoint(const Tuple *a, const Tuple *b);
 
 /* Cardinality operations */
 
@@ -48,16 +72,33 @@ extern int cardinality_is_finite(Cardinality c);
 extern int cardinality_is_infinite(Cardinality c);
 extern void cardinality_print(Cardinality c);
 extern Cardinality cardinality_product(Cardinality a, Cardinality b);
+extern Cardinality cardinality_union(Cardinality a, Cardinality b);
+extern Cardinality cardinality_intersection(Cardinality a, Cardinality b);
+extern Cardinality cardinality_difference(Cardinality a, Cardinality b);
 
 /* Relation operations */
 
 extern Relation *relation_project(const Relation *r, const char **attr_names, size_t num_attrs,
                                   const char *new_name);
+extern Relation *relation_union(const Relation *left, const Relation *right,
+                                const char *new_name);
+extern Relation *relation_intersect(const Relation *left, const Relation *right,
+                                    const char *new_name);
+extern Relation *relation_difference(const Relation *left, const Relation *right,
+                                     const char *new_name);
+extern Relation *relation_product(const Relation *left, const Relation *right,
+                                  const char *new_name);
+extern Relation *relation_divide(const Relation *dividend, const Relation *divisor,
+                                 const char **quotient_attrs, size_t quotient_count,
+                                 const char **divisor_attrs, size_t divisor_count,
+                                 const char *new_name);
 extern Relation *relation_create(const char *name);
 extern int relation_add_tuple(Relation *r, Tuple *t);
+extern int relation_add_tuples(Relation *r, Tuple *const *tuples, size_t count);
 extern void relation_destroy(Relation *r);
 extern void relation_print(const Relation *r);
 extern Tuple *relation_find_tuple(Relation *r, Tuple *t);
+extern int relation_remove_tuple(Relation *r, Tuple *t);
 extern Relation *relation_create_with_cardinality(const char *name, Cardinality card);
 extern void relation_print_with_cardinality(const Relation *r);
 extern void relation_update_cardinality(Relation *r);
@@ -70,6 +111,7 @@ extern InfiniteRelation *infinite_relation_create_with_cardinality(const char *n
                                                                    TupleGeneratorFn fn,
                                                                    void *userdata,
                                                                    Cardinality card);
+extern void infinite_relation_set_batch_generator(InfiniteRelation *r, BatchGeneratorFn fn);
 extern void infinite_relation_destroy(InfiniteRelation *r);
 extern Tuple *infinite_relation_tuple_at(InfiniteRelation *r, size_t n);
 extern void infinite_relation_print_prefix(InfiniteRelation *r, size_t count);
@@ -78,6 +120,12 @@ extern Tuple *infinite_relation_find_tuple(InfiniteRelation *r, Tuple *target);
 extern InfiniteRelationIterator *infinite_relation_iterator_create(InfiniteRelation *r);
 extern Tuple *infinite_relation_iterator_next(InfiniteRelationIterator *iter);
 extern void infinite_relation_iterator_destroy(InfiniteRelationIterator *iter);
+extern InfiniteRelation *infinite_relation_union(InfiniteRelation *left, InfiniteRelation *right,
+                                                 const char *name);
+extern InfiniteRelation *infinite_relation_intersect(InfiniteRelation *left,
+                                                     InfiniteRelation *right, const char *name);
+extern InfiniteRelation *infinite_relation_difference(InfiniteRelation *left,
+                                                      InfiniteRelation *right, const char *name);
 
 /* Join operations */
 
@@ -87,13 +135,197 @@ extern InfiniteRelation *infinite_relation_join(InfiniteRelation *left, Infinite
                                                 JoinPredicateFn predicate, void *userdata,
                                                 const char *result_name,
                                                 Cardinality result_cardinality);
+extern InfiniteRelation *infinite_relation_join_parallel(InfiniteRelation *left,
+                                                         InfiniteRelation *right,
+                                                         JoinPredicateFn predicate, void *userdata,
+                                                         const char *result_name,
+                                                         Cardinality result_cardinality,
+                                                         Scheduler *scheduler);
+extern InfiniteRelation *infinite_relation_join_finite(const Relation *finite,
+                                                       const char *finite_attr, CompareOp op,
+                                                       InfiniteRelation *infinite,
+                                                       const char *infinite_attr,
+                                                       const char *result_name,
+                                                       Scheduler *scheduler);
+extern InfiniteRelation *infinite_relation_product(InfiniteRelation *left,
+                                                   InfiniteRelation *right,
+                                                   const char *result_name);
+extern Relation *relation_semi_join(const Relation *left, const Relation *right,
+                                    const char **attrs, size_t count, const char *result_name);
+extern Relation *relation_anti_join(const Relation *left, const Relation *right,
+                                    const char **attrs, size_t count, const char *result_name);
+extern Relation *relation_semi_join_infinite(const Relation *left, InfiniteRelation *right,
+                                             const char **attrs, size_t count,
+                                             size_t search_limit, size_t *undecided,
+                                             const char *result_name);
+extern Relation *relation_anti_join_infinite(const Relation *left, InfiniteRelation *right,
+                                             const char **attrs, size_t count,
+                                             size_t search_limit, size_t *undecided,
+                                             const char *result_name);
 extern Tuple *tuple_merge(Tuple *left, Tuple *right);
 
+/* Operators */
+
+extern int operator_open(Operator *op);
+extern Tuple *operator_next(Operator *op);
+extern void operator_close(Operator *op);
+extern void operator_destroy(Operator *op);
+extern Relation *operator_collect(Operator *op, const char *name);
+extern Operator *operator_scan(const Relation *r);
+extern Operator *operator_generator_scan(InfiniteRelation *r);
+extern Operator *operator_select(Operator *child, TuplePredicateFn predicate, void *userdata);
+extern Operator *operator_project(Operator *child, const char **attr_names, size_t num_attrs);
+extern Operator *operator_rename(Operator *child, const char *from, const char *to);
+extern Operator *operator_limit(Operator *child, size_t limit);
+extern Operator *operator_join(Operator *left, Operator *right, JoinPredicateFn predicate,
+                               void *userdata);
+extern Operator *operator_hash_join(Operator *left, Operator *right, const char *left_attr,
+                                    const char *right_attr);
+extern Operator *operator_natural_join(Operator *left, Operator *right, const char **attrs,
+                                       size_t count);
+extern Operator *operator_union(Operator *left, Operator *right);
+extern Operator *operator_difference(Operator *left, Operator *right);
+extern Operator *operator_intersect(Operator *left, Operator *right);
+extern Operator *operator_divide(Operator *dividend, Operator *divisor,
+                                 const char **quotient_attrs, size_t quotient_count,
+                                 const char **divisor_attrs, size_t divisor_count);
+extern Operator *operator_semi_join(Operator *left, Operator *right, const char **attrs,
+                                    size_t count);
+extern Operator *operator_anti_join(Operator *left, Operator *right, const char **attrs,
+                                    size_t count);
+extern Operator *operator_index_scan(const Relation *r, const RelationIndex *index,
+                                     const char *attr, CompareOp op, const Attribute *constant);
+extern Operator *operator_index_join(Operator *outer, const Relation *r,
+                                     const RelationIndex *index);
+
+/* Secondary indexes */
+
+extern RelationIndex *relation_create_index(Relation *r, IndexKind kind, const char *const *attrs,
+                                            size_t count);
+extern int relation_drop_index(Relation *r, RelationIndex *index);
+extern RelationIndex *relation_find_index(const Relation *r, const char *const *attrs,
+                                          size_t count, CompareOp op);
+extern int index_lookup(const RelationIndex *index, const Tuple *probe, CompareOp op,
+                        IndexCursor *cursor);
+extern Tuple *index_cursor_next(IndexCursor *cursor);
+extern size_t index_size(const RelationIndex *index);
+
+/* Expressions */
+
+extern Expression *expression_scan(const Relation *r);
+extern Expression *expression_select(Expression *child, const char *attribute, CompareOp op,
+                                     const Attribute *constant);
+extern Expression *expression_select_attributes(Expression *child, const char *attribute,
+                                                CompareOp op, const char *other);
+extern Expression *expression_project(Expression *child, const char **names, size_t count);
+extern Expression *expression_rename(Expression *child, const char *from, const char *to);
+extern Expression *expression_join(Expression *left, Expression *right);
+extern Expression *expression_product(Expression *left, Expression *right);
+extern Expression *expression_union(Expression *left, Expression *right);
+extern Expression *expression_difference(Expression *left, Expression *right);
+extern Expression *expression_divide(Expression *dividend, Expression *divisor,
+                                     const char **quotient, size_t quotient_count,
+                                     const char **divisor_attrs, size_t divisor_count);
+extern void expression_destroy(Expression *e);
+extern Cardinality expression_estimate(const Expression *e);
+extern Expression *expression_optimize(Expression *e);
+extern Operator *expression_compile(const Expression *e);
+extern Relation *expression_evaluate(const Expression *e, const char *name);
+extern char *expression_to_string(const Expression *e);
+extern void expression_print(const Expression *e);
+
+/* Parallel execution */
+
+extern Scheduler *scheduler_create(unsigned threads);
+extern void scheduler_destroy(Scheduler *s);
+extern unsigned scheduler_threads(const Scheduler *s);
+extern int scheduler_spawn(Scheduler *s, TaskGroup *group, TaskFn fn, void *arg);
+extern void scheduler_wait(Scheduler *s, TaskGroup *group);
+extern int scheduler_parallel_for(Scheduler *s, size_t count, size_t grain, RangeFn body,
+                                  void *arg);
+extern Relation *relation_hash_join(const Relation *left, const Relation *right,
+                                    const char **attrs, size_t count, Scheduler *scheduler,
+                                    const char *result_name);
+extern Tuple *tuple_natural_merge(const Tuple *left, const Tuple *right);
+
+/* Statistics */
+
+extern int relation_enable_statistics(Relation *r);
+extern RelationStatistics *statistics_create(void);
+extern void statistics_destroy(RelationStatistics *s);
+extern int statistics_add_tuple(RelationStatistics *s, const Tuple *t);
+extern AttributeStatistics *statistics_attribute(const RelationStatistics *s, const char *name);
+extern uint64_t statistics_distinct(const RelationStatistics *s, const char *name);
+extern const EquiDepthHistogram *statistics_histogram(AttributeStatistics *a);
+extern double statistics_selectivity(const RelationStatistics *s, const char *name, CompareOp op,
+                                     const Attribute *constant);
+extern double statistics_join_selectivity(const RelationStatistics *a, const char *left_name,
+                                          const RelationStatistics *b, const char *right_name);
+extern void statistics_print(const RelationStatistics *s);
+extern void infinite_relation_set_density(InfiniteRelation *r, DensityFn fn);
+extern double infinite_relation_density(InfiniteRelation *r, size_t prefix, const char *attribute,
+                                        CompareOp op, const Attribute *constant);
+extern void infinite_relation_set_index_range(InfiniteRelation *r, IndexRangeFn fn);
+extern InfiniteRelation *infinite_relation_restrict(InfiniteRelation *r, const char *attribute,
+                                                    CompareOp op, const Attribute *constant);
+
+/* Vectorized execution */
+
+extern ColumnBatch *column_batch_create(const char *const *names, const AttributeType *types,
+                                        size_t column_count, size_t capacity);
+extern ColumnBatch *column_batch_create_for_tuple(const Tuple *t, size_t capacity);
+extern void column_batch_destroy(ColumnBatch *b);
+extern int column_batch_append_tuple(ColumnBatch *b, Tuple *t);
+extern Tuple *column_batch_row_to_tuple(const ColumnBatch *b, size_t row);
+extern int batch_operator_open(BatchOperator *op);
+extern const ColumnBatch *batch_operator_next(BatchOperator *op);
+extern void batch_operator_close(BatchOperator *op);
+extern void batch_operator_destroy(BatchOperator *op);
+extern Relation *batch_collect(BatchOperator *op, const char *name);
+extern Operator *operator_from_batches(BatchOperator *op);
+extern BatchOperator *batch_scan(const Relation *r);
+extern BatchOperator *batch_generator_scan(InfiniteRelation *r, size_t limit);
+extern BatchOperator *batch_filter(BatchOperator *child, const char *column, CompareOp op,
+                                   const Attribute *constant);
+extern BatchOperator *batch_project(BatchOperator *child, const char **columns, size_t count);
+extern BatchOperator *batch_hash_join(BatchOperator *left, BatchOperator *right,
+                                      const char *left_column, const char *right_column);
+
+/* Predicates */
+
+extern Predicate *predicate_parse(const char *text, size_t len, char *error, size_t error_size);
+extern Predicate *predicate_create(void);
+extern void predicate_destroy(Predicate *p);
+extern int predicate_push_attribute(Predicate *p, const char *name);
+extern int predicate_push_constant(Predicate *p, const Attribute *constant);
+extern int predicate_emit(Predicate *p, PredicateOpcode opcode);
+extern int predicate_emit_compare(Predicate *p, CompareOp op);
+extern int predicate_finish(Predicate *p);
+extern int predicate_holds(Tuple *t, void *predicate);
+extern size_t predicate_select_batch(Predicate *p, const ColumnBatch *b, const uint32_t *sel,
+                                     size_t n, uint32_t *out);
+extern BatchOperator *batch_filter_predicate(BatchOperator *child, Predicate *predicate);
+
+/* Bulk loading */
+
+extern int loader_load(const char *path, const LoaderOptions *options, LoaderBatchFn sink,
+                       void *userdata, LoaderStats *stats);
+extern long loader_load_relation(const char *path, const LoaderOptions *options, Relation *r,
+                                 LoaderStats *stats);
+
 /* Primitive Relations */
 
 extern Tuple *successor_generator(size_t n, void *userdata);
 extern Tuple *natural_generator(size_t n, void *userdata);
 extern Tuple *integer_generator(size_t n, void *userdata);
+extern size_t successor_batch_generator(size_t start, size_t count, ColumnBatch *out,
+                                        void *userdata);
+extern size_t natural_batch_generator(size_t start, size_t count, ColumnBatch *out,
+                                      void *userdata);
+extern int natural_index_range(const char *attribute, CompareOp op, const Attribute *constant,
+                               IndexRange *out, void *userdata);
+extern int successor_index_range(const char *attribute, CompareOp op, const Attribute *constant,
+                                 IndexRange *out, void *userdata);
 
 /* Arithmetic Relations */
 
@@ -0,0 +1,82 @@
+#ifndef HASH_MAP_H
+#define HASH_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file hash_map.h
+ * @brief Generic separate-chaining hash map.
+ *
+ * Keys and values are opaque pointers; the map is parameterised by a hash
+ * function and an equality function in the same way Set is parameterised by
+ * a comparison function.
+ */
+
+typedef struct HashMap HashMap;
+
+/* Hash a key. */
+typedef uint64_t (*HashMapHashFn)(const void *key);
+
+/* Return 1 if the two keys are equal, 0 otherwise. */
+typedef int (*HashMapEqualsFn)(const void *a, const void *b);
+
+/* Free a key or value (optional, can be NULL). */
+typedef void (*HashMapFreeFn)(void *elem);
+
+/* Iteration callback. */
+typedef void (*HashMapIterFn)(void *key, void *value, void *userdata);
+
+HashMap *hash_map_create(HashMapHashFn hash, HashMapEqualsFn equals, HashMapFreeFn key_free,
+                         HashMapFreeFn value_free);
+void hash_map_destroy(HashMap *map);
+
+/**
+ * @brief Insert or replace the value for a key.
+ *
+ * When the key is already present its value is replaced (the old value is
+ * freed with value_free) and the new key pointer is freed with key_free.
+ *
+ * @return 1 if inserted, 0 if replaced, -1 on error.
+ */
+int hash_map_put(HashMap *map, void *key, void *value);
+
+/**
+ * @brief Look up the value stored for a key.
+ * @return The value, or NULL if absent.
+ */
+void *hash_map_get(const HashMap *map, const void *key);
+
+/**
+ * @brief Look up with a precomputed hash and a custom probe comparison.
+ *
+ * Allows lookups by a representation other than the stored key type (for
+ * instance a non NUL-terminated name). `equals` is called as
+ * equals(stored_key, probe).
+ */
+void *hash_map_find(const HashMap *map, uint64_t hash, const void *probe, HashMapEqualsFn equals);
+
+/**
+ * @brief Remove a key (freeing key and value with the map's free functions).
+ * @return 1 if removed, 0 if not found.
+ */
+int hash_map_remove(HashMap *map, const void *key);
+
+size_t hash_map_size(const HashMap *map);
+void hash_map_foreach(const HashMap *map, HashMapIterFn fn, void *userdata);
+
+/**
+ * @brief FNV-1a hash of a byte range.
+ */
+uint64_t hash_bytes(const void *data, size_t len);
+
+/**
+ * @brief Combine two hashes.
+ */
+uint64_t hash_combine(uint64_t seed, uint64_t h);
+
+/* Hash and equality for NUL-terminated string keys. */
+uint64_t hash_string(const void *key);
+int hash_string_equals(const void *a, const void *b);
+
+#endif // HASH_MAP_H
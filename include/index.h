@@ -0,0 +1,141 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stddef.h>
+
+#include "attribute.h"
+#include "relation.h"
+#include "tuple.h"
+
+/**
+ * @file index.h
+ * @brief Secondary indexes on the attributes of a finite Relation.
+ *
+ * An index maps the values of one or more attributes to the tuples holding
+ * them, so a lookup does not scan the relation:
+ *
+ * - INDEX_HASH answers equality on all of its attributes.
+ * - INDEX_ORDERED keeps the tuples sorted by its attributes (in order) and
+ *   also answers <, <=, > and >= when it has a single attribute.
+ *
+ * Values compare like selections do (attribute_value_compare): ints and
+ * rationals by number, strings with strcmp. Tuples lacking one of the
+ * indexed attributes, or holding a set there, are not indexed; no
+ * selection on them could hold.
+ *
+ * A relation owns its indexes. relation_add_tuple, relation_add_tuples and
+ * relation_remove_tuple keep them up to date; an index that cannot be
+ * updated (out of memory) is dropped, so lookups never miss tuples.
+ * Indexes live in memory only and are not written to snapshots.
+ *
+ * Example usage:
+ * @code{.c}
+ *   const char *attrs[] = {"age"};
+ *   relation_create_index(people, INDEX_ORDERED, attrs, 1);
+ *   RelationIndex *idx = relation_find_index(people, attrs, 1, CMP_GE);
+ *   IndexCursor c;
+ *   if (idx && index_lookup(idx, probe, CMP_GE, &c) == 0)   // probe holds age = 18
+ *     for (Tuple *t; (t = index_cursor_next(&c)) != NULL;)
+ *       tuple_print(t);
+ * @endcode
+ */
+
+typedef enum { INDEX_HASH, INDEX_ORDERED } IndexKind;
+
+typedef struct RelationIndex RelationIndex;
+
+/**
+ * Tuples found by a lookup, borrowed from the relation. Valid until the
+ * relation or its indexes are next modified.
+ */
+typedef struct {
+  Tuple *const *tuples;
+  size_t count;
+  size_t position;
+} IndexCursor;
+
+/**
+ * @brief Build an index over the tuples of `r` and keep it up to date.
+ *
+ * @param r Relation to index.
+ * @param kind INDEX_HASH or INDEX_ORDERED.
+ * @param attrs Names of the indexed attributes (copied).
+ * @param count Number of attributes (at least 1).
+ * @return The index (owned by `r`), or NULL on error or if `r` already has
+ *         an index of this kind on these attributes.
+ */
+RelationIndex *relation_create_index(Relation *r, IndexKind kind, const char *const *attrs,
+                                     size_t count);
+
+/**
+ * @brief Destroy one index of `r`.
+ * @return 0 on success, -1 if `index` does not belong to `r`.
+ */
+int relation_drop_index(Relation *r, RelationIndex *index);
+
+/**
+ * @brief Find an index of `r` that answers `attrs op values`.
+ *
+ * The index must be on exactly the attributes `attrs` (in any order) and
+ * support `op`; a hash index is preferred for equality.
+ *
+ * @return The index, or NULL if there is none.
+ */
+RelationIndex *relation_find_index(const Relation *r, const char *const *attrs, size_t count,
+                                   CompareOp op);
+
+/**
+ * @brief Find the tuples whose indexed attributes compare to those of `probe` by `op`.
+ *
+ * `probe` must hold every indexed attribute; other attributes are ignored.
+ * For an ordered index with several attributes only CMP_EQ is supported.
+ *
+ * @return 0 on success (the cursor may be empty), -1 if the index cannot
+ *         answer the lookup.
+ */
+int index_lookup(const RelationIndex *index, const Tuple *probe, CompareOp op,
+                 IndexCursor *cursor);
+
+/**
+ * @brief Next tuple of a lookup (borrowed), or NULL at the end.
+ */
+Tuple *index_cursor_next(IndexCursor *cursor);
+
+IndexKind index_kind(const RelationIndex *index);
+
+/**
+ * @brief The indexed attribute names, in index order.
+ */
+const char *const *index_attributes(const RelationIndex *index, size_t *count);
+
+/**
+ * @brief Number of tuples in the index.
+ */
+size_t index_size(const RelationIndex *index);
+
+/* Maintenance (called by relation.c) */
+
+/**
+ * @brief Add a new member of the owning relation to its indexes.
+ *
+ * Indexes that fail to update are dropped.
+ */
+void relation_indexes_add(Relation *r, Tuple *const *tuples, size_t count);
+
+/**
+ * @brief Remove a member of the owning relation from its indexes.
+ */
+void relation_indexes_remove(Relation *r, Tuple *t);
+
+/**
+ * @brief Destroy every index of a relation.
+ */
+void relation_indexes_destroy(Relation *r);
+
+/**
+ * @brief Equality lookup of `probe` in any index whose attributes it all holds.
+ * @return 0 with the candidates in `cursor`, -1 if no index applies.
+ */
+int relation_indexes_probe(const Relation *r, const Tuple *probe, IndexCursor *cursor);
+
+#endif // INDEX_H
@@ -10,6 +10,43 @@
  */
 typedef Tuple *(*TupleGeneratorFn)(size_t n, void *userdata);
 
+struct ColumnBatch;
+
+/**
+ * Optional columnar form of a generator: append the tuples for indices
+ * start..start+count-1 as rows of `out` (whose heading is that of tuple 0).
+ * Returns the number of rows appended; fewer than `count` means the
+ * generator ended.
+ */
+typedef size_t (*BatchGeneratorFn)(size_t start, size_t count, struct ColumnBatch *out,
+                                   void *userdata);
+
+/**
+ * Optional density estimate: the fraction of the first `prefix` tuples of the
+ * enumeration for which `attribute op constant` holds, or a negative value
+ * when the generator cannot tell.
+ */
+typedef double (*DensityFn)(size_t prefix, const char *attribute, CompareOp op,
+                            const Attribute *constant, void *userdata);
+
+/**
+ * Half-open range [begin, end) of generator indices; end is SIZE_MAX when unbounded.
+ */
+typedef struct {
+  size_t begin;
+  size_t end;
+} IndexRange;
+
+/**
+ * Optional index map of a generator: store in `out` the indices whose tuples
+ * satisfy `attribute op constant` — exactly those, not a superset — and
+ * return 0, or return -1 when they do not form one range (or the attribute
+ * is unknown). Generators whose attributes grow with the index can answer
+ * every comparison except !=.
+ */
+typedef int (*IndexRangeFn)(const char *attribute, CompareOp op, const Attribute *constant,
+                            IndexRange *out, void *userdata);
+
 /**
  * InfiniteRelation is just a handle for a generator + metadata.
  */
@@ -18,6 +55,10 @@ typedef struct {
   TupleGeneratorFn gen_fn;
   void *userdata;
   Cardinality cardinality;
+  BatchGeneratorFn batch_fn; /** NULL unless set with infinite_relation_set_batch_generator */
+  DensityFn density_fn;      /** NULL unless set with infinite_relation_set_density */
+  IndexRangeFn range_fn;     /** NULL unless set with infinite_relation_set_index_range */
+  void (*userdata_free)(void *userdata); /** Releases `userdata` on destroy (NULL: not owned) */
 } InfiniteRelation;
 
 typedef struct {
@@ -37,6 +78,77 @@ InfiniteRelation *infinite_relation_create(const char *name, TupleGeneratorFn fn
 InfiniteRelation *infinite_relation_create_with_cardinality(const char *name, TupleGeneratorFn fn,
                                                             void *userdata, Cardinality card);
 
+/**
+ * Attach a columnar generator producing the same tuples as `gen_fn`.
+ */
+void infinite_relation_set_batch_generator(InfiniteRelation *r, BatchGeneratorFn fn);
+
+/**
+ * Attach a density estimate for predicates over the generated tuples.
+ */
+void infinite_relation_set_density(InfiniteRelation *r, DensityFn fn);
+
+/**
+ * Estimate the fraction of the first `prefix` tuples satisfying
+ * `attribute op constant`. Uses the relation's DensityFn when it has one and
+ * otherwise evaluates the predicate on INFINITE_RELATION_DENSITY_SAMPLES
+ * tuples spread evenly over the prefix.
+ */
+double infinite_relation_density(InfiniteRelation *r, size_t prefix, const char *attribute,
+                                 CompareOp op, const Attribute *constant);
+
+#define INFINITE_RELATION_DENSITY_SAMPLES 256
+
+/**
+ * Attach an index map, which lets scans skip indices a constraint excludes.
+ */
+void infinite_relation_set_index_range(InfiniteRelation *r, IndexRangeFn fn);
+
+/**
+ * Restrict a relation to the tuples satisfying `attribute op constant`.
+ *
+ * The result enumerates only the index range given by the relation's
+ * IndexRangeFn, in the same order; when that range is bounded the result is
+ * finite and its cardinality exact. Restrictions compose, so constraints can
+ * be applied one after the other. `r` must outlive the result.
+ *
+ * @return The restricted relation (destroy with infinite_relation_destroy),
+ *         or NULL if `r` cannot map the constraint to a range.
+ */
+InfiniteRelation *infinite_relation_restrict(InfiniteRelation *r, const char *attribute,
+                                             CompareOp op, const Attribute *constant);
+
+/**
+ * Set algebra on infinite relations, evaluated lazily by dovetailing.
+ *
+ * The inputs are enumerated in alternation, so every tuple of either one is
+ * reached after finitely many steps even when both are infinite; a
+ * generator's first NULL (or its finite cardinality) ends its input. The
+ * result's tuples are distinct, come out in the order their steps decide
+ * them, and are remembered (as are the input tuples met), so the nth tuple
+ * is generated once. An intersection tuple is decided once both inputs have
+ * produced it; a difference needs a finite right input, which is read whole
+ * on the first call. The cardinality follows cardinality_union,
+ * cardinality_intersection and cardinality_difference. At most
+ * INFINITE_RELATION_MAX_STEPS steps are taken: a tuple not decided by then
+ * is NULL (the enumeration ends there).
+ *
+ * Headings are checked like for relation_union (on tuple 0 of each input).
+ * The inputs must outlive the result; destroy it with infinite_relation_destroy.
+ *
+ * @return The result, or NULL on error, if the headings differ, or (for a
+ *         difference) if `right` is not finite.
+ */
+InfiniteRelation *infinite_relation_union(InfiniteRelation *left, InfiniteRelation *right,
+                                          const char *name);
+InfiniteRelation *infinite_relation_intersect(InfiniteRelation *left, InfiniteRelation *right,
+                                              const char *name);
+InfiniteRelation *infinite_relation_difference(InfiniteRelation *left, InfiniteRelation *right,
+                                               const char *name);
+
+/** Steps a union, intersection or difference takes at most */
+#define INFINITE_RELATION_MAX_STEPS 100000000
+
 /**
  * Destroy an infinite relation handle (does not free generated tuples).
  */
@@ -1,9 +1,12 @@
 #ifndef JOIN_H
 #define JOIN_H
 
+#include <pthread.h>
+
 #include "cardinality.h"
 #include "infinite_relation.h"
 #include "relation.h"
+#include "scheduler.h"
 #include "tuple.h"
 
 /**
@@ -30,11 +33,96 @@ typedef int (*JoinPredicateFn)(Tuple *left, Tuple *right, void *userdata);
 Relation *relation_join(Relation *left, Relation *right, JoinPredicateFn predicate, void *userdata,
                         const char *result_name);
 
+/**
+ * @brief Natural join of two finite relations as a partitioned hash join.
+ *
+ * Both inputs are partitioned by the hash of their `attrs` values, then
+ * every partition is built (right side) and probed (left side) as an
+ * independent task. Each task writes to its own buffer, so the phases need
+ * no locks; the buffers are linked into the result at the end.
+ *
+ * Result tuples are the left tuple plus the right attributes it lacks (see
+ * tuple_natural_merge). Tuples missing a join attribute match nothing; with
+ * `count` 0 every pair matches (Cartesian product).
+ *
+ * @param left Probe side.
+ * @param right Build side (the smaller input, ideally).
+ * @param attrs Names of the join attributes.
+ * @param count Number of join attributes.
+ * @param scheduler Scheduler running the tasks, or NULL to join on the calling thread.
+ * @param result_name Name for the result relation.
+ * @return New relation, or NULL on error.
+ */
+Relation *relation_hash_join(const Relation *left, const Relation *right, const char **attrs,
+                             size_t count, Scheduler *scheduler, const char *result_name);
+
+/**
+ * @brief Semi-join (⋉) of two finite relations: the left tuples with a match on `attrs`.
+ *
+ * Left tuples are copied unchanged; nothing is merged. The right relation
+ * is hashed by its distinct `attrs` values and every left tuple probes it
+ * once (see operator_semi_join).
+ *
+ * @return New relation, or NULL on error.
+ */
+Relation *relation_semi_join(const Relation *left, const Relation *right, const char **attrs,
+                             size_t count, const char *result_name);
+
+/**
+ * @brief Anti-join (▷) of two finite relations: the left tuples without a match on `attrs`.
+ */
+Relation *relation_anti_join(const Relation *left, const Relation *right, const char **attrs,
+                             size_t count, const char *result_name);
+
+/** Right tuples a semi-join with an infinite relation reads at most, unless told otherwise */
+#define SEMI_JOIN_SEARCH_LIMIT 1000000
+
+/**
+ * @brief Semi-join of a finite relation with an infinite one on `attrs`.
+ *
+ * No pair is enumerated. When `right` has an IndexRangeFn answering
+ * equality on every join attribute, each left tuple only reads the right
+ * tuples in the range its values map to, and an empty range proves it has
+ * no match. Otherwise the left tuples share one scan of the first
+ * `search_limit` right tuples, which stops as soon as all of them matched.
+ * A right side of finite cardinality is read to its end, so every tuple is
+ * decided; against an infinite one, a tuple without a range or a match in
+ * the prefix is undecided and left out (also by the anti-join).
+ *
+ * @param left Finite input; its tuples are copied unchanged.
+ * @param right Infinite input.
+ * @param attrs Names of the join attributes.
+ * @param count Number of join attributes.
+ * @param search_limit Right tuples scanned at most (0: SEMI_JOIN_SEARCH_LIMIT),
+ *        also the largest index range read for one tuple.
+ * @param undecided If not NULL, receives the number of left tuples left undecided.
+ * @param result_name Name for the result relation.
+ * @return New relation, or NULL on error.
+ */
+Relation *relation_semi_join_infinite(const Relation *left, InfiniteRelation *right,
+                                      const char **attrs, size_t count, size_t search_limit,
+                                      size_t *undecided, const char *result_name);
+
+/**
+ * @brief Anti-join of a finite relation with an infinite one: the left tuples proven
+ *        to have no match (see relation_semi_join_infinite).
+ */
+Relation *relation_anti_join_infinite(const Relation *left, InfiniteRelation *right,
+                                      const char **attrs, size_t count, size_t search_limit,
+                                      size_t *undecided, const char *result_name);
+
 /**
  * @brief Join context for infinite relations.
  *
  * Since infinite joins can produce infinite results, we represent them
  * as infinite relations with a generator that performs the join on-demand.
+ *
+ * The generator remembers the Cantor index of every match it has found, so
+ * asking for the nth tuple only enumerates pairs beyond the last match seen
+ * (iterating the first K tuples costs one pass instead of K). With a
+ * scheduler, each stretch of pairs is split into ranges tested concurrently
+ * and the matches are merged back in index order, so the tuples come out in
+ * the same order as with sequential enumeration.
  */
 typedef struct {
   InfiniteRelation *left;
@@ -42,8 +130,20 @@ typedef struct {
   JoinPredicateFn predicate;
   void *userdata;
   Cardinality result_cardinality;
+  Scheduler *scheduler;   /** Runs the enumeration in parallel (NULL: calling thread) */
+  size_t *matches;        /** Cantor indices of the matches found so far, ascending */
+  size_t match_count;
+  size_t match_capacity;
+  size_t next_attempt;    /** First Cantor index not enumerated yet */
+  size_t attempt_limit;   /** Pairs enumerated at most */
+  size_t left_count;      /** When nonzero the left input is finite and pair k is
+                              (k mod left_count, k / left_count) instead of Cantor's */
+  pthread_mutex_t lock;   /** Serializes generator calls sharing the memo */
 } InfiniteJoinContext;
 
+/** Cantor indices an infinite join enumerates before giving up on the next match */
+#define INFINITE_JOIN_MAX_ATTEMPTS 100000000
+
 /**
  * @brief Perform a nested loop join on two infinite relations.
  *
@@ -62,6 +162,80 @@ InfiniteRelation *infinite_relation_join(InfiniteRelation *left, InfiniteRelatio
                                          JoinPredicateFn predicate, void *userdata,
                                          const char *result_name, Cardinality result_cardinality);
 
+/**
+ * @brief Like infinite_relation_join, enumerating pairs on `scheduler`'s workers.
+ *
+ * The generators of both inputs and the predicate are called concurrently,
+ * so they must be thread-safe (the primitive and arithmetic generators are).
+ */
+InfiniteRelation *infinite_relation_join_parallel(InfiniteRelation *left, InfiniteRelation *right,
+                                                  JoinPredicateFn predicate, void *userdata,
+                                                  const char *result_name,
+                                                  Cardinality result_cardinality,
+                                                  Scheduler *scheduler);
+
+/**
+ * @brief Report how far an infinite join has enumerated.
+ *
+ * `attempts` is the number of pairs tested so far and `matches` the number
+ * that satisfied the predicate; attempts / matches is the cost of a result
+ * tuple. Enumeration is memoized, so both only grow over the relation's life.
+ *
+ * @return 0 on success, -1 if `r` was not created by an infinite join.
+ */
+int infinite_relation_join_progress(InfiniteRelation *r, size_t *attempts, size_t *matches);
+
+/**
+ * @brief Join a finite relation with an infinite one on `finite_attr op infinite_attr`.
+ *
+ * When every value of `finite_attr` is numeric, their min/max bound
+ * `infinite_attr`: e.g. `finite.x < N.n` only needs n > min(x), and
+ * `finite.x > N.n` only n < max(x). When the infinite side has an
+ * IndexRangeFn the bounds are pushed into its scan with
+ * infinite_relation_restrict, so excluded indices are never generated; a
+ * bounded range leaves finitely many pairs to test, so enumeration ends.
+ * The result reports CARD_UNKNOWN all the same: how many of those pairs
+ * match is not known until they have been tested. Other values (strings,
+ * say) give no bound, and the infinite side is then enumerated
+ * unrestricted, up to INFINITE_JOIN_MAX_ATTEMPTS pairs.
+ *
+ * Pairs are enumerated as (finite tuple k mod |F|, infinite index k / |F|),
+ * so every pair is reached without Cantor's detour through absent indices.
+ * Result tuples are built with tuple_merge (left_/right_ prefixes), like
+ * the other infinite joins.
+ *
+ * @param finite Finite input (must outlive the result; later insertions are not seen).
+ * @param finite_attr Attribute of the finite tuples.
+ * @param op Comparison between the two attributes.
+ * @param infinite Infinite input (must outlive the result).
+ * @param infinite_attr Attribute of the generated tuples.
+ * @param result_name Name for the result relation.
+ * @param scheduler Scheduler enumerating pairs in parallel, or NULL.
+ * @return The join (destroy with infinite_relation_destroy), or NULL on error.
+ */
+InfiniteRelation *infinite_relation_join_finite(const Relation *finite, const char *finite_attr,
+                                                CompareOp op, InfiniteRelation *infinite,
+                                                const char *infinite_attr,
+                                                const char *result_name, Scheduler *scheduler);
+
+/**
+ * @brief Cartesian product of two relations with disjoint headings, evaluated lazily.
+ *
+ * Tuple n of the product is computed directly from n, without a memo: pairs
+ * are enumerated by Cantor pairing (dovetailing) when both inputs are
+ * infinite, and row by row over the finite input otherwise, so every pair
+ * is reached. Result tuples are built with tuple_natural_merge (no
+ * prefixes); the cardinality is cardinality_product of the inputs'.
+ *
+ * @param left First input (must outlive the result).
+ * @param right Second input (must outlive the result).
+ * @param result_name Name for the result relation.
+ * @return The product (destroy with infinite_relation_destroy), or NULL on
+ *         error or if tuple 0 of the inputs share an attribute.
+ */
+InfiniteRelation *infinite_relation_product(InfiniteRelation *left, InfiniteRelation *right,
+                                            const char *result_name);
+
 /**
  * @brief Merge two tuples into one (for join results).
  *
@@ -74,4 +248,12 @@ InfiniteRelation *infinite_relation_join(InfiniteRelation *left, InfiniteRelatio
  */
 Tuple *tuple_merge(Tuple *left, Tuple *right);
 
+/**
+ * @brief Merge two tuples that agree on their common attributes (for natural joins).
+ *
+ * @return A copy of `left` plus copies of the attributes of `right` whose
+ *         names `left` lacks, or NULL on error.
+ */
+Tuple *tuple_natural_merge(const Tuple *left, const Tuple *right);
+
 #endif // JOIN_H
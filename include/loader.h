@@ -0,0 +1,99 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "relation.h"
+#include "tuple.h"
+
+/**
+ * @file loader.h
+ * @brief Bulk loading of delimited text files (CSV, TSV) into relations.
+ *
+ * The first line is the heading: one attribute name per field, optionally
+ * typed as `name:int`, `name:rational` or `name:string`. Untyped columns are
+ * inferred from the first LOADER_INFER_ROWS rows (int, else rational, else
+ * string). Each following line is one tuple. Fields may be quoted with `"`
+ * (a doubled `""` inside quotes is a literal quote); a record never spans
+ * lines. An empty unquoted field leaves the attribute out of the tuple.
+ *
+ * The file is memory-mapped and processed in windows of LOADER_WINDOW bytes.
+ * Each window is split at line boundaries and parsed by several threads; the
+ * tuples are then handed over in batches, in file order.
+ */
+
+#define LOADER_INFER_ROWS 1000
+#define LOADER_WINDOW (64u * 1024u * 1024u)
+#define LOADER_DEFAULT_BATCH 4096
+#define LOADER_MAX_THREADS 64
+
+typedef struct {
+  char delimiter;     /** Field separator; 0 picks tab for `.tsv` files and ',' otherwise */
+  unsigned threads;   /** Parser threads; 0 uses one per online CPU */
+  size_t batch_rows;  /** Tuples per batch handed to the sink; 0 uses LOADER_DEFAULT_BATCH */
+} LoaderOptions;
+
+typedef struct {
+  uint64_t rows;     /** Tuples handed to the sink */
+  uint64_t rejected; /** Lines with the wrong number of fields or unparsable values */
+  size_t columns;    /** Attributes in the heading */
+} LoaderStats;
+
+/**
+ * @brief Receives a batch of newly created tuples.
+ *
+ * Ownership of the tuples passes to the sink, which must release them even
+ * when it fails.
+ *
+ * @return 0 to continue, -1 to abort the load.
+ */
+typedef int (*LoaderBatchFn)(Tuple *const *tuples, size_t count, void *userdata);
+
+/**
+ * @brief Parse a delimited file and stream its tuples to `sink` in batches.
+ *
+ * @param path File to load.
+ * @param options Options, or NULL for the defaults.
+ * @param sink Batch consumer.
+ * @param userdata Passed to the sink.
+ * @param stats Optional output: rows loaded and rejected.
+ * @return 0 on success, -1 if the file cannot be read, its heading is invalid,
+ *         memory runs out or the sink aborts.
+ */
+int loader_load(const char *path, const LoaderOptions *options, LoaderBatchFn sink, void *userdata,
+                LoaderStats *stats);
+
+/**
+ * @brief Load a delimited file into a relation.
+ *
+ * @return Number of tuples added, or -1 on error (see loader_load).
+ */
+long loader_load_relation(const char *path, const LoaderOptions *options, Relation *r,
+                          LoaderStats *stats);
+
+/**
+ * @brief Resolve a client-supplied path inside a load directory.
+ *
+ * `path` must be relative. It is joined to `dir` and canonicalized
+ * (following `..` and symbolic links); the result must still lie under `dir`.
+ *
+ * @return The canonical path (caller frees), or NULL if it is absolute,
+ *         escapes `dir` or does not exist.
+ */
+char *loader_resolve_path(const char *dir, const char *path);
+
+/* Forward declaration to avoid a cycle with schema.h */
+struct Schema;
+
+/**
+ * @brief Load a delimited file into a schema relation, creating it if needed.
+ *
+ * Creation and tuples are logged when the schema has a WAL attached.
+ *
+ * @return 0 on success, -1 on error (tuples of completed batches stay loaded).
+ */
+int loader_load_into(struct Schema *schema, const char *relation, const char *path,
+                     const LoaderOptions *options, LoaderStats *stats);
+
+#endif // LOADER_H
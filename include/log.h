@@ -0,0 +1,101 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdarg.h>
+#include <stdatomic.h>
+
+/**
+ * @file log.h
+ * @brief Leveled, asynchronous logging.
+ *
+ * Callers format a record and push it onto a lock-free ring buffer; a
+ * background thread writes records to the sink. Logging never blocks the
+ * caller: when the ring is full the record is dropped and counted.
+ *
+ * Records are written as one line of key=value pairs:
+ *
+ *   ts=2026-01-01T00:00:00.000Z level=info component=server msg="..."
+ *
+ * Until log_init is called, records are written synchronously to stderr.
+ */
+
+typedef enum {
+  LOG_LEVEL_ERROR = 0,
+  LOG_LEVEL_WARN = 1,
+  LOG_LEVEL_INFO = 2,
+  LOG_LEVEL_DEBUG = 3
+} LogLevel;
+
+/**
+ * @brief Start the background writer.
+ *
+ * @param level Most verbose level that is recorded.
+ * @param sample_every Keep 1 in `sample_every` records from sampled call sites (0 or 1 keeps all).
+ * @return 0 on success, -1 if the writer thread could not be started.
+ */
+int log_init(LogLevel level, unsigned sample_every);
+
+/**
+ * @brief Start the writer configured from the environment.
+ *
+ * ALGEBRA_LOG_LEVEL selects error|warn|info|debug (default info) and
+ * ALGEBRA_LOG_SAMPLE sets the sampling rate (default 1).
+ */
+int log_init_from_env(void);
+
+/**
+ * @brief Flush pending records and stop the writer.
+ */
+void log_shutdown(void);
+
+void log_set_level(LogLevel level);
+
+/**
+ * @brief Check whether records at `level` are recorded (cheap; use to guard expensive formatting).
+ */
+int log_enabled(LogLevel level);
+
+/**
+ * @brief Number of records dropped because the ring was full.
+ */
+unsigned long log_dropped(void);
+
+/**
+ * @brief Record a message. Prefer the log_* macros below.
+ *
+ * `component` is stored by pointer and must be a string literal.
+ */
+void log_write(LogLevel level, const char *component, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+void log_vwrite(LogLevel level, const char *component, const char *fmt, va_list args);
+
+/**
+ * @brief Decide whether a sampled call site should log this time.
+ */
+int log_sample(atomic_ulong *counter);
+
+#define log_error(component, ...) log_write(LOG_LEVEL_ERROR, component, __VA_ARGS__)
+#define log_warn(component, ...) log_write(LOG_LEVEL_WARN, component, __VA_ARGS__)
+#define log_info(component, ...)                                                                   \
+  do {                                                                                             \
+    if (log_enabled(LOG_LEVEL_INFO))                                                               \
+      log_write(LOG_LEVEL_INFO, component, __VA_ARGS__);                                           \
+  } while (0)
+#define log_debug(component, ...)                                                                  \
+  do {                                                                                             \
+    if (log_enabled(LOG_LEVEL_DEBUG))                                                              \
+      log_write(LOG_LEVEL_DEBUG, component, __VA_ARGS__);                                          \
+  } while (0)
+
+/**
+ * Log from a hot call site, keeping only 1 in N records (see log_init).
+ */
+#define log_sampled(level, component, ...)                                                         \
+  do {                                                                                             \
+    static atomic_ulong log_site_counter_;                                                         \
+    if (log_enabled(level) && log_sample(&log_site_counter_))                                      \
+      log_write(level, component, __VA_ARGS__);                                                    \
+  } while (0)
+
+#endif // LOG_H
@@ -0,0 +1,155 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file metrics.h
+ * @brief Low-overhead runtime counters and latency histograms.
+ *
+ * Every thread updates its own block of counters, so recording never
+ * contends: an update is a relaxed load and store on memory no other thread
+ * writes, which compiles to a plain add. Readers sum the blocks of all
+ * threads; the block of a thread that exits is folded into a shared total.
+ *
+ * metrics_to_text renders everything in the Prometheus text exposition
+ * format, which is what the server's STATS command returns.
+ *
+ * Building with -DALGEBRA_NO_METRICS turns the recording macros into no-ops.
+ */
+
+typedef enum {
+  METRIC_SET_ADDS,                /** set_add calls */
+  METRIC_TUPLES_CREATED,          /** Tuples allocated by tuple_create */
+  METRIC_TUPLES_GENERATED,        /** Tuples and batch rows produced by infinite generators */
+  METRIC_JOIN_PAIRS,              /** Predicate evaluations of relation_join */
+  METRIC_JOIN_MATCHES,            /** Pairs relation_join kept */
+  METRIC_INFINITE_JOIN_ATTEMPTS,  /** Pairs an infinite join tested */
+  METRIC_INFINITE_JOIN_MATCHES,   /** Pairs an infinite join kept */
+  METRIC_COUNTER_COUNT
+} MetricCounter;
+
+/** Server commands, each with a request count, an error count and a latency histogram */
+typedef enum {
+  METRIC_COMMAND_CREATE_RELATION,
+  METRIC_COMMAND_ADD_TUPLE,
+  METRIC_COMMAND_QUERY_RELATION,
+  METRIC_COMMAND_LIST_RELATIONS,
+  METRIC_COMMAND_EVALUATE,
+  METRIC_COMMAND_LOAD_RELATION,
+  METRIC_COMMAND_CHECKPOINT,
+  METRIC_COMMAND_STATS,
+  METRIC_COMMAND_EXPLAIN_ANALYZE,
+  METRIC_COMMAND_CREATE_INDEX,
+  METRIC_COMMAND_SELECT,
+  METRIC_COMMAND_OTHER, /** Malformed or unknown requests */
+  METRIC_COMMAND_COUNT
+} MetricCommand;
+
+/**
+ * Latency histogram buckets are log-linear: 2^METRICS_HISTOGRAM_SUB_BITS
+ * linear buckets per power of two, so a recorded value is off by at most
+ * 1/2^METRICS_HISTOGRAM_SUB_BITS (12.5%).
+ */
+#define METRICS_HISTOGRAM_SUB_BITS 3
+#define METRICS_HISTOGRAM_BUCKETS                                                                  \
+  ((64 - METRICS_HISTOGRAM_SUB_BITS + 1) << METRICS_HISTOGRAM_SUB_BITS)
+
+typedef struct {
+  atomic_uint_fast64_t count;
+  atomic_uint_fast64_t errors;
+  atomic_uint_fast64_t sum_ns;
+  atomic_uint_fast64_t buckets[METRICS_HISTOGRAM_BUCKETS];
+} MetricsHistogram;
+
+/** One thread's metrics; only its own thread writes to it */
+typedef struct MetricsBlock {
+  atomic_uint_fast64_t counters[METRIC_COUNTER_COUNT];
+  MetricsHistogram commands[METRIC_COMMAND_COUNT];
+  struct MetricsBlock *next; /** Registry of live threads */
+} MetricsBlock;
+
+/** Totals over all threads at the time of the call */
+typedef struct {
+  uint64_t counters[METRIC_COUNTER_COUNT];
+  struct {
+    uint64_t count;
+    uint64_t errors;
+    uint64_t sum_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns; /** Upper bound of the highest non-empty bucket */
+  } commands[METRIC_COMMAND_COUNT];
+} MetricsSnapshot;
+
+extern _Thread_local MetricsBlock *metrics_thread_block;
+
+/**
+ * @brief Allocate and register the calling thread's block (done on first use).
+ * @return The block, or NULL if it could not be allocated (updates are then dropped).
+ */
+MetricsBlock *metrics_register_thread(void);
+
+/**
+ * @brief Sum the blocks of all threads.
+ */
+void metrics_snapshot(MetricsSnapshot *out);
+
+/**
+ * @brief Zero every counter and histogram.
+ *
+ * Updates racing with the reset may survive it.
+ */
+void metrics_reset(void);
+
+/**
+ * @brief Render all metrics in the Prometheus text exposition format.
+ * @return Heap-allocated text (free it), or NULL on error.
+ */
+char *metrics_to_text(void);
+
+/** Name used in labels and the text format, e.g. "ADD_TUPLE" */
+const char *metrics_command_name(MetricCommand command);
+
+/** Monotonic clock in nanoseconds, for timing histogram samples */
+uint64_t metrics_now_ns(void);
+
+void metrics_block_observe(MetricsBlock *b, MetricCommand command, uint64_t ns, int failed);
+
+static inline MetricsBlock *metrics_block(void) {
+  MetricsBlock *b = metrics_thread_block;
+  return b ? b : metrics_register_thread();
+}
+
+// Single writer per block: a relaxed load and store is enough and avoids a locked add
+static inline void metrics_block_add(MetricsBlock *b, MetricCounter counter, uint64_t n) {
+  if (!b)
+    return;
+  atomic_uint_fast64_t *c = &b->counters[counter];
+  atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n,
+                        memory_order_relaxed);
+}
+
+/** Current value of a counter of the calling thread alone (for measuring a stretch of work) */
+static inline uint64_t metrics_thread_counter(MetricCounter counter) {
+  MetricsBlock *b = metrics_block();
+  return b ? atomic_load_explicit(&b->counters[counter], memory_order_relaxed) : 0;
+}
+
+#ifdef ALGEBRA_NO_METRICS
+// The arguments are not evaluated
+#define metrics_add(counter, n) ((void)sizeof(counter), (void)sizeof(n))
+#define metrics_observe(command, ns, failed)                                                       \
+  ((void)sizeof(command), (void)sizeof(ns), (void)sizeof(failed))
+#else
+/** Add `n` to a counter of the calling thread */
+#define metrics_add(counter, n) metrics_block_add(metrics_block(), (counter), (n))
+/** Record one request of `command` that took `ns` nanoseconds */
+#define metrics_observe(command, ns, failed)                                                       \
+  metrics_block_observe(metrics_block(), (command), (ns), (failed))
+#endif
+
+#endif // METRICS_H
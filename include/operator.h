@@ -0,0 +1,286 @@
+#ifndef OPERATOR_H
+#define OPERATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "index.h"
+#include "infinite_relation.h"
+#include "join.h"
+#include "relation.h"
+#include "tuple.h"
+
+/**
+ * @file operator.h
+ * @brief Pull-based (iterator) query operators.
+ *
+ * Every operator implements open/next/close. A plan is a tree of operators:
+ * the consumer calls next on the root, which pulls from its children one
+ * tuple at a time, so an expression of several operators runs without
+ * building intermediate relations.
+ *
+ * Tuples returned by next are freshly allocated and owned by the caller,
+ * like the tuples of a TupleGeneratorFn. Operators own their children:
+ * destroying the root destroys the whole plan.
+ *
+ * Operators whose semantics need a whole input (the build side of a join,
+ * the right side of a difference, duplicate elimination) buffer it on open,
+ * so those inputs must be finite. Scans of infinite relations are unbounded;
+ * put a limit above them.
+ */
+
+typedef struct Operator Operator;
+
+/**
+ * Selection predicate: returns 1 to keep the tuple, 0 to drop it.
+ */
+typedef int (*TuplePredicateFn)(Tuple *t, void *userdata);
+
+/**
+ * Execution counters of one operator, collected once profiling is enabled
+ * (operator_profile_enable).
+ *
+ * Times cover open, next and close and include the work of the inputs;
+ * subtract theirs for the operator's own share. tuples_created and set_adds
+ * are read from the calling thread's metrics (metrics.h), so they miss work
+ * done on other threads and stay 0 when metrics are compiled out.
+ */
+typedef struct {
+  char label[64];           /** Free-form description printed after the name */
+  uint64_t opens;           /** Times the operator was opened */
+  uint64_t rows_out;        /** Tuples returned by next */
+  uint64_t wall_ns;         /** Elapsed time */
+  uint64_t cpu_ns;          /** CPU time of the calling thread */
+  uint64_t tuples_created;  /** Tuples allocated */
+  uint64_t set_adds;        /** set_add calls, i.e. attribute and duplicate checks */
+  uint64_t predicate_calls; /** Predicate evaluations, or hash table probes of hash joins */
+  uint64_t pairs_tested;    /** Generator scans of infinite joins: pairs the join tested */
+} OperatorProfile;
+
+typedef struct {
+  const char *name; /** Operator kind, e.g. "Scan" */
+  int (*open)(Operator *op);
+  Tuple *(*next)(Operator *op);
+  void (*close)(Operator *op);
+  void (*destroy)(Operator *op); /** Release the operator-specific state */
+} OperatorVTable;
+
+struct Operator {
+  const OperatorVTable *vtable;
+  void *state;
+  Operator *left;  /** First (or only) input, NULL for leaves */
+  Operator *right; /** Second input of binary operators */
+  OperatorProfile *profile; /** NULL unless profiling is enabled */
+  int failed;               /** Set when next stopped on an error rather than the end */
+};
+
+/**
+ * @brief Prepare an operator (and its inputs) to produce tuples.
+ * @return 0 on success, -1 on error.
+ */
+int operator_open(Operator *op);
+
+/**
+ * @brief Produce the next tuple (owned by the caller), or NULL at the end.
+ *
+ * NULL is also returned on error, with `failed` set on the operator. A
+ * failure of an input is passed on to the operator reading it.
+ */
+Tuple *operator_next(Operator *op);
+
+/**
+ * @brief Record that `op` stopped on an error; for next implementations.
+ * @return NULL, so `return operator_fail(op);` ends the stream.
+ */
+Tuple *operator_fail(Operator *op);
+
+/**
+ * @brief Release what open acquired. The operator may be opened again.
+ */
+void operator_close(Operator *op);
+
+/**
+ * @brief Destroy an operator and its inputs. Safe to pass NULL.
+ */
+void operator_destroy(Operator *op);
+
+/**
+ * @brief Run a plan to completion and collect its tuples into a new relation.
+ *
+ * Opens, drains and closes `op` (but does not destroy it).
+ *
+ * @return The relation, or NULL on error (including an operator that failed
+ *         mid-stream, so a result is never silently truncated).
+ */
+Relation *operator_collect(Operator *op, const char *name);
+
+/* Profiling */
+
+/**
+ * @brief Collect an OperatorProfile for `op` and every operator below it.
+ *
+ * Enable before opening the plan. Profiling reads the clocks around every
+ * call, which costs on the order of a microsecond per tuple.
+ *
+ * @return 0 on success, -1 on allocation failure.
+ */
+int operator_profile_enable(Operator *op);
+
+/**
+ * @brief The profile of `op`, or NULL if profiling is not enabled.
+ */
+const OperatorProfile *operator_profile(const Operator *op);
+
+/**
+ * @brief Render the profiles of a plan as an indented tree, one operator per line.
+ *
+ * Each line shows the rows the operator consumed and produced, its total and
+ * own (minus inputs) wall time, CPU time, allocations, set_add calls and
+ * predicate calls; generator scans of infinite joins add the pairs tested
+ * and pairs per produced tuple.
+ *
+ * @return A newly allocated string, or NULL on error or if profiling is not enabled.
+ */
+char *operator_profile_report(const Operator *op);
+
+/* Leaves */
+
+/**
+ * @brief Scan the tuples of a finite relation (copies; the relation is not modified).
+ */
+Operator *operator_scan(const Relation *r);
+
+/**
+ * @brief Scan an infinite relation through an InfiniteRelationIterator.
+ *
+ * Produces generator indices 0, 1, 2, ... and ends only if the generator does.
+ */
+Operator *operator_generator_scan(InfiniteRelation *r);
+
+/**
+ * @brief The tuples of `r` whose `attr` compares to `constant` by `op`, found through `index`.
+ *
+ * Produces the same tuples as selecting on a scan of `r`. `index` must be an
+ * index of `r` that supports `op` on `attr` alone (see relation_find_index);
+ * the constant is copied.
+ */
+Operator *operator_index_scan(const Relation *r, const RelationIndex *index, const char *attr,
+                              CompareOp op, const Attribute *constant);
+
+/* Unary operators (ownership of `child` is taken, also on failure) */
+
+/**
+ * @brief Keep the tuples for which `predicate` holds.
+ */
+Operator *operator_select(Operator *child, TuplePredicateFn predicate, void *userdata);
+
+/**
+ * @brief Keep only the named attributes, eliminating duplicate tuples.
+ */
+Operator *operator_project(Operator *child, const char **attr_names, size_t num_attrs);
+
+/**
+ * @brief Rename attribute `from` to `to`.
+ *
+ * Tuples that already have an attribute named `to` are passed through unchanged.
+ */
+Operator *operator_rename(Operator *child, const char *from, const char *to);
+
+/**
+ * @brief Stop after `limit` tuples (bounds scans of infinite relations).
+ */
+Operator *operator_limit(Operator *child, size_t limit);
+
+/* Binary operators (ownership of both inputs is taken, also on failure) */
+
+/**
+ * @brief Nested loop join; the right input is buffered on open.
+ *
+ * Result tuples are built with tuple_merge (attributes prefixed left_/right_).
+ */
+Operator *operator_join(Operator *left, Operator *right, JoinPredicateFn predicate,
+                        void *userdata);
+
+/**
+ * @brief Equi-join on `left_attr` = `right_attr` using a hash table on the right input.
+ *
+ * Produces the same tuples as operator_join with an equality predicate, in
+ * time proportional to the inputs and the output rather than their product.
+ */
+Operator *operator_hash_join(Operator *left, Operator *right, const char *left_attr,
+                             const char *right_attr);
+
+/**
+ * @brief Natural join on the attributes `attrs`; the right input is buffered on open.
+ *
+ * Tuples match when they agree on every attribute in `attrs`. A result
+ * tuple holds the left attributes plus the right attributes not already
+ * present, without prefixes. With `count` 0 every pair matches (the
+ * Cartesian product).
+ */
+Operator *operator_natural_join(Operator *left, Operator *right, const char **attrs,
+                                size_t count);
+
+/**
+ * @brief Semi-join (⋉): the left tuples, unchanged, that agree with some right tuple on `attrs`.
+ *
+ * The right input is reduced to its distinct `attrs` values on open, so
+ * each left tuple costs one hash probe however many right tuples match it,
+ * and no merged tuple is built. Left tuples lacking one of `attrs` match
+ * nothing; with `count` 0 every left tuple matches unless the right input
+ * is empty.
+ */
+Operator *operator_semi_join(Operator *left, Operator *right, const char **attrs, size_t count);
+
+/**
+ * @brief Anti-join (▷): the left tuples, unchanged, that agree with no right tuple on `attrs`.
+ *
+ * Works like operator_semi_join and keeps the tuples it would drop.
+ */
+Operator *operator_anti_join(Operator *left, Operator *right, const char **attrs, size_t count);
+
+/**
+ * @brief Index nested loop join: natural join of `outer` with `r` on the attributes of `index`.
+ *
+ * Each outer tuple is looked up in `index` instead of buffering and hashing
+ * `r`. Produces the same tuples as operator_natural_join on those attributes,
+ * except that set-valued join attributes never match (they are not indexed).
+ * Ownership of `outer` is taken, also on failure.
+ */
+Operator *operator_index_join(Operator *outer, const Relation *r, const RelationIndex *index);
+
+/**
+ * @brief Set union; duplicates are eliminated.
+ */
+Operator *operator_union(Operator *left, Operator *right);
+
+/**
+ * @brief Set difference (left minus right); the right input is buffered on open.
+ */
+Operator *operator_difference(Operator *left, Operator *right);
+
+/**
+ * @brief Set intersection; the right input is buffered on open.
+ */
+Operator *operator_intersect(Operator *left, Operator *right);
+
+/**
+ * @brief Relational division (÷): the `quotient_attrs` values paired in `dividend`
+ *        with every tuple of `divisor`.
+ *
+ * Both inputs are read on open. The distinct `divisor_attrs` values of the
+ * divisor are numbered, then the dividend is grouped by its quotient values
+ * while counting, per group, the distinct divisor values it holds; a group
+ * qualifies when its count is that of the divisor. Every tuple costs a few
+ * hash probes, so division runs in time linear in its inputs. Tuples lacking
+ * one of the attributes are ignored, except that any dividend tuple with
+ * the quotient attributes forms a group (so dividing by an empty relation
+ * gives every group).
+ *
+ * @return The operator, or NULL on error or if an attribute is in both lists.
+ */
+Operator *operator_divide(Operator *dividend, Operator *divisor, const char **quotient_attrs,
+                          size_t quotient_count, const char **divisor_attrs,
+                          size_t divisor_count);
+
+#endif // OPERATOR_H
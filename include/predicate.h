@@ -0,0 +1,126 @@
+#ifndef PREDICATE_H
+#define PREDICATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "attribute.h"
+#include "batch.h"
+#include "tuple.h"
+
+/**
+ * @file predicate.h
+ * @brief Selection predicates compiled to a flat bytecode.
+ *
+ * A Predicate is a postfix program over a small value stack: comparisons,
+ * the boolean connectives and arithmetic over attributes and constants.
+ * Attribute names are collected into slots when the program is built, so
+ * evaluation reads each referenced attribute once and never searches for a
+ * name per instruction:
+ *
+ * - predicate_holds evaluates a tuple. Slots are resolved against the
+ *   heading of the previous tuple by position; a tuple with another heading
+ *   resolves them again.
+ * - predicate_select_batch evaluates a ColumnBatch one instruction at a time
+ *   over all selected rows, with slots bound to columns once per batch.
+ *
+ * Semantics follow selections (attribute_value_compare): ints and rationals
+ * compare by number, strings with strcmp. Arithmetic on two ints stays
+ * integral; / and any rational operand give a rational. A missing attribute,
+ * a string operand of arithmetic, integer overflow, division by zero and a
+ * comparison of a number with a string give an unknown value, and the
+ * connectives use three-valued logic: (or unknown true) holds, (not
+ * unknown) is unknown, and a tuple qualifies only if the result is true.
+ *
+ * The text syntax is parsed by predicate_parse (expression_parser.h):
+ *
+ * @code{.c}
+ *   const char *text = "(or (lt age 18) (ge (* age 2) 130))";
+ *   Predicate *p = predicate_parse(text, strlen(text), NULL, 0);
+ *   Operator *plan = operator_select(operator_scan(people), predicate_holds, p);
+ *   ...
+ *   operator_destroy(plan);
+ *   predicate_destroy(p);
+ * @endcode
+ *
+ * A predicate keeps evaluation scratch space, so evaluate it from one
+ * thread at a time.
+ */
+
+typedef enum {
+  PREDICATE_ATTRIBUTE, /** Push an attribute (operand: slot) */
+  PREDICATE_CONSTANT,  /** Push a constant (operand: constant index) */
+  PREDICATE_ADD,       /** Pop b, a; push a + b */
+  PREDICATE_SUB,
+  PREDICATE_MUL,
+  PREDICATE_DIV,
+  PREDICATE_COMPARE, /** Pop b, a; push a op b (operand: CompareOp) */
+  PREDICATE_AND,     /** Pop two booleans; push their conjunction */
+  PREDICATE_OR,
+  PREDICATE_NOT /** Negate the boolean on top */
+} PredicateOpcode;
+
+typedef struct {
+  PredicateOpcode opcode;
+  uint32_t operand;
+} PredicateInstruction;
+
+typedef struct Predicate Predicate;
+
+/* Construction: emit the program in postfix order, then call predicate_finish */
+
+Predicate *predicate_create(void);
+void predicate_destroy(Predicate *p);
+
+/**
+ * @brief Push the value of attribute `name` (copied).
+ * @return 0 on success, -1 on error.
+ */
+int predicate_push_attribute(Predicate *p, const char *name);
+
+/**
+ * @brief Push a constant (an int, rational or string attribute; its name is ignored).
+ * @return 0 on success, -1 on error or for another type.
+ */
+int predicate_push_constant(Predicate *p, const Attribute *constant);
+
+/**
+ * @brief Emit an arithmetic or boolean instruction (anything but the pushes and
+ *        PREDICATE_COMPARE).
+ * @return 0 on success, -1 if the operands on the stack do not fit.
+ */
+int predicate_emit(Predicate *p, PredicateOpcode opcode);
+
+/**
+ * @brief Emit a comparison of the two values on top of the stack.
+ */
+int predicate_emit_compare(Predicate *p, CompareOp op);
+
+/**
+ * @brief Check that the program leaves exactly one boolean and prepare it for evaluation.
+ * @return 0 on success, -1 on error. No instruction may be emitted afterwards.
+ */
+int predicate_finish(Predicate *p);
+
+/* Evaluation (of finished predicates) */
+
+/**
+ * @brief Whether `t` satisfies the predicate (a TuplePredicateFn, see operator.h).
+ *
+ * @param t Tuple to test.
+ * @param predicate The Predicate.
+ * @return 1 if the predicate is true for `t`, 0 if it is false or unknown.
+ */
+int predicate_holds(Tuple *t, void *predicate);
+
+/**
+ * @brief Keep the rows of `sel[0..n)` of `b` that satisfy the predicate.
+ *
+ * Works like the batch_select kernels of batch.h: the surviving rows are
+ * written to `out` (which may alias `sel`) and counted. Columns missing
+ * from `b` are unknown.
+ */
+size_t predicate_select_batch(Predicate *p, const ColumnBatch *b, const uint32_t *sel, size_t n,
+                              uint32_t *out);
+
+#endif // PREDICATE_H
@@ -1,6 +1,7 @@
 #ifndef PRIMITIVE_RELATIONS_H
 #define PRIMITIVE_RELATIONS_H
 
+#include "infinite_relation.h"
 #include "tuple.h"
 
 /* Generator for successor relation R = {(x, x+1) | x ∈ N} */
@@ -9,6 +10,21 @@ Tuple *successor_generator(size_t n, void *userdata);
 /* Generator for naturals N */
 Tuple *natural_generator(size_t n, void *userdata);
 
+struct ColumnBatch;
+
+/* Columnar forms of the generators above (see BatchGeneratorFn) */
+size_t successor_batch_generator(size_t start, size_t count, struct ColumnBatch *out,
+                                 void *userdata);
+size_t natural_batch_generator(size_t start, size_t count, struct ColumnBatch *out,
+                               void *userdata);
+
+/* Index maps of the generators above (see IndexRangeFn): n of N, and in/out of
+   the successor relation, grow with the index */
+int natural_index_range(const char *attribute, CompareOp op, const Attribute *constant,
+                        IndexRange *out, void *userdata);
+int successor_index_range(const char *attribute, CompareOp op, const Attribute *constant,
+                          IndexRange *out, void *userdata);
+
 /* Generator for integers Z */
 Tuple *integer_generator(size_t n, void *userdata);
 
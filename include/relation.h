@@ -5,10 +5,15 @@
 #include "set.h"
 #include "tuple.h"
 
+struct RelationStatistics;
+struct RelationIndex;
+
 typedef struct {
   char *name;
   Set *tuples;
   Cardinality cardinality;
+  struct RelationStatistics *statistics; /** NULL unless relation_enable_statistics was called */
+  struct RelationIndex *indexes;         /** Secondary indexes (see index.h), or NULL */
 } Relation;
 
 /**
@@ -31,9 +36,68 @@ typedef struct {
 Relation *relation_project(const Relation *r, const char **attr_names, size_t num_attrs,
                            const char *new_name);
 
+/**
+ * @brief Set algebra on finite relations.
+ *
+ * Union, intersection and difference need inputs with the same heading
+ * (attribute names and types, taken from the first tuple of each) and the
+ * product inputs with disjoint headings; an empty relation fits any heading.
+ * Tuples are hashed, so each operation runs in time linear in its inputs
+ * (plus the output, for the product), and the inputs are not modified.
+ *
+ * The result holds copies of the tuples and its exact count. When an input
+ * declares an infinite cardinality (see relation_create_with_cardinality),
+ * the result's is derived from the inputs' with the cardinality_* rules.
+ *
+ * @return A new Relation named `new_name`, or NULL on error or if the
+ *         headings do not fit.
+ *
+ * Example usage:
+ * @code{.c}
+ *   Relation *staff = relation_union(employees, contractors, "Staff");
+ *   Relation *pairs = relation_product(staff, projects, "Assignments");
+ * @endcode
+ */
+Relation *relation_union(const Relation *left, const Relation *right, const char *new_name);
+Relation *relation_intersect(const Relation *left, const Relation *right, const char *new_name);
+Relation *relation_difference(const Relation *left, const Relation *right, const char *new_name);
+Relation *relation_product(const Relation *left, const Relation *right, const char *new_name);
+
+/**
+ * @brief Relational division: the `quotient_attrs` values of `dividend` that
+ *        appear with every `divisor_attrs` value of `divisor`.
+ *
+ * Runs in time linear in the inputs by hashing and counting (see
+ * operator_divide), instead of the products and differences of the textbook
+ * definition.
+ *
+ * @return A new Relation with the quotient attributes, or NULL on error or
+ *         if an attribute is in both lists.
+ *
+ * Example usage:
+ * @code{.c}
+ *   // Students who took every required course
+ *   const char *quotient[] = {"student"}, *divisor[] = {"course"};
+ *   Relation *r = relation_divide(enrolled, required, quotient, 1, divisor, 1, "AllDone");
+ * @endcode
+ */
+Relation *relation_divide(const Relation *dividend, const Relation *divisor,
+                          const char **quotient_attrs, size_t quotient_count,
+                          const char **divisor_attrs, size_t divisor_count, const char *new_name);
+
 Relation *relation_create(const char *name);
 int relation_add_tuple(Relation *r, Tuple *t);
+int relation_add_tuples(Relation *r, Tuple *const *tuples, size_t count);
 void relation_destroy(Relation *r);
+
+/**
+ * @brief Remove a tuple (by identity) from a relation and its indexes, and destroy it.
+ *
+ * The relation's statistics are not updated; they keep describing a superset.
+ *
+ * @return 1 if removed, 0 if `t` is not a member.
+ */
+int relation_remove_tuple(Relation *r, Tuple *t);
 void relation_print(const Relation *r);
 Tuple *relation_find_tuple(Relation *r, Tuple *t);
 
@@ -0,0 +1,92 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+
+/**
+ * @file scheduler.h
+ * @brief Work-stealing task scheduler over a fixed pool of threads.
+ *
+ * Every worker owns a deque: tasks spawned by a worker go to the bottom of
+ * its own deque and it pops them from there (newest first, so the data they
+ * touch is still in cache), while idle workers steal from the top of other
+ * deques (oldest first, so they take large pieces of work). Tasks spawned
+ * from outside the pool are spread over the deques round-robin. Each deque
+ * has its own lock, so there is no global queue to contend on.
+ *
+ * Tasks are grouped in a TaskGroup so a caller can wait for the ones it
+ * spawned; a waiting thread runs pending tasks of that group instead of
+ * blocking, which makes it safe for tasks to spawn and wait on subtasks.
+ * It never runs tasks of other groups, so a caller may wait while holding a
+ * lock that unrelated tasks need (an infinite join enumerating under its
+ * memo lock, say) without those tasks re-entering it on the same thread.
+ *
+ * Example usage:
+ * @code{.c}
+ *   Scheduler *s = scheduler_create(0);  // one thread per online CPU
+ *   TaskGroup g = TASK_GROUP_INIT;
+ *   for (size_t i = 0; i < n; i++)
+ *     scheduler_spawn(s, &g, work, &items[i]);
+ *   scheduler_wait(s, &g);
+ *   scheduler_destroy(s);
+ * @endcode
+ */
+
+typedef void (*TaskFn)(void *arg);
+
+/** Range body of scheduler_parallel_for: process items begin..end-1 */
+typedef void (*RangeFn)(size_t begin, size_t end, void *arg);
+
+typedef struct Scheduler Scheduler;
+
+typedef struct {
+  size_t pending; /** Tasks spawned in the group that have not finished (updated atomically) */
+} TaskGroup;
+
+#define TASK_GROUP_INIT {0}
+
+/** Most threads a scheduler runs */
+#define SCHEDULER_MAX_THREADS 256
+
+/**
+ * @brief Start a scheduler.
+ * @param threads Number of worker threads; 0 uses one per online CPU.
+ * @return The scheduler, or NULL on error.
+ */
+Scheduler *scheduler_create(unsigned threads);
+
+/**
+ * @brief Stop the workers and destroy the scheduler. Pending tasks are run first.
+ */
+void scheduler_destroy(Scheduler *s);
+
+/**
+ * @brief Number of worker threads.
+ */
+unsigned scheduler_threads(const Scheduler *s);
+
+/**
+ * @brief Queue `fn(arg)` as part of `group`.
+ *
+ * @return 0 on success, -1 if the task could not be queued (it is then run
+ *         on the calling thread before returning, so the work is never lost).
+ */
+int scheduler_spawn(Scheduler *s, TaskGroup *group, TaskFn fn, void *arg);
+
+/**
+ * @brief Wait until every task of `group` has finished, running tasks of
+ *        `group` meanwhile.
+ */
+void scheduler_wait(Scheduler *s, TaskGroup *group);
+
+/**
+ * @brief Run `body` over 0..count-1 split into ranges of about `grain` items, and wait.
+ *
+ * A NULL scheduler runs the whole range on the calling thread, so callers
+ * need no separate sequential path.
+ *
+ * @return 0 on success, -1 on error (the range is still fully processed).
+ */
+int scheduler_parallel_for(Scheduler *s, size_t count, size_t grain, RangeFn body, void *arg);
+
+#endif // SCHEDULER_H
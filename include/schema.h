@@ -0,0 +1,148 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include "hash_map.h"
+#include "relation.h"
+#include "set.h"
+
+/**
+ * @file schema.h
+ * @brief Named collection of relations served by the engine.
+ *
+ * The schema owns every relation added to it and is shared by all the
+ * protocol front ends (XML and binary). Lookups by name are O(1).
+ *
+ * Relations loaded from a snapshot start out empty and are filled from the
+ * mapped file the first time they are looked up. Every relation of the
+ * schema maintains statistics (statistics.h) for the planner.
+ */
+
+typedef struct Wal Wal;
+typedef struct Snapshot Snapshot;
+typedef struct SchemaChange SchemaChange;
+
+typedef struct Schema {
+  HashMap *relations;     /** Relation name -> Relation* */
+  Wal *wal;               /** Log of mutations (NULL when not durable) */
+  Snapshot *snapshot;     /** Snapshot the schema was loaded from (or NULL) */
+  HashMap *unmaterialized; /** Relation name -> SnapshotRelation* not yet decoded */
+  char *snapshot_path;    /** Where checkpoints are written (or NULL) */
+  char *load_dir;         /** Only directory LOAD_RELATION may read (NULL disables it) */
+  int materialize_failed; /** A snapshot relation failed to decode (checkpoints are refused) */
+  SchemaChange *changes;  /** Mutations logged since the last commit, oldest first */
+  size_t change_count;
+  size_t change_capacity;
+} Schema;
+
+/**
+ * @brief Create an empty schema.
+ */
+Schema *schema_create(void);
+
+/**
+ * @brief Create a schema restored from a snapshot and a write-ahead log.
+ *
+ * Either path may be NULL. A missing snapshot file starts an empty schema;
+ * the snapshot path is kept as the target of schema_checkpoint. The WAL is
+ * opened (created if needed), replayed on top of the snapshot and attached.
+ *
+ * @return The schema, or NULL if either file could not be used.
+ */
+Schema *schema_open(const char *snapshot_path, const char *wal_path);
+
+/**
+ * @brief Destroy a schema, every relation it owns, its attached WAL and snapshot (if any).
+ */
+void schema_destroy(Schema *s);
+
+/**
+ * @brief Find a relation by name.
+ *
+ * @return The relation, or NULL if no relation has that name or its rows
+ *         could not be decoded from the snapshot (the lookup can be retried;
+ *         the relation stays backed by the snapshot).
+ */
+Relation *schema_find_relation(Schema *s, const char *name);
+
+/**
+ * @brief Find a relation by a name of `len` bytes (not necessarily NUL-terminated).
+ */
+Relation *schema_find_relation_n(Schema *s, const char *name, size_t len);
+
+/**
+ * @brief Add a relation to the schema (ownership is taken).
+ *
+ * @return 1 if added, 0 if a relation with that name already exists, -1 on error.
+ */
+int schema_add_relation(Schema *s, Relation *r);
+
+/**
+ * @brief Create a relation and add it to the schema, logging it if a WAL is attached.
+ *
+ * @param s Schema.
+ * @param name Name of the new relation.
+ * @param out Optional output: the created relation.
+ * @return 1 if created, 0 if the name is taken, -1 on error (including a
+ *         failure to log, in which case nothing is created).
+ */
+int schema_create_relation(Schema *s, const char *name, Relation **out);
+
+/**
+ * @brief Insert a tuple into a schema relation, logging it if a WAL is attached.
+ *
+ * @return Same as relation_add_tuple (1 added, 0 present, -1 error); a tuple
+ *         that cannot be logged is not added.
+ */
+int schema_insert_tuple(Schema *s, Relation *r, Tuple *t);
+
+/**
+ * @brief Make the mutations logged since the last commit durable (see wal_commit).
+ *
+ * If the log cannot commit them, the mutations are undone, newest first:
+ * tuples are removed from their relations and created relations are
+ * dropped, so memory matches the log again. Without a WAL this does nothing.
+ *
+ * @return 0 on success, -1 if the log failed and the mutations were undone.
+ */
+int schema_commit(Schema *s);
+
+/**
+ * @brief Register every relation of a snapshot without decoding its rows.
+ *
+ * The schema takes ownership of the snapshot. Each relation reports the
+ * snapshot's row count as its cardinality and is materialized on first lookup.
+ *
+ * @return Number of relations registered, or -1 on error.
+ */
+long schema_load_snapshot(Schema *s, Snapshot *snap);
+
+/**
+ * @brief Write a snapshot of the schema to its snapshot path and restart the WAL.
+ *
+ * Pending log records are committed first; the snapshot is tagged with the
+ * next epoch and the log is truncated to that epoch once the snapshot is durable.
+ *
+ * @return 0 on success, -1 on error (including when no snapshot path is set,
+ *         and once any relation failed to decode from the snapshot).
+ */
+int schema_checkpoint(Schema *s);
+
+/**
+ * @brief Insert a batch of newly created tuples, logging them if a WAL is attached.
+ *
+ * See relation_add_tuples: the tuples are linked in without membership checks.
+ *
+ * @return 0 on success (ownership of the tuples is taken), -1 on error (no
+ *         tuple is added or logged).
+ */
+int schema_insert_tuples(Schema *s, Relation *r, Tuple *const *tuples, size_t count);
+
+/**
+ * @brief Iterate over all relations in the schema (in no particular order).
+ *
+ * Relations are not materialized; use the relation's cardinality rather than
+ * its tuple set to size relations that may still live in the snapshot.
+ */
+void schema_foreach(Schema *s, SetIterFn fn, void *userdata);
+
+#endif // SCHEMA_H
@@ -21,8 +21,23 @@ int set_remove(Set *set, const void *elem);
 int set_contains(const Set *set, const void *elem);
 size_t set_size(const Set *set);
 
+/* Bulk insertion of elements known to be new: no membership checks are made,
+   so the elements must differ from each other and from every current member
+   (e.g. freshly allocated tuples in a relation compared by identity).
+   All or nothing: returns 0 on success, -1 on error (nothing is added). */
+int set_add_batch(Set *set, void *const *elems, size_t count);
+
 /* Iteration */
 typedef void (*SetIterFn)(void *elem, void *userdata);
 void set_foreach(const Set *set, SetIterFn fn, void *userdata);
 
+/* Cursor for pulling elements one at a time (see set_iter_next).
+   Invalidated by removing the element it is positioned on. */
+typedef struct {
+  const void *node;
+} SetIter;
+
+void set_iter_init(const Set *set, SetIter *it);
+void *set_iter_next(SetIter *it); /* NULL once every element was returned */
+
 #endif // SET_H
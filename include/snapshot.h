@@ -0,0 +1,83 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "relation.h"
+
+/**
+ * @file snapshot.h
+ * @brief Memory-mapped checkpoint files.
+ *
+ * A snapshot holds every relation of a schema:
+ *
+ *   header:    "RASN" | u32 version | u64 epoch | u32 relation_count |
+ *              u64 directory_offset | u64 directory_length
+ *   blocks:    per relation, its rows; each row is one value per heading column
+ *              (WIRE_NULL where a tuple lacks the attribute)
+ *   directory: per relation, string name | u64 rows | u16 columns |
+ *              columns × (string name, u8 tag) | u64 block_offset | u64 block_length
+ *
+ * Opening a snapshot maps the file and reads only the header and directory.
+ * Row blocks are decoded when a relation is first used, so startup cost is
+ * proportional to metadata rather than data. The epoch ties a snapshot to the
+ * write-ahead log generation that continues it.
+ */
+
+#define SNAPSHOT_MAGIC "RASN"
+#define SNAPSHOT_VERSION 1
+
+typedef struct Snapshot Snapshot;
+
+/**
+ * Directory entry of one relation in a snapshot.
+ */
+typedef struct {
+  char *name;
+  uint64_t rows;
+  uint16_t column_count;
+  char **column_names;
+  uint8_t *column_tags;
+  const unsigned char *block; /** Points into the mapping */
+  uint64_t block_length;
+} SnapshotRelation;
+
+/**
+ * @brief Map a snapshot file and read its directory.
+ * @return The snapshot, or NULL if the file is missing (errno ENOENT) or
+ *         malformed (errno EINVAL).
+ */
+Snapshot *snapshot_open(const char *path);
+
+/**
+ * @brief Unmap a snapshot. No relation may still need materializing from it.
+ */
+void snapshot_close(Snapshot *snap);
+
+uint64_t snapshot_epoch(const Snapshot *snap);
+size_t snapshot_relation_count(const Snapshot *snap);
+SnapshotRelation *snapshot_relation_at(Snapshot *snap, size_t i);
+
+/**
+ * @brief Decode a relation's row block into `r`.
+ * @return Number of tuples added, or -1 if the block is malformed.
+ */
+long snapshot_materialize(const SnapshotRelation *entry, Relation *r);
+
+/* Forward declaration to avoid a cycle with schema.h */
+struct Schema;
+
+/**
+ * @brief Write every relation of `schema` to `path` atomically.
+ *
+ * Relations that have not been materialized are copied block-for-block from
+ * the snapshot they were loaded from. The file is written to a temporary
+ * name, fsynced and renamed over `path`, and the directory is fsynced so the
+ * rename survives a crash.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int snapshot_write(struct Schema *schema, const char *path, uint64_t epoch);
+
+#endif // SNAPSHOT_H
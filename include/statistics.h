@@ -0,0 +1,143 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "attribute.h"
+#include "relation.h"
+#include "tuple.h"
+
+/**
+ * @file statistics.h
+ * @brief Per-relation and per-attribute statistics for cost-based planning.
+ *
+ * Statistics are maintained incrementally: every tuple added to a relation
+ * with statistics enabled updates, for each of its attributes,
+ *
+ * - the number of tuples having the attribute
+ * - a HyperLogLog sketch of the distinct values (about 3% standard error)
+ * - the numeric minimum and maximum
+ * - the most common values (Space-Saving summary, identified by value hash)
+ * - a reservoir sample of numeric values, from which an equi-depth
+ *   histogram is built when a planner asks for it
+ *
+ * Schema relations have statistics enabled; relations built by operators do not.
+ */
+
+#define STATISTICS_HLL_BITS 10
+#define STATISTICS_HLL_REGISTERS (1u << STATISTICS_HLL_BITS)
+#define STATISTICS_MCV_SIZE 16
+#define STATISTICS_SAMPLE_SIZE 1024
+#define STATISTICS_HISTOGRAM_BUCKETS 32
+
+/** Selectivity used when nothing is known about a predicate */
+#define STATISTICS_DEFAULT_EQ_SELECTIVITY 0.1
+#define STATISTICS_DEFAULT_RANGE_SELECTIVITY (1.0 / 3.0)
+
+typedef struct {
+  uint64_t hash;  /** attribute_value_hash of the value */
+  uint64_t count; /** Estimated occurrences (an upper bound) */
+  uint64_t error; /** How much `count` may overestimate */
+} MostCommonValue;
+
+typedef struct {
+  double bounds[STATISTICS_HISTOGRAM_BUCKETS + 1]; /** Bucket i spans bounds[i]..bounds[i+1] */
+  size_t bucket_count;                             /** 0 when there are no numeric values */
+} EquiDepthHistogram;
+
+typedef struct {
+  char *name;
+  uint64_t count;   /** Tuples having the attribute */
+  uint64_t numeric; /** Of which with an ATTR_INT or ATTR_RATIONAL value */
+  double min, max;  /** Numeric range (valid when numeric > 0) */
+  uint8_t hll[STATISTICS_HLL_REGISTERS];
+  MostCommonValue mcv[STATISTICS_MCV_SIZE];
+  size_t mcv_count;
+  double *sample; /** Reservoir of numeric values (NULL until the first one) */
+  size_t sample_count;
+  EquiDepthHistogram histogram;
+  uint64_t histogram_numeric; /** `numeric` when the histogram was last built */
+} AttributeStatistics;
+
+typedef struct RelationStatistics {
+  uint64_t rows;
+  AttributeStatistics **attributes;
+  size_t count;
+  size_t capacity;
+  uint64_t seed; /** State of the reservoir sampling generator */
+} RelationStatistics;
+
+/**
+ * @brief Create empty statistics.
+ */
+RelationStatistics *statistics_create(void);
+
+/**
+ * @brief Destroy statistics. Safe to pass NULL.
+ */
+void statistics_destroy(RelationStatistics *s);
+
+/**
+ * @brief Account for a tuple added to the relation.
+ * @return 0 on success, -1 on error (the statistics stay usable but incomplete).
+ */
+int statistics_add_tuple(RelationStatistics *s, const Tuple *t);
+
+/**
+ * @brief Statistics of one attribute, or NULL if no tuple has it.
+ */
+AttributeStatistics *statistics_attribute(const RelationStatistics *s, const char *name);
+
+/**
+ * @brief Estimated number of distinct values of an attribute (0 if unknown).
+ */
+uint64_t statistics_distinct(const RelationStatistics *s, const char *name);
+
+/**
+ * @brief Equi-depth histogram of an attribute's numeric values, rebuilt from
+ *        the sample if tuples were added since it was last built.
+ */
+const EquiDepthHistogram *statistics_histogram(AttributeStatistics *a);
+
+/**
+ * @brief Estimated fraction of tuples satisfying `name op constant`.
+ *
+ * Equality uses the most common values, then assumes the remaining tuples
+ * spread evenly over the remaining distinct values; ranges use the
+ * histogram. Tuples lacking the attribute never qualify.
+ *
+ * @return A fraction in [0, 1]; the default selectivities when the
+ *         attribute has no statistics.
+ */
+double statistics_selectivity(const RelationStatistics *s, const char *name, CompareOp op,
+                              const Attribute *constant);
+
+/**
+ * @brief Estimated fraction of pairs satisfying `a.left_name = b.right_name`.
+ *
+ * Assumes the side with fewer distinct values has all its values on the other
+ * side: 1 / max(distinct(a), distinct(b)).
+ *
+ * @return The fraction, or -1 if either side has no distinct count.
+ */
+double statistics_join_selectivity(const RelationStatistics *a, const char *left_name,
+                                   const RelationStatistics *b, const char *right_name);
+
+/**
+ * @brief Combine P(value < k) and P(value = k) into the fraction satisfying `value op k`.
+ */
+double selectivity_from_distribution(CompareOp op, double less, double equal);
+
+/**
+ * @brief Print the statistics of a relation to stdout.
+ */
+void statistics_print(const RelationStatistics *s);
+
+/**
+ * @brief Start maintaining statistics for a relation, from the tuples it already has.
+ * @return 0 on success (or if already enabled), -1 on error.
+ */
+int relation_enable_statistics(Relation *r);
+
+#endif // STATISTICS_H
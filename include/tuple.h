@@ -12,4 +12,8 @@ int tuple_add_attribute(Tuple *t, Attribute *attr);
 void tuple_print(const Tuple *t);
 Attribute *tuple_find_attribute(Tuple *t, const char *name);
 int tuple_equals(Tuple *a, Tuple *b);
+Tuple *tuple_copy(const Tuple *t);
+uint64_t tuple_hash(const Tuple *t);
+int tuple_heading_equals(const Tuple *a, const Tuple *b);
+int tuple_heading_disjoint(const Tuple *a, const Tuple *b);
 #endif // TUPLE_H
@@ -0,0 +1,120 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "relation.h"
+#include "tuple.h"
+
+/**
+ * @file wal.h
+ * @brief Append-only write-ahead log of schema mutations.
+ *
+ * The log starts with the magic `RAWL`, a u32 version and a u64 epoch,
+ * followed by records:
+ *
+ *   u32 payload_length | u32 crc32(payload) | payload
+ *
+ * where the payload is a u8 record type (see WalRecordType) and its body,
+ * encoded with wire.h:
+ * - CREATE_RELATION: string name
+ * - ADD_TUPLE:       string relation, u16 count, count × (string name, value)
+ *
+ * Records are buffered in memory and made durable by wal_commit, which
+ * writes the whole batch and issues a single fsync (group commit).
+ *
+ * The epoch numbers log generations: a checkpoint writes a snapshot tagged
+ * with the next epoch and then restarts the log at that epoch, so a log
+ * older than the snapshot is recognised as already captured by it.
+ */
+
+#define WAL_MAGIC "RAWL"
+#define WAL_VERSION 2
+
+/** Most attributes an ADD_TUPLE record can hold (its count is a u16) */
+#define WAL_MAX_ATTRIBUTES UINT16_MAX
+
+typedef enum { WAL_CREATE_RELATION = 1, WAL_ADD_TUPLE = 2 } WalRecordType;
+
+typedef struct Wal Wal;
+
+/* Forward declaration to avoid a cycle with schema.h */
+struct Schema;
+
+/**
+ * @brief Open (or create) a log for appending.
+ *
+ * An existing log must be replayed with wal_replay before new records are appended.
+ *
+ * @return The log, or NULL on failure.
+ */
+Wal *wal_open(const char *path);
+
+/**
+ * @brief Apply every intact record in the log to `schema`.
+ *
+ * Replay stops at the first torn or corrupt record. That record and
+ * anything after it are cut off so new appends follow the last good one.
+ *
+ * @return Number of records applied, or -1 on I/O error.
+ */
+long wal_replay(Wal *wal, struct Schema *schema);
+
+/**
+ * @brief Buffer a CREATE_RELATION record.
+ * @return 0 on success, -1 on error.
+ */
+int wal_log_create_relation(Wal *wal, const char *name);
+
+/**
+ * @brief Buffer an ADD_TUPLE record.
+ * @return 0 on success, -1 on error (including a tuple of more than
+ *         WAL_MAX_ATTRIBUTES attributes, which the record cannot count).
+ */
+int wal_log_add_tuple(Wal *wal, const char *relation, const Tuple *t);
+
+/**
+ * @brief Write all buffered records and fsync once.
+ *
+ * On failure the buffered records are discarded and the file is cut back to
+ * the end of the last successful commit, so none of the batch is replayed.
+ * If the file cannot be cut back, every later commit fails until wal_truncate
+ * starts a new generation.
+ *
+ * @return 0 on success (or nothing pending), -1 on I/O error.
+ */
+int wal_commit(Wal *wal);
+
+/**
+ * @brief Number of records buffered since the last commit.
+ */
+size_t wal_pending(const Wal *wal);
+
+/**
+ * @brief Discard buffered records beyond the first `keep`, including any
+ *        partially encoded one.
+ *
+ * Lets a caller that logs ahead of a mutation take the record back when the
+ * mutation is not applied: save wal_pending before logging, roll back to it.
+ */
+void wal_rollback(Wal *wal, size_t keep);
+
+/**
+ * @brief Epoch of the log's current generation.
+ */
+uint64_t wal_epoch(const Wal *wal);
+
+/**
+ * @brief Discard the log's contents and start generation `epoch`
+ *        (after a checkpoint has captured them).
+ * @return 0 on success, -1 on I/O error.
+ */
+int wal_truncate(Wal *wal, uint64_t epoch);
+
+/**
+ * @brief Commit pending records and close the log.
+ */
+void wal_close(Wal *wal);
+
+#endif // WAL_H
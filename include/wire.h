@@ -0,0 +1,112 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "attribute.h"
+
+/**
+ * @file wire.h
+ * @brief Compact binary encoding of engine values.
+ *
+ * All integers are written in network byte order. Strings are length-prefixed
+ * with a u32 and are not NUL-terminated on the wire. Attribute values are
+ * written as a one-byte type tag followed by the payload for that type.
+ */
+
+/** Type tags used for attribute values on the wire. */
+typedef enum {
+  WIRE_NULL = 0,     /** Missing value (no payload) */
+  WIRE_INT = 1,      /** i64 */
+  WIRE_RATIONAL = 2, /** IEEE-754 double, as u64 bits */
+  WIRE_STRING = 3    /** u32 length + bytes */
+} WireTag;
+
+/**
+ * Growable output buffer.
+ */
+typedef struct {
+  unsigned char *data;
+  size_t size;
+  size_t capacity;
+} WireBuffer;
+
+/**
+ * Bounds-checked reader over a byte range. Any out-of-bounds read sets
+ * `error` and makes subsequent reads return zero values.
+ */
+typedef struct {
+  const unsigned char *data;
+  size_t size;
+  size_t offset;
+  int error;
+} WireReader;
+
+void wire_buffer_init(WireBuffer *b);
+void wire_buffer_free(WireBuffer *b);
+void wire_buffer_reset(WireBuffer *b);
+
+/**
+ * @brief Ensure room for `extra` more bytes.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int wire_buffer_reserve(WireBuffer *b, size_t extra);
+
+int wire_put_u8(WireBuffer *b, uint8_t v);
+int wire_put_u16(WireBuffer *b, uint16_t v);
+int wire_put_u32(WireBuffer *b, uint32_t v);
+int wire_put_u64(WireBuffer *b, uint64_t v);
+int wire_put_i64(WireBuffer *b, int64_t v);
+int wire_put_f64(WireBuffer *b, double v);
+int wire_put_bytes(WireBuffer *b, const void *data, size_t len);
+int wire_put_string(WireBuffer *b, const char *s, size_t len);
+
+/**
+ * @brief Write a tagged attribute value (WIRE_NULL when `attr` is NULL).
+ */
+int wire_put_value(WireBuffer *b, const Attribute *attr);
+
+/**
+ * @brief Overwrite a u32 previously reserved at `offset` (for length prefixes).
+ */
+void wire_patch_u32(WireBuffer *b, size_t offset, uint32_t v);
+
+void wire_reader_init(WireReader *r, const void *data, size_t size);
+uint8_t wire_get_u8(WireReader *r);
+uint16_t wire_get_u16(WireReader *r);
+uint32_t wire_get_u32(WireReader *r);
+uint64_t wire_get_u64(WireReader *r);
+int64_t wire_get_i64(WireReader *r);
+double wire_get_f64(WireReader *r);
+
+/**
+ * @brief Read a length-prefixed string as a view into the reader's buffer.
+ * @return Pointer to the first byte (not NUL-terminated), or NULL on error.
+ */
+const char *wire_get_string(WireReader *r, size_t *len);
+
+/**
+ * @brief Read a tagged value and allocate it in the engine's attribute representation.
+ *
+ * An integer outside INT_MIN..INT_MAX sets the reader's error flag.
+ *
+ * @param r Reader.
+ * @param type Output: decoded attribute type.
+ * @return Newly allocated value suitable for attribute_create, or NULL on error.
+ *         A WIRE_NULL value also returns NULL, with `type` set to ATTR_UNKNOWN
+ *         and the reader's error flag left clear.
+ */
+void *wire_get_value(WireReader *r, AttributeType *type);
+
+/**
+ * @brief CRC-32 (IEEE) of a byte range, for integrity checks on persisted data.
+ */
+uint32_t wire_crc32(const void *data, size_t len);
+
+/**
+ * @brief Decode a u32 stored in network byte order.
+ */
+uint32_t wire_decode_u32(const unsigned char *p);
+
+#endif // WIRE_H
@@ -0,0 +1,97 @@
+#ifndef XML_PARSER_H
+#define XML_PARSER_H
+
+#include <stddef.h>
+
+/**
+ * @file xml_parser.h
+ * @brief Single-pass, zero-copy parser for XML requests.
+ *
+ * The parser walks the receive buffer once and records string views into it;
+ * nothing is copied until a handler decides to keep a value. Views into a
+ * request stay valid for as long as the buffer that was parsed, and until
+ * xml_request_free.
+ *
+ * Entity references are decoded: the five predefined entities (`&lt;`,
+ * `&gt;`, `&amp;`, `&quot;`, `&apos;`) and numeric character references. A
+ * view whose text contained one points into a buffer owned by the request
+ * instead of into the document.
+ */
+
+/**
+ * A non-owning view of `len` bytes. Not NUL-terminated.
+ */
+typedef struct {
+  const char *data;
+  size_t len;
+} XmlView;
+
+/**
+ * One `<attribute>` of an ADD_TUPLE request.
+ */
+typedef struct {
+  XmlView name;
+  XmlView type;
+  XmlView value;
+} XmlAttributeView;
+
+/**
+ * The fields of a request the server understands.
+ * A field whose `data` is NULL was not present.
+ */
+typedef struct {
+  XmlView id; /** Client-supplied request id, echoed in the response */
+  XmlView command;
+  XmlView name;
+  XmlView relation;
+  XmlView path;       /** File to read (LOAD_RELATION) */
+  XmlView expression; /** Algebra expression (EVALUATE), see expression_parser.h */
+  XmlView kind;       /** Index kind (CREATE_INDEX): "hash" or "ordered" */
+  XmlView predicate;  /** Selection predicate (SELECT), see predicate.h */
+  int has_attributes; /** An <attributes> element was present */
+  XmlAttributeView *attributes;
+  size_t attribute_count;
+  size_t attribute_capacity;
+  char *decoded;      /** Decoded text of the views that held entity references */
+  size_t decoded_len;
+} XmlRequest;
+
+/**
+ * @brief Parse an XML request in a single pass.
+ *
+ * @param xml Start of the request (need not be NUL-terminated).
+ * @param len Length of the request in bytes.
+ * @param req Output; release with xml_request_free.
+ * @return 0 on success, -1 if the document is not well formed or holds an
+ *         unknown or malformed entity reference.
+ */
+int xml_parse_request(const char *xml, size_t len, XmlRequest *req);
+
+/**
+ * @brief Release memory owned by a parsed request (not the buffer it views).
+ */
+void xml_request_free(XmlRequest *req);
+
+/**
+ * @brief Compare a view against a NUL-terminated string.
+ */
+int xml_view_equals(XmlView v, const char *s);
+
+/**
+ * @brief Copy a view into a newly allocated NUL-terminated string.
+ */
+char *xml_view_dup(XmlView v);
+
+/**
+ * @brief Parse a decimal integer from a view (leading/trailing whitespace allowed).
+ * @return 0 on success, -1 if the view is not an integer.
+ */
+int xml_view_to_int(XmlView v, int *out);
+
+/**
+ * @brief Parse a floating point number from a view.
+ * @return 0 on success, -1 if the view is not a number.
+ */
+int xml_view_to_double(XmlView v, double *out);
+
+#endif // XML_PARSER_H
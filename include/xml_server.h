@@ -1 +1,45 @@
+#ifndef XML_SERVER_H
+#define XML_SERVER_H
+
+/**
+ * @file xml_server.h
+ * @brief Socket server exposing the engine over the XML and binary protocols.
+ */
+
+#include <stddef.h>
+
+#include "schema.h"
+#include "wire.h"
+
+typedef struct {
+  int port;
+  const char *wal_path;      /** Write-ahead log; NULL keeps the schema in memory only */
+  const char *snapshot_path; /** Snapshot loaded at startup and written by CHECKPOINT */
+  const char *load_dir;      /** Directory LOAD_RELATION reads from; NULL disables it */
+} ServerOptions;
+
+/**
+ * @brief Execute one XML request document against the schema.
+ *
+ * Appends the complete response document to `response`; a malformed request
+ * gets an error response.
+ */
+void xml_process_request(Schema *schema, const char *xml, size_t len, WireBuffer *response);
+
+/**
+ * @brief Serve an in-memory schema on `port` (never returns on success).
+ */
 int start_xml_server(int port);
+
+/**
+ * @brief Serve a schema configured by `options` (never returns on success).
+ *
+ * When a snapshot is configured its relations are mapped first (and decoded
+ * on first use). When a write-ahead log is configured it is then replayed
+ * before the server starts accepting connections, and every mutation is
+ * logged to it. LOAD_RELATION only reads files under the load directory,
+ * and is refused when none is configured.
+ */
+int start_server(const ServerOptions *options);
+
+#endif // XML_SERVER_H
@@ -4,10 +4,12 @@
  */
 
 #include "arithmetic_relations.h"
+#include "statistics.h"
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // Cantor pairing for natural numbers
 static void cantor_unpair_nat(size_t n, size_t *k1, size_t *k2) {
@@ -139,22 +141,109 @@ Tuple *integer_division_generator(size_t n, void *userdata) {
   return NULL; // Should rarely happen
 }
 
+/*
+ * Density estimates. The first n pairs of the Cantor enumeration are the
+ * naturals (a, b) with a + b < w, w ≈ sqrt(2n); zigzag encoding halves
+ * them, so the integers (x, y) fill the diamond |x| + |y| < R = w / 2.
+ * Over that diamond x + y and x - y are uniform on [-R, R] while x and y
+ * alone have a triangular distribution peaking at 0.
+ */
+
+static double enumeration_radius(size_t prefix) {
+  double w = floor((sqrt(8.0 * prefix + 1.0) - 1.0) / 2.0);
+  return w > 1.0 ? w / 2.0 : 0.5;
+}
+
+// x + y or x - y equals / is below k
+static double uniform_density(double radius, CompareOp op, double k) {
+  double values = 2.0 * radius + 1.0;
+  double equal = (k == floor(k) && fabs(k) <= radius) ? 1.0 / values : 0.0;
+  double less = (ceil(k) + radius) / values;
+  less = less < 0.0 ? 0.0 : less > 1.0 ? 1.0 : less;
+  return selectivity_from_distribution(op, less, equal);
+}
+
+// A single operand equals / is below k
+static double triangular_density(double radius, CompareOp op, double k) {
+  double r2 = radius * radius;
+  double equal = (k == floor(k) && fabs(k) < radius) ? (radius - fabs(k)) / r2 : 0.0;
+  double less;
+  if (k <= -radius)
+    less = 0.0;
+  else if (k >= radius)
+    less = 1.0;
+  else if (k <= 0)
+    less = (radius + k) * (radius + k) / (2.0 * r2);
+  else
+    less = 1.0 - (radius - k) * (radius - k) / (2.0 * r2);
+  return selectivity_from_distribution(op, less, equal);
+}
+
+// Density over the enumeration for the two operands and, when `linear` is
+// not NULL, a result that is the sum or difference of the operands
+static double pair_density(size_t prefix, const char *attribute, CompareOp op,
+                           const Attribute *constant, const char *first, const char *second,
+                           const char *linear) {
+  if (!constant || !constant->value ||
+      (constant->type != ATTR_INT && constant->type != ATTR_RATIONAL))
+    return -1.0;
+  double k = constant->type == ATTR_INT ? *(int *)constant->value : *(double *)constant->value;
+  double radius = enumeration_radius(prefix);
+  if (strcmp(attribute, first) == 0 || strcmp(attribute, second) == 0)
+    return triangular_density(radius, op, k);
+  if (linear && strcmp(attribute, linear) == 0)
+    return uniform_density(radius, op, k);
+  return -1.0;
+}
+
+double addition_density(size_t prefix, const char *attribute, CompareOp op,
+                        const Attribute *constant, void *userdata) {
+  (void)userdata;
+  return pair_density(prefix, attribute, op, constant, "operand1", "operand2", "result");
+}
+
+double subtraction_density(size_t prefix, const char *attribute, CompareOp op,
+                           const Attribute *constant, void *userdata) {
+  (void)userdata;
+  return pair_density(prefix, attribute, op, constant, "operand1", "operand2", "result");
+}
+
+double multiplication_density(size_t prefix, const char *attribute, CompareOp op,
+                              const Attribute *constant, void *userdata) {
+  (void)userdata;
+  return pair_density(prefix, attribute, op, constant, "operand1", "operand2", NULL);
+}
+
+double division_density(size_t prefix, const char *attribute, CompareOp op,
+                        const Attribute *constant, void *userdata) {
+  (void)userdata;
+  return pair_density(prefix, attribute, op, constant, "dividend", "divisor", NULL);
+}
+
 InfiniteRelation *create_addition_relation(void) {
-  return infinite_relation_create_with_cardinality("ADD", addition_generator, NULL,
-                                                   cardinality_infinite(CARD_ALEPH_0));
+  InfiniteRelation *r = infinite_relation_create_with_cardinality(
+      "ADD", addition_generator, NULL, cardinality_infinite(CARD_ALEPH_0));
+  infinite_relation_set_density(r, addition_density);
+  return r;
 }
 
 InfiniteRelation *create_subtraction_relation(void) {
-  return infinite_relation_create_with_cardinality("SUB", subtraction_generator, NULL,
-                                                   cardinality_infinite(CARD_ALEPH_0));
+  InfiniteRelation *r = infinite_relation_create_with_cardinality(
+      "SUB", subtraction_generator, NULL, cardinality_infinite(CARD_ALEPH_0));
+  infinite_relation_set_density(r, subtraction_density);
+  return r;
 }
 
 InfiniteRelation *create_multiplication_relation(void) {
-  return infinite_relation_create_with_cardinality("MUL", multiplication_generator, NULL,
-                                                   cardinality_infinite(CARD_ALEPH_0));
+  InfiniteRelation *r = infinite_relation_create_with_cardinality(
+      "MUL", multiplication_generator, NULL, cardinality_infinite(CARD_ALEPH_0));
+  infinite_relation_set_density(r, multiplication_density);
+  return r;
 }
 
 InfiniteRelation *create_division_relation(void) {
-  return infinite_relation_create_with_cardinality("DIV", integer_division_generator, NULL,
-                                                   cardinality_infinite(CARD_ALEPH_0));
+  InfiniteRelation *r = infinite_relation_create_with_cardinality(
+      "DIV", integer_division_generator, NULL, cardinality_infinite(CARD_ALEPH_0));
+  infinite_relation_set_density(r, division_density);
+  return r;
 }
@@ -12,14 +12,8 @@
 #include <string.h>
 
 #include "attribute.h"
-#include "set.h" /* for ATTR_SET printing */
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-#include "attribute.h"
-#include "set.h" /* for ATTR_SET printing */
+#include "hash_map.h" /* for hash_bytes */
+#include "set.h"      /* for ATTR_SET printing */
 
 /**
  * @brief Create a new Attribute.
@@ -97,3 +91,169 @@ void attribute_print(const Attribute *attr) {
   }
   printf("\n");
 }
+
+/**
+ * @brief Copy an Attribute together with its value.
+ *
+ * Sets are not deep-copied: the copy shares the original's Set.
+ *
+ * @param attr Pointer to the Attribute to copy.
+ * @return Pointer to the new Attribute, or NULL on failure.
+ */
+Attribute *attribute_copy(const Attribute *attr) {
+  void *value_copy = NULL;
+
+  switch (attr->type) {
+  case ATTR_INT: {
+    int *v = malloc(sizeof(int));
+    if (v)
+      *v = *(int *)attr->value;
+    value_copy = v;
+    break;
+  }
+  case ATTR_RATIONAL: {
+    double *v = malloc(sizeof(double));
+    if (v)
+      *v = *(double *)attr->value;
+    value_copy = v;
+    break;
+  }
+  case ATTR_STRING:
+    value_copy = strdup((char *)attr->value);
+    break;
+  case ATTR_SET:
+    // For now, we don't deep copy sets - would need recursive logic
+    fprintf(stderr, "Warning: shallow copy of SET attribute\n");
+    value_copy = attr->value;
+    break;
+  default:
+    break;
+  }
+
+  return attribute_create(attr->name, attr->type, value_copy);
+}
+
+/**
+ * @brief Check if two Attributes hold the same value, regardless of their names.
+ *
+ * @param a Pointer to first Attribute.
+ * @param b Pointer to second Attribute.
+ * @return 1 if the types and values are equal, 0 otherwise.
+ */
+int attribute_value_equals(const Attribute *a, const Attribute *b) {
+  if (a->type != b->type)
+    return 0;
+
+  switch (a->type) {
+  case ATTR_INT:
+    return *(int *)a->value == *(int *)b->value;
+  case ATTR_RATIONAL:
+    return *(double *)a->value == *(double *)b->value;
+  case ATTR_STRING:
+    return strcmp((char *)a->value, (char *)b->value) == 0;
+  case ATTR_SET:
+    return set_size((Set *)a->value) == set_size((Set *)b->value);
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief Hash an Attribute's value, consistently with attribute_value_equals.
+ *
+ * @param attr Pointer to the Attribute.
+ * @return 64-bit hash.
+ */
+uint64_t attribute_value_hash(const Attribute *attr) {
+  switch (attr->type) {
+  case ATTR_INT:
+    return hash_bytes(attr->value, sizeof(int));
+  case ATTR_RATIONAL: {
+    // -0.0 == 0.0, so both must hash alike
+    double v = *(double *)attr->value;
+    if (v == 0.0)
+      v = 0.0;
+    return hash_bytes(&v, sizeof(v));
+  }
+  case ATTR_STRING:
+    return hash_string(attr->value);
+  case ATTR_SET:
+    return (uint64_t)set_size((Set *)attr->value);
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief Order two Attribute values, regardless of their names.
+ *
+ * Ints and rationals compare numerically with each other; strings compare
+ * with strcmp. Other combinations are not ordered.
+ *
+ * @param a Pointer to first Attribute.
+ * @param b Pointer to second Attribute.
+ * @param result Set to a value <0, 0 or >0 as `a` is below, equal to or above `b`.
+ * @return 0 on success, -1 if the values cannot be compared.
+ */
+int attribute_value_compare(const Attribute *a, const Attribute *b, int *result) {
+  if (!a->value || !b->value)
+    return -1;
+  if (a->type == ATTR_STRING && b->type == ATTR_STRING) {
+    *result = strcmp((char *)a->value, (char *)b->value);
+    return 0;
+  }
+  if (a->type == ATTR_INT && b->type == ATTR_INT) {
+    int x = *(int *)a->value, y = *(int *)b->value;
+    *result = (x > y) - (x < y);
+    return 0;
+  }
+  if ((a->type != ATTR_INT && a->type != ATTR_RATIONAL) ||
+      (b->type != ATTR_INT && b->type != ATTR_RATIONAL))
+    return -1;
+  double x = a->type == ATTR_INT ? *(int *)a->value : *(double *)a->value;
+  double y = b->type == ATTR_INT ? *(int *)b->value : *(double *)b->value;
+  *result = (x > y) - (x < y);
+  return 0;
+}
+
+/**
+ * @brief Check whether a comparison result (as from strcmp) satisfies `op`.
+ */
+int compare_op_holds(CompareOp op, int cmp) {
+  switch (op) {
+  case CMP_EQ:
+    return cmp == 0;
+  case CMP_NE:
+    return cmp != 0;
+  case CMP_LT:
+    return cmp < 0;
+  case CMP_LE:
+    return cmp <= 0;
+  case CMP_GT:
+    return cmp > 0;
+  case CMP_GE:
+    return cmp >= 0;
+  }
+  return 0;
+}
+
+/**
+ * @brief Check if two Attributes are equal (name and value).
+ *
+ * @param a Pointer to first Attribute.
+ * @param b Pointer to second Attribute.
+ * @return 1 if equal, 0 otherwise.
+ */
+int attribute_equals(const Attribute *a, const Attribute *b) {
+  return strcmp(a->name, b->name) == 0 && attribute_value_equals(a, b);
+}
+
+/**
+ * @brief Hash an Attribute's name and value, consistently with attribute_equals.
+ *
+ * @param attr Pointer to the Attribute.
+ * @return 64-bit hash.
+ */
+uint64_t attribute_hash(const Attribute *attr) {
+  return hash_combine(hash_string(attr->name), attribute_value_hash(attr));
+}
@@ -0,0 +1,429 @@
+/**
+ * @file batch.c
+ * @brief Columnar batches and typed kernels for vectorized execution.
+ *
+ * The kernels are written as one loop per comparison operator so that the
+ * loop body is branch-free for numeric columns: every live row is written
+ * to the output and the output cursor advances only when the row passes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "hash_map.h"
+
+// Bytes per value of a supported column type (0 if unsupported)
+static size_t value_size(AttributeType type) {
+  switch (type) {
+  case ATTR_INT:
+    return sizeof(int);
+  case ATTR_RATIONAL:
+    return sizeof(double);
+  case ATTR_STRING:
+    return sizeof(char *);
+  default:
+    return 0;
+  }
+}
+
+// Release a column's arrays (unless borrowed) and name
+static void column_free(ColumnVector *c, size_t rows) {
+  if (!c->borrowed) {
+    if (c->type == ATTR_STRING && c->values) {
+      char **strings = (char **)c->values;
+      for (size_t i = 0; i < rows; i++)
+        free(strings[i]);
+    }
+    free(c->values);
+    free(c->valid);
+  }
+  free(c->name);
+}
+
+ColumnBatch *column_batch_create(const char *const *names, const AttributeType *types,
+                                 size_t column_count, size_t capacity) {
+  ColumnBatch *b = calloc(1, sizeof(ColumnBatch));
+  if (!b)
+    return NULL;
+  b->columns = calloc(column_count ? column_count : 1, sizeof(ColumnVector));
+  b->selection = malloc((capacity ? capacity : 1) * sizeof(uint32_t));
+  b->capacity = capacity;
+  if (!b->columns || !b->selection) {
+    column_batch_destroy(b);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < column_count; i++) {
+    ColumnVector *c = &b->columns[i];
+    size_t size = value_size(types[i]);
+    c->type = types[i];
+    c->name = strdup(names[i]);
+    c->values = size ? calloc(capacity ? capacity : 1, size) : NULL;
+    c->valid = calloc(capacity ? capacity : 1, sizeof(uint8_t));
+    b->column_count++;
+    if (!c->name || !c->values || !c->valid) {
+      column_batch_destroy(b);
+      return NULL;
+    }
+  }
+  return b;
+}
+
+typedef struct {
+  const char **names;
+  AttributeType *types;
+  size_t count;
+} HeadingContext;
+
+static void heading_cb(void *element, void *userdata) {
+  Attribute *attr = (Attribute *)element;
+  HeadingContext *ctx = (HeadingContext *)userdata;
+  if (!value_size(attr->type))
+    return;
+  ctx->names[ctx->count] = attr->name;
+  ctx->types[ctx->count] = attr->type;
+  ctx->count++;
+}
+
+ColumnBatch *column_batch_create_for_tuple(const Tuple *t, size_t capacity) {
+  size_t n = set_size(t);
+  HeadingContext ctx = {.names = malloc((n ? n : 1) * sizeof(char *)),
+                        .types = malloc((n ? n : 1) * sizeof(AttributeType)),
+                        .count = 0};
+  ColumnBatch *b = NULL;
+  if (ctx.names && ctx.types) {
+    set_foreach(t, heading_cb, &ctx);
+    b = column_batch_create(ctx.names, ctx.types, ctx.count, capacity);
+  }
+  free(ctx.names);
+  free(ctx.types);
+  return b;
+}
+
+ColumnBatch *column_batch_create_like(const ColumnBatch *src, const char *prefix,
+                                      size_t capacity) {
+  size_t n = src->column_count;
+  char **names = calloc(n ? n : 1, sizeof(char *));
+  AttributeType *types = malloc((n ? n : 1) * sizeof(AttributeType));
+  ColumnBatch *b = NULL;
+  int ok = names && types;
+  for (size_t i = 0; ok && i < n; i++) {
+    const char *name = src->columns[i].name;
+    size_t len = (prefix ? strlen(prefix) + 1 : 0) + strlen(name) + 1;
+    names[i] = malloc(len);
+    ok = names[i] != NULL;
+    if (ok) {
+      if (prefix)
+        snprintf(names[i], len, "%s_%s", prefix, name);
+      else
+        memcpy(names[i], name, len);
+    }
+    types[i] = src->columns[i].type;
+  }
+  if (ok)
+    b = column_batch_create((const char *const *)names, types, n, capacity);
+  for (size_t i = 0; names && i < n; i++)
+    free(names[i]);
+  free(names);
+  free(types);
+  return b;
+}
+
+void column_batch_destroy(ColumnBatch *b) {
+  if (!b)
+    return;
+  for (size_t i = 0; i < b->column_count; i++)
+    column_free(&b->columns[i], b->rows);
+  free(b->columns);
+  free(b->selection);
+  free(b);
+}
+
+void column_batch_clear(ColumnBatch *b) {
+  for (size_t i = 0; i < b->column_count; i++) {
+    ColumnVector *c = &b->columns[i];
+    if (c->borrowed || c->type != ATTR_STRING)
+      continue;
+    char **strings = (char **)c->values;
+    for (size_t r = 0; r < b->rows; r++) {
+      free(strings[r]);
+      strings[r] = NULL;
+    }
+  }
+  b->rows = 0;
+  b->selected = 0;
+}
+
+int column_batch_reserve(ColumnBatch *b, size_t capacity) {
+  if (capacity <= b->capacity)
+    return 0;
+  uint32_t *selection = realloc(b->selection, capacity * sizeof(uint32_t));
+  if (!selection)
+    return -1;
+  b->selection = selection;
+  for (size_t i = 0; i < b->column_count; i++) {
+    ColumnVector *c = &b->columns[i];
+    if (c->borrowed)
+      return -1;
+    size_t size = value_size(c->type);
+    void *values = realloc(c->values, capacity * size);
+    if (!values)
+      return -1;
+    c->values = values;
+    uint8_t *valid = realloc(c->valid, capacity);
+    if (!valid)
+      return -1;
+    c->valid = valid;
+    memset(c->valid + b->capacity, 0, capacity - b->capacity);
+    if (c->type == ATTR_STRING)
+      memset((char **)c->values + b->capacity, 0, (capacity - b->capacity) * sizeof(char *));
+  }
+  b->capacity = capacity;
+  return 0;
+}
+
+int column_batch_find(const ColumnBatch *b, const char *name) {
+  for (size_t i = 0; i < b->column_count; i++) {
+    if (strcmp(b->columns[i].name, name) == 0)
+      return (int)i;
+  }
+  return -1;
+}
+
+long column_batch_append_row(ColumnBatch *b) {
+  if (b->rows == b->capacity)
+    return -1;
+  size_t row = b->rows++;
+  for (size_t i = 0; i < b->column_count; i++) {
+    b->columns[i].valid[row] = 0;
+    if (b->columns[i].type == ATTR_STRING)
+      ((char **)b->columns[i].values)[row] = NULL;
+  }
+  b->selection[b->selected++] = (uint32_t)row;
+  return (long)row;
+}
+
+// Store a value (copied) in a column row
+static int column_set(ColumnVector *c, size_t row, const void *value) {
+  switch (c->type) {
+  case ATTR_INT:
+    ((int *)c->values)[row] = *(const int *)value;
+    break;
+  case ATTR_RATIONAL:
+    ((double *)c->values)[row] = *(const double *)value;
+    break;
+  case ATTR_STRING: {
+    char *s = strdup((const char *)value);
+    if (!s)
+      return -1;
+    ((char **)c->values)[row] = s;
+    break;
+  }
+  default:
+    return -1;
+  }
+  c->valid[row] = 1;
+  return 0;
+}
+
+// Address of a column value in the form attribute values use
+static const void *column_get(const ColumnVector *c, size_t row) {
+  if (c->type == ATTR_STRING)
+    return ((char *const *)c->values)[row];
+  return (const char *)c->values + row * value_size(c->type);
+}
+
+int column_batch_append_tuple(ColumnBatch *b, Tuple *t) {
+  long row = column_batch_append_row(b);
+  if (row < 0)
+    return -1;
+  for (size_t i = 0; i < b->column_count; i++) {
+    ColumnVector *c = &b->columns[i];
+    Attribute *attr = tuple_find_attribute(t, c->name);
+    if (attr && attr->type == c->type && attr->value && column_set(c, (size_t)row, attr->value) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+int column_batch_copy_values(ColumnBatch *dst, size_t dst_row, size_t dst_first,
+                             const ColumnBatch *src, size_t src_row) {
+  for (size_t i = 0; i < src->column_count; i++) {
+    const ColumnVector *from = &src->columns[i];
+    ColumnVector *to = &dst->columns[dst_first + i];
+    if (from->valid[src_row] && column_set(to, dst_row, column_get(from, src_row)) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+Tuple *column_batch_row_to_tuple(const ColumnBatch *b, size_t row) {
+  Tuple *t = tuple_create();
+  if (!t)
+    return NULL;
+  for (size_t i = 0; i < b->column_count; i++) {
+    const ColumnVector *c = &b->columns[i];
+    if (!c->valid[row])
+      continue;
+    void *value;
+    if (c->type == ATTR_STRING) {
+      value = strdup(column_get(c, row));
+    } else {
+      value = malloc(value_size(c->type));
+      if (value)
+        memcpy(value, column_get(c, row), value_size(c->type));
+    }
+    Attribute *attr = value ? attribute_create(c->name, c->type, value) : NULL;
+    if (!attr) {
+      free(value);
+      tuple_destroy(t);
+      return NULL;
+    }
+    tuple_add_attribute(t, attr);
+  }
+  return t;
+}
+
+int column_batch_rows_equal(const ColumnBatch *a, size_t row_a, const int *cols_a,
+                            const ColumnBatch *b, size_t row_b, const int *cols_b,
+                            size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const ColumnVector *ca = &a->columns[cols_a[i]];
+    const ColumnVector *cb = &b->columns[cols_b[i]];
+    int va = ca->valid[row_a], vb = cb->valid[row_b];
+    if (va != vb || (va && ca->type != cb->type))
+      return 0;
+    if (!va)
+      continue;
+    switch (ca->type) {
+    case ATTR_INT:
+      if (((int *)ca->values)[row_a] != ((int *)cb->values)[row_b])
+        return 0;
+      break;
+    case ATTR_RATIONAL:
+      if (((double *)ca->values)[row_a] != ((double *)cb->values)[row_b])
+        return 0;
+      break;
+    case ATTR_STRING:
+      if (strcmp(((char **)ca->values)[row_a], ((char **)cb->values)[row_b]) != 0)
+        return 0;
+      break;
+    default:
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// One branch-free loop per operator over the live rows
+#define SELECT_LOOPS(value, constant)                                                             \
+  size_t m = 0;                                                                                    \
+  switch (op) {                                                                                    \
+  case CMP_EQ:                                                                                     \
+    for (size_t i = 0; i < n; i++) {                                                               \
+      uint32_t r = sel[i];                                                                         \
+      out[m] = r;                                                                                  \
+      m += valid[r] & ((value) == (constant));                                                     \
+    }                                                                                              \
+    break;                                                                                         \
+  case CMP_NE:                                                                                     \
+    for (size_t i = 0; i < n; i++) {                                                               \
+      uint32_t r = sel[i];                                                                         \
+      out[m] = r;                                                                                  \
+      m += valid[r] & ((value) != (constant));                                                     \
+    }                                                                                              \
+    break;                                                                                         \
+  case CMP_LT:                                                                                     \
+    for (size_t i = 0; i < n; i++) {                                                               \
+      uint32_t r = sel[i];                                                                         \
+      out[m] = r;                                                                                  \
+      m += valid[r] & ((value) < (constant));                                                      \
+    }                                                                                              \
+    break;                                                                                         \
+  case CMP_LE:                                                                                     \
+    for (size_t i = 0; i < n; i++) {                                                               \
+      uint32_t r = sel[i];                                                                         \
+      out[m] = r;                                                                                  \
+      m += valid[r] & ((value) <= (constant));                                                     \
+    }                                                                                              \
+    break;                                                                                         \
+  case CMP_GT:                                                                                     \
+    for (size_t i = 0; i < n; i++) {                                                               \
+      uint32_t r = sel[i];                                                                         \
+      out[m] = r;                                                                                  \
+      m += valid[r] & ((value) > (constant));                                                      \
+    }                                                                                              \
+    break;                                                                                         \
+  case CMP_GE:                                                                                     \
+    for (size_t i = 0; i < n; i++) {                                                               \
+      uint32_t r = sel[i];                                                                         \
+      out[m] = r;                                                                                  \
+      m += valid[r] & ((value) >= (constant));                                                     \
+    }                                                                                              \
+    break;                                                                                         \
+  }                                                                                                \
+  return m
+
+size_t batch_select_int(const int *values, const uint8_t *valid, CompareOp op, int constant,
+                        const uint32_t *sel, size_t n, uint32_t *out) {
+  SELECT_LOOPS(values[r], constant);
+}
+
+size_t batch_select_double(const double *values, const uint8_t *valid, CompareOp op,
+                           double constant, const uint32_t *sel, size_t n, uint32_t *out) {
+  SELECT_LOOPS(values[r], constant);
+}
+
+size_t batch_select_string(char *const *values, const uint8_t *valid, CompareOp op,
+                           const char *constant, const uint32_t *sel, size_t n, uint32_t *out) {
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t r = sel[i];
+    if (valid[r] && compare_op_holds(op, strcmp(values[r], constant)))
+      out[m++] = r;
+  }
+  return m;
+}
+
+// Finalizer of splitmix64: a cheap, well-mixed hash of a 64-bit word
+static uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+#define INVALID_HASH 0x9e3779b97f4a7c15ULL
+
+void batch_hash_column(const ColumnVector *c, const uint32_t *sel, size_t n, uint64_t *hashes,
+                       int combine) {
+  for (size_t i = 0; i < n; i++) {
+    uint32_t r = sel[i];
+    uint64_t h = INVALID_HASH;
+    if (c->valid[r]) {
+      switch (c->type) {
+      case ATTR_INT:
+        h = mix64((uint64_t)(uint32_t)((const int *)c->values)[r]);
+        break;
+      case ATTR_RATIONAL: {
+        // -0.0 == 0.0, so both must hash alike
+        double v = ((const double *)c->values)[r];
+        uint64_t bits;
+        if (v == 0.0)
+          v = 0.0;
+        memcpy(&bits, &v, sizeof(bits));
+        h = mix64(bits);
+        break;
+      }
+      case ATTR_STRING:
+        h = hash_string(((char *const *)c->values)[r]);
+        break;
+      default:
+        break;
+      }
+    }
+    hashes[i] = combine ? hash_combine(hashes[i], h) : h;
+  }
+}
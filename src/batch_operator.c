@@ -0,0 +1,845 @@
+/**
+ * @file batch_operator.c
+ * @brief Vectorized query operators over ColumnBatch.
+ *
+ * Operators that need to remember rows (the build side of a hash join,
+ * the rows already produced by a projection) keep them in a RowTable: a
+ * growable ColumnBatch plus a chained hash index over its rows, so rows
+ * stay columnar and are compared column by column.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch_operator.h"
+#include "metrics.h"
+
+#define COLLECT_BATCH 1024
+
+/* Row tables */
+
+typedef struct {
+  ColumnBatch *rows;
+  uint64_t *hashes;    // hash of each stored row
+  uint32_t *chain;     // next row in the same bucket + 1; 0 ends the chain
+  uint32_t *buckets;   // first row of each bucket + 1
+  size_t bucket_count; // power of two
+} RowTable;
+
+static void row_table_free(RowTable *t) {
+  column_batch_destroy(t->rows);
+  free(t->hashes);
+  free(t->chain);
+  free(t->buckets);
+  memset(t, 0, sizeof(RowTable));
+}
+
+// Create an empty table with the heading of `heading`
+static int row_table_init(RowTable *t, const ColumnBatch *heading) {
+  t->rows = column_batch_create_like(heading, NULL, BATCH_CAPACITY);
+  t->hashes = malloc(BATCH_CAPACITY * sizeof(uint64_t));
+  t->chain = malloc(BATCH_CAPACITY * sizeof(uint32_t));
+  t->buckets = calloc(BATCH_CAPACITY, sizeof(uint32_t));
+  t->bucket_count = BATCH_CAPACITY;
+  if (!t->rows || !t->hashes || !t->chain || !t->buckets) {
+    row_table_free(t);
+    return -1;
+  }
+  return 0;
+}
+
+// Link row `r` into its bucket
+static void row_table_link(RowTable *t, size_t r) {
+  size_t b = t->hashes[r] & (t->bucket_count - 1);
+  t->chain[r] = t->buckets[b];
+  t->buckets[b] = (uint32_t)r + 1;
+}
+
+// Double the capacity and the bucket count (keeping at most one row per bucket on average)
+static int row_table_grow(RowTable *t) {
+  size_t capacity = t->rows->capacity * 2;
+  if (column_batch_reserve(t->rows, capacity) < 0)
+    return -1;
+  uint64_t *hashes = realloc(t->hashes, capacity * sizeof(uint64_t));
+  if (!hashes)
+    return -1;
+  t->hashes = hashes;
+  uint32_t *chain = realloc(t->chain, capacity * sizeof(uint32_t));
+  if (!chain)
+    return -1;
+  t->chain = chain;
+  uint32_t *buckets = calloc(capacity, sizeof(uint32_t));
+  if (!buckets)
+    return -1;
+  free(t->buckets);
+  t->buckets = buckets;
+  t->bucket_count = capacity;
+  for (size_t r = 0; r < t->rows->rows; r++)
+    row_table_link(t, r);
+  return 0;
+}
+
+// Store a copy of `src` row `row` under `hash`
+static int row_table_add(RowTable *t, const ColumnBatch *src, size_t row, uint64_t hash) {
+  if (t->rows->rows == t->rows->capacity && row_table_grow(t) < 0)
+    return -1;
+  long r = column_batch_append_row(t->rows);
+  if (r < 0 || column_batch_copy_values(t->rows, (size_t)r, 0, src, row) < 0)
+    return -1;
+  t->hashes[r] = hash;
+  row_table_link(t, (size_t)r);
+  return 0;
+}
+
+// First candidate row for `hash` + 1, or 0
+static uint32_t row_table_head(const RowTable *t, uint64_t hash) {
+  return t->buckets[hash & (t->bucket_count - 1)];
+}
+
+// Whether the table holds a row equal (in every column) to `src` row `row`
+static int row_table_contains(const RowTable *t, const ColumnBatch *src, size_t row,
+                              uint64_t hash, const int *columns) {
+  for (uint32_t e = row_table_head(t, hash); e; e = t->chain[e - 1]) {
+    size_t r = e - 1;
+    if (t->hashes[r] == hash &&
+        column_batch_rows_equal(t->rows, r, columns, src, row, columns, src->column_count))
+      return 1;
+  }
+  return 0;
+}
+
+// Grow a scratch array of hashes to hold at least `n` entries
+static int reserve_hashes(uint64_t **hashes, size_t *capacity, size_t n) {
+  if (n <= *capacity)
+    return 0;
+  uint64_t *grown = realloc(*hashes, n * sizeof(uint64_t));
+  if (!grown)
+    return -1;
+  *hashes = grown;
+  *capacity = n;
+  return 0;
+}
+
+/* Framework */
+
+// Allocate an operator with zeroed state; takes ownership of the inputs
+static BatchOperator *batch_operator_new(const BatchOperatorVTable *vtable, size_t state_size,
+                                         BatchOperator *left, BatchOperator *right, int arity) {
+  BatchOperator *op = malloc(sizeof(BatchOperator));
+  void *state = calloc(1, state_size);
+  if (!op || !state || (arity >= 1 && !left) || (arity >= 2 && !right)) {
+    free(op);
+    free(state);
+    batch_operator_destroy(left);
+    batch_operator_destroy(right);
+    return NULL;
+  }
+  op->vtable = vtable;
+  op->state = state;
+  op->left = left;
+  op->right = right;
+  return op;
+}
+
+int batch_operator_open(BatchOperator *op) {
+  if (op->left && batch_operator_open(op->left) < 0)
+    return -1;
+  if (op->right && batch_operator_open(op->right) < 0)
+    return -1;
+  return op->vtable->open ? op->vtable->open(op) : 0;
+}
+
+const ColumnBatch *batch_operator_next(BatchOperator *op) { return op->vtable->next(op); }
+
+void batch_operator_close(BatchOperator *op) {
+  if (op->vtable->close)
+    op->vtable->close(op);
+  if (op->left)
+    batch_operator_close(op->left);
+  if (op->right)
+    batch_operator_close(op->right);
+}
+
+void batch_operator_destroy(BatchOperator *op) {
+  if (!op)
+    return;
+  if (op->vtable->destroy)
+    op->vtable->destroy(op);
+  free(op->state);
+  batch_operator_destroy(op->left);
+  batch_operator_destroy(op->right);
+  free(op);
+}
+
+Relation *batch_collect(BatchOperator *op, const char *name) {
+  Relation *result = relation_create(name);
+  if (!result)
+    return NULL;
+  if (batch_operator_open(op) < 0) {
+    batch_operator_close(op);
+    relation_destroy(result);
+    return NULL;
+  }
+
+  Tuple *tuples[COLLECT_BATCH];
+  size_t count = 0;
+  int failed = 0;
+  const ColumnBatch *b;
+  while (!failed && (b = batch_operator_next(op)) != NULL) {
+    for (size_t i = 0; !failed && i < b->selected; i++) {
+      Tuple *t = column_batch_row_to_tuple(b, b->selection[i]);
+      if (!t) {
+        failed = 1;
+        break;
+      }
+      tuples[count++] = t;
+      if (count == COLLECT_BATCH) {
+        failed = relation_add_tuples(result, tuples, count) < 0;
+        if (!failed)
+          count = 0;
+      }
+    }
+  }
+  if (!failed && count)
+    failed = relation_add_tuples(result, tuples, count) < 0;
+  batch_operator_close(op);
+
+  if (failed) {
+    for (size_t i = 0; i < count; i++)
+      tuple_destroy(tuples[i]);
+    relation_destroy(result);
+    return NULL;
+  }
+  return result;
+}
+
+/* Tuple adapter */
+
+typedef struct {
+  BatchOperator *plan;
+  const ColumnBatch *batch;
+  size_t pos;
+} AdapterState;
+
+static int adapter_open(Operator *op) {
+  AdapterState *s = (AdapterState *)op->state;
+  s->batch = NULL;
+  return batch_operator_open(s->plan);
+}
+
+static Tuple *adapter_next(Operator *op) {
+  AdapterState *s = (AdapterState *)op->state;
+  while (!s->batch || s->pos == s->batch->selected) {
+    s->batch = batch_operator_next(s->plan);
+    s->pos = 0;
+    if (!s->batch)
+      return NULL;
+  }
+  Tuple *t = column_batch_row_to_tuple(s->batch, s->batch->selection[s->pos++]);
+  return t ? t : operator_fail(op);
+}
+
+static void adapter_close(Operator *op) {
+  AdapterState *s = (AdapterState *)op->state;
+  batch_operator_close(s->plan);
+  s->batch = NULL;
+}
+
+static void adapter_destroy(Operator *op) {
+  AdapterState *s = (AdapterState *)op->state;
+  batch_operator_destroy(s->plan);
+}
+
+static const OperatorVTable adapter_vtable = {"FromBatches", adapter_open, adapter_next,
+                                              adapter_close, adapter_destroy};
+
+Operator *operator_from_batches(BatchOperator *plan) {
+  if (!plan)
+    return NULL;
+  Operator *op = malloc(sizeof(Operator));
+  AdapterState *s = calloc(1, sizeof(AdapterState));
+  if (!op || !s) {
+    free(op);
+    free(s);
+    batch_operator_destroy(plan);
+    return NULL;
+  }
+  s->plan = plan;
+  op->vtable = &adapter_vtable;
+  op->state = s;
+  op->left = NULL;
+  op->right = NULL;
+  op->profile = NULL;
+  op->failed = 0;
+  return op;
+}
+
+/* Scan */
+
+typedef struct {
+  const Relation *relation;
+  SetIter it;
+  Tuple *pending; // first tuple, read on open to learn the heading
+  ColumnBatch *batch;
+} BatchScanState;
+
+static int batch_scan_open(BatchOperator *op) {
+  BatchScanState *s = (BatchScanState *)op->state;
+  set_iter_init(s->relation->tuples, &s->it);
+  s->pending = set_iter_next(&s->it);
+  if (!s->pending)
+    return 0;
+  s->batch = column_batch_create_for_tuple(s->pending, BATCH_CAPACITY);
+  return s->batch ? 0 : -1;
+}
+
+static const ColumnBatch *batch_scan_next(BatchOperator *op) {
+  BatchScanState *s = (BatchScanState *)op->state;
+  if (!s->batch)
+    return NULL;
+  column_batch_clear(s->batch);
+  if (s->pending) {
+    if (column_batch_append_tuple(s->batch, s->pending) < 0)
+      return NULL;
+    s->pending = NULL;
+  }
+  Tuple *t;
+  while (s->batch->rows < s->batch->capacity && (t = set_iter_next(&s->it)) != NULL) {
+    if (column_batch_append_tuple(s->batch, t) < 0)
+      return NULL;
+  }
+  return s->batch->selected ? s->batch : NULL;
+}
+
+static void batch_scan_close(BatchOperator *op) {
+  BatchScanState *s = (BatchScanState *)op->state;
+  column_batch_destroy(s->batch);
+  s->batch = NULL;
+  s->pending = NULL;
+}
+
+static const BatchOperatorVTable batch_scan_vtable = {"BatchScan", batch_scan_open,
+                                                      batch_scan_next, batch_scan_close,
+                                                      batch_scan_close};
+
+BatchOperator *batch_scan(const Relation *r) {
+  if (!r)
+    return NULL;
+  BatchOperator *op = batch_operator_new(&batch_scan_vtable, sizeof(BatchScanState), NULL, NULL, 0);
+  if (op)
+    ((BatchScanState *)op->state)->relation = r;
+  return op;
+}
+
+/* Generator scan */
+
+typedef struct {
+  InfiniteRelation *relation;
+  size_t limit;
+  size_t index; // next generator index
+  ColumnBatch *batch;
+} BatchGeneratorState;
+
+static int batch_generator_open(BatchOperator *op) {
+  BatchGeneratorState *s = (BatchGeneratorState *)op->state;
+  s->index = 0;
+  if (s->limit == 0)
+    return 0;
+  Tuple *first = infinite_relation_tuple_at(s->relation, 0);
+  if (!first)
+    return 0;
+  s->batch = column_batch_create_for_tuple(first, BATCH_CAPACITY);
+  tuple_destroy(first);
+  return s->batch ? 0 : -1;
+}
+
+static const ColumnBatch *batch_generator_next(BatchOperator *op) {
+  BatchGeneratorState *s = (BatchGeneratorState *)op->state;
+  if (!s->batch || s->index >= s->limit)
+    return NULL;
+  column_batch_clear(s->batch);
+  size_t want = s->limit - s->index;
+  if (want > s->batch->capacity)
+    want = s->batch->capacity;
+
+  size_t produced = 0;
+  if (s->relation->batch_fn) {
+    produced = s->relation->batch_fn(s->index, want, s->batch, s->relation->userdata);
+    metrics_add(METRIC_TUPLES_GENERATED, produced);
+  } else {
+    for (; produced < want; produced++) {
+      Tuple *t = infinite_relation_tuple_at(s->relation, s->index + produced);
+      if (!t)
+        break;
+      int rc = column_batch_append_tuple(s->batch, t);
+      tuple_destroy(t);
+      if (rc < 0)
+        return NULL;
+    }
+  }
+  // A short batch means the generator ended
+  s->index = produced < want ? s->limit : s->index + produced;
+  return s->batch->selected ? s->batch : NULL;
+}
+
+static void batch_generator_close(BatchOperator *op) {
+  BatchGeneratorState *s = (BatchGeneratorState *)op->state;
+  column_batch_destroy(s->batch);
+  s->batch = NULL;
+}
+
+static const BatchOperatorVTable batch_generator_vtable = {
+    "BatchGeneratorScan", batch_generator_open, batch_generator_next, batch_generator_close,
+    batch_generator_close};
+
+BatchOperator *batch_generator_scan(InfiniteRelation *r, size_t limit) {
+  if (!r)
+    return NULL;
+  BatchOperator *op =
+      batch_operator_new(&batch_generator_vtable, sizeof(BatchGeneratorState), NULL, NULL, 0);
+  if (op) {
+    BatchGeneratorState *s = (BatchGeneratorState *)op->state;
+    s->relation = r;
+    s->limit = limit;
+  }
+  return op;
+}
+
+/* Filter */
+
+typedef struct {
+  char *column;
+  CompareOp op;
+  AttributeType type;
+  int int_value;
+  double double_value;
+  char *string_value;
+} FilterState;
+
+// Compare an int column with a double constant, staging the values as doubles
+static size_t select_int_as_double(const ColumnVector *c, CompareOp op, double constant,
+                                   uint32_t *sel, size_t n) {
+  double values[BATCH_CAPACITY];
+  uint8_t valid[BATCH_CAPACITY];
+  uint32_t positions[BATCH_CAPACITY];
+  size_t kept = 0;
+  for (size_t done = 0; done < n; done += BATCH_CAPACITY) {
+    size_t chunk = n - done < BATCH_CAPACITY ? n - done : BATCH_CAPACITY;
+    for (size_t i = 0; i < chunk; i++) {
+      values[i] = ((const int *)c->values)[sel[done + i]];
+      valid[i] = c->valid[sel[done + i]];
+      positions[i] = (uint32_t)i;
+    }
+    size_t m = batch_select_double(values, valid, op, constant, positions, chunk, positions);
+    for (size_t i = 0; i < m; i++)
+      sel[kept++] = sel[done + positions[i]];
+  }
+  return kept;
+}
+
+// Narrow the selection of `b` to the rows passing the filter
+static size_t filter_batch(const FilterState *s, ColumnBatch *b) {
+  int col = column_batch_find(b, s->column);
+  if (col < 0)
+    return 0;
+  const ColumnVector *c = &b->columns[col];
+  uint32_t *sel = b->selection;
+  size_t n = b->selected;
+  switch (c->type) {
+  case ATTR_INT:
+    if (s->type == ATTR_INT)
+      return batch_select_int(c->values, c->valid, s->op, s->int_value, sel, n, sel);
+    if (s->type == ATTR_RATIONAL)
+      return select_int_as_double(c, s->op, s->double_value, sel, n);
+    return 0;
+  case ATTR_RATIONAL:
+    if (s->type == ATTR_RATIONAL || s->type == ATTR_INT)
+      return batch_select_double(c->values, c->valid, s->op, s->double_value, sel, n, sel);
+    return 0;
+  case ATTR_STRING:
+    if (s->type == ATTR_STRING)
+      return batch_select_string(c->values, c->valid, s->op, s->string_value, sel, n, sel);
+    return 0;
+  default:
+    return 0;
+  }
+}
+
+static const ColumnBatch *filter_next(BatchOperator *op) {
+  FilterState *s = (FilterState *)op->state;
+  const ColumnBatch *b;
+  while ((b = batch_operator_next(op->left)) != NULL) {
+    // Consumers may narrow the selection of the batches they receive
+    ColumnBatch *narrowed = (ColumnBatch *)b;
+    narrowed->selected = filter_batch(s, narrowed);
+    if (narrowed->selected)
+      return b;
+  }
+  return NULL;
+}
+
+static void filter_destroy(BatchOperator *op) {
+  FilterState *s = (FilterState *)op->state;
+  free(s->column);
+  free(s->string_value);
+}
+
+static const BatchOperatorVTable filter_vtable = {"BatchFilter", NULL, filter_next, NULL,
+                                                  filter_destroy};
+
+BatchOperator *batch_filter(BatchOperator *child, const char *column, CompareOp cmp,
+                            const Attribute *constant) {
+  BatchOperator *op = batch_operator_new(&filter_vtable, sizeof(FilterState), child, NULL, 1);
+  if (!op)
+    return NULL;
+  FilterState *s = (FilterState *)op->state;
+  s->op = cmp;
+  s->column = strdup(column);
+  int ok = s->column && constant && constant->value;
+  if (ok) {
+    s->type = constant->type;
+    switch (constant->type) {
+    case ATTR_INT:
+      s->int_value = *(const int *)constant->value;
+      s->double_value = s->int_value;
+      break;
+    case ATTR_RATIONAL:
+      s->double_value = *(const double *)constant->value;
+      break;
+    case ATTR_STRING:
+      ok = (s->string_value = strdup((const char *)constant->value)) != NULL;
+      break;
+    default:
+      ok = 0;
+    }
+  }
+  if (!ok) {
+    batch_operator_destroy(op);
+    return NULL;
+  }
+  return op;
+}
+
+/* Predicate filter */
+
+typedef struct {
+  Predicate *predicate; // borrowed
+} PredicateFilterState;
+
+static const ColumnBatch *predicate_filter_next(BatchOperator *op) {
+  PredicateFilterState *s = (PredicateFilterState *)op->state;
+  const ColumnBatch *b;
+  while ((b = batch_operator_next(op->left)) != NULL) {
+    ColumnBatch *narrowed = (ColumnBatch *)b;
+    narrowed->selected = predicate_select_batch(s->predicate, b, narrowed->selection,
+                                                narrowed->selected, narrowed->selection);
+    if (narrowed->selected)
+      return b;
+  }
+  return NULL;
+}
+
+static const BatchOperatorVTable predicate_filter_vtable = {"BatchPredicateFilter", NULL,
+                                                            predicate_filter_next, NULL, NULL};
+
+BatchOperator *batch_filter_predicate(BatchOperator *child, Predicate *predicate) {
+  if (!predicate) {
+    batch_operator_destroy(child);
+    return NULL;
+  }
+  BatchOperator *op =
+      batch_operator_new(&predicate_filter_vtable, sizeof(PredicateFilterState), child, NULL, 1);
+  if (op)
+    ((PredicateFilterState *)op->state)->predicate = predicate;
+  return op;
+}
+
+/* Project */
+
+typedef struct {
+  char **names;
+  size_t count;
+  ColumnBatch *out; // view over the child's columns
+  int *sources;     // child column of each output column
+  int *columns;     // 0..out->column_count-1, for row comparisons
+  uint64_t *hashes;
+  size_t hash_capacity;
+  RowTable seen;
+} ProjectState;
+
+// Build the output view from the heading of the first child batch
+static int project_prepare(ProjectState *s, const ColumnBatch *b) {
+  s->out = calloc(1, sizeof(ColumnBatch));
+  s->sources = malloc((s->count ? s->count : 1) * sizeof(int));
+  s->columns = malloc((s->count ? s->count : 1) * sizeof(int));
+  if (!s->out || !s->sources || !s->columns)
+    return -1;
+  s->out->columns = calloc(s->count ? s->count : 1, sizeof(ColumnVector));
+  if (!s->out->columns)
+    return -1;
+
+  // Names missing from the input are left out, as operator_project does
+  for (size_t i = 0; i < s->count; i++) {
+    int src = column_batch_find(b, s->names[i]);
+    if (src < 0 || column_batch_find(s->out, s->names[i]) >= 0)
+      continue;
+    ColumnVector *c = &s->out->columns[s->out->column_count];
+    if (!(c->name = strdup(s->names[i])))
+      return -1;
+    c->type = b->columns[src].type;
+    c->borrowed = 1;
+    s->sources[s->out->column_count] = src;
+    s->columns[s->out->column_count] = (int)s->out->column_count;
+    s->out->column_count++;
+  }
+  return row_table_init(&s->seen, s->out);
+}
+
+// Point the view at the arrays of `b` and make room for its selection
+static int project_bind(ProjectState *s, const ColumnBatch *b) {
+  ColumnBatch *out = s->out;
+  if (out->capacity < b->capacity) {
+    uint32_t *selection = realloc(out->selection, b->capacity * sizeof(uint32_t));
+    if (!selection)
+      return -1;
+    out->selection = selection;
+    out->capacity = b->capacity;
+  }
+  for (size_t i = 0; i < out->column_count; i++) {
+    out->columns[i].values = b->columns[s->sources[i]].values;
+    out->columns[i].valid = b->columns[s->sources[i]].valid;
+  }
+  out->rows = b->rows;
+  return reserve_hashes(&s->hashes, &s->hash_capacity, b->selected);
+}
+
+static const ColumnBatch *project_next(BatchOperator *op) {
+  ProjectState *s = (ProjectState *)op->state;
+  const ColumnBatch *b;
+  while ((b = batch_operator_next(op->left)) != NULL) {
+    if ((!s->out && project_prepare(s, b) < 0) || project_bind(s, b) < 0)
+      return NULL;
+    ColumnBatch *out = s->out;
+    if (out->column_count == 0)
+      memset(s->hashes, 0, b->selected * sizeof(uint64_t));
+    for (size_t i = 0; i < out->column_count; i++)
+      batch_hash_column(&out->columns[i], b->selection, b->selected, s->hashes, i > 0);
+
+    out->selected = 0;
+    for (size_t i = 0; i < b->selected; i++) {
+      uint32_t row = b->selection[i];
+      if (row_table_contains(&s->seen, out, row, s->hashes[i], s->columns))
+        continue;
+      if (row_table_add(&s->seen, out, row, s->hashes[i]) < 0)
+        return NULL;
+      out->selection[out->selected++] = row;
+    }
+    if (out->selected)
+      return out;
+  }
+  return NULL;
+}
+
+static void project_close(BatchOperator *op) {
+  ProjectState *s = (ProjectState *)op->state;
+  column_batch_destroy(s->out);
+  s->out = NULL;
+  free(s->sources);
+  s->sources = NULL;
+  free(s->columns);
+  s->columns = NULL;
+  free(s->hashes);
+  s->hashes = NULL;
+  s->hash_capacity = 0;
+  row_table_free(&s->seen);
+}
+
+static void project_destroy(BatchOperator *op) {
+  ProjectState *s = (ProjectState *)op->state;
+  project_close(op);
+  for (size_t i = 0; s->names && i < s->count; i++)
+    free(s->names[i]);
+  free(s->names);
+}
+
+static const BatchOperatorVTable project_vtable = {"BatchProject", NULL, project_next,
+                                                   project_close, project_destroy};
+
+BatchOperator *batch_project(BatchOperator *child, const char **columns, size_t count) {
+  BatchOperator *op = batch_operator_new(&project_vtable, sizeof(ProjectState), child, NULL, 1);
+  if (!op)
+    return NULL;
+  ProjectState *s = (ProjectState *)op->state;
+  s->names = calloc(count ? count : 1, sizeof(char *));
+  if (!s->names) {
+    batch_operator_destroy(op);
+    return NULL;
+  }
+  s->count = count;
+  for (size_t i = 0; i < count; i++) {
+    if (!(s->names[i] = strdup(columns[i]))) {
+      batch_operator_destroy(op);
+      return NULL;
+    }
+  }
+  return op;
+}
+
+/* Hash join */
+
+typedef struct {
+  char *left_column;
+  char *right_column;
+  RowTable build; // right rows with a valid key, hashed on it
+  int build_key;
+  ColumnBatch *out;
+  const ColumnBatch *outer; // current left batch
+  int outer_key;
+  uint64_t *hashes; // key hashes of the outer (or build) batch, by selection position
+  size_t hash_capacity;
+  size_t pos;     // selection position in `outer`
+  uint32_t match; // next candidate build row + 1
+} BatchHashJoinState;
+
+// Buffer the right input
+static int hash_join_open(BatchOperator *op) {
+  BatchHashJoinState *s = (BatchHashJoinState *)op->state;
+  const ColumnBatch *b;
+  while ((b = batch_operator_next(op->right)) != NULL) {
+    if (!s->build.rows) {
+      if (row_table_init(&s->build, b) < 0)
+        return -1;
+      s->build_key = column_batch_find(b, s->right_column);
+    }
+    // Rows without the join column can never match
+    if (s->build_key < 0)
+      continue;
+    if (reserve_hashes(&s->hashes, &s->hash_capacity, b->selected) < 0)
+      return -1;
+    const ColumnVector *key = &b->columns[s->build_key];
+    batch_hash_column(key, b->selection, b->selected, s->hashes, 0);
+    for (size_t i = 0; i < b->selected; i++) {
+      uint32_t row = b->selection[i];
+      if (key->valid[row] && row_table_add(&s->build, b, row, s->hashes[i]) < 0)
+        return -1;
+    }
+  }
+  s->outer = NULL;
+  return 0;
+}
+
+// Output heading: the left columns prefixed left_, then the right ones prefixed right_
+static ColumnBatch *join_heading(const ColumnBatch *left, const ColumnBatch *right) {
+  ColumnBatch *l = column_batch_create_like(left, "left", 0);
+  ColumnBatch *r = column_batch_create_like(right, "right", 0);
+  size_t n = left->column_count + right->column_count;
+  const char **names = malloc((n ? n : 1) * sizeof(char *));
+  AttributeType *types = malloc((n ? n : 1) * sizeof(AttributeType));
+  ColumnBatch *out = NULL;
+  if (l && r && names && types) {
+    for (size_t i = 0; i < l->column_count; i++) {
+      names[i] = l->columns[i].name;
+      types[i] = l->columns[i].type;
+    }
+    for (size_t i = 0; i < r->column_count; i++) {
+      names[l->column_count + i] = r->columns[i].name;
+      types[l->column_count + i] = r->columns[i].type;
+    }
+    out = column_batch_create(names, types, n, BATCH_CAPACITY);
+  }
+  column_batch_destroy(l);
+  column_batch_destroy(r);
+  free(names);
+  free(types);
+  return out;
+}
+
+// Move to the next left batch that has the join column; 0 at the end
+static int hash_join_advance(BatchHashJoinState *s, BatchOperator *left) {
+  while ((s->outer = batch_operator_next(left)) != NULL) {
+    const ColumnBatch *b = s->outer;
+    s->outer_key = column_batch_find(b, s->left_column);
+    if (s->outer_key < 0)
+      continue;
+    if (!s->out && !(s->out = join_heading(b, s->build.rows)))
+      return 0;
+    if (reserve_hashes(&s->hashes, &s->hash_capacity, b->selected) < 0)
+      return 0;
+    batch_hash_column(&b->columns[s->outer_key], b->selection, b->selected, s->hashes, 0);
+    s->pos = 0;
+    s->match = row_table_head(&s->build, s->hashes[0]);
+    return 1;
+  }
+  return 0;
+}
+
+static const ColumnBatch *hash_join_next(BatchOperator *op) {
+  BatchHashJoinState *s = (BatchHashJoinState *)op->state;
+  if (!s->build.rows || s->build.rows->rows == 0)
+    return NULL;
+  if (s->out)
+    column_batch_clear(s->out);
+
+  while (!s->out || s->out->rows < s->out->capacity) {
+    if (!s->outer && !hash_join_advance(s, op->left))
+      break;
+    const ColumnBatch *b = s->outer;
+    if (!s->match) {
+      if (++s->pos == b->selected)
+        s->outer = NULL;
+      else
+        s->match = row_table_head(&s->build, s->hashes[s->pos]);
+      continue;
+    }
+
+    size_t r = s->match - 1;
+    s->match = s->build.chain[r];
+    size_t row = b->selection[s->pos];
+    if (s->build.hashes[r] != s->hashes[s->pos] ||
+        !column_batch_rows_equal(b, row, &s->outer_key, s->build.rows, r, &s->build_key, 1))
+      continue;
+    long o = column_batch_append_row(s->out);
+    if (o < 0 || column_batch_copy_values(s->out, (size_t)o, 0, b, row) < 0 ||
+        column_batch_copy_values(s->out, (size_t)o, b->column_count, s->build.rows, r) < 0)
+      return NULL;
+  }
+  return s->out && s->out->selected ? s->out : NULL;
+}
+
+static void hash_join_close(BatchOperator *op) {
+  BatchHashJoinState *s = (BatchHashJoinState *)op->state;
+  row_table_free(&s->build);
+  column_batch_destroy(s->out);
+  s->out = NULL;
+  free(s->hashes);
+  s->hashes = NULL;
+  s->hash_capacity = 0;
+  s->outer = NULL;
+  s->match = 0;
+}
+
+static void hash_join_destroy(BatchOperator *op) {
+  BatchHashJoinState *s = (BatchHashJoinState *)op->state;
+  hash_join_close(op);
+  free(s->left_column);
+  free(s->right_column);
+}
+
+static const BatchOperatorVTable hash_join_vtable = {"BatchHashJoin", hash_join_open,
+                                                     hash_join_next, hash_join_close,
+                                                     hash_join_destroy};
+
+BatchOperator *batch_hash_join(BatchOperator *left, BatchOperator *right,
+                               const char *left_column, const char *right_column) {
+  BatchOperator *op =
+      batch_operator_new(&hash_join_vtable, sizeof(BatchHashJoinState), left, right, 2);
+  if (!op)
+    return NULL;
+  BatchHashJoinState *s = (BatchHashJoinState *)op->state;
+  s->left_column = strdup(left_column);
+  s->right_column = strdup(right_column);
+  if (!s->left_column || !s->right_column) {
+    batch_operator_destroy(op);
+    return NULL;
+  }
+  return op;
+}
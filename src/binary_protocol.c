@@ -0,0 +1,355 @@
+/**
+ * @file binary_protocol.c
+ * @brief Binary protocol front end for the Relational Algebra Engine.
+ *
+ * Executes the same commands as the XML server but exchanges typed,
+ * length-prefixed frames instead of text (see binary_protocol.h).
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "attribute.h"
+#include "binary_protocol.h"
+#include "expression.h"
+#include "expression_parser.h"
+#include "loader.h"
+#include "relation.h"
+#include "tuple.h"
+
+// Start a response frame; returns the offset of the length prefix
+static size_t begin_response(WireBuffer *out, uint32_t id, BinaryStatus status,
+                             const char *message) {
+  size_t start = out->size;
+  wire_put_u32(out, 0);
+  wire_put_u32(out, id);
+  wire_put_u8(out, (uint8_t)status);
+  wire_put_string(out, message, strlen(message));
+  return start;
+}
+
+// Fill in the length prefix of a finished response frame
+static int end_response(WireBuffer *out, size_t start) {
+  if (out->size < start + 4)
+    return -1;
+  wire_patch_u32(out, start, (uint32_t)(out->size - start - 4));
+  return 0;
+}
+
+static int respond(WireBuffer *out, uint32_t id, BinaryStatus status, const char *message) {
+  size_t start = begin_response(out, id, status, message);
+  return end_response(out, start);
+}
+
+// Copy a wire string view into a NUL-terminated buffer
+static char *string_dup(const char *s, size_t len) {
+  char *copy = malloc(len + 1);
+  if (!copy)
+    return NULL;
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+// Handle CREATE_RELATION
+static int handle_create_relation(Schema *schema, uint32_t id, WireReader *in, WireBuffer *out) {
+  size_t len;
+  const char *s = wire_get_string(in, &len);
+  if (!s)
+    return respond(out, id, BIN_STATUS_ERROR, "Missing relation name");
+
+  char *name = string_dup(s, len);
+  if (!name)
+    return respond(out, id, BIN_STATUS_ERROR, "Failed to create relation");
+
+  if (schema_find_relation(schema, name)) {
+    free(name);
+    return respond(out, id, BIN_STATUS_ERROR, "Relation already exists");
+  }
+
+  int created = schema_create_relation(schema, name, NULL);
+  free(name);
+  if (created != 1)
+    return respond(out, id, BIN_STATUS_ERROR, "Failed to create relation");
+
+  return respond(out, id, BIN_STATUS_OK, "Relation created");
+}
+
+// Handle ADD_TUPLE
+static int handle_add_tuple(Schema *schema, uint32_t id, WireReader *in, WireBuffer *out) {
+  size_t len;
+  const char *s = wire_get_string(in, &len);
+  if (!s)
+    return respond(out, id, BIN_STATUS_ERROR, "Missing relation name");
+
+  char *relation_name = string_dup(s, len);
+  Relation *r = relation_name ? schema_find_relation(schema, relation_name) : NULL;
+  free(relation_name);
+  if (!r)
+    return respond(out, id, BIN_STATUS_ERROR, "Relation not found");
+
+  uint16_t count = wire_get_u16(in);
+  Tuple *t = tuple_create();
+
+  for (uint16_t i = 0; i < count; i++) {
+    const char *attr_name = wire_get_string(in, &len);
+    AttributeType type;
+    void *value = attr_name ? wire_get_value(in, &type) : NULL;
+    if (!value) {
+      tuple_destroy(t);
+      return respond(out, id, BIN_STATUS_ERROR, "Malformed attribute");
+    }
+
+    char *name = string_dup(attr_name, len);
+    tuple_add_attribute(t, attribute_create(name, type, value));
+    free(name);
+  }
+  // A missing count or bytes past the last attribute mean the frame is not one tuple
+  if (in->error || in->offset != in->size) {
+    tuple_destroy(t);
+    return respond(out, id, BIN_STATUS_ERROR, "Malformed tuple");
+  }
+
+  int result = schema_insert_tuple(schema, r, t);
+  if (result == 1)
+    return respond(out, id, BIN_STATUS_OK, "Tuple added");
+
+  tuple_destroy(t);
+  if (result == 0)
+    return respond(out, id, BIN_STATUS_OK, "Tuple already exists");
+  return respond(out, id, BIN_STATUS_ERROR, "Failed to add tuple");
+}
+
+// Heading collected from the first tuple of a relation
+typedef struct {
+  const Attribute **columns;
+  size_t count;
+  size_t capacity;
+} Heading;
+
+static void heading_add_cb(void *element, void *userdata) {
+  Heading *h = (Heading *)userdata;
+  if (h->count == h->capacity) {
+    size_t cap = h->capacity ? h->capacity * 2 : 8;
+    const Attribute **columns = realloc(h->columns, cap * sizeof(*columns));
+    if (!columns)
+      return;
+    h->columns = columns;
+    h->capacity = cap;
+  }
+  h->columns[h->count++] = (const Attribute *)element;
+}
+
+// Remember the first tuple visited (used to derive the heading)
+static void first_tuple_cb(void *element, void *userdata) {
+  Tuple **first = (Tuple **)userdata;
+  if (!*first)
+    *first = (Tuple *)element;
+}
+
+static uint8_t attribute_tag(AttributeType type) {
+  switch (type) {
+  case ATTR_INT:
+    return WIRE_INT;
+  case ATTR_RATIONAL:
+    return WIRE_RATIONAL;
+  case ATTR_STRING:
+    return WIRE_STRING;
+  default:
+    return WIRE_NULL;
+  }
+}
+
+typedef struct {
+  const Heading *heading;
+  WireBuffer *out;
+} RowEncodeContext;
+
+// Encode one tuple as a row of values in heading order
+static void encode_row_cb(void *element, void *userdata) {
+  Tuple *t = (Tuple *)element;
+  RowEncodeContext *ctx = (RowEncodeContext *)userdata;
+  for (size_t i = 0; i < ctx->heading->count; i++) {
+    Attribute *attr = tuple_find_attribute(t, ctx->heading->columns[i]->name);
+    wire_put_value(ctx->out, attr);
+  }
+}
+
+// Send a relation: heading once, then rows
+static int respond_relation(WireBuffer *out, uint32_t id, const char *message, Relation *r) {
+  Tuple *first = NULL;
+  set_foreach(r->tuples, first_tuple_cb, &first);
+
+  Heading heading = {.columns = NULL, .count = 0, .capacity = 0};
+  if (first)
+    set_foreach(first, heading_add_cb, &heading);
+
+  size_t start = begin_response(out, id, BIN_STATUS_OK, message);
+  wire_put_string(out, r->name, strlen(r->name));
+  wire_put_u64(out, set_size(r->tuples));
+  wire_put_u16(out, (uint16_t)heading.count);
+  for (size_t i = 0; i < heading.count; i++) {
+    const Attribute *column = heading.columns[i];
+    wire_put_string(out, column->name, strlen(column->name));
+    wire_put_u8(out, attribute_tag(column->type));
+  }
+
+  wire_put_u64(out, set_size(r->tuples));
+  RowEncodeContext ctx = {.heading = &heading, .out = out};
+  set_foreach(r->tuples, encode_row_cb, &ctx);
+
+  free(heading.columns);
+  return end_response(out, start);
+}
+
+// Handle QUERY_RELATION
+static int handle_query_relation(Schema *schema, uint32_t id, WireReader *in, WireBuffer *out) {
+  size_t len;
+  const char *s = wire_get_string(in, &len);
+  if (!s)
+    return respond(out, id, BIN_STATUS_ERROR, "Missing relation name");
+
+  char *relation_name = string_dup(s, len);
+  Relation *r = relation_name ? schema_find_relation(schema, relation_name) : NULL;
+  free(relation_name);
+  if (!r)
+    return respond(out, id, BIN_STATUS_ERROR, "Relation not found");
+
+  return respond_relation(out, id, "Query executed", r);
+}
+
+// Handle EVALUATE: parse, optimize and run an expression; the result is sent like a query
+static int handle_evaluate(Schema *schema, uint32_t id, WireReader *in, WireBuffer *out) {
+  size_t len;
+  const char *text = wire_get_string(in, &len);
+  if (!text)
+    return respond(out, id, BIN_STATUS_ERROR, "Missing expression");
+
+  char error[256] = "Invalid expression";
+  Expression *e = expression_parse(schema, text, len, error, sizeof(error));
+  if (!e)
+    return respond(out, id, BIN_STATUS_ERROR, error);
+  e = expression_optimize(e);
+  Relation *r = e ? expression_evaluate(e, "result") : NULL;
+  expression_destroy(e);
+  if (!r)
+    return respond(out, id, BIN_STATUS_ERROR, "Evaluation failed");
+
+  int status = respond_relation(out, id, "Expression evaluated", r);
+  relation_destroy(r);
+  return status;
+}
+
+typedef struct {
+  WireBuffer *out;
+  uint32_t count;
+} ListContext;
+
+static void list_relation_cb(void *element, void *userdata) {
+  Relation *r = (Relation *)element;
+  ListContext *ctx = (ListContext *)userdata;
+  wire_put_string(ctx->out, r->name, strlen(r->name));
+  // The cardinality is known without materializing snapshot relations
+  wire_put_u64(ctx->out, r->cardinality.finite_count);
+  ctx->count++;
+}
+
+// Handle LIST_RELATIONS
+static int handle_list_relations(Schema *schema, uint32_t id, WireBuffer *out) {
+  size_t start = begin_response(out, id, BIN_STATUS_OK, "Relations listed");
+  size_t count_offset = out->size;
+  wire_put_u32(out, 0);
+
+  ListContext ctx = {.out = out, .count = 0};
+  schema_foreach(schema, list_relation_cb, &ctx);
+  if (out->size >= count_offset + 4)
+    wire_patch_u32(out, count_offset, ctx.count);
+
+  return end_response(out, start);
+}
+
+// Handle LOAD_RELATION: u64 rows loaded, u64 rows rejected
+static int handle_load_relation(Schema *schema, uint32_t id, WireReader *in, WireBuffer *out) {
+  size_t relation_len, path_len;
+  const char *relation = wire_get_string(in, &relation_len);
+  const char *path = relation ? wire_get_string(in, &path_len) : NULL;
+  if (!path)
+    return respond(out, id, BIN_STATUS_ERROR, "Missing relation or path");
+
+  if (!schema->load_dir)
+    return respond(out, id, BIN_STATUS_ERROR, "No load directory configured");
+
+  char *requested = string_dup(path, path_len);
+  char *file = requested ? loader_resolve_path(schema->load_dir, requested) : NULL;
+  free(requested);
+  if (!file)
+    return respond(out, id, BIN_STATUS_ERROR, "Path is not a file in the load directory");
+
+  char *relation_name = string_dup(relation, relation_len);
+  LoaderStats stats;
+  int status = relation_name ? loader_load_into(schema, relation_name, file, NULL, &stats) : -1;
+  free(relation_name);
+  free(file);
+  if (status < 0)
+    return respond(out, id, BIN_STATUS_ERROR, "Failed to load relation");
+
+  size_t start = begin_response(out, id, BIN_STATUS_OK, "Relation loaded");
+  wire_put_u64(out, stats.rows);
+  wire_put_u64(out, stats.rejected);
+  return end_response(out, start);
+}
+
+// Handle CHECKPOINT
+static int handle_checkpoint(Schema *schema, uint32_t id, WireBuffer *out) {
+  if (!schema->snapshot_path)
+    return respond(out, id, BIN_STATUS_ERROR, "No snapshot path configured");
+  if (schema_checkpoint(schema) < 0)
+    return respond(out, id, BIN_STATUS_ERROR, "Checkpoint failed");
+  return respond(out, id, BIN_STATUS_OK, "Checkpoint written");
+}
+
+int binary_reject_request(const unsigned char *payload, size_t len, const char *message,
+                          WireBuffer *response) {
+  WireReader in;
+  wire_reader_init(&in, payload, len);
+  uint32_t id = wire_get_u32(&in);
+  return respond(response, id, BIN_STATUS_ERROR, message);
+}
+
+int binary_process_request(Schema *schema, const unsigned char *payload, size_t len,
+                           WireBuffer *response) {
+  WireReader in;
+  wire_reader_init(&in, payload, len);
+
+  uint32_t id = wire_get_u32(&in);
+  uint8_t opcode = wire_get_u8(&in);
+  if (in.error)
+    return respond(response, id, BIN_STATUS_ERROR, "Missing command");
+
+  switch (opcode) {
+  case BIN_OP_CREATE_RELATION:
+    return handle_create_relation(schema, id, &in, response);
+  case BIN_OP_ADD_TUPLE:
+    return handle_add_tuple(schema, id, &in, response);
+  case BIN_OP_QUERY_RELATION:
+    return handle_query_relation(schema, id, &in, response);
+  case BIN_OP_LIST_RELATIONS:
+    return handle_list_relations(schema, id, response);
+  case BIN_OP_LOAD_RELATION:
+    return handle_load_relation(schema, id, &in, response);
+  case BIN_OP_CHECKPOINT:
+    return handle_checkpoint(schema, id, response);
+  case BIN_OP_EVALUATE:
+    return handle_evaluate(schema, id, &in, response);
+  default:
+    return respond(response, id, BIN_STATUS_ERROR, "Cannot discern command");
+  }
+}
+
+long binary_frame_size(const unsigned char *data, size_t avail) {
+  if (avail < 4)
+    return 0;
+  uint32_t len = wire_decode_u32(data);
+  if (len > BINARY_MAX_FRAME)
+    return -1;
+  return avail - 4 >= len ? (long)len + 4 : 0;
+}
@@ -72,3 +72,37 @@ Cardinality cardinality_product(Cardinality a, Cardinality b) {
   CardinalityType max_type = a.type > b.type ? a.type : b.type;
   return cardinality_infinite(max_type);
 }
+
+// Whether `c` is known to be the empty cardinality
+static int cardinality_is_zero(Cardinality c) {
+  return c.type == CARD_FINITE && c.finite_count == 0;
+}
+
+Cardinality cardinality_union(Cardinality a, Cardinality b) {
+  if (a.type == CARD_UNKNOWN || b.type == CARD_UNKNOWN)
+    return cardinality_infinite(CARD_UNKNOWN);
+  if (cardinality_is_zero(a))
+    return b;
+  if (cardinality_is_zero(b))
+    return a;
+  if (a.type == CARD_FINITE && b.type == CARD_FINITE)
+    return cardinality_infinite(CARD_UNKNOWN);
+
+  // At least one infinite: the union is as large as the larger input
+  CardinalityType max_type = a.type > b.type ? a.type : b.type;
+  return cardinality_infinite(max_type);
+}
+
+Cardinality cardinality_intersection(Cardinality a, Cardinality b) {
+  if (cardinality_is_zero(a) || cardinality_is_zero(b))
+    return cardinality_finite(0);
+  return cardinality_infinite(CARD_UNKNOWN);
+}
+
+Cardinality cardinality_difference(Cardinality a, Cardinality b) {
+  if (cardinality_is_zero(a) || cardinality_is_zero(b))
+    return a;
+  if (cardinality_is_infinite(a) && b.type == CARD_FINITE)
+    return a;
+  return cardinality_infinite(CARD_UNKNOWN);
+}
@@ -0,0 +1,1127 @@
+/**
+ * @file expression.c
+ * @brief Relational algebra expressions: construction, optimization, compilation.
+ *
+ * The optimizer works on headings (the attribute names an expression
+ * produces), derived from the first tuple of each scanned relation. The
+ * rewrites only move or drop nodes; conditions and names are never changed
+ * except when a selection moves below a rename.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "expression.h"
+#include "statistics.h"
+
+/* Name lists (borrowed strings, no duplicates) */
+
+typedef struct {
+  const char **names;
+  size_t count;
+  size_t capacity;
+  int error;
+} NameList;
+
+static int names_contains(const NameList *l, const char *name) {
+  for (size_t i = 0; i < l->count; i++) {
+    if (strcmp(l->names[i], name) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+static void names_add(NameList *l, const char *name) {
+  if (l->error || names_contains(l, name))
+    return;
+  if (l->count == l->capacity) {
+    size_t cap = l->capacity ? l->capacity * 2 : 8;
+    const char **names = realloc(l->names, cap * sizeof(char *));
+    if (!names) {
+      l->error = 1;
+      return;
+    }
+    l->names = names;
+    l->capacity = cap;
+  }
+  l->names[l->count++] = name;
+}
+
+static void names_add_all(NameList *l, const NameList *from) {
+  for (size_t i = 0; i < from->count; i++)
+    names_add(l, from->names[i]);
+}
+
+// Every name of `a` is in `b`
+static int names_subset(const NameList *a, const NameList *b) {
+  for (size_t i = 0; i < a->count; i++) {
+    if (!names_contains(b, a->names[i]))
+      return 0;
+  }
+  return 1;
+}
+
+static void names_free(NameList *l) {
+  free(l->names);
+  memset(l, 0, sizeof(NameList));
+}
+
+static void heading_add_cb(void *element, void *userdata) {
+  names_add((NameList *)userdata, ((Attribute *)element)->name);
+}
+
+// Attribute names produced by `e`; returns -1 if memory runs out
+static int expression_heading(const Expression *e, NameList *out) {
+  switch (e->kind) {
+  case EXPR_SCAN: {
+    SetIter it;
+    set_iter_init(e->relation->tuples, &it);
+    Tuple *first = set_iter_next(&it);
+    if (first)
+      set_foreach(first, heading_add_cb, out);
+    break;
+  }
+  case EXPR_SELECT:
+  case EXPR_UNION:
+  case EXPR_DIFFERENCE:
+    return expression_heading(e->left, out);
+  case EXPR_PROJECT:
+  case EXPR_DIVIDE: {
+    NameList child = {0};
+    expression_heading(e->left, &child);
+    size_t count = e->kind == EXPR_DIVIDE ? e->quotient_count : e->name_count;
+    for (size_t i = 0; i < count; i++) {
+      if (names_contains(&child, e->names[i]))
+        names_add(out, e->names[i]);
+    }
+    out->error |= child.error;
+    names_free(&child);
+    break;
+  }
+  case EXPR_RENAME: {
+    NameList child = {0};
+    expression_heading(e->left, &child);
+    int renamed = names_contains(&child, e->names[0]) && !names_contains(&child, e->names[1]);
+    for (size_t i = 0; i < child.count; i++)
+      names_add(out, renamed && strcmp(child.names[i], e->names[0]) == 0 ? e->names[1]
+                                                                         : child.names[i]);
+    out->error |= child.error;
+    names_free(&child);
+    break;
+  }
+  case EXPR_JOIN:
+  case EXPR_PRODUCT:
+    expression_heading(e->left, out);
+    expression_heading(e->right, out);
+    break;
+  }
+  return out->error ? -1 : 0;
+}
+
+// Attributes referenced by a condition
+static void condition_names(const Condition *c, NameList *out) {
+  names_add(out, c->attribute);
+  if (!c->constant)
+    names_add(out, c->other);
+}
+
+// Attributes present on both sides of a binary expression
+static int shared_names(const Expression *e, NameList *out) {
+  NameList left = {0}, right = {0};
+  int status = expression_heading(e->left, &left) | expression_heading(e->right, &right);
+  for (size_t i = 0; status == 0 && i < left.count; i++) {
+    if (names_contains(&right, left.names[i]))
+      names_add(out, left.names[i]);
+  }
+  names_free(&left);
+  names_free(&right);
+  return status || out->error ? -1 : 0;
+}
+
+/* Construction */
+
+// Allocate a node; takes ownership of the children
+static Expression *expression_new(ExpressionKind kind, Expression *left, Expression *right,
+                                  int arity) {
+  Expression *e = calloc(1, sizeof(Expression));
+  if (!e || (arity >= 1 && !left) || (arity >= 2 && !right)) {
+    free(e);
+    expression_destroy(left);
+    expression_destroy(right);
+    return NULL;
+  }
+  e->kind = kind;
+  e->left = left;
+  e->right = right;
+  return e;
+}
+
+// Copy `count` names into the node
+static int set_names(Expression *e, const char *const *names, size_t count) {
+  e->names = calloc(count ? count : 1, sizeof(char *));
+  if (!e->names)
+    return -1;
+  e->name_count = count;
+  for (size_t i = 0; i < count; i++) {
+    if (!(e->names[i] = strdup(names[i])))
+      return -1;
+  }
+  return 0;
+}
+
+Expression *expression_scan(const Relation *r) {
+  if (!r)
+    return NULL;
+  Expression *e = expression_new(EXPR_SCAN, NULL, NULL, 0);
+  if (e)
+    e->relation = r;
+  return e;
+}
+
+// Build a selection node with a copy of condition `c` over `child`
+static Expression *select_with(Expression *child, const Condition *c) {
+  Expression *e = expression_new(EXPR_SELECT, child, NULL, 1);
+  if (!e)
+    return NULL;
+  e->condition.op = c->op;
+  e->condition.attribute = strdup(c->attribute);
+  int ok = e->condition.attribute != NULL;
+  if (ok && c->constant)
+    ok = (e->condition.constant = attribute_copy(c->constant)) != NULL;
+  else if (ok)
+    ok = (e->condition.other = strdup(c->other)) != NULL;
+  if (!ok) {
+    expression_destroy(e);
+    return NULL;
+  }
+  return e;
+}
+
+Expression *expression_select(Expression *child, const char *attribute, CompareOp op,
+                              const Attribute *constant) {
+  if (!attribute || !constant || !constant->value) {
+    expression_destroy(child);
+    return NULL;
+  }
+  Condition c = {.attribute = (char *)attribute, .op = op, .constant = (Attribute *)constant};
+  return select_with(child, &c);
+}
+
+Expression *expression_select_attributes(Expression *child, const char *attribute, CompareOp op,
+                                         const char *other) {
+  if (!attribute || !other) {
+    expression_destroy(child);
+    return NULL;
+  }
+  Condition c = {.attribute = (char *)attribute, .op = op, .other = (char *)other};
+  return select_with(child, &c);
+}
+
+Expression *expression_project(Expression *child, const char **names, size_t count) {
+  Expression *e = expression_new(EXPR_PROJECT, child, NULL, 1);
+  if (e && set_names(e, names, count) < 0) {
+    expression_destroy(e);
+    return NULL;
+  }
+  return e;
+}
+
+Expression *expression_rename(Expression *child, const char *from, const char *to) {
+  Expression *e = expression_new(EXPR_RENAME, child, NULL, 1);
+  const char *names[] = {from, to};
+  if (e && (!from || !to || set_names(e, names, 2) < 0)) {
+    expression_destroy(e);
+    return NULL;
+  }
+  return e;
+}
+
+Expression *expression_join(Expression *left, Expression *right) {
+  return expression_new(EXPR_JOIN, left, right, 2);
+}
+
+Expression *expression_product(Expression *left, Expression *right) {
+  return expression_new(EXPR_PRODUCT, left, right, 2);
+}
+
+Expression *expression_union(Expression *left, Expression *right) {
+  return expression_new(EXPR_UNION, left, right, 2);
+}
+
+Expression *expression_difference(Expression *left, Expression *right) {
+  return expression_new(EXPR_DIFFERENCE, left, right, 2);
+}
+
+Expression *expression_divide(Expression *dividend, Expression *divisor, const char **quotient,
+                              size_t quotient_count, const char **divisor_attrs,
+                              size_t divisor_count) {
+  Expression *e = expression_new(EXPR_DIVIDE, dividend, divisor, 2);
+  size_t count = quotient_count + divisor_count;
+  const char **names = malloc((count ? count : 1) * sizeof(char *));
+  int ok = e && names;
+  for (size_t i = 0; ok && i < count; i++) {
+    names[i] = i < quotient_count ? quotient[i] : divisor_attrs[i - quotient_count];
+    for (size_t j = 0; i >= quotient_count && j < quotient_count; j++)
+      ok = ok && strcmp(names[i], names[j]) != 0;
+  }
+  if (!ok || set_names(e, names, count) < 0) {
+    expression_destroy(e);
+    e = NULL;
+  } else {
+    e->quotient_count = quotient_count;
+  }
+  free(names);
+  return e;
+}
+
+// Free one node, leaving its children alone
+static void expression_free_node(Expression *e) {
+  free(e->condition.attribute);
+  free(e->condition.other);
+  if (e->condition.constant)
+    attribute_destroy(e->condition.constant);
+  for (size_t i = 0; e->names && i < e->name_count; i++)
+    free(e->names[i]);
+  free(e->names);
+  free(e);
+}
+
+void expression_destroy(Expression *e) {
+  if (!e)
+    return;
+  expression_destroy(e->left);
+  expression_destroy(e->right);
+  expression_free_node(e);
+}
+
+/* Estimation */
+
+// Scale a finite cardinality by a fraction, keeping non-empty inputs non-empty
+static Cardinality scale(Cardinality c, double fraction) {
+  if (!cardinality_is_finite(c) || c.finite_count == 0)
+    return c;
+  uint64_t scaled = (uint64_t)((double)c.finite_count * fraction + 0.5);
+  return cardinality_finite(scaled ? scaled : 1);
+}
+
+// Whether `a` is a smaller estimate than `b`
+static int cardinality_less(Cardinality a, Cardinality b) {
+  if (cardinality_is_finite(a) != cardinality_is_finite(b))
+    return cardinality_is_finite(a);
+  if (cardinality_is_finite(a))
+    return a.finite_count < b.finite_count;
+  return a.type < b.type;
+}
+
+// Estimated size of a join of inputs of sizes `a` and `b` when nothing else is known
+static Cardinality join_estimate(Cardinality a, Cardinality b, int shares_attributes) {
+  if (!shares_attributes || !cardinality_is_finite(a) || !cardinality_is_finite(b))
+    return cardinality_product(a, b);
+  return cardinality_less(a, b) ? b : a;
+}
+
+// Statistics of the relation attribute `*name` of `e` comes from, following
+// renames (which update `*name`); NULL when it has none or mixes several inputs
+static RelationStatistics *attribute_source(const Expression *e, const char **name) {
+  switch (e->kind) {
+  case EXPR_SCAN:
+    return e->relation->statistics;
+  case EXPR_SELECT:
+  case EXPR_PROJECT:
+  case EXPR_DIFFERENCE:
+  case EXPR_DIVIDE:
+    return attribute_source(e->left, name);
+  case EXPR_RENAME:
+    if (strcmp(*name, e->names[1]) == 0)
+      *name = e->names[0];
+    else if (strcmp(*name, e->names[0]) == 0)
+      return NULL;
+    return attribute_source(e->left, name);
+  case EXPR_JOIN:
+  case EXPR_PRODUCT: {
+    NameList left = {0};
+    int in_left = expression_heading(e->left, &left) == 0 && names_contains(&left, *name);
+    names_free(&left);
+    // A shared join attribute is described equally well by either side
+    return attribute_source(in_left ? e->left : e->right, name);
+  }
+  case EXPR_UNION:
+    return NULL;
+  }
+  return NULL;
+}
+
+// Estimated distinct values of an attribute of `e` with `rows` tuples (0 if unknown)
+static uint64_t expression_distinct(const Expression *e, const char *name, Cardinality rows) {
+  const RelationStatistics *stats = attribute_source(e, &name);
+  uint64_t distinct = stats ? statistics_distinct(stats, name) : 0;
+  if (cardinality_is_finite(rows) && distinct > rows.finite_count)
+    distinct = rows.finite_count;
+  return distinct;
+}
+
+static double selection_selectivity(const Expression *e) {
+  const Condition *c = &e->condition;
+  if (c->constant) {
+    const char *name = c->attribute;
+    const RelationStatistics *stats = attribute_source(e->left, &name);
+    if (stats)
+      return statistics_selectivity(stats, name, c->op, c->constant);
+  }
+  switch (c->op) {
+  case CMP_EQ:
+    return STATISTICS_DEFAULT_EQ_SELECTIVITY;
+  case CMP_NE:
+    return 1.0 - STATISTICS_DEFAULT_EQ_SELECTIVITY;
+  default:
+    return STATISTICS_DEFAULT_RANGE_SELECTIVITY;
+  }
+}
+
+// |L ⋈ R| = |L| |R| / max(distinct(L.a), distinct(R.a)) for each shared attribute a
+static Cardinality natural_join_estimate(const Expression *e) {
+  Cardinality a = expression_estimate(e->left);
+  Cardinality b = expression_estimate(e->right);
+  NameList shared = {0};
+  shared_names(e, &shared);
+  if (shared.count == 0 || !cardinality_is_finite(a) || !cardinality_is_finite(b)) {
+    names_free(&shared);
+    return join_estimate(a, b, shared.count > 0);
+  }
+  double size = (double)a.finite_count * (double)b.finite_count;
+  int known = 0;
+  for (size_t i = 0; i < shared.count; i++) {
+    uint64_t da = expression_distinct(e->left, shared.names[i], a);
+    uint64_t db = expression_distinct(e->right, shared.names[i], b);
+    if (da && db) {
+      size /= (double)(da > db ? da : db);
+      known = 1;
+    }
+  }
+  names_free(&shared);
+  if (!known)
+    return join_estimate(a, b, 1);
+  if (size < 1.0 && a.finite_count && b.finite_count)
+    size = 1.0;
+  return cardinality_finite((uint64_t)(size + 0.5));
+}
+
+Cardinality expression_estimate(const Expression *e) {
+  switch (e->kind) {
+  case EXPR_SCAN:
+    return e->relation->cardinality;
+  case EXPR_SELECT:
+    return scale(expression_estimate(e->left), selection_selectivity(e));
+  case EXPR_PROJECT:
+  case EXPR_RENAME:
+  case EXPR_DIFFERENCE:
+    return expression_estimate(e->left);
+  case EXPR_JOIN:
+    return natural_join_estimate(e);
+  case EXPR_PRODUCT:
+    return cardinality_product(expression_estimate(e->left), expression_estimate(e->right));
+  case EXPR_DIVIDE: {
+    // Each quotient tuple needs one dividend tuple per divisor tuple
+    Cardinality a = expression_estimate(e->left);
+    Cardinality b = expression_estimate(e->right);
+    if (cardinality_is_finite(a) && cardinality_is_finite(b) && b.finite_count > 1)
+      return scale(a, 1.0 / (double)b.finite_count);
+    return a;
+  }
+  case EXPR_UNION: {
+    Cardinality a = expression_estimate(e->left);
+    Cardinality b = expression_estimate(e->right);
+    if (cardinality_is_finite(a) && cardinality_is_finite(b))
+      return cardinality_finite(a.finite_count + b.finite_count);
+    return cardinality_product(a, b);
+  }
+  }
+  return cardinality_infinite(CARD_UNKNOWN);
+}
+
+/* Selection pushdown */
+
+// Replace every reference to `from` in a condition by `to`
+static int condition_rename(Condition *c, const char *from, const char *to) {
+  char **names[] = {&c->attribute, &c->other};
+  for (size_t i = 0; i < 2; i++) {
+    if (!*names[i] || strcmp(*names[i], from) != 0)
+      continue;
+    char *copy = strdup(to);
+    if (!copy)
+      return -1;
+    free(*names[i]);
+    *names[i] = copy;
+  }
+  return 0;
+}
+
+static Expression *sink_selection(Expression *sel);
+
+// Move `sel` below `child` into the child's input `slot`; returns the new root (`child`)
+static Expression *sink_into(Expression *sel, Expression *child, Expression **slot) {
+  sel->left = *slot;
+  *slot = sink_selection(sel);
+  return child;
+}
+
+// Push selection `sel` as far down as it can go; returns the new root of its subtree
+static Expression *sink_selection(Expression *sel) {
+  Expression *child = sel->left;
+  NameList attrs = {0}, heading = {0}, right = {0};
+  condition_names(&sel->condition, &attrs);
+  expression_heading(child, &heading);
+
+  // A condition on a missing attribute never holds; moving it could change that
+  Expression *root = sel;
+  if (attrs.error || heading.error || !names_subset(&attrs, &heading))
+    goto done;
+
+  switch (child->kind) {
+  case EXPR_SELECT:
+  case EXPR_PROJECT:
+  case EXPR_DIFFERENCE:
+  case EXPR_DIVIDE: // σ(R ÷ S) = σ(R) ÷ S for a condition on quotient attributes
+    root = sink_into(sel, child, &child->left);
+    break;
+  case EXPR_RENAME:
+    if (names_contains(&attrs, child->names[0]) ||
+        condition_rename(&sel->condition, child->names[1], child->names[0]) < 0)
+      break;
+    root = sink_into(sel, child, &child->left);
+    break;
+  case EXPR_UNION: {
+    Expression *copy = select_with(child->right, &sel->condition);
+    // On failure select_with has destroyed the right input, which marks the tree invalid
+    child->right = copy ? sink_selection(copy) : NULL;
+    root = sink_into(sel, child, &child->left);
+    break;
+  }
+  case EXPR_JOIN:
+  case EXPR_PRODUCT: {
+    NameList left = {0};
+    expression_heading(child->left, &left);
+    expression_heading(child->right, &right);
+    int in_left = !left.error && names_subset(&attrs, &left);
+    int in_right = !right.error && names_subset(&attrs, &right);
+    names_free(&left);
+    if (in_left && in_right && child->kind == EXPR_JOIN) {
+      // Shared attributes are equal on both sides of a natural join
+      Expression *copy = select_with(child->right, &sel->condition);
+      child->right = copy ? sink_selection(copy) : NULL;
+    }
+    if (in_left)
+      root = sink_into(sel, child, &child->left);
+    else if (in_right)
+      root = sink_into(sel, child, &child->right);
+    break;
+  }
+  default:
+    break;
+  }
+
+done:
+  names_free(&attrs);
+  names_free(&heading);
+  names_free(&right);
+  return root;
+}
+
+static int has_null_child(const Expression *e, int arity) {
+  return (arity >= 1 && !e->left) || (arity >= 2 && !e->right);
+}
+
+static int expression_arity(const Expression *e) {
+  switch (e->kind) {
+  case EXPR_SCAN:
+    return 0;
+  case EXPR_SELECT:
+  case EXPR_PROJECT:
+  case EXPR_RENAME:
+    return 1;
+  default:
+    return 2;
+  }
+}
+
+// Whether a tree is intact (rewrites leave NULL children when memory runs out)
+static int expression_valid(const Expression *e) {
+  if (!e || has_null_child(e, expression_arity(e)))
+    return 0;
+  return (!e->left || expression_valid(e->left)) && (!e->right || expression_valid(e->right));
+}
+
+static Expression *push_selections(Expression *e) {
+  if (e->left)
+    e->left = push_selections(e->left);
+  if (e->right)
+    e->right = push_selections(e->right);
+  if (e->kind == EXPR_SELECT && e->left)
+    return sink_selection(e);
+  return e;
+}
+
+/* Join reordering */
+
+typedef struct {
+  Expression **items;
+  size_t count;
+  size_t capacity;
+} ExpressionList;
+
+static int list_add(ExpressionList *l, Expression *e) {
+  if (l->count == l->capacity) {
+    size_t cap = l->capacity ? l->capacity * 2 : 8;
+    Expression **items = realloc(l->items, cap * sizeof(Expression *));
+    if (!items)
+      return -1;
+    l->items = items;
+    l->capacity = cap;
+  }
+  l->items[l->count++] = e;
+  return 0;
+}
+
+// A natural join, or a product of disjoint headings (which is the same thing)
+static int is_join(const Expression *e) {
+  if (e->kind == EXPR_JOIN)
+    return 1;
+  if (e->kind != EXPR_PRODUCT)
+    return 0;
+  NameList shared = {0};
+  int status = shared_names(e, &shared);
+  int disjoint = status == 0 && shared.count == 0;
+  names_free(&shared);
+  return disjoint;
+}
+
+// Collect the inputs of a tree of joins, freeing the join nodes
+static int flatten_joins(Expression *e, ExpressionList *inputs) {
+  if (!is_join(e)) {
+    if (list_add(inputs, e) == 0)
+      return 0;
+    expression_destroy(e);
+    return -1;
+  }
+  Expression *left = e->left, *right = e->right;
+  expression_free_node(e);
+  int status = flatten_joins(left, inputs);
+  return flatten_joins(right, inputs) | status;
+}
+
+static Expression *reorder_joins(Expression *e);
+
+// Rebuild a join tree greedily from its inputs (which are consumed)
+static Expression *build_join_order(ExpressionList *inputs) {
+  size_t n = inputs->count;
+  Cardinality *estimates = malloc(n * sizeof(Cardinality));
+  NameList *headings = calloc(n, sizeof(NameList));
+  NameList joined = {0};
+  Expression *acc = NULL;
+  if (!estimates || !headings)
+    goto done;
+
+  size_t first = 0;
+  for (size_t i = 0; i < n; i++) {
+    estimates[i] = expression_estimate(inputs->items[i]);
+    expression_heading(inputs->items[i], &headings[i]);
+    if (cardinality_less(estimates[i], estimates[first]))
+      first = i;
+  }
+  acc = inputs->items[first];
+  inputs->items[first] = NULL;
+  names_add_all(&joined, &headings[first]);
+  Cardinality acc_estimate = estimates[first];
+
+  for (size_t step = 1; acc && step < n; step++) {
+    // Prefer inputs that share attributes (a real join over a product), then the smallest result
+    size_t best = n;
+    int best_shares = 0;
+    Cardinality best_estimate = {0};
+    for (size_t j = 0; j < n; j++) {
+      if (!inputs->items[j])
+        continue;
+      int shares = 0;
+      for (size_t k = 0; !shares && k < headings[j].count; k++)
+        shares = names_contains(&joined, headings[j].names[k]);
+      Expression probe = {.kind = EXPR_JOIN, .left = acc, .right = inputs->items[j]};
+      Cardinality estimate = expression_estimate(&probe);
+      if (best == n || shares > best_shares ||
+          (shares == best_shares && cardinality_less(estimate, best_estimate))) {
+        best = j;
+        best_shares = shares;
+        best_estimate = estimate;
+      }
+    }
+
+    Expression *next = inputs->items[best];
+    inputs->items[best] = NULL;
+    // The smaller side goes right, where the join buffers it
+    acc = cardinality_less(acc_estimate, estimates[best]) ? expression_join(next, acc)
+                                                          : expression_join(acc, next);
+    names_add_all(&joined, &headings[best]);
+    acc_estimate = best_estimate;
+  }
+
+done:
+  for (size_t i = 0; i < n; i++) {
+    expression_destroy(inputs->items[i]);
+    if (headings)
+      names_free(&headings[i]);
+  }
+  free(estimates);
+  free(headings);
+  names_free(&joined);
+  return acc;
+}
+
+static Expression *reorder_joins(Expression *e) {
+  if (!is_join(e)) {
+    if (e->left)
+      e->left = reorder_joins(e->left);
+    if (e->right)
+      e->right = reorder_joins(e->right);
+    return e;
+  }
+
+  ExpressionList inputs = {0};
+  int status = flatten_joins(e, &inputs);
+  for (size_t i = 0; i < inputs.count; i++)
+    inputs.items[i] = reorder_joins(inputs.items[i]);
+  Expression *result = status == 0 ? build_join_order(&inputs) : NULL;
+  if (status != 0) {
+    for (size_t i = 0; i < inputs.count; i++)
+      expression_destroy(inputs.items[i]);
+  }
+  free(inputs.items);
+  return result;
+}
+
+/* Projection pushdown and elimination */
+
+// Wrap `e` in a projection onto `names`
+static Expression *project_onto(Expression *e, const NameList *names) {
+  return expression_project(e, names->names, names->count);
+}
+
+// Push projections into join inputs; `required` is NULL when every attribute is needed
+static Expression *push_projections(Expression *e, const NameList *required) {
+  NameList need = {0};
+  switch (e->kind) {
+  case EXPR_PROJECT:
+    for (size_t i = 0; i < e->name_count; i++)
+      names_add(&need, e->names[i]);
+    e->left = push_projections(e->left, need.error ? NULL : &need);
+    break;
+  case EXPR_SELECT:
+    if (required) {
+      names_add_all(&need, required);
+      condition_names(&e->condition, &need);
+    }
+    e->left = push_projections(e->left, required && !need.error ? &need : NULL);
+    break;
+  case EXPR_RENAME:
+    if (required) {
+      names_add_all(&need, required);
+      names_add(&need, e->names[0]);
+    }
+    e->left = push_projections(e->left, required && !need.error ? &need : NULL);
+    break;
+  case EXPR_UNION:
+    e->left = push_projections(e->left, required);
+    e->right = push_projections(e->right, required);
+    break;
+  case EXPR_JOIN:
+  case EXPR_PRODUCT: {
+    if (!required) {
+      e->left = push_projections(e->left, NULL);
+      e->right = push_projections(e->right, NULL);
+      break;
+    }
+    NameList keep = {0};
+    names_add_all(&keep, required);
+    if (e->kind == EXPR_JOIN)
+      shared_names(e, &keep);
+    Expression **sides[] = {&e->left, &e->right};
+    for (size_t s = 0; s < 2; s++) {
+      NameList heading = {0}, narrowed = {0};
+      expression_heading(*sides[s], &heading);
+      for (size_t i = 0; i < heading.count; i++) {
+        if (names_contains(&keep, heading.names[i]))
+          names_add(&narrowed, heading.names[i]);
+      }
+      int ok = !keep.error && !heading.error && !narrowed.error;
+      *sides[s] = push_projections(*sides[s], ok ? &narrowed : NULL);
+      if (ok && narrowed.count < heading.count && *sides[s])
+        *sides[s] = project_onto(*sides[s], &narrowed);
+      names_free(&heading);
+      names_free(&narrowed);
+    }
+    names_free(&keep);
+    break;
+  }
+  case EXPR_DIFFERENCE:
+  case EXPR_DIVIDE:
+    // π(A − B) differs from π(A) − π(B), so nothing is narrowed below a difference
+    e->left = push_projections(e->left, NULL);
+    e->right = push_projections(e->right, NULL);
+    break;
+  case EXPR_SCAN:
+    break;
+  }
+  names_free(&need);
+  return e;
+}
+
+static Expression *eliminate_projections(Expression *e) {
+  if (e->left)
+    e->left = eliminate_projections(e->left);
+  if (e->right)
+    e->right = eliminate_projections(e->right);
+  if (e->kind != EXPR_PROJECT || !e->left)
+    return e;
+
+  NameList names = {0};
+  for (size_t i = 0; i < e->name_count; i++)
+    names_add(&names, e->names[i]);
+
+  // π_X(π_Y(E)) = π_X(E) when X ⊆ Y
+  while (e->left->kind == EXPR_PROJECT && !names.error) {
+    NameList inner = {0};
+    for (size_t i = 0; i < e->left->name_count; i++)
+      names_add(&inner, e->left->names[i]);
+    int subset = !inner.error && names_subset(&names, &inner);
+    names_free(&inner);
+    if (!subset)
+      break;
+    Expression *inner_node = e->left;
+    e->left = inner_node->left;
+    expression_free_node(inner_node);
+  }
+
+  // A projection onto every attribute of its input does nothing
+  NameList heading = {0};
+  expression_heading(e->left, &heading);
+  int redundant = !names.error && !heading.error && names_subset(&names, &heading) &&
+                  names_subset(&heading, &names);
+  names_free(&heading);
+  names_free(&names);
+  if (!redundant)
+    return e;
+  Expression *child = e->left;
+  expression_free_node(e);
+  return child;
+}
+
+Expression *expression_optimize(Expression *e) {
+  if (!e)
+    return NULL;
+  e = push_selections(e);
+  if (e && expression_valid(e))
+    e = reorder_joins(e);
+  if (e && expression_valid(e))
+    e = push_projections(e, NULL);
+  if (e && expression_valid(e))
+    e = eliminate_projections(e);
+  if (!e || !expression_valid(e)) {
+    expression_destroy(e);
+    return NULL;
+  }
+  return e;
+}
+
+/* Compilation */
+
+// Selection predicate: evaluate a Condition against a tuple
+static int condition_holds(Tuple *t, void *userdata) {
+  const Condition *c = (const Condition *)userdata;
+  Attribute *a = tuple_find_attribute(t, c->attribute);
+  Attribute *b = c->constant ? c->constant : tuple_find_attribute(t, c->other);
+  int cmp;
+  if (!a || !b || attribute_value_compare(a, b, &cmp) < 0)
+    return 0;
+  return compare_op_holds(c->op, cmp);
+}
+
+// An index answering a selection directly on a scan, or NULL
+static const RelationIndex *selection_index(const Expression *e) {
+  const Condition *c = &e->condition;
+  if (e->left->kind != EXPR_SCAN || !c->constant)
+    return NULL;
+  const char *attrs[] = {c->attribute};
+  return relation_find_index(e->left->relation, attrs, 1, c->op);
+}
+
+// The scanned input of a join that has an index on exactly the shared attributes, or NULL
+static const Expression *indexed_join_input(const Expression *e, const RelationIndex **index) {
+  NameList shared = {0};
+  const Expression *found = NULL;
+  if (shared_names(e, &shared) == 0 && shared.count > 0) {
+    const Expression *sides[] = {e->right, e->left};
+    for (size_t i = 0; !found && i < 2; i++) {
+      if (sides[i]->kind != EXPR_SCAN)
+        continue;
+      *index = relation_find_index(sides[i]->relation, (const char *const *)shared.names,
+                                   shared.count, CMP_EQ);
+      if (*index)
+        found = sides[i];
+    }
+  }
+  names_free(&shared);
+  return found;
+}
+
+Operator *expression_compile(const Expression *e) {
+  if (!e)
+    return NULL;
+  switch (e->kind) {
+  case EXPR_SCAN:
+    return operator_scan(e->relation);
+  case EXPR_SELECT: {
+    const RelationIndex *index = selection_index(e);
+    if (index)
+      return operator_index_scan(e->left->relation, index, e->condition.attribute,
+                                 e->condition.op, e->condition.constant);
+    return operator_select(expression_compile(e->left), condition_holds, (void *)&e->condition);
+  }
+  case EXPR_PROJECT:
+    return operator_project(expression_compile(e->left), (const char **)e->names, e->name_count);
+  case EXPR_RENAME:
+    return operator_rename(expression_compile(e->left), e->names[0], e->names[1]);
+  case EXPR_JOIN: {
+    const RelationIndex *index = NULL;
+    const Expression *inner = indexed_join_input(e, &index);
+    if (inner) {
+      Operator *outer = expression_compile(inner == e->left ? e->right : e->left);
+      return operator_index_join(outer, inner->relation, index);
+    }
+    NameList shared = {0};
+    if (shared_names(e, &shared) < 0) {
+      names_free(&shared);
+      return NULL;
+    }
+    Operator *left = expression_compile(e->left);
+    Operator *right = expression_compile(e->right);
+    Operator *op = operator_natural_join(left, right, shared.names, shared.count);
+    names_free(&shared);
+    return op;
+  }
+  case EXPR_PRODUCT: {
+    Operator *left = expression_compile(e->left);
+    Operator *right = expression_compile(e->right);
+    return operator_natural_join(left, right, NULL, 0);
+  }
+  case EXPR_UNION: {
+    Operator *left = expression_compile(e->left);
+    Operator *right = expression_compile(e->right);
+    return operator_union(left, right);
+  }
+  case EXPR_DIFFERENCE: {
+    Operator *left = expression_compile(e->left);
+    Operator *right = expression_compile(e->right);
+    return operator_difference(left, right);
+  }
+  case EXPR_DIVIDE: {
+    Operator *left = expression_compile(e->left);
+    Operator *right = expression_compile(e->right);
+    return operator_divide(left, right, (const char **)e->names, e->quotient_count,
+                           (const char **)e->names + e->quotient_count,
+                           e->name_count - e->quotient_count);
+  }
+  }
+  return NULL;
+}
+
+Relation *expression_evaluate(const Expression *e, const char *name) {
+  Operator *plan = expression_compile(e);
+  if (!plan)
+    return NULL;
+  Relation *result = operator_collect(plan, name);
+  operator_destroy(plan);
+  return result;
+}
+
+/* Printing */
+
+typedef struct {
+  char *data;
+  size_t len;
+  size_t capacity;
+  int error;
+} TextBuffer;
+
+static void text_append(TextBuffer *b, const char *fmt, ...) {
+  if (b->error)
+    return;
+  for (;;) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(b->data + b->len, b->capacity - b->len, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+      b->error = 1;
+      return;
+    }
+    if ((size_t)n < b->capacity - b->len) {
+      b->len += (size_t)n;
+      return;
+    }
+    size_t cap = (b->capacity + (size_t)n + 1) * 2;
+    char *data = realloc(b->data, cap);
+    if (!data) {
+      b->error = 1;
+      return;
+    }
+    b->data = data;
+    b->capacity = cap;
+  }
+}
+
+static const char *compare_op_symbol(CompareOp op) {
+  static const char *symbols[] = {"=", "!=", "<", "<=", ">", ">="};
+  return symbols[op];
+}
+
+static void constant_to_text(TextBuffer *b, const Attribute *a) {
+  switch (a->type) {
+  case ATTR_INT:
+    text_append(b, "%d", *(int *)a->value);
+    break;
+  case ATTR_RATIONAL: {
+    // Keep a decimal point so the value reads back as a rational
+    char number[64];
+    snprintf(number, sizeof(number), "%.17g", *(double *)a->value);
+    text_append(b, strpbrk(number, ".eEn") ? "%s" : "%s.0", number);
+    break;
+  }
+  case ATTR_STRING:
+    text_append(b, "\"");
+    for (const char *p = a->value; *p; p++)
+      text_append(b, *p == '"' || *p == '\\' ? "\\%c" : "%c", *p);
+    text_append(b, "\"");
+    break;
+  default:
+    text_append(b, "?");
+  }
+}
+
+// The arguments of one node (not its inputs), each preceded by a space
+static void node_arguments_to_text(TextBuffer *b, const Expression *e) {
+  switch (e->kind) {
+  case EXPR_SCAN:
+    text_append(b, " %s", e->relation->name);
+    break;
+  case EXPR_SELECT:
+    text_append(b, " (%s %s ", compare_op_symbol(e->condition.op), e->condition.attribute);
+    if (e->condition.constant)
+      constant_to_text(b, e->condition.constant);
+    else
+      text_append(b, "%s", e->condition.other);
+    text_append(b, ")");
+    break;
+  case EXPR_PROJECT:
+    text_append(b, " (");
+    for (size_t i = 0; i < e->name_count; i++)
+      text_append(b, i ? " %s" : "%s", e->names[i]);
+    text_append(b, ")");
+    break;
+  case EXPR_DIVIDE:
+    text_append(b, " (");
+    for (size_t i = 0; i < e->quotient_count; i++)
+      text_append(b, i ? " %s" : "%s", e->names[i]);
+    text_append(b, ") (");
+    for (size_t i = e->quotient_count; i < e->name_count; i++)
+      text_append(b, i > e->quotient_count ? " %s" : "%s", e->names[i]);
+    text_append(b, ")");
+    break;
+  case EXPR_RENAME:
+    text_append(b, " %s %s", e->names[0], e->names[1]);
+    break;
+  default:
+    break;
+  }
+}
+
+static void expression_to_text(TextBuffer *b, const Expression *e) {
+  static const char *keywords[] = {"scan",  "select",     "project", "rename", "join",
+                                   "product", "union", "difference", "divide"};
+  text_append(b, "(%s", keywords[e->kind]);
+  node_arguments_to_text(b, e);
+  if (e->left) {
+    text_append(b, " ");
+    expression_to_text(b, e->left);
+  }
+  if (e->right) {
+    text_append(b, " ");
+    expression_to_text(b, e->right);
+  }
+  text_append(b, ")");
+}
+
+char *expression_to_string(const Expression *e) {
+  TextBuffer b = {0};
+  expression_to_text(&b, e);
+  if (b.error || !b.data) {
+    free(b.data);
+    return NULL;
+  }
+  return b.data;
+}
+
+/* Profiling */
+
+// Label each operator with the arguments of the expression node it was compiled from
+static void label_plan(const Expression *e, Operator *op) {
+  if (!e || !op || !op->profile)
+    return;
+  // Index scans and joins absorb a scan input; name its relation too
+  const RelationIndex *index = NULL;
+  const Expression *absorbed = NULL;
+  if (e->kind == EXPR_SELECT && selection_index(e))
+    absorbed = e->left;
+  else if (e->kind == EXPR_JOIN)
+    absorbed = indexed_join_input(e, &index);
+
+  TextBuffer b = {0};
+  if (absorbed)
+    node_arguments_to_text(&b, absorbed);
+  node_arguments_to_text(&b, e);
+  if (!b.error && b.data)
+    snprintf(op->profile->label, sizeof(op->profile->label), "%s", b.data + 1);
+  free(b.data);
+  if (e->kind == EXPR_SELECT && absorbed)
+    return;
+  if (absorbed) {
+    label_plan(absorbed == e->left ? e->right : e->left, op->left);
+    return;
+  }
+  label_plan(e->left, op->left);
+  label_plan(e->right, op->right);
+}
+
+Relation *expression_evaluate_analyze(const Expression *e, const char *name, char **report) {
+  *report = NULL;
+  Operator *plan = expression_compile(e);
+  if (!plan)
+    return NULL;
+  if (operator_profile_enable(plan) < 0) {
+    operator_destroy(plan);
+    return NULL;
+  }
+  label_plan(e, plan);
+  Relation *result = operator_collect(plan, name);
+  if (result && !(*report = operator_profile_report(plan))) {
+    relation_destroy(result);
+    result = NULL;
+  }
+  operator_destroy(plan);
+  return result;
+}
+
+void expression_print(const Expression *e) {
+  char *text = expression_to_string(e);
+  if (text)
+    printf("%s\n", text);
+  free(text);
+}
@@ -0,0 +1,662 @@
+/**
+ * @file expression_parser.c
+ * @brief Recursive descent parser for the S-expression syntax of algebra expressions.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "expression_parser.h"
+
+typedef enum { TOKEN_OPEN, TOKEN_CLOSE, TOKEN_ATOM, TOKEN_STRING, TOKEN_END } TokenKind;
+
+typedef struct {
+  TokenKind kind;
+  const char *start; // atom text, or string contents (escapes still in place)
+  size_t len;
+} Token;
+
+typedef struct {
+  Schema *schema;
+  const char *text;
+  const char *p;
+  const char *end;
+  char *error;
+  size_t error_size;
+  int failed;
+} Parser;
+
+// Record the first error, prefixed with its offset in the text
+static void parse_error(Parser *ps, const char *fmt, ...) {
+  if (ps->failed)
+    return;
+  ps->failed = 1;
+  if (!ps->error || ps->error_size == 0)
+    return;
+  int n = snprintf(ps->error, ps->error_size, "at %ld: ", (long)(ps->p - ps->text));
+  if (n < 0 || (size_t)n >= ps->error_size)
+    return;
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(ps->error + n, ps->error_size - (size_t)n, fmt, ap);
+  va_end(ap);
+}
+
+static int is_delimiter(char c) {
+  return isspace((unsigned char)c) || c == '(' || c == ')' || c == '"';
+}
+
+static Token next_token(Parser *ps) {
+  while (ps->p < ps->end && isspace((unsigned char)*ps->p))
+    ps->p++;
+  Token t = {.kind = TOKEN_END, .start = ps->p, .len = 0};
+  if (ps->p == ps->end)
+    return t;
+
+  char c = *ps->p;
+  if (c == '(' || c == ')') {
+    t.kind = c == '(' ? TOKEN_OPEN : TOKEN_CLOSE;
+    t.len = 1;
+    ps->p++;
+    return t;
+  }
+  if (c == '"') {
+    const char *q = ++ps->p;
+    while (q < ps->end && *q != '"')
+      q += *q == '\\' && q + 1 < ps->end ? 2 : 1;
+    if (q >= ps->end) {
+      parse_error(ps, "unterminated string");
+      t.kind = TOKEN_END;
+      return t;
+    }
+    t.kind = TOKEN_STRING;
+    t.start = ps->p;
+    t.len = (size_t)(q - ps->p);
+    ps->p = q + 1;
+    return t;
+  }
+
+  const char *q = ps->p;
+  while (q < ps->end && !is_delimiter(*q))
+    q++;
+  t.kind = TOKEN_ATOM;
+  t.len = (size_t)(q - ps->p);
+  ps->p = q;
+  return t;
+}
+
+static int token_is(Token t, const char *s) {
+  return t.kind == TOKEN_ATOM && strlen(s) == t.len && memcmp(t.start, s, t.len) == 0;
+}
+
+static int expect(Parser *ps, TokenKind kind, const char *what) {
+  Token t = next_token(ps);
+  if (t.kind == kind)
+    return 0;
+  parse_error(ps, "expected %s", what);
+  return -1;
+}
+
+// Read an atom as a new NUL-terminated name
+static char *parse_name(Parser *ps) {
+  Token t = next_token(ps);
+  if (t.kind != TOKEN_ATOM) {
+    parse_error(ps, "expected a name");
+    return NULL;
+  }
+  char *name = malloc(t.len + 1);
+  if (!name) {
+    parse_error(ps, "out of memory");
+    return NULL;
+  }
+  memcpy(name, t.start, t.len);
+  name[t.len] = '\0';
+  return name;
+}
+
+/* Conditions */
+
+typedef struct {
+  char *name;          // attribute operand
+  Attribute *constant; // literal operand
+} Operand;
+
+static void operand_free(Operand *o) {
+  free(o->name);
+  if (o->constant)
+    attribute_destroy(o->constant);
+}
+
+static int looks_numeric(Token t) {
+  size_t i = 0;
+  if (i < t.len && (t.start[i] == '-' || t.start[i] == '+'))
+    i++;
+  if (i < t.len && t.start[i] == '.')
+    i++;
+  return i < t.len && isdigit((unsigned char)t.start[i]);
+}
+
+// Parse a number literal into an int or rational attribute
+static Attribute *parse_number(Parser *ps, Token t) {
+  char buf[64];
+  if (t.len >= sizeof(buf)) {
+    parse_error(ps, "number too long");
+    return NULL;
+  }
+  memcpy(buf, t.start, t.len);
+  buf[t.len] = '\0';
+
+  char *end;
+  errno = 0;
+  void *value = NULL;
+  AttributeType type;
+  if (strpbrk(buf, ".eE")) {
+    double d = strtod(buf, &end);
+    type = ATTR_RATIONAL;
+    if (*end == '\0' && errno == 0 && (value = malloc(sizeof(double))))
+      *(double *)value = d;
+  } else {
+    long l = strtol(buf, &end, 10);
+    type = ATTR_INT;
+    if (*end == '\0' && errno == 0 && l >= INT_MIN && l <= INT_MAX &&
+        (value = malloc(sizeof(int))))
+      *(int *)value = (int)l;
+  }
+  Attribute *a = value ? attribute_create("constant", type, value) : NULL;
+  if (!a) {
+    free(value);
+    parse_error(ps, "invalid number '%s'", buf);
+  }
+  return a;
+}
+
+// Decode a string token (\" and \\ escapes) into a string attribute
+static Attribute *parse_string(Parser *ps, Token t) {
+  char *s = malloc(t.len + 1);
+  size_t n = 0;
+  for (size_t i = 0; s && i < t.len; i++) {
+    if (t.start[i] == '\\' && i + 1 < t.len)
+      i++;
+    s[n++] = t.start[i];
+  }
+  if (s)
+    s[n] = '\0';
+  Attribute *a = s ? attribute_create("constant", ATTR_STRING, s) : NULL;
+  if (!a) {
+    free(s);
+    parse_error(ps, "out of memory");
+  }
+  return a;
+}
+
+static int parse_operand(Parser *ps, Operand *o) {
+  Token t = next_token(ps);
+  if (t.kind == TOKEN_STRING)
+    return (o->constant = parse_string(ps, t)) ? 0 : -1;
+  if (t.kind != TOKEN_ATOM) {
+    parse_error(ps, "expected an attribute or a constant");
+    return -1;
+  }
+  if (looks_numeric(t))
+    return (o->constant = parse_number(ps, t)) ? 0 : -1;
+  if (!(o->name = malloc(t.len + 1))) {
+    parse_error(ps, "out of memory");
+    return -1;
+  }
+  memcpy(o->name, t.start, t.len);
+  o->name[t.len] = '\0';
+  return 0;
+}
+
+static int parse_compare_op(Token t, CompareOp *op) {
+  static const struct {
+    const char *symbol;
+    const char *word;
+    CompareOp op;
+  } ops[] = {{"=", "eq", CMP_EQ},  {"!=", "ne", CMP_NE}, {"<", "lt", CMP_LT},
+             {"<=", "le", CMP_LE}, {">", "gt", CMP_GT},  {">=", "ge", CMP_GE}};
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    if (token_is(t, ops[i].symbol) || token_is(t, ops[i].word)) {
+      *op = ops[i].op;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+// The operator that holds for (b, a) exactly when `op` holds for (a, b)
+static CompareOp flip_compare_op(CompareOp op) {
+  switch (op) {
+  case CMP_LT:
+    return CMP_GT;
+  case CMP_LE:
+    return CMP_GE;
+  case CMP_GT:
+    return CMP_LT;
+  case CMP_GE:
+    return CMP_LE;
+  default:
+    return op;
+  }
+}
+
+typedef struct {
+  Condition *items;
+  size_t count;
+  size_t capacity;
+} ConditionList;
+
+static void conditions_free(ConditionList *l) {
+  for (size_t i = 0; i < l->count; i++) {
+    free(l->items[i].attribute);
+    free(l->items[i].other);
+    if (l->items[i].constant)
+      attribute_destroy(l->items[i].constant);
+  }
+  free(l->items);
+}
+
+// Parse a comparison or conjunction, appending its comparisons to `out`
+static int parse_condition(Parser *ps, ConditionList *out) {
+  if (expect(ps, TOKEN_OPEN, "'(' starting a condition") < 0)
+    return -1;
+  Token head = next_token(ps);
+  if (token_is(head, "and")) {
+    for (;;) {
+      const char *mark = ps->p;
+      Token t = next_token(ps);
+      if (t.kind == TOKEN_CLOSE)
+        return 0;
+      ps->p = mark;
+      if (parse_condition(ps, out) < 0)
+        return -1;
+    }
+  }
+
+  CompareOp op;
+  if (parse_compare_op(head, &op) < 0) {
+    parse_error(ps, "unknown comparison '%.*s'", (int)head.len, head.start);
+    return -1;
+  }
+  Operand a = {0}, b = {0};
+  int status = parse_operand(ps, &a);
+  if (status == 0)
+    status = parse_operand(ps, &b);
+  if (status == 0)
+    status = expect(ps, TOKEN_CLOSE, "')' after a comparison");
+  if (status == 0 && !a.name && !b.name) {
+    parse_error(ps, "a comparison needs an attribute");
+    status = -1;
+  }
+  if (status == 0 && out->count == out->capacity) {
+    size_t cap = out->capacity ? out->capacity * 2 : 4;
+    Condition *items = realloc(out->items, cap * sizeof(Condition));
+    if (items) {
+      out->items = items;
+      out->capacity = cap;
+    } else {
+      parse_error(ps, "out of memory");
+      status = -1;
+    }
+  }
+  if (status < 0) {
+    operand_free(&a);
+    operand_free(&b);
+    return -1;
+  }
+
+  // Normalize to `attribute op (constant | attribute)`
+  Condition *c = &out->items[out->count++];
+  if (!a.name) {
+    Operand swap = a;
+    a = b;
+    b = swap;
+    op = flip_compare_op(op);
+  }
+  c->attribute = a.name;
+  c->op = op;
+  c->constant = b.constant;
+  c->other = b.name;
+  return 0;
+}
+
+/* Predicates */
+
+static int parse_predicate_term(Parser *ps, Predicate *p) {
+  Token t = next_token(ps);
+  if (t.kind == TOKEN_STRING || (t.kind == TOKEN_ATOM && looks_numeric(t))) {
+    Attribute *constant = t.kind == TOKEN_STRING ? parse_string(ps, t) : parse_number(ps, t);
+    int status = constant ? predicate_push_constant(p, constant) : -1;
+    if (constant && status < 0)
+      parse_error(ps, "out of memory");
+    attribute_destroy(constant);
+    return status;
+  }
+  if (t.kind == TOKEN_ATOM) {
+    char *name = malloc(t.len + 1);
+    int status = -1;
+    if (name) {
+      memcpy(name, t.start, t.len);
+      name[t.len] = '\0';
+      status = predicate_push_attribute(p, name);
+    }
+    free(name);
+    if (status < 0)
+      parse_error(ps, "out of memory");
+    return status;
+  }
+  if (t.kind != TOKEN_OPEN) {
+    parse_error(ps, "expected an attribute, a constant or an arithmetic expression");
+    return -1;
+  }
+
+  static const struct {
+    const char *symbol;
+    const char *word;
+    PredicateOpcode opcode;
+  } ops[] = {{"+", "add", PREDICATE_ADD},
+             {"-", "sub", PREDICATE_SUB},
+             {"*", "mul", PREDICATE_MUL},
+             {"/", "div", PREDICATE_DIV}};
+  Token head = next_token(ps);
+  size_t i = 0;
+  while (i < sizeof(ops) / sizeof(ops[0]) && !token_is(head, ops[i].symbol) &&
+         !token_is(head, ops[i].word))
+    i++;
+  if (i == sizeof(ops) / sizeof(ops[0])) {
+    parse_error(ps, "unknown arithmetic operator '%.*s'", (int)head.len, head.start);
+    return -1;
+  }
+  // (op a b c ...) folds to the left: ((a op b) op c) ...
+  if (parse_predicate_term(ps, p) < 0 || parse_predicate_term(ps, p) < 0)
+    return -1;
+  for (;;) {
+    if (predicate_emit(p, ops[i].opcode) < 0) {
+      parse_error(ps, "out of memory");
+      return -1;
+    }
+    const char *mark = ps->p;
+    if (next_token(ps).kind == TOKEN_CLOSE)
+      return 0;
+    ps->p = mark;
+    if (parse_predicate_term(ps, p) < 0)
+      return -1;
+  }
+}
+
+static int parse_predicate_condition(Parser *ps, Predicate *p) {
+  if (expect(ps, TOKEN_OPEN, "'(' starting a condition") < 0)
+    return -1;
+  Token head = next_token(ps);
+  if (token_is(head, "and") || token_is(head, "or")) {
+    PredicateOpcode opcode = token_is(head, "and") ? PREDICATE_AND : PREDICATE_OR;
+    if (parse_predicate_condition(ps, p) < 0)
+      return -1;
+    for (;;) {
+      const char *mark = ps->p;
+      if (next_token(ps).kind == TOKEN_CLOSE)
+        return 0;
+      ps->p = mark;
+      if (parse_predicate_condition(ps, p) < 0)
+        return -1;
+      if (predicate_emit(p, opcode) < 0) {
+        parse_error(ps, "out of memory");
+        return -1;
+      }
+    }
+  }
+  if (token_is(head, "not")) {
+    if (parse_predicate_condition(ps, p) < 0)
+      return -1;
+    if (predicate_emit(p, PREDICATE_NOT) < 0) {
+      parse_error(ps, "out of memory");
+      return -1;
+    }
+    return expect(ps, TOKEN_CLOSE, "')' after a negated condition");
+  }
+
+  CompareOp op;
+  if (parse_compare_op(head, &op) < 0) {
+    parse_error(ps, "unknown comparison '%.*s'", (int)head.len, head.start);
+    return -1;
+  }
+  if (parse_predicate_term(ps, p) < 0 || parse_predicate_term(ps, p) < 0)
+    return -1;
+  if (predicate_emit_compare(p, op) < 0) {
+    parse_error(ps, "out of memory");
+    return -1;
+  }
+  return expect(ps, TOKEN_CLOSE, "')' after a comparison");
+}
+
+Predicate *predicate_parse(const char *text, size_t len, char *error, size_t error_size) {
+  Parser ps = {.schema = NULL,
+               .text = text,
+               .p = text,
+               .end = text + len,
+               .error = error,
+               .error_size = error_size,
+               .failed = 0};
+  Predicate *p = predicate_create();
+  if (!p) {
+    parse_error(&ps, "out of memory");
+    return NULL;
+  }
+  if (parse_predicate_condition(&ps, p) < 0) {
+    predicate_destroy(p);
+    return NULL;
+  }
+  if (next_token(&ps).kind != TOKEN_END) {
+    parse_error(&ps, "unexpected text after the predicate");
+    predicate_destroy(p);
+    return NULL;
+  }
+  if (predicate_finish(p) < 0) {
+    parse_error(&ps, "out of memory");
+    predicate_destroy(p);
+    return NULL;
+  }
+  return p;
+}
+
+/* Expressions */
+
+static Expression *parse_expression(Parser *ps);
+
+static Expression *parse_scan(Parser *ps) {
+  Token t = next_token(ps);
+  if (t.kind != TOKEN_ATOM) {
+    parse_error(ps, "expected a relation name");
+    return NULL;
+  }
+  Relation *r = schema_find_relation_n(ps->schema, t.start, t.len);
+  if (!r) {
+    parse_error(ps, "relation '%.*s' not found", (int)t.len, t.start);
+    return NULL;
+  }
+  return expression_scan(r);
+}
+
+static Expression *parse_select(Parser *ps) {
+  ConditionList conditions = {0};
+  Expression *e = NULL;
+  if (parse_condition(ps, &conditions) == 0)
+    e = parse_expression(ps);
+  // A conjunction becomes a stack of selections
+  for (size_t i = 0; e && i < conditions.count; i++) {
+    const Condition *c = &conditions.items[i];
+    e = c->constant ? expression_select(e, c->attribute, c->op, c->constant)
+                    : expression_select_attributes(e, c->attribute, c->op, c->other);
+  }
+  conditions_free(&conditions);
+  return e;
+}
+
+typedef struct {
+  const char **names;
+  size_t count;
+} NameList;
+
+static void name_list_free(NameList *l) {
+  for (size_t i = 0; i < l->count; i++)
+    free((char *)l->names[i]);
+  free(l->names);
+}
+
+// Parse a parenthesized list of attribute names; returns -1 on error
+static int parse_name_list(Parser *ps, NameList *out) {
+  if (expect(ps, TOKEN_OPEN, "'(' starting the attribute list") < 0)
+    return -1;
+  const char **names = NULL;
+  size_t count = 0, capacity = 0;
+  int ok = 1;
+  for (;;) {
+    Token t = next_token(ps);
+    if (t.kind == TOKEN_CLOSE)
+      break;
+    if (t.kind != TOKEN_ATOM) {
+      parse_error(ps, "expected an attribute name");
+      ok = 0;
+      break;
+    }
+    if (count == capacity) {
+      size_t cap = capacity ? capacity * 2 : 8;
+      const char **grown = realloc(names, cap * sizeof(char *));
+      if (!grown) {
+        parse_error(ps, "out of memory");
+        ok = 0;
+        break;
+      }
+      names = grown;
+      capacity = cap;
+    }
+    char *name = malloc(t.len + 1);
+    if (!name) {
+      parse_error(ps, "out of memory");
+      ok = 0;
+      break;
+    }
+    memcpy(name, t.start, t.len);
+    name[t.len] = '\0';
+    names[count++] = name;
+  }
+  out->names = names;
+  out->count = count;
+  return ok ? 0 : -1;
+}
+
+static Expression *parse_project(Parser *ps) {
+  NameList names = {0};
+  Expression *e = parse_name_list(ps, &names) == 0 ? parse_expression(ps) : NULL;
+  if (e)
+    e = expression_project(e, names.names, names.count);
+  name_list_free(&names);
+  return e;
+}
+
+static Expression *parse_divide(Parser *ps) {
+  NameList quotient = {0}, divisor = {0};
+  Expression *e = NULL;
+  if (parse_name_list(ps, &quotient) == 0 && parse_name_list(ps, &divisor) == 0) {
+    for (size_t i = 0; i < divisor.count && !ps->failed; i++) {
+      for (size_t j = 0; j < quotient.count; j++) {
+        if (strcmp(divisor.names[i], quotient.names[j]) == 0) {
+          parse_error(ps, "attribute '%s' is both in the quotient and the divisor",
+                      divisor.names[i]);
+          break;
+        }
+      }
+    }
+    Expression *dividend = ps->failed ? NULL : parse_expression(ps);
+    Expression *by = dividend ? parse_expression(ps) : NULL;
+    if (by)
+      e = expression_divide(dividend, by, quotient.names, quotient.count, divisor.names,
+                            divisor.count);
+    else
+      expression_destroy(dividend);
+  }
+  name_list_free(&quotient);
+  name_list_free(&divisor);
+  return e;
+}
+
+static Expression *parse_rename(Parser *ps) {
+  char *from = parse_name(ps);
+  char *to = from ? parse_name(ps) : NULL;
+  Expression *child = to ? parse_expression(ps) : NULL;
+  Expression *e = child ? expression_rename(child, from, to) : NULL;
+  free(from);
+  free(to);
+  return e;
+}
+
+static Expression *parse_binary(Parser *ps, Expression *(*build)(Expression *, Expression *)) {
+  Expression *left = parse_expression(ps);
+  Expression *right = left ? parse_expression(ps) : NULL;
+  if (!right) {
+    expression_destroy(left);
+    return NULL;
+  }
+  return build(left, right);
+}
+
+static Expression *parse_expression(Parser *ps) {
+  if (expect(ps, TOKEN_OPEN, "'(' starting an expression") < 0)
+    return NULL;
+  Token head = next_token(ps);
+  Expression *e;
+  if (token_is(head, "scan"))
+    e = parse_scan(ps);
+  else if (token_is(head, "select"))
+    e = parse_select(ps);
+  else if (token_is(head, "project"))
+    e = parse_project(ps);
+  else if (token_is(head, "rename"))
+    e = parse_rename(ps);
+  else if (token_is(head, "join"))
+    e = parse_binary(ps, expression_join);
+  else if (token_is(head, "product"))
+    e = parse_binary(ps, expression_product);
+  else if (token_is(head, "union"))
+    e = parse_binary(ps, expression_union);
+  else if (token_is(head, "difference"))
+    e = parse_binary(ps, expression_difference);
+  else if (token_is(head, "divide"))
+    e = parse_divide(ps);
+  else {
+    parse_error(ps, "unknown operator '%.*s'", (int)head.len, head.start);
+    return NULL;
+  }
+
+  if (!e) {
+    parse_error(ps, "out of memory");
+    return NULL;
+  }
+  if (expect(ps, TOKEN_CLOSE, "')' closing the expression") < 0) {
+    expression_destroy(e);
+    return NULL;
+  }
+  return e;
+}
+
+Expression *expression_parse(Schema *schema, const char *text, size_t len, char *error,
+                             size_t error_size) {
+  Parser ps = {.schema = schema,
+               .text = text,
+               .p = text,
+               .end = text + len,
+               .error = error,
+               .error_size = error_size,
+               .failed = 0};
+  Expression *e = parse_expression(&ps);
+  if (e && next_token(&ps).kind != TOKEN_END) {
+    parse_error(&ps, "unexpected text after the expression");
+    expression_destroy(e);
+    return NULL;
+  }
+  return e;
+}
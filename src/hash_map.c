@@ -0,0 +1,185 @@
+/**
+ * @file hash_map.c
+ * @brief Separate-chaining hash map with power-of-two bucket arrays.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash_map.h"
+
+#define HASH_MAP_INITIAL_BUCKETS 16
+
+typedef struct HashMapEntry {
+  uint64_t hash;
+  void *key;
+  void *value;
+  struct HashMapEntry *next;
+} HashMapEntry;
+
+struct HashMap {
+  HashMapEntry **buckets;
+  size_t bucket_count; // always a power of two
+  size_t size;
+  HashMapHashFn hash;
+  HashMapEqualsFn equals;
+  HashMapFreeFn key_free;
+  HashMapFreeFn value_free;
+};
+
+uint64_t hash_bytes(const void *data, size_t len) {
+  const unsigned char *p = (const unsigned char *)data;
+  uint64_t h = 1469598103934665603ULL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+uint64_t hash_combine(uint64_t seed, uint64_t h) {
+  return seed ^ (h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+uint64_t hash_string(const void *key) {
+  const char *s = (const char *)key;
+  return hash_bytes(s, strlen(s));
+}
+
+int hash_string_equals(const void *a, const void *b) {
+  return strcmp((const char *)a, (const char *)b) == 0;
+}
+
+HashMap *hash_map_create(HashMapHashFn hash, HashMapEqualsFn equals, HashMapFreeFn key_free,
+                         HashMapFreeFn value_free) {
+  if (!hash || !equals)
+    return NULL;
+  HashMap *map = malloc(sizeof(HashMap));
+  if (!map)
+    return NULL;
+  map->buckets = calloc(HASH_MAP_INITIAL_BUCKETS, sizeof(HashMapEntry *));
+  if (!map->buckets) {
+    free(map);
+    return NULL;
+  }
+  map->bucket_count = HASH_MAP_INITIAL_BUCKETS;
+  map->size = 0;
+  map->hash = hash;
+  map->equals = equals;
+  map->key_free = key_free;
+  map->value_free = value_free;
+  return map;
+}
+
+void hash_map_destroy(HashMap *map) {
+  if (!map)
+    return;
+  for (size_t i = 0; i < map->bucket_count; i++) {
+    HashMapEntry *e = map->buckets[i];
+    while (e) {
+      HashMapEntry *next = e->next;
+      if (map->key_free)
+        map->key_free(e->key);
+      if (map->value_free)
+        map->value_free(e->value);
+      free(e);
+      e = next;
+    }
+  }
+  free(map->buckets);
+  free(map);
+}
+
+// Double the bucket array once the load factor exceeds 3/4
+static int hash_map_grow(HashMap *map) {
+  size_t count = map->bucket_count * 2;
+  HashMapEntry **buckets = calloc(count, sizeof(HashMapEntry *));
+  if (!buckets)
+    return -1;
+  for (size_t i = 0; i < map->bucket_count; i++) {
+    HashMapEntry *e = map->buckets[i];
+    while (e) {
+      HashMapEntry *next = e->next;
+      size_t b = e->hash & (count - 1);
+      e->next = buckets[b];
+      buckets[b] = e;
+      e = next;
+    }
+  }
+  free(map->buckets);
+  map->buckets = buckets;
+  map->bucket_count = count;
+  return 0;
+}
+
+int hash_map_put(HashMap *map, void *key, void *value) {
+  uint64_t h = map->hash(key);
+  size_t b = h & (map->bucket_count - 1);
+  for (HashMapEntry *e = map->buckets[b]; e; e = e->next) {
+    if (e->hash == h && map->equals(e->key, key)) {
+      if (map->value_free && e->value != value)
+        map->value_free(e->value);
+      if (map->key_free && e->key != key)
+        map->key_free(key);
+      e->value = value;
+      return 0;
+    }
+  }
+
+  if (map->size + 1 > map->bucket_count - map->bucket_count / 4) {
+    if (hash_map_grow(map) < 0)
+      return -1;
+    b = h & (map->bucket_count - 1);
+  }
+
+  HashMapEntry *e = malloc(sizeof(HashMapEntry));
+  if (!e)
+    return -1;
+  e->hash = h;
+  e->key = key;
+  e->value = value;
+  e->next = map->buckets[b];
+  map->buckets[b] = e;
+  map->size++;
+  return 1;
+}
+
+void *hash_map_find(const HashMap *map, uint64_t hash, const void *probe, HashMapEqualsFn equals) {
+  for (HashMapEntry *e = map->buckets[hash & (map->bucket_count - 1)]; e; e = e->next) {
+    if (e->hash == hash && equals(e->key, probe))
+      return e->value;
+  }
+  return NULL;
+}
+
+void *hash_map_get(const HashMap *map, const void *key) {
+  return hash_map_find(map, map->hash(key), key, map->equals);
+}
+
+int hash_map_remove(HashMap *map, const void *key) {
+  uint64_t h = map->hash(key);
+  HashMapEntry **link = &map->buckets[h & (map->bucket_count - 1)];
+  while (*link) {
+    HashMapEntry *e = *link;
+    if (e->hash == h && map->equals(e->key, key)) {
+      *link = e->next;
+      if (map->key_free)
+        map->key_free(e->key);
+      if (map->value_free)
+        map->value_free(e->value);
+      free(e);
+      map->size--;
+      return 1;
+    }
+    link = &e->next;
+  }
+  return 0;
+}
+
+size_t hash_map_size(const HashMap *map) { return map->size; }
+
+void hash_map_foreach(const HashMap *map, HashMapIterFn fn, void *userdata) {
+  for (size_t i = 0; i < map->bucket_count; i++) {
+    for (HashMapEntry *e = map->buckets[i]; e; e = e->next)
+      fn(e->key, e->value, userdata);
+  }
+}
@@ -0,0 +1,503 @@
+/**
+ * @file index.c
+ * @brief Hash and ordered secondary indexes of relations.
+ *
+ * A hash index maps each distinct key to the list of tuples holding it; a
+ * list doubles as its own hash map key, so no key values are copied. An
+ * ordered index is an array of tuple pointers sorted by key, searched with
+ * binary search. Keys are read from the tuples themselves, which the
+ * relation keeps alive for as long as they are indexed.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash_map.h"
+#include "index.h"
+#include "log.h"
+
+// Inserting more tuples than this at once re-sorts instead of shifting per tuple
+#define ORDERED_BULK_THRESHOLD 16
+
+struct RelationIndex {
+  IndexKind kind;
+  char **attrs;
+  size_t count;
+  HashMap *buckets; // INDEX_HASH: TupleList keys and values
+  Tuple **sorted;   // INDEX_ORDERED
+  size_t size;      // tuples indexed
+  size_t capacity;  // of `sorted`
+  RelationIndex *next;
+};
+
+typedef struct {
+  uint64_t hash;
+  Tuple **items;
+  size_t count;
+  size_t capacity;
+} TupleList;
+
+typedef struct {
+  const RelationIndex *index;
+  const Tuple *tuple;
+} KeyProbe;
+
+/* Keys */
+
+typedef enum { VALUE_NUMBER, VALUE_STRING, VALUE_OTHER } ValueClass;
+
+static ValueClass value_class(const Attribute *a) {
+  if (a->type == ATTR_INT || a->type == ATTR_RATIONAL)
+    return VALUE_NUMBER;
+  return a->type == ATTR_STRING ? VALUE_STRING : VALUE_OTHER;
+}
+
+// Hash consistent with attribute_value_compare: 3 and 3.0 hash alike
+static uint64_t value_hash(const Attribute *a) {
+  if (a->type == ATTR_INT || a->type == ATTR_RATIONAL) {
+    double v = a->type == ATTR_INT ? *(int *)a->value : *(double *)a->value;
+    if (v == 0.0)
+      v = 0.0; // -0.0
+    return hash_bytes(&v, sizeof(v));
+  }
+  return hash_string(a->value);
+}
+
+// Total order: numbers, then strings, each ordered by value
+static int value_compare(const Attribute *a, const Attribute *b) {
+  ValueClass ca = value_class(a), cb = value_class(b);
+  if (ca != cb)
+    return ca < cb ? -1 : 1;
+  int cmp = 0;
+  attribute_value_compare(a, b, &cmp);
+  return cmp;
+}
+
+// Only tuples holding every indexed attribute, with a comparable value, are indexed
+static int has_key(const RelationIndex *idx, const Tuple *t) {
+  for (size_t i = 0; i < idx->count; i++) {
+    Attribute *a = tuple_find_attribute((Tuple *)t, idx->attrs[i]);
+    if (!a || !a->value || value_class(a) == VALUE_OTHER)
+      return 0;
+  }
+  return 1;
+}
+
+static uint64_t key_hash(const RelationIndex *idx, const Tuple *t) {
+  uint64_t h = 0;
+  for (size_t i = 0; i < idx->count; i++)
+    h = hash_combine(h, value_hash(tuple_find_attribute((Tuple *)t, idx->attrs[i])));
+  return h;
+}
+
+static int key_compare(const RelationIndex *idx, const Tuple *a, const Tuple *b) {
+  for (size_t i = 0; i < idx->count; i++) {
+    int cmp = value_compare(tuple_find_attribute((Tuple *)a, idx->attrs[i]),
+                            tuple_find_attribute((Tuple *)b, idx->attrs[i]));
+    if (cmp)
+      return cmp;
+  }
+  return 0;
+}
+
+/* Hash indexes */
+
+static uint64_t list_hash(const void *key) { return ((const TupleList *)key)->hash; }
+
+static int list_identical(const void *a, const void *b) { return a == b; }
+
+static void list_free(void *key) {
+  TupleList *list = (TupleList *)key;
+  free(list->items);
+  free(list);
+}
+
+static int list_matches_probe(const void *stored, const void *probe) {
+  const TupleList *list = (const TupleList *)stored;
+  const KeyProbe *p = (const KeyProbe *)probe;
+  return key_compare(p->index, list->items[0], p->tuple) == 0;
+}
+
+static TupleList *hash_find(const RelationIndex *idx, const Tuple *t, uint64_t hash) {
+  KeyProbe probe = {.index = idx, .tuple = t};
+  return hash_map_find(idx->buckets, hash, &probe, list_matches_probe);
+}
+
+static int hash_insert(RelationIndex *idx, Tuple *t) {
+  uint64_t hash = key_hash(idx, t);
+  TupleList *list = hash_find(idx, t, hash);
+  if (!list) {
+    list = calloc(1, sizeof(TupleList));
+    if (!list)
+      return -1;
+    list->hash = hash;
+    if (hash_map_put(idx->buckets, list, list) < 0) {
+      free(list);
+      return -1;
+    }
+  }
+  if (list->count == list->capacity) {
+    size_t cap = list->capacity ? list->capacity * 2 : 2;
+    Tuple **items = realloc(list->items, cap * sizeof(Tuple *));
+    if (!items) {
+      if (list->count == 0)
+        hash_map_remove(idx->buckets, list);
+      return -1;
+    }
+    list->items = items;
+    list->capacity = cap;
+  }
+  list->items[list->count++] = t;
+  idx->size++;
+  return 0;
+}
+
+static void hash_remove(RelationIndex *idx, Tuple *t) {
+  TupleList *list = hash_find(idx, t, key_hash(idx, t));
+  for (size_t i = 0; list && i < list->count; i++) {
+    if (list->items[i] != t)
+      continue;
+    list->items[i] = list->items[--list->count];
+    idx->size--;
+    if (list->count == 0)
+      hash_map_remove(idx->buckets, list);
+    return;
+  }
+}
+
+/* Ordered indexes */
+
+// First position whose key is not less than (or, with `after`, greater than) t's
+static size_t ordered_bound(const RelationIndex *idx, const Tuple *t, int after) {
+  size_t lo = 0, hi = idx->size;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    int cmp = key_compare(idx, idx->sorted[mid], t);
+    if (cmp < 0 || (after && cmp == 0))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// First position whose leading value belongs to a class after `c` (or, with !after, not before)
+static size_t class_bound(const RelationIndex *idx, ValueClass c, int after) {
+  size_t lo = 0, hi = idx->size;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    ValueClass m = value_class(tuple_find_attribute(idx->sorted[mid], idx->attrs[0]));
+    if (m < c || (after && m == c))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static int ordered_reserve(RelationIndex *idx, size_t extra) {
+  if (idx->size + extra <= idx->capacity)
+    return 0;
+  size_t cap = idx->capacity ? idx->capacity : 64;
+  while (cap < idx->size + extra)
+    cap *= 2;
+  Tuple **sorted = realloc(idx->sorted, cap * sizeof(Tuple *));
+  if (!sorted)
+    return -1;
+  idx->sorted = sorted;
+  idx->capacity = cap;
+  return 0;
+}
+
+// Stable bottom-up merge sort of `items` by key
+static int ordered_sort(const RelationIndex *idx, Tuple **items, size_t n) {
+  if (n < 2)
+    return 0;
+  Tuple **buffer = malloc(n * sizeof(Tuple *));
+  if (!buffer)
+    return -1;
+  Tuple **from = items, **to = buffer;
+  for (size_t width = 1; width < n; width *= 2) {
+    for (size_t lo = 0; lo < n; lo += 2 * width) {
+      size_t mid = lo + width < n ? lo + width : n;
+      size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+      size_t i = lo, j = mid, k = lo;
+      while (i < mid && j < hi)
+        to[k++] = key_compare(idx, from[j], from[i]) < 0 ? from[j++] : from[i++];
+      while (i < mid)
+        to[k++] = from[i++];
+      while (j < hi)
+        to[k++] = from[j++];
+    }
+    Tuple **swap = from;
+    from = to;
+    to = swap;
+  }
+  if (from != items)
+    memcpy(items, from, n * sizeof(Tuple *));
+  free(buffer);
+  return 0;
+}
+
+static int ordered_insert(RelationIndex *idx, Tuple *t) {
+  if (ordered_reserve(idx, 1) < 0)
+    return -1;
+  size_t at = ordered_bound(idx, t, 1);
+  memmove(idx->sorted + at + 1, idx->sorted + at, (idx->size - at) * sizeof(Tuple *));
+  idx->sorted[at] = t;
+  idx->size++;
+  return 0;
+}
+
+static void ordered_remove(RelationIndex *idx, Tuple *t) {
+  for (size_t i = ordered_bound(idx, t, 0); i < idx->size; i++) {
+    if (idx->sorted[i] == t) {
+      memmove(idx->sorted + i, idx->sorted + i + 1, (idx->size - i - 1) * sizeof(Tuple *));
+      idx->size--;
+      return;
+    }
+    if (key_compare(idx, idx->sorted[i], t) != 0)
+      return;
+  }
+}
+
+/* Maintenance */
+
+static int index_add(RelationIndex *idx, Tuple *const *tuples, size_t count) {
+  if (idx->kind == INDEX_HASH) {
+    for (size_t i = 0; i < count; i++)
+      if (has_key(idx, tuples[i]) && hash_insert(idx, tuples[i]) < 0)
+        return -1;
+    return 0;
+  }
+  if (count <= ORDERED_BULK_THRESHOLD) {
+    for (size_t i = 0; i < count; i++)
+      if (has_key(idx, tuples[i]) && ordered_insert(idx, tuples[i]) < 0)
+        return -1;
+    return 0;
+  }
+  if (ordered_reserve(idx, count) < 0)
+    return -1;
+  for (size_t i = 0; i < count; i++)
+    if (has_key(idx, tuples[i]))
+      idx->sorted[idx->size++] = tuples[i];
+  return ordered_sort(idx, idx->sorted, idx->size);
+}
+
+static void index_destroy(RelationIndex *idx) {
+  for (size_t i = 0; i < idx->count; i++)
+    free(idx->attrs[i]);
+  free(idx->attrs);
+  hash_map_destroy(idx->buckets);
+  free(idx->sorted);
+  free(idx);
+}
+
+static void unlink_index(Relation *r, RelationIndex *idx) {
+  for (RelationIndex **p = &r->indexes; *p; p = &(*p)->next) {
+    if (*p == idx) {
+      *p = idx->next;
+      return;
+    }
+  }
+}
+
+void relation_indexes_add(Relation *r, Tuple *const *tuples, size_t count) {
+  RelationIndex *idx = r->indexes;
+  while (idx) {
+    RelationIndex *next = idx->next;
+    if (index_add(idx, tuples, count) < 0) {
+      // A partially updated index would miss tuples; scans stay correct
+      log_warn("index", "dropping an index of %s: out of memory", r->name);
+      unlink_index(r, idx);
+      index_destroy(idx);
+    }
+    idx = next;
+  }
+}
+
+void relation_indexes_remove(Relation *r, Tuple *t) {
+  for (RelationIndex *idx = r->indexes; idx; idx = idx->next) {
+    if (!has_key(idx, t))
+      continue;
+    if (idx->kind == INDEX_HASH)
+      hash_remove(idx, t);
+    else
+      ordered_remove(idx, t);
+  }
+}
+
+void relation_indexes_destroy(Relation *r) {
+  while (r->indexes) {
+    RelationIndex *next = r->indexes->next;
+    index_destroy(r->indexes);
+    r->indexes = next;
+  }
+}
+
+/* Creation and lookup */
+
+static int same_attributes(const RelationIndex *idx, const char *const *attrs, size_t count) {
+  if (idx->count != count)
+    return 0;
+  for (size_t i = 0; i < count; i++) {
+    size_t j = 0;
+    while (j < count && strcmp(idx->attrs[j], attrs[i]) != 0)
+      j++;
+    if (j == count)
+      return 0;
+  }
+  return 1;
+}
+
+static void collect_tuple_cb(void *element, void *userdata) {
+  RelationIndex *idx = (RelationIndex *)userdata;
+  Tuple *t = (Tuple *)element;
+  if (has_key(idx, t))
+    idx->sorted[idx->size++] = t;
+}
+
+RelationIndex *relation_create_index(Relation *r, IndexKind kind, const char *const *attrs,
+                                     size_t count) {
+  if (!r || !attrs || count == 0)
+    return NULL;
+  for (RelationIndex *idx = r->indexes; idx; idx = idx->next) {
+    if (idx->kind == kind && same_attributes(idx, attrs, count))
+      return NULL;
+  }
+
+  RelationIndex *idx = calloc(1, sizeof(RelationIndex));
+  if (!idx)
+    return NULL;
+  idx->kind = kind;
+  idx->attrs = calloc(count, sizeof(char *));
+  int failed = !idx->attrs;
+  for (size_t i = 0; !failed && i < count; i++)
+    failed = !(idx->attrs[idx->count++] = strdup(attrs[i]));
+  if (!failed && kind == INDEX_HASH)
+    failed = !(idx->buckets = hash_map_create(list_hash, list_identical, list_free, NULL));
+
+  // Bulk build: gather the members once, then sort or hash them together
+  size_t members = set_size(r->tuples);
+  if (!failed)
+    failed = ordered_reserve(idx, members) < 0;
+  if (!failed) {
+    set_foreach(r->tuples, collect_tuple_cb, idx);
+    if (kind == INDEX_ORDERED) {
+      failed = ordered_sort(idx, idx->sorted, idx->size) < 0;
+    } else {
+      size_t n = idx->size;
+      idx->size = 0;
+      for (size_t i = 0; !failed && i < n; i++)
+        failed = hash_insert(idx, idx->sorted[i]) < 0;
+      free(idx->sorted);
+      idx->sorted = NULL;
+      idx->capacity = 0;
+    }
+  }
+  if (failed) {
+    index_destroy(idx);
+    return NULL;
+  }
+  idx->next = r->indexes;
+  r->indexes = idx;
+  return idx;
+}
+
+int relation_drop_index(Relation *r, RelationIndex *index) {
+  for (RelationIndex *idx = r->indexes; idx; idx = idx->next) {
+    if (idx == index) {
+      unlink_index(r, idx);
+      index_destroy(idx);
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static int supports(const RelationIndex *idx, CompareOp op) {
+  if (op == CMP_EQ)
+    return 1;
+  return idx->kind == INDEX_ORDERED && idx->count == 1 && op != CMP_NE;
+}
+
+RelationIndex *relation_find_index(const Relation *r, const char *const *attrs, size_t count,
+                                   CompareOp op) {
+  RelationIndex *found = NULL;
+  for (RelationIndex *idx = r ? r->indexes : NULL; idx; idx = idx->next) {
+    if (!supports(idx, op) || !same_attributes(idx, attrs, count))
+      continue;
+    if (idx->kind == INDEX_HASH)
+      return idx;
+    found = idx;
+  }
+  return found;
+}
+
+int relation_indexes_probe(const Relation *r, const Tuple *probe, IndexCursor *cursor) {
+  for (RelationIndex *idx = r->indexes; idx; idx = idx->next) {
+    if (has_key(idx, probe) && index_lookup(idx, probe, CMP_EQ, cursor) == 0)
+      return 0;
+  }
+  return -1;
+}
+
+int index_lookup(const RelationIndex *index, const Tuple *probe, CompareOp op,
+                 IndexCursor *cursor) {
+  if (!supports(index, op))
+    return -1;
+  for (size_t i = 0; i < index->count; i++) {
+    Attribute *a = tuple_find_attribute((Tuple *)probe, index->attrs[i]);
+    if (!a || !a->value)
+      return -1;
+  }
+  cursor->tuples = NULL;
+  cursor->count = 0;
+  cursor->position = 0;
+  // Values no selection can compare match nothing
+  if (!has_key(index, probe))
+    return 0;
+
+  if (index->kind == INDEX_HASH) {
+    TupleList *list = hash_find(index, probe, key_hash(index, probe));
+    if (list) {
+      cursor->tuples = list->items;
+      cursor->count = list->count;
+    }
+    return 0;
+  }
+
+  size_t begin = 0, end = 0;
+  if (op == CMP_EQ) {
+    begin = ordered_bound(index, probe, 0);
+    end = ordered_bound(index, probe, 1);
+  } else {
+    // Ranges stay within the values comparable to the probe's
+    ValueClass c = value_class(tuple_find_attribute((Tuple *)probe, index->attrs[0]));
+    size_t first = class_bound(index, c, 0), last = class_bound(index, c, 1);
+    if (op == CMP_LT || op == CMP_LE) {
+      begin = first;
+      end = ordered_bound(index, probe, op == CMP_LE);
+    } else {
+      begin = ordered_bound(index, probe, op == CMP_GT);
+      end = last;
+    }
+  }
+  if (begin < end) {
+    cursor->tuples = index->sorted + begin;
+    cursor->count = end - begin;
+  }
+  return 0;
+}
+
+Tuple *index_cursor_next(IndexCursor *cursor) {
+  return cursor->position < cursor->count ? cursor->tuples[cursor->position++] : NULL;
+}
+
+IndexKind index_kind(const RelationIndex *index) { return index->kind; }
+
+const char *const *index_attributes(const RelationIndex *index, size_t *count) {
+  *count = index->count;
+  return (const char *const *)index->attrs;
+}
+
+size_t index_size(const RelationIndex *index) { return index->size; }
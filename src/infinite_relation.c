@@ -1,7 +1,11 @@
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "hash_map.h"
 #include "infinite_relation.h"
+#include "metrics.h"
 
 InfiniteRelation *infinite_relation_create(const char *name, TupleGeneratorFn fn, void *userdata) {
   InfiniteRelation *r = malloc(sizeof(InfiniteRelation));
@@ -9,6 +13,10 @@ InfiniteRelation *infinite_relation_create(const char *name, TupleGeneratorFn fn
   r->gen_fn = fn;
   r->userdata = userdata;
   r->cardinality = cardinality_infinite(CARD_ALEPH_0); // Default to countably infinite
+  r->batch_fn = NULL;
+  r->density_fn = NULL;
+  r->range_fn = NULL;
+  r->userdata_free = NULL;
   return r;
 }
 
@@ -19,15 +27,133 @@ InfiniteRelation *infinite_relation_create_with_cardinality(const char *name, Tu
   return r;
 }
 
-void infinite_relation_destroy(InfiniteRelation *r) {
+void infinite_relation_set_batch_generator(InfiniteRelation *r, BatchGeneratorFn fn) {
+  if (r)
+    r->batch_fn = fn;
+}
+
+void infinite_relation_set_density(InfiniteRelation *r, DensityFn fn) {
   if (r)
-    free(r);
+    r->density_fn = fn;
+}
+
+double infinite_relation_density(InfiniteRelation *r, size_t prefix, const char *attribute,
+                                 CompareOp op, const Attribute *constant) {
+  if (!r || prefix == 0)
+    return 0.0;
+  if (r->density_fn) {
+    double density = r->density_fn(prefix, attribute, op, constant, r->userdata);
+    if (density >= 0.0)
+      return density;
+  }
+  // Sample indices spread over the prefix, so the estimate follows the enumeration order
+  size_t samples = prefix < INFINITE_RELATION_DENSITY_SAMPLES ? prefix
+                                                              : INFINITE_RELATION_DENSITY_SAMPLES;
+  size_t seen = 0, matched = 0;
+  for (size_t i = 0; i < samples; i++) {
+    size_t n = i * (prefix / samples) + i * (prefix % samples) / samples;
+    Tuple *t = infinite_relation_tuple_at(r, n);
+    if (!t)
+      break;
+    Attribute *a = tuple_find_attribute(t, attribute);
+    int cmp;
+    if (a && attribute_value_compare(a, constant, &cmp) == 0 && compare_op_holds(op, cmp))
+      matched++;
+    seen++;
+    tuple_destroy(t);
+  }
+  return seen ? (double)matched / seen : 0.0;
+}
+
+void infinite_relation_set_index_range(InfiniteRelation *r, IndexRangeFn fn) {
+  if (r)
+    r->range_fn = fn;
+}
+
+typedef struct {
+  InfiniteRelation *base;
+  IndexRange range;
+} Restriction;
+
+static Tuple *restricted_generator(size_t n, void *userdata) {
+  Restriction *res = (Restriction *)userdata;
+  if (n >= res->range.end - res->range.begin)
+    return NULL;
+  // The base generator directly, so the tuple is counted once
+  return res->base->gen_fn(res->range.begin + n, res->base->userdata);
+}
+
+static size_t restricted_batch_generator(size_t start, size_t count, struct ColumnBatch *out,
+                                         void *userdata) {
+  Restriction *res = (Restriction *)userdata;
+  size_t size = res->range.end - res->range.begin;
+  if (start >= size)
+    return 0;
+  if (count > size - start)
+    count = size - start;
+  return res->base->batch_fn(res->range.begin + start, count, out, res->base->userdata);
+}
+
+// Map a constraint through the base relation, then into the restriction's own indices
+static int restricted_range(const char *attribute, CompareOp op, const Attribute *constant,
+                            IndexRange *out, void *userdata) {
+  Restriction *res = (Restriction *)userdata;
+  IndexRange base;
+  if (!res->base->range_fn ||
+      res->base->range_fn(attribute, op, constant, &base, res->base->userdata) < 0)
+    return -1;
+  size_t begin = base.begin > res->range.begin ? base.begin : res->range.begin;
+  size_t end = base.end < res->range.end ? base.end : res->range.end;
+  if (end < begin)
+    end = begin;
+  out->begin = begin - res->range.begin;
+  out->end = end == SIZE_MAX ? SIZE_MAX : end - res->range.begin;
+  return 0;
+}
+
+InfiniteRelation *infinite_relation_restrict(InfiniteRelation *r, const char *attribute,
+                                             CompareOp op, const Attribute *constant) {
+  IndexRange range;
+  if (!r || !r->range_fn || r->range_fn(attribute, op, constant, &range, r->userdata) < 0)
+    return NULL;
+  Restriction *res = malloc(sizeof(Restriction));
+  if (!res)
+    return NULL;
+  res->base = r;
+  res->range = range;
+  if (res->range.end < res->range.begin)
+    res->range.end = res->range.begin;
+
+  Cardinality card = range.end == SIZE_MAX ? r->cardinality
+                                           : cardinality_finite(res->range.end - res->range.begin);
+  InfiniteRelation *restricted =
+      infinite_relation_create_with_cardinality(r->name, restricted_generator, res, card);
+  if (!restricted) {
+    free(res);
+    return NULL;
+  }
+  restricted->userdata_free = free;
+  restricted->range_fn = restricted_range;
+  if (r->batch_fn)
+    restricted->batch_fn = restricted_batch_generator;
+  return restricted;
+}
+
+void infinite_relation_destroy(InfiniteRelation *r) {
+  if (!r)
+    return;
+  if (r->userdata_free)
+    r->userdata_free(r->userdata);
+  free(r);
 }
 
 Tuple *infinite_relation_tuple_at(InfiniteRelation *r, size_t n) {
   if (!r || !r->gen_fn)
     return NULL;
-  return r->gen_fn(n, r->userdata);
+  Tuple *t = r->gen_fn(n, r->userdata);
+  if (t)
+    metrics_add(METRIC_TUPLES_GENERATED, 1);
+  return t;
 }
 
 void infinite_relation_print_prefix(InfiniteRelation *r, size_t count) {
@@ -116,3 +242,198 @@ Tuple *infinite_relation_find_tuple(InfiniteRelation *r, Tuple *target) {
   infinite_relation_iterator_destroy(iter);
   return found;
 }
+
+/*
+ * Set algebra by dovetailing.
+ *
+ * The inputs are enumerated in alternation (step k visits index k / 2 of
+ * input k mod 2; a difference only walks its left input), so every tuple of
+ * either input is reached after finitely many steps. Each input is read
+ * until its generator first returns NULL or its finite cardinality is
+ * reached. The tuples met are kept in hash sets, and each result is
+ * recorded when its step decides it: for a union the first occurrence, for
+ * an intersection the first occurrence on the second side to produce it.
+ * Results point into those sets, so the nth one is copied out without
+ * enumerating again.
+ */
+
+typedef enum { DOVETAIL_UNION, DOVETAIL_INTERSECT, DOVETAIL_DIFFERENCE } DovetailKind;
+
+typedef struct {
+  DovetailKind kind;
+  InfiniteRelation *inputs[2];
+  size_t limits[2]; // indices each input generates (SIZE_MAX: unbounded)
+  HashMap *seen[2]; // tuples met on each side; a union keeps both sides in seen[0]
+  Tuple **results;  // borrowed from `seen`, in the order they were decided
+  size_t result_count;
+  size_t result_capacity;
+  size_t next_step;
+  int excluded;         // a difference has read its right input into seen[1]
+  pthread_mutex_t lock; // serializes generator calls sharing the memo
+} Dovetail;
+
+static uint64_t dovetail_hash(const void *key) { return tuple_hash((const Tuple *)key); }
+
+static int dovetail_equals(const void *a, const void *b) {
+  return tuple_equals((Tuple *)a, (Tuple *)b);
+}
+
+static void dovetail_tuple_free(void *key) { tuple_destroy((Tuple *)key); }
+
+static void dovetail_free(void *userdata) {
+  Dovetail *d = (Dovetail *)userdata;
+  pthread_mutex_destroy(&d->lock);
+  hash_map_destroy(d->seen[0]);
+  hash_map_destroy(d->seen[1]);
+  free(d->results);
+  free(d);
+}
+
+static size_t input_limit(const InfiniteRelation *r) {
+  return cardinality_is_finite(r->cardinality) ? r->cardinality.finite_count : SIZE_MAX;
+}
+
+// Remember `t` in `set`, which takes it if it is new; returns 1 if new, 0 if not, -1 on error
+static int dovetail_remember(HashMap *set, Tuple *t) {
+  int status = hash_map_get(set, t) ? 0 : hash_map_put(set, t, t);
+  if (status != 1)
+    tuple_destroy(t);
+  return status;
+}
+
+static int dovetail_record(Dovetail *d, Tuple *t) {
+  if (d->result_count == d->result_capacity) {
+    size_t cap = d->result_capacity ? d->result_capacity * 2 : 64;
+    Tuple **grown = realloc(d->results, cap * sizeof(Tuple *));
+    if (!grown)
+      return -1;
+    d->results = grown;
+    d->result_capacity = cap;
+  }
+  d->results[d->result_count++] = t;
+  return 0;
+}
+
+// Read the right input of a difference, which is finite, into seen[1]
+static void dovetail_exclude(Dovetail *d) {
+  for (size_t i = 0; i < d->limits[1]; i++) {
+    Tuple *t = infinite_relation_tuple_at(d->inputs[1], i);
+    if (!t)
+      break;
+    dovetail_remember(d->seen[1], t);
+  }
+  d->excluded = 1;
+}
+
+// Take one step; returns 0 once both inputs are exhausted (or on error)
+static int dovetail_step(Dovetail *d) {
+  int two_sided = d->kind != DOVETAIL_DIFFERENCE;
+  size_t step = d->next_step;
+  int side = two_sided ? (int)(step & 1) : 0;
+  size_t index = two_sided ? step / 2 : step;
+  if (index >= d->limits[0] && (!two_sided || index >= d->limits[1]))
+    return 0;
+  d->next_step++;
+  if (index >= d->limits[side])
+    return 1;
+
+  Tuple *t = infinite_relation_tuple_at(d->inputs[side], index);
+  if (!t) {
+    d->limits[side] = index; // the generator ended
+    return 1;
+  }
+  int status;
+  switch (d->kind) {
+  case DOVETAIL_UNION:
+    status = dovetail_remember(d->seen[0], t);
+    break;
+  case DOVETAIL_INTERSECT:
+    status = dovetail_remember(d->seen[side], t);
+    if (status == 1 && !hash_map_get(d->seen[1 - side], t))
+      status = 0;
+    break;
+  default:
+    if (hash_map_get(d->seen[1], t)) {
+      tuple_destroy(t);
+      status = 0;
+    } else {
+      status = dovetail_remember(d->seen[0], t);
+    }
+    break;
+  }
+  if (status == 1)
+    status = dovetail_record(d, t);
+  return status >= 0;
+}
+
+static Tuple *dovetail_generator(size_t n, void *userdata) {
+  Dovetail *d = (Dovetail *)userdata;
+  pthread_mutex_lock(&d->lock);
+  if (d->kind == DOVETAIL_DIFFERENCE && !d->excluded)
+    dovetail_exclude(d);
+  while (d->result_count <= n && d->next_step < INFINITE_RELATION_MAX_STEPS && dovetail_step(d))
+    ;
+  Tuple *t = n < d->result_count ? tuple_copy(d->results[n]) : NULL;
+  pthread_mutex_unlock(&d->lock);
+  return t;
+}
+
+static InfiniteRelation *dovetail_create(DovetailKind kind, InfiniteRelation *left,
+                                         InfiniteRelation *right, const char *name,
+                                         Cardinality card) {
+  if (!left || !right)
+    return NULL;
+  // Compare the headings of the first tuples, when both inputs have one
+  Tuple *hl = infinite_relation_tuple_at(left, 0), *hr = infinite_relation_tuple_at(right, 0);
+  int compatible = !hl || !hr || tuple_heading_equals(hl, hr);
+  tuple_destroy(hl);
+  tuple_destroy(hr);
+  if (!compatible)
+    return NULL;
+
+  Dovetail *d = calloc(1, sizeof(Dovetail));
+  if (!d)
+    return NULL;
+  d->kind = kind;
+  d->inputs[0] = left;
+  d->inputs[1] = right;
+  d->limits[0] = input_limit(left);
+  d->limits[1] = input_limit(right);
+  pthread_mutex_init(&d->lock, NULL);
+  d->seen[0] = hash_map_create(dovetail_hash, dovetail_equals, dovetail_tuple_free, NULL);
+  d->seen[1] = hash_map_create(dovetail_hash, dovetail_equals, dovetail_tuple_free, NULL);
+  InfiniteRelation *r = d->seen[0] && d->seen[1] ? infinite_relation_create_with_cardinality(
+                                                       name, dovetail_generator, d, card)
+                                                 : NULL;
+  if (!r) {
+    dovetail_free(d);
+    return NULL;
+  }
+  r->userdata_free = dovetail_free;
+  return r;
+}
+
+InfiniteRelation *infinite_relation_union(InfiniteRelation *left, InfiniteRelation *right,
+                                          const char *name) {
+  if (!left || !right)
+    return NULL;
+  return dovetail_create(DOVETAIL_UNION, left, right, name,
+                         cardinality_union(left->cardinality, right->cardinality));
+}
+
+InfiniteRelation *infinite_relation_intersect(InfiniteRelation *left, InfiniteRelation *right,
+                                              const char *name) {
+  if (!left || !right)
+    return NULL;
+  return dovetail_create(DOVETAIL_INTERSECT, left, right, name,
+                         cardinality_intersection(left->cardinality, right->cardinality));
+}
+
+InfiniteRelation *infinite_relation_difference(InfiniteRelation *left, InfiniteRelation *right,
+                                               const char *name) {
+  // Only a finite right input can be excluded before the left tuples are decided
+  if (!left || !right || !cardinality_is_finite(right->cardinality))
+    return NULL;
+  return dovetail_create(DOVETAIL_DIFFERENCE, left, right, name,
+                         cardinality_difference(left->cardinality, right->cardinality));
+}
@@ -4,7 +4,11 @@
  */
 #include "join.h"
 #include "attribute.h"
+#include "hash_map.h"
+#include "metrics.h"
+#include "operator.h"
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,40 +23,6 @@ typedef struct {
   void *userdata;
 } JoinIterContext;
 
-/**
- * Helper to copy an attribute with its value.
- */
-static Attribute *attribute_copy(const Attribute *attr) {
-  void *value_copy = NULL;
-
-  switch (attr->type) {
-  case ATTR_INT: {
-    int *v = malloc(sizeof(int));
-    *v = *(int *)attr->value;
-    value_copy = v;
-    break;
-  }
-  case ATTR_RATIONAL: {
-    int *v = malloc(sizeof(double));
-    *v = *(int *)attr->value;
-    value_copy = v;
-    break;
-  }
-  case ATTR_STRING:
-    value_copy = strdup((char *)attr->value);
-    break;
-  case ATTR_SET:
-    // For now, we don't deep copy sets - would need recursive logic
-    fprintf(stderr, "Warning: shallow copy of SET attribute\n");
-    value_copy = attr->value;
-    break;
-  default:
-    break;
-  }
-
-  return attribute_create(attr->name, attr->type, value_copy);
-}
-
 /**
  * Context for merging tuple attributes.
  */
@@ -103,6 +73,33 @@ Tuple *tuple_merge(Tuple *left, Tuple *right) {
   return merged;
 }
 
+/**
+ * Context for copying the right attributes the left tuple lacks.
+ */
+typedef struct {
+  Tuple *target;
+  const Tuple *left;
+} NaturalMergeContext;
+
+static void copy_missing_attribute_cb(void *element, void *userdata) {
+  Attribute *attr = (Attribute *)element;
+  NaturalMergeContext *ctx = (NaturalMergeContext *)userdata;
+  if (tuple_find_attribute((Tuple *)ctx->left, attr->name))
+    return;
+  Attribute *copy = attribute_copy(attr);
+  if (copy)
+    tuple_add_attribute(ctx->target, copy);
+}
+
+Tuple *tuple_natural_merge(const Tuple *left, const Tuple *right) {
+  Tuple *merged = tuple_copy(left);
+  if (!merged)
+    return NULL;
+  NaturalMergeContext ctx = {.target = merged, .left = left};
+  set_foreach(right, copy_missing_attribute_cb, &ctx);
+  return merged;
+}
+
 /**
  * Context for inner loop of nested loop join.
  */
@@ -154,6 +151,11 @@ Relation *relation_join(Relation *left, Relation *right, JoinPredicateFn predica
   // Nested loop join: for each tuple in left, check all tuples in right
   set_foreach(left->tuples, join_outer_cb, &ctx);
 
+  // Every pair is tested once, so the counts need no work in the loop
+  metrics_add(METRIC_JOIN_PAIRS, set_size(left->tuples) * set_size(right->tuples));
+  if (result)
+    metrics_add(METRIC_JOIN_MATCHES, set_size(result->tuples));
+
   return result;
 }
 
@@ -173,68 +175,900 @@ static void cantor_unpair(size_t n, size_t *k1, size_t *k2) {
   *k1 = w - *k2;
 }
 
-/**
- * Generator function for infinite join.
+/*
+ * Enumeration of infinite joins.
  *
- * We enumerate pairs (i,j) using Cantor pairing and count only those
- * that satisfy the predicate. The nth result is the nth matching pair.
+ * Pairs are tested in stretches of Cantor indices. A stretch is split into
+ * ranges of INFINITE_JOIN_RANGE indices; each range records its matches in
+ * a private buffer, and the buffers are appended to the memo in range order.
+ * A stretch that finds nothing makes the next one twice as long, so
+ * selective predicates are not throttled by the per-stretch overhead.
  */
-static Tuple *infinite_join_generator(size_t n, void *userdata) {
-  InfiniteJoinContext *ctx = (InfiniteJoinContext *)userdata;
 
-  // We need to find the nth pair that satisfies the predicate
-  size_t found_count = 0;
-  size_t attempt = 0;
-  const size_t max_attempts = 100000000; // Safety limit
+#define INFINITE_JOIN_RANGE 1024
+#define INFINITE_JOIN_MAX_STRETCH (1u << 22)
 
-  while (found_count <= n && attempt < max_attempts) {
-    size_t i, j;
-    cantor_unpair(attempt, &i, &j);
+typedef struct {
+  InfiniteJoinContext *ctx;
+  size_t begin;
+  size_t end;
+  size_t *matches;
+  size_t count;
+  size_t capacity;
+  int failed;
+} EnumerationRange;
 
-    // Generate tuples from both relations
-    Tuple *left_tuple = infinite_relation_tuple_at(ctx->left, i);
-    Tuple *right_tuple = infinite_relation_tuple_at(ctx->right, j);
+// Generate the pair numbered `attempt`; returns 0 if either side has no tuple there
+static int pair_at(InfiniteJoinContext *ctx, size_t attempt, Tuple **left, Tuple **right) {
+  size_t i, j;
+  if (ctx->left_count) {
+    i = attempt % ctx->left_count;
+    j = attempt / ctx->left_count;
+  } else {
+    cantor_unpair(attempt, &i, &j);
+  }
+  *left = infinite_relation_tuple_at(ctx->left, i);
+  *right = infinite_relation_tuple_at(ctx->right, j);
+  if (*left && *right)
+    return 1;
+  if (*left)
+    tuple_destroy(*left);
+  if (*right)
+    tuple_destroy(*right);
+  return 0;
+}
 
-    if (!left_tuple || !right_tuple) {
-      if (left_tuple)
-        tuple_destroy(left_tuple);
-      if (right_tuple)
-        tuple_destroy(right_tuple);
-      attempt++;
+static void enumerate_range(void *arg) {
+  EnumerationRange *range = (EnumerationRange *)arg;
+  InfiniteJoinContext *ctx = range->ctx;
+  size_t attempts = 0;
+  for (size_t attempt = range->begin; attempt < range->end && !range->failed; attempt++) {
+    Tuple *left_tuple, *right_tuple;
+    if (!pair_at(ctx, attempt, &left_tuple, &right_tuple))
+      continue;
+    attempts++;
+    int matches = ctx->predicate(left_tuple, right_tuple, ctx->userdata);
+    tuple_destroy(left_tuple);
+    tuple_destroy(right_tuple);
+    if (!matches)
       continue;
+    if (range->count == range->capacity) {
+      size_t cap = range->capacity ? range->capacity * 2 : 16;
+      size_t *grown = realloc(range->matches, cap * sizeof(size_t));
+      if (!grown) {
+        range->failed = 1;
+        break;
+      }
+      range->matches = grown;
+      range->capacity = cap;
     }
+    range->matches[range->count++] = attempt;
+  }
+  // Once per range: the workers running ranges each update their own counters
+  metrics_add(METRIC_INFINITE_JOIN_ATTEMPTS, attempts);
+  metrics_add(METRIC_INFINITE_JOIN_MATCHES, range->count);
+}
 
-    // Check predicate
-    int matches = ctx->predicate(left_tuple, right_tuple, ctx->userdata);
+// Test the pairs [begin, end) and append their matches to the memo
+static int enumerate_stretch(InfiniteJoinContext *ctx, size_t begin, size_t end) {
+  size_t n = (end - begin + INFINITE_JOIN_RANGE - 1) / INFINITE_JOIN_RANGE;
+  EnumerationRange *ranges = calloc(n, sizeof(EnumerationRange));
+  if (!ranges)
+    return -1;
+  TaskGroup group = TASK_GROUP_INIT;
+  for (size_t r = 0; r < n; r++) {
+    ranges[r].ctx = ctx;
+    ranges[r].begin = begin + r * INFINITE_JOIN_RANGE;
+    ranges[r].end = ranges[r].begin + INFINITE_JOIN_RANGE < end
+                        ? ranges[r].begin + INFINITE_JOIN_RANGE
+                        : end;
+    if (ctx->scheduler)
+      scheduler_spawn(ctx->scheduler, &group, enumerate_range, &ranges[r]);
+    else
+      enumerate_range(&ranges[r]);
+  }
+  if (ctx->scheduler)
+    scheduler_wait(ctx->scheduler, &group);
 
-    if (matches) {
-      if (found_count == n) {
-        // This is the nth match - return it
-        Tuple *merged = tuple_merge(left_tuple, right_tuple);
-        tuple_destroy(left_tuple);
-        tuple_destroy(right_tuple);
-        return merged;
+  int status = 0;
+  for (size_t r = 0; r < n; r++) {
+    EnumerationRange *range = &ranges[r];
+    if (range->failed)
+      status = -1;
+    if (status == 0 && ctx->match_count + range->count > ctx->match_capacity) {
+      size_t cap = ctx->match_capacity ? ctx->match_capacity : 64;
+      while (cap < ctx->match_count + range->count)
+        cap *= 2;
+      size_t *grown = realloc(ctx->matches, cap * sizeof(size_t));
+      if (grown) {
+        ctx->matches = grown;
+        ctx->match_capacity = cap;
+      } else {
+        status = -1;
       }
-      found_count++;
     }
+    if (status == 0) {
+      memcpy(ctx->matches + ctx->match_count, range->matches, range->count * sizeof(size_t));
+      ctx->match_count += range->count;
+    }
+    free(range->matches);
+  }
+  free(ranges);
+  // On failure nothing past the matches already recorded counts as enumerated
+  if (status == 0)
+    ctx->next_attempt = end;
+  return status;
+}
 
-    tuple_destroy(left_tuple);
-    tuple_destroy(right_tuple);
-    attempt++;
+/**
+ * Generator function for infinite join.
+ *
+ * We enumerate pairs (i,j) using Cantor pairing and count only those
+ * that satisfy the predicate. The nth result is the nth matching pair.
+ */
+static Tuple *infinite_join_generator(size_t n, void *userdata) {
+  InfiniteJoinContext *ctx = (InfiniteJoinContext *)userdata;
+  pthread_mutex_lock(&ctx->lock);
+
+  size_t stretch = INFINITE_JOIN_RANGE;
+  if (ctx->scheduler)
+    stretch *= scheduler_threads(ctx->scheduler);
+  while (ctx->match_count <= n && ctx->next_attempt < ctx->attempt_limit) {
+    size_t end = ctx->next_attempt + stretch;
+    if (end > ctx->attempt_limit)
+      end = ctx->attempt_limit;
+    size_t found = ctx->match_count;
+    if (enumerate_stretch(ctx, ctx->next_attempt, end) < 0)
+      break;
+    if (ctx->match_count == found && stretch < INFINITE_JOIN_MAX_STRETCH)
+      stretch *= 2;
   }
 
-  return NULL; // No match found in reasonable attempts
+  Tuple *merged = NULL;
+  if (n < ctx->match_count) {
+    Tuple *left_tuple, *right_tuple;
+    if (pair_at(ctx, ctx->matches[n], &left_tuple, &right_tuple)) {
+      merged = tuple_merge(left_tuple, right_tuple);
+      tuple_destroy(left_tuple);
+      tuple_destroy(right_tuple);
+    }
+  }
+  pthread_mutex_unlock(&ctx->lock);
+  return merged; // NULL when no match was found in reasonable attempts
+}
+
+int infinite_relation_join_progress(InfiniteRelation *r, size_t *attempts, size_t *matches) {
+  if (!r || r->gen_fn != infinite_join_generator)
+    return -1;
+  InfiniteJoinContext *ctx = (InfiniteJoinContext *)r->userdata;
+  pthread_mutex_lock(&ctx->lock);
+  *attempts = ctx->next_attempt;
+  *matches = ctx->match_count;
+  pthread_mutex_unlock(&ctx->lock);
+  return 0;
 }
 
 InfiniteRelation *infinite_relation_join(InfiniteRelation *left, InfiniteRelation *right,
                                          JoinPredicateFn predicate, void *userdata,
                                          const char *result_name, Cardinality result_cardinality) {
-  InfiniteJoinContext *ctx = malloc(sizeof(InfiniteJoinContext));
+  return infinite_relation_join_parallel(left, right, predicate, userdata, result_name,
+                                         result_cardinality, NULL);
+}
+
+// Set up the enumeration state of a join context allocated by the caller
+static void join_context_init(InfiniteJoinContext *ctx, InfiniteRelation *left,
+                              InfiniteRelation *right, JoinPredicateFn predicate, void *userdata,
+                              Cardinality result_cardinality, Scheduler *scheduler) {
   ctx->left = left;
   ctx->right = right;
   ctx->predicate = predicate;
   ctx->userdata = userdata;
   ctx->result_cardinality = result_cardinality;
+  ctx->scheduler = scheduler;
+  ctx->attempt_limit = INFINITE_JOIN_MAX_ATTEMPTS;
+  pthread_mutex_init(&ctx->lock, NULL);
+}
+
+static void join_context_free(void *userdata) {
+  InfiniteJoinContext *ctx = (InfiniteJoinContext *)userdata;
+  pthread_mutex_destroy(&ctx->lock);
+  free(ctx->matches);
+  free(ctx);
+}
+
+InfiniteRelation *infinite_relation_join_parallel(InfiniteRelation *left, InfiniteRelation *right,
+                                                  JoinPredicateFn predicate, void *userdata,
+                                                  const char *result_name,
+                                                  Cardinality result_cardinality,
+                                                  Scheduler *scheduler) {
+  InfiniteJoinContext *ctx = calloc(1, sizeof(InfiniteJoinContext));
+  if (!ctx)
+    return NULL;
+  join_context_init(ctx, left, right, predicate, userdata, result_cardinality, scheduler);
+
+  InfiniteRelation *joined = infinite_relation_create(result_name, infinite_join_generator, ctx);
+  if (!joined) {
+    join_context_free(ctx);
+    return NULL;
+  }
+  joined->userdata_free = join_context_free;
+  return joined;
+}
+
+/* Infinite products */
+
+typedef struct {
+  InfiniteRelation *left;
+  InfiniteRelation *right;
+  size_t left_count;  // nonzero when the left input is finite
+  size_t right_count; // nonzero when the right input is finite
+} ProductContext;
+
+// Pair n of the product: Cantor's when both inputs are infinite, rows of the finite one otherwise
+static Tuple *product_generator(size_t n, void *userdata) {
+  ProductContext *ctx = (ProductContext *)userdata;
+  size_t i, j;
+  if (ctx->left_count) {
+    i = n % ctx->left_count;
+    j = n / ctx->left_count;
+    if (ctx->right_count && j >= ctx->right_count)
+      return NULL;
+  } else if (ctx->right_count) {
+    i = n / ctx->right_count;
+    j = n % ctx->right_count;
+  } else {
+    cantor_unpair(n, &i, &j);
+  }
+  Tuple *left = infinite_relation_tuple_at(ctx->left, i);
+  Tuple *right = left ? infinite_relation_tuple_at(ctx->right, j) : NULL;
+  Tuple *merged = right ? tuple_natural_merge(left, right) : NULL;
+  tuple_destroy(left);
+  tuple_destroy(right);
+  return merged;
+}
+
+// Number of tuples of a finite input, or 0 when it is infinite, unknown or empty
+static size_t finite_count(const InfiniteRelation *r) {
+  return cardinality_is_finite(r->cardinality) ? r->cardinality.finite_count : 0;
+}
+
+InfiniteRelation *infinite_relation_product(InfiniteRelation *left, InfiniteRelation *right,
+                                            const char *result_name) {
+  if (!left || !right)
+    return NULL;
+  Tuple *hl = infinite_relation_tuple_at(left, 0), *hr = infinite_relation_tuple_at(right, 0);
+  int disjoint = !hl || !hr || tuple_heading_disjoint(hl, hr);
+  tuple_destroy(hl);
+  tuple_destroy(hr);
+  if (!disjoint)
+    return NULL;
+
+  Cardinality card = cardinality_product(left->cardinality, right->cardinality);
+  ProductContext *ctx = malloc(sizeof(ProductContext));
+  InfiniteRelation *product =
+      ctx ? infinite_relation_create_with_cardinality(result_name, product_generator, ctx, card)
+          : NULL;
+  if (!product) {
+    free(ctx);
+    return NULL;
+  }
+  ctx->left = left;
+  ctx->right = right;
+  ctx->left_count = finite_count(left);
+  ctx->right_count = finite_count(right);
+  product->userdata_free = free;
+  return product;
+}
+
+/* Finite ⋈ infinite joins */
+
+typedef struct {
+  InfiniteJoinContext join; // first, so the join generator can use the same userdata
+  Tuple **tuples;           // snapshot of the finite side
+  size_t count;
+  InfiniteRelation *finite_view;
+  InfiniteRelation *restricted[2]; // bounds pushed into the infinite side (NULL if none)
+  char *finite_attr;
+  char *infinite_attr;
+  CompareOp op;
+} FiniteJoinContext;
+
+static Tuple *finite_tuple_generator(size_t n, void *userdata) {
+  FiniteJoinContext *ctx = (FiniteJoinContext *)userdata;
+  return n < ctx->count ? tuple_copy(ctx->tuples[n]) : NULL;
+}
+
+static int compare_attributes_predicate(Tuple *left, Tuple *right, void *userdata) {
+  FiniteJoinContext *ctx = (FiniteJoinContext *)userdata;
+  Attribute *a = tuple_find_attribute(left, ctx->finite_attr);
+  Attribute *b = tuple_find_attribute(right, ctx->infinite_attr);
+  int cmp;
+  return a && b && attribute_value_compare(a, b, &cmp) == 0 && compare_op_holds(ctx->op, cmp);
+}
+
+static void finite_join_free(void *userdata) {
+  FiniteJoinContext *ctx = (FiniteJoinContext *)userdata;
+  pthread_mutex_destroy(&ctx->join.lock);
+  free(ctx->join.matches);
+  free(ctx->tuples);
+  infinite_relation_destroy(ctx->finite_view);
+  infinite_relation_destroy(ctx->restricted[1]);
+  infinite_relation_destroy(ctx->restricted[0]);
+  free(ctx->finite_attr);
+  free(ctx->infinite_attr);
+  free(ctx);
+}
+
+typedef struct {
+  FiniteJoinContext *ctx;
+  double min;
+  double max;
+  size_t numeric;
+  size_t other; // values that are not numbers (strings, sets), which give no bound
+} FiniteSideContext;
+
+static void snapshot_tuple_cb(void *element, void *userdata) {
+  FiniteSideContext *side = (FiniteSideContext *)userdata;
+  Tuple *t = (Tuple *)element;
+  side->ctx->tuples[side->ctx->count++] = t;
+  Attribute *a = tuple_find_attribute(t, side->ctx->finite_attr);
+  if (!a || !a->value)
+    return;
+  if (a->type != ATTR_INT && a->type != ATTR_RATIONAL) {
+    side->other++;
+    return;
+  }
+  double v = a->type == ATTR_INT ? *(int *)a->value : *(double *)a->value;
+  if (side->numeric == 0 || v < side->min)
+    side->min = v;
+  if (side->numeric == 0 || v > side->max)
+    side->max = v;
+  side->numeric++;
+}
+
+// Push `infinite_attr op bound` into the scan of the infinite side, if it can take it
+static void push_bound(FiniteJoinContext *ctx, CompareOp op, double bound) {
+  InfiniteRelation *scan = ctx->restricted[0] ? ctx->restricted[0] : ctx->join.right;
+  Attribute constant = {.name = ctx->infinite_attr, .type = ATTR_RATIONAL, .value = &bound};
+  InfiniteRelation *restricted =
+      infinite_relation_restrict(scan, ctx->infinite_attr, op, &constant);
+  if (!restricted)
+    return;
+  ctx->restricted[ctx->restricted[0] ? 1 : 0] = restricted;
+  ctx->join.right = restricted;
+}
+
+InfiniteRelation *infinite_relation_join_finite(const Relation *finite, const char *finite_attr,
+                                                CompareOp op, InfiniteRelation *infinite,
+                                                const char *infinite_attr,
+                                                const char *result_name, Scheduler *scheduler) {
+  FiniteJoinContext *ctx = calloc(1, sizeof(FiniteJoinContext));
+  if (!ctx)
+    return NULL;
+  join_context_init(&ctx->join, NULL, infinite, compare_attributes_predicate, ctx,
+                    cardinality_infinite(CARD_ALEPH_0), scheduler);
+  size_t size = set_size(finite->tuples);
+  ctx->tuples = malloc((size ? size : 1) * sizeof(Tuple *));
+  ctx->finite_attr = strdup(finite_attr);
+  ctx->infinite_attr = strdup(infinite_attr);
+  ctx->op = op;
+  ctx->finite_view = infinite_relation_create_with_cardinality(
+      finite->name, finite_tuple_generator, ctx, cardinality_finite(size));
+  if (!ctx->tuples || !ctx->finite_attr || !ctx->infinite_attr || !ctx->finite_view) {
+    finite_join_free(ctx);
+    return NULL;
+  }
+  ctx->join.left = ctx->finite_view;
+
+  FiniteSideContext side = {.ctx = ctx};
+  set_foreach(finite->tuples, snapshot_tuple_cb, &side);
+  ctx->join.left_count = ctx->count;
+
+  // finite.a op inf.b can only hold for b within the range of the a values.
+  // Non-numeric values bound nothing, so the infinite side is then scanned
+  // unrestricted; without any value the predicate never holds.
+  if (side.numeric == 0 && side.other == 0) {
+    ctx->join.attempt_limit = 0;
+  } else if (side.other == 0) {
+    switch (op) {
+    case CMP_EQ:
+      push_bound(ctx, CMP_GE, side.min);
+      push_bound(ctx, CMP_LE, side.max);
+      break;
+    case CMP_LT:
+      push_bound(ctx, CMP_GT, side.min);
+      break;
+    case CMP_LE:
+      push_bound(ctx, CMP_GE, side.min);
+      break;
+    case CMP_GT:
+      push_bound(ctx, CMP_LT, side.max);
+      break;
+    case CMP_GE:
+      push_bound(ctx, CMP_LE, side.max);
+      break;
+    case CMP_NE:
+      break;
+    }
+  }
+
+  // A bounded infinite side leaves finitely many pairs; how many of them
+  // match is unknown until they are tested, so neither is the cardinality
+  Cardinality right = ctx->join.right->cardinality;
+  if (cardinality_is_finite(right) && ctx->join.attempt_limit > 0) {
+    uint64_t pairs = right.finite_count * ctx->count;
+    if (ctx->count == 0 || pairs / ctx->count == right.finite_count)
+      ctx->join.attempt_limit =
+          pairs < INFINITE_JOIN_MAX_ATTEMPTS ? pairs : INFINITE_JOIN_MAX_ATTEMPTS;
+    ctx->join.result_cardinality = cardinality_infinite(CARD_UNKNOWN);
+  }
+  if (ctx->count == 0)
+    ctx->join.attempt_limit = 0;
+
+  InfiniteRelation *joined = infinite_relation_create_with_cardinality(
+      result_name, infinite_join_generator, ctx, ctx->join.result_cardinality);
+  if (!joined) {
+    finite_join_free(ctx);
+    return NULL;
+  }
+  joined->userdata_free = finite_join_free;
+  return joined;
+}
+
+/*
+ * Partitioned hash join.
+ *
+ * Both inputs are split into morsels of JOIN_MORSEL tuples. Per morsel, one
+ * task hashes the join key of every tuple and counts how many fall in each
+ * partition; a prefix sum over those counts gives every morsel a private
+ * slice of each partition, which a second task fills. Partitions are then
+ * joined independently, each writing to its own output buffer, and the
+ * buffers are linked into the result at the end. No phase shares mutable
+ * state between tasks.
+ */
+
+#define JOIN_MORSEL 4096
+#define JOIN_MIN_PARTITION_ROWS 2048
+#define JOIN_MAX_PARTITIONS 1024
+#define NO_PARTITION UINT32_MAX
+
+typedef struct {
+  Tuple *tuple;
+  uint64_t hash;
+} KeyedTuple;
+
+typedef struct {
+  Tuple **tuples; // the relation's tuples, in iteration order
+  size_t count;
+  uint64_t *hashes;
+  uint32_t *partitions; // NO_PARTITION for tuples lacking a join attribute
+  size_t *offsets;      // morsel × partition: count, then first slot of the morsel's slice
+  KeyedTuple *partitioned;
+  size_t *starts; // partition p spans partitioned[starts[p]..starts[p + 1])
+} JoinSide;
+
+typedef struct {
+  Tuple **tuples;
+  size_t count;
+  size_t capacity;
+  int failed;
+} JoinOutput;
+
+typedef struct {
+  JoinSide left;
+  JoinSide right;
+  const char **attrs;
+  size_t attr_count;
+  size_t partitions;
+  unsigned partition_bits;
+  JoinOutput *outputs;
+  JoinSide *side; // side being partitioned
+} PartitionedJoin;
+
+// Hash of the join attribute values; returns -1 if the tuple lacks one
+static int join_key_hash(Tuple *t, const char **attrs, size_t count, uint64_t *out) {
+  uint64_t h = 0x9e3779b97f4a7c15ULL;
+  for (size_t i = 0; i < count; i++) {
+    Attribute *a = tuple_find_attribute(t, attrs[i]);
+    if (!a)
+      return -1;
+    h = hash_combine(h, attribute_value_hash(a));
+  }
+  // Finish the hash: its top bits pick the partition, its low bits the bucket
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  *out = h;
+  return 0;
+}
+
+static int join_keys_equal(Tuple *a, Tuple *b, const char **attrs, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (!attribute_value_equals(tuple_find_attribute(a, attrs[i]),
+                                tuple_find_attribute(b, attrs[i])))
+      return 0;
+  }
+  return 1;
+}
+
+static void hash_morsels(size_t begin, size_t end, void *arg) {
+  PartitionedJoin *j = (PartitionedJoin *)arg;
+  JoinSide *side = j->side;
+  size_t *counts = side->offsets + begin / JOIN_MORSEL * j->partitions;
+  for (size_t i = begin; i < end; i++) {
+    if (join_key_hash(side->tuples[i], j->attrs, j->attr_count, &side->hashes[i]) < 0) {
+      side->partitions[i] = NO_PARTITION;
+      continue;
+    }
+    uint32_t p = j->partition_bits ? (uint32_t)(side->hashes[i] >> (64 - j->partition_bits)) : 0;
+    side->partitions[i] = p;
+    counts[p]++;
+  }
+}
+
+static void scatter_morsels(size_t begin, size_t end, void *arg) {
+  PartitionedJoin *j = (PartitionedJoin *)arg;
+  JoinSide *side = j->side;
+  size_t *cursor = side->offsets + begin / JOIN_MORSEL * j->partitions;
+  for (size_t i = begin; i < end; i++) {
+    uint32_t p = side->partitions[i];
+    if (p != NO_PARTITION)
+      side->partitioned[cursor[p]++] = (KeyedTuple){side->tuples[i], side->hashes[i]};
+  }
+}
+
+static void collect_tuple_cb(void *element, void *userdata) {
+  JoinSide *side = (JoinSide *)userdata;
+  side->tuples[side->count++] = (Tuple *)element;
+}
+
+// Hash and scatter one input into its partitions
+static int partition_side(Scheduler *scheduler, PartitionedJoin *j, JoinSide *side,
+                          const Relation *r) {
+  size_t n = set_size(r->tuples);
+  size_t morsels = n / JOIN_MORSEL + 1;
+  side->tuples = malloc((n ? n : 1) * sizeof(Tuple *));
+  side->hashes = malloc((n ? n : 1) * sizeof(uint64_t));
+  side->partitions = malloc((n ? n : 1) * sizeof(uint32_t));
+  side->offsets = calloc(morsels * j->partitions, sizeof(size_t));
+  side->partitioned = malloc((n ? n : 1) * sizeof(KeyedTuple));
+  side->starts = calloc(j->partitions + 1, sizeof(size_t));
+  if (!side->tuples || !side->hashes || !side->partitions || !side->offsets ||
+      !side->partitioned || !side->starts)
+    return -1;
+  set_foreach(r->tuples, collect_tuple_cb, side);
+
+  j->side = side;
+  int status = scheduler_parallel_for(scheduler, n, JOIN_MORSEL, hash_morsels, j);
+
+  // Partition-major prefix sum: each morsel's slice of a partition follows the previous morsel's
+  size_t next = 0;
+  for (size_t p = 0; p < j->partitions; p++) {
+    side->starts[p] = next;
+    for (size_t m = 0; m < morsels; m++) {
+      size_t count = side->offsets[m * j->partitions + p];
+      side->offsets[m * j->partitions + p] = next;
+      next += count;
+    }
+  }
+  side->starts[j->partitions] = next;
+
+  if (scheduler_parallel_for(scheduler, n, JOIN_MORSEL, scatter_morsels, j) < 0)
+    status = -1;
+  return status;
+}
+
+static void output_add(JoinOutput *out, Tuple *t) {
+  if (!t) {
+    out->failed = 1;
+    return;
+  }
+  if (out->count == out->capacity) {
+    size_t cap = out->capacity ? out->capacity * 2 : 256;
+    Tuple **tuples = realloc(out->tuples, cap * sizeof(Tuple *));
+    if (!tuples) {
+      tuple_destroy(t);
+      out->failed = 1;
+      return;
+    }
+    out->tuples = tuples;
+    out->capacity = cap;
+  }
+  out->tuples[out->count++] = t;
+}
+
+// Build a chained table over the right side of a partition and probe it with the left side
+static void join_partition(PartitionedJoin *j, size_t p) {
+  JoinOutput *out = &j->outputs[p];
+  KeyedTuple *build = j->right.partitioned + j->right.starts[p];
+  size_t build_count = j->right.starts[p + 1] - j->right.starts[p];
+  KeyedTuple *probe = j->left.partitioned + j->left.starts[p];
+  size_t probe_count = j->left.starts[p + 1] - j->left.starts[p];
+  if (build_count == 0 || probe_count == 0)
+    return;
+
+  size_t buckets = 16;
+  while (buckets < build_count * 2)
+    buckets *= 2;
+  size_t *heads = malloc(buckets * sizeof(size_t));
+  size_t *next = malloc(build_count * sizeof(size_t));
+  if (!heads || !next) {
+    free(heads);
+    free(next);
+    out->failed = 1;
+    return;
+  }
+  memset(heads, 0xff, buckets * sizeof(size_t));
+  for (size_t i = 0; i < build_count; i++) {
+    size_t b = build[i].hash & (buckets - 1);
+    next[i] = heads[b];
+    heads[b] = i;
+  }
+
+  for (size_t i = 0; i < probe_count && !out->failed; i++) {
+    for (size_t e = heads[probe[i].hash & (buckets - 1)]; e != SIZE_MAX; e = next[e]) {
+      if (build[e].hash == probe[i].hash &&
+          join_keys_equal(probe[i].tuple, build[e].tuple, j->attrs, j->attr_count))
+        output_add(out, tuple_natural_merge(probe[i].tuple, build[e].tuple));
+    }
+  }
+  free(heads);
+  free(next);
+}
+
+static void join_partitions(size_t begin, size_t end, void *arg) {
+  for (size_t p = begin; p < end; p++)
+    join_partition((PartitionedJoin *)arg, p);
+}
+
+static void join_side_free(JoinSide *side) {
+  free(side->tuples);
+  free(side->hashes);
+  free(side->partitions);
+  free(side->offsets);
+  free(side->partitioned);
+  free(side->starts);
+}
+
+Relation *relation_hash_join(const Relation *left, const Relation *right, const char **attrs,
+                             size_t count, Scheduler *scheduler, const char *result_name) {
+  PartitionedJoin j = {.attrs = attrs, .attr_count = count, .partitions = 1};
+  if (scheduler) {
+    // A few partitions per thread balance skew; tiny partitions only add overhead
+    size_t rows = set_size(left->tuples) + set_size(right->tuples);
+    size_t wanted = (size_t)scheduler_threads(scheduler) * 4;
+    while (j.partitions < wanted && j.partitions < JOIN_MAX_PARTITIONS &&
+           j.partitions * 2 * JOIN_MIN_PARTITION_ROWS <= rows) {
+      j.partitions *= 2;
+      j.partition_bits++;
+    }
+  }
+
+  Relation *result = NULL;
+  j.outputs = calloc(j.partitions, sizeof(JoinOutput));
+  int status = j.outputs ? 0 : -1;
+  if (status == 0 && (partition_side(scheduler, &j, &j.right, right) < 0 ||
+                      partition_side(scheduler, &j, &j.left, left) < 0))
+    status = -1;
+  if (status == 0 && scheduler_parallel_for(scheduler, j.partitions, 1, join_partitions, &j) < 0)
+    status = -1;
+  for (size_t p = 0; status == 0 && p < j.partitions; p++) {
+    if (j.outputs[p].failed)
+      status = -1;
+  }
+  if (status == 0)
+    result = relation_create(result_name);
+
+  // Link every partition's output into the result; whatever is not linked is freed
+  for (size_t p = 0; j.outputs && p < j.partitions; p++) {
+    JoinOutput *out = &j.outputs[p];
+    if (result && relation_add_tuples(result, out->tuples, out->count) < 0) {
+      relation_destroy(result);
+      result = NULL;
+    }
+    for (size_t i = 0; !result && i < out->count; i++)
+      tuple_destroy(out->tuples[i]);
+    free(out->tuples);
+  }
+  free(j.outputs);
+  join_side_free(&j.left);
+  join_side_free(&j.right);
+  return result;
+}
+
+/* Semi-joins and anti-joins */
+
+static Relation *semi_join_finite(const Relation *left, const Relation *right, const char **attrs,
+                                  size_t count, int anti, const char *result_name) {
+  Operator *(*semi)(Operator *, Operator *, const char **, size_t) =
+      anti ? operator_anti_join : operator_semi_join;
+  Operator *plan = semi(operator_scan(left), operator_scan(right), attrs, count);
+  Relation *result = plan ? operator_collect(plan, result_name) : NULL;
+  operator_destroy(plan);
+  return result;
+}
+
+Relation *relation_semi_join(const Relation *left, const Relation *right, const char **attrs,
+                             size_t count, const char *result_name) {
+  return semi_join_finite(left, right, attrs, count, 0, result_name);
+}
+
+Relation *relation_anti_join(const Relation *left, const Relation *right, const char **attrs,
+                             size_t count, const char *result_name) {
+  return semi_join_finite(left, right, attrs, count, 1, result_name);
+}
+
+/*
+ * Semi-joins against an infinite relation.
+ *
+ * Each left tuple ends up matched, unmatched or undecided. Tuples lacking a
+ * join attribute are unmatched. When the right side can map equality on
+ * every join attribute to an index range, a bounded range is scanned for
+ * the tuple alone (an empty one means no match). The rest share one scan
+ * of a prefix of the right side, which stops once every pending key has
+ * matched; keys not met are unmatched if the generator ended within the
+ * prefix and undecided otherwise.
+ */
+
+typedef enum { SEMI_UNDECIDED, SEMI_MATCHED, SEMI_UNMATCHED } SemiOutcome;
+
+// Markers stored as the values of the pending keys (borrowed from the left tuples' keys)
+static char semi_pending, semi_matched;
+
+// Copy of the join attributes of `t`, or NULL if it lacks one
+static Tuple *semi_join_key(Tuple *t, const char **attrs, size_t count) {
+  Tuple *key = tuple_create();
+  for (size_t i = 0; key && i < count; i++) {
+    Attribute *attr = tuple_find_attribute(t, attrs[i]);
+    Attribute *copy = attr ? attribute_copy(attr) : NULL;
+    if (!copy) {
+      tuple_destroy(key);
+      return NULL;
+    }
+    tuple_add_attribute(key, copy);
+  }
+  return key;
+}
+
+// Decide `key` through the index ranges of `right`; SEMI_UNDECIDED if they cannot
+static SemiOutcome semi_join_by_range(InfiniteRelation *right, Tuple *key, const char **attrs,
+                                      size_t count, size_t search_limit) {
+  if (!right->range_fn || count == 0)
+    return SEMI_UNDECIDED;
+  IndexRange range = {0, SIZE_MAX};
+  for (size_t i = 0; i < count; i++) {
+    IndexRange r;
+    Attribute *value = tuple_find_attribute(key, attrs[i]);
+    if (right->range_fn(attrs[i], CMP_EQ, value, &r, right->userdata) < 0)
+      return SEMI_UNDECIDED;
+    range.begin = r.begin > range.begin ? r.begin : range.begin;
+    range.end = r.end < range.end ? r.end : range.end;
+  }
+  if (range.end <= range.begin)
+    return SEMI_UNMATCHED;
+  if (range.end - range.begin > search_limit)
+    return SEMI_UNDECIDED;
+
+  // The range holds every tuple equal by value; a match must also have equal types
+  SemiOutcome outcome = SEMI_UNMATCHED;
+  for (size_t n = range.begin; n < range.end && outcome == SEMI_UNMATCHED; n++) {
+    Tuple *t = infinite_relation_tuple_at(right, n);
+    if (!t)
+      break;
+    Tuple *candidate = semi_join_key(t, attrs, count);
+    if (candidate && tuple_equals(candidate, key))
+      outcome = SEMI_MATCHED;
+    tuple_destroy(candidate);
+    tuple_destroy(t);
+  }
+  return outcome;
+}
+
+static uint64_t semi_key_hash(const void *key) { return tuple_hash((const Tuple *)key); }
+
+static int semi_key_equals(const void *a, const void *b) {
+  return tuple_equals((Tuple *)a, (Tuple *)b);
+}
+
+static Relation *semi_join_infinite(const Relation *left, InfiniteRelation *right,
+                                    const char **attrs, size_t count, size_t search_limit,
+                                    size_t *undecided, int anti, const char *result_name) {
+  if (search_limit == 0)
+    search_limit = SEMI_JOIN_SEARCH_LIMIT;
+  // A finite right side is searched to its end, which decides every tuple
+  if (cardinality_is_finite(right->cardinality))
+    search_limit = right->cardinality.finite_count;
+
+  size_t n = set_size(left->tuples);
+  Tuple **tuples = malloc((n ? n : 1) * sizeof(Tuple *));
+  Tuple **keys = calloc(n ? n : 1, sizeof(Tuple *));
+  SemiOutcome *outcomes = calloc(n ? n : 1, sizeof(SemiOutcome));
+  HashMap *pending = hash_map_create(semi_key_hash, semi_key_equals, NULL, NULL); // keys[]
+  Relation *result = NULL;
+  if (!tuples || !keys || !outcomes || !pending)
+    goto done;
+
+  SetIter it;
+  set_iter_init(left->tuples, &it);
+  size_t remaining = 0; // distinct pending keys not matched yet
+  for (size_t i = 0; i < n; i++) {
+    tuples[i] = (Tuple *)set_iter_next(&it);
+    keys[i] = semi_join_key(tuples[i], attrs, count);
+    if (!keys[i]) {
+      outcomes[i] = SEMI_UNMATCHED;
+      continue;
+    }
+    if (!cardinality_is_finite(right->cardinality))
+      outcomes[i] = semi_join_by_range(right, keys[i], attrs, count, search_limit);
+    if (outcomes[i] != SEMI_UNDECIDED || hash_map_get(pending, keys[i]))
+      continue;
+    if (hash_map_put(pending, keys[i], &semi_pending) < 0)
+      goto done;
+    remaining++;
+  }
+
+  // One scan of the prefix serves every pending key
+  int ended = 0;
+  for (size_t k = 0; remaining > 0 && k < search_limit; k++) {
+    Tuple *t = infinite_relation_tuple_at(right, k);
+    if (!t) {
+      ended = 1;
+      break;
+    }
+    Tuple *key = semi_join_key(t, attrs, count);
+    if (key && hash_map_get(pending, key) == &semi_pending) {
+      hash_map_put(pending, key, &semi_matched); // keeps the stored key
+      remaining--;
+    }
+    tuple_destroy(key);
+    tuple_destroy(t);
+  }
+  if (remaining > 0 && cardinality_is_finite(right->cardinality))
+    ended = 1;
+
+  result = relation_create(result_name);
+  size_t skipped = 0;
+  for (size_t i = 0; result && i < n; i++) {
+    if (outcomes[i] == SEMI_UNDECIDED) {
+      void *state = hash_map_get(pending, keys[i]);
+      outcomes[i] = state == &semi_matched ? SEMI_MATCHED
+                    : ended                ? SEMI_UNMATCHED
+                                           : SEMI_UNDECIDED;
+    }
+    if (outcomes[i] == SEMI_UNDECIDED) {
+      skipped++;
+      continue;
+    }
+    if ((outcomes[i] == SEMI_UNMATCHED) != anti)
+      continue;
+    Tuple *copy = tuple_copy(tuples[i]);
+    if (!copy || relation_add_tuples(result, &copy, 1) < 0) {
+      tuple_destroy(copy);
+      relation_destroy(result);
+      result = NULL;
+    }
+  }
+  if (result && undecided)
+    *undecided = skipped;
+
+done:
+  for (size_t i = 0; keys && i < n; i++)
+    tuple_destroy(keys[i]);
+  free(keys);
+  free(tuples);
+  free(outcomes);
+  hash_map_destroy(pending);
+  return result;
+}
+
+Relation *relation_semi_join_infinite(const Relation *left, InfiniteRelation *right,
+                                      const char **attrs, size_t count, size_t search_limit,
+                                      size_t *undecided, const char *result_name) {
+  return semi_join_infinite(left, right, attrs, count, search_limit, undecided, 0, result_name);
+}
 
-  return infinite_relation_create(result_name, infinite_join_generator, ctx);
+Relation *relation_anti_join_infinite(const Relation *left, InfiniteRelation *right,
+                                      const char **attrs, size_t count, size_t search_limit,
+                                      size_t *undecided, const char *result_name) {
+  return semi_join_infinite(left, right, attrs, count, search_limit, undecided, 1, result_name);
 }
@@ -0,0 +1,607 @@
+/**
+ * @file loader.c
+ * @brief Parallel bulk loader for delimited text files.
+ *
+ * The file is mapped once and walked in windows. Every window is cut into
+ * line-aligned chunks that are parsed into tuples concurrently; the main
+ * thread then delivers each chunk's tuples to the sink in file order, so
+ * parsing dominates the cost rather than insertion.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "attribute.h"
+#include "loader.h"
+#include "log.h"
+#include "schema.h"
+
+// Windows smaller than this per thread are not worth splitting further
+#define LOADER_MIN_CHUNK (256u * 1024u)
+
+typedef struct {
+  char *name;
+  AttributeType type; /** ATTR_UNKNOWN until typed or inferred */
+} LoaderColumn;
+
+typedef struct {
+  LoaderColumn *columns;
+  size_t count;
+  char delimiter;
+} LoaderHeading;
+
+// One field of a line; quoted fields may still contain doubled quotes
+typedef struct {
+  const char *data;
+  size_t len;
+  int quoted;
+} LoaderField;
+
+// A line-aligned slice of a window and the tuples parsed from it
+typedef struct {
+  const LoaderHeading *heading;
+  const char *begin;
+  const char *end;
+  Tuple **tuples;
+  size_t count;
+  size_t capacity;
+  uint64_t rejected;
+  int failed;
+} LoaderChunk;
+
+// Split a line into at most `max` fields; returns the number of fields
+// (max + 1 if there are more) or -1 if a quoted field is not terminated
+static long split_line(const char *p, const char *end, char delimiter, LoaderField *fields,
+                       size_t max) {
+  size_t n = 0;
+  for (;;) {
+    LoaderField f = {.data = p, .len = 0, .quoted = 0};
+    if (p < end && *p == '"') {
+      const char *q = p + 1;
+      for (;;) {
+        q = memchr(q, '"', (size_t)(end - q));
+        if (!q)
+          return -1;
+        if (q + 1 < end && q[1] == '"') {
+          q += 2;
+          continue;
+        }
+        break;
+      }
+      f.data = p + 1;
+      f.len = (size_t)(q - f.data);
+      f.quoted = 1;
+      p = q + 1;
+      if (p < end && *p != delimiter)
+        return -1;
+    } else {
+      const char *d = memchr(p, delimiter, (size_t)(end - p));
+      f.len = (size_t)((d ? d : end) - p);
+      p += f.len;
+    }
+
+    if (n == max)
+      return (long)max + 1;
+    fields[n++] = f;
+    if (p >= end)
+      return (long)n;
+    p++; // skip the delimiter; a trailing one yields an empty last field
+  }
+}
+
+// Strip surrounding blanks from an unquoted field
+static LoaderField field_trim(LoaderField f) {
+  if (f.quoted)
+    return f;
+  while (f.len && isspace((unsigned char)f.data[0])) {
+    f.data++;
+    f.len--;
+  }
+  while (f.len && isspace((unsigned char)f.data[f.len - 1]))
+    f.len--;
+  return f;
+}
+
+static int field_to_int(LoaderField f, int *out) {
+  f = field_trim(f);
+  if (f.len == 0)
+    return -1;
+  size_t i = 0;
+  int negative = 0;
+  if (f.data[0] == '-' || f.data[0] == '+') {
+    negative = f.data[0] == '-';
+    i++;
+  }
+  if (i == f.len)
+    return -1;
+  long long value = 0;
+  for (; i < f.len; i++) {
+    if (f.data[i] < '0' || f.data[i] > '9')
+      return -1;
+    value = value * 10 + (f.data[i] - '0');
+    if (value > (long long)INT_MAX + 1)
+      return -1;
+  }
+  if (negative)
+    value = -value;
+  if (value > INT_MAX || value < INT_MIN)
+    return -1;
+  *out = (int)value;
+  return 0;
+}
+
+static int field_to_double(LoaderField f, double *out) {
+  f = field_trim(f);
+  // strtod needs a terminator, and the mapping has none at the end of the file
+  char buf[64];
+  if (f.len == 0 || f.len >= sizeof(buf))
+    return -1;
+  memcpy(buf, f.data, f.len);
+  buf[f.len] = '\0';
+  char *endptr;
+  *out = strtod(buf, &endptr);
+  return *endptr == '\0' ? 0 : -1;
+}
+
+// Copy a field, collapsing doubled quotes inside quoted fields
+static char *field_dup(LoaderField f) {
+  char *s = malloc(f.len + 1);
+  if (!s)
+    return NULL;
+  size_t n = 0;
+  for (size_t i = 0; i < f.len; i++) {
+    s[n++] = f.data[i];
+    if (f.quoted && f.data[i] == '"')
+      i++;
+  }
+  s[n] = '\0';
+  return s;
+}
+
+// Convert a field to a value of the column type; NULL if it does not parse
+static void *field_value(AttributeType type, LoaderField f) {
+  switch (type) {
+  case ATTR_INT: {
+    int parsed;
+    if (field_to_int(f, &parsed) < 0)
+      return NULL;
+    int *v = malloc(sizeof(int));
+    if (v)
+      *v = parsed;
+    return v;
+  }
+  case ATTR_RATIONAL: {
+    double parsed;
+    if (field_to_double(f, &parsed) < 0)
+      return NULL;
+    double *v = malloc(sizeof(double));
+    if (v)
+      *v = parsed;
+    return v;
+  }
+  case ATTR_STRING:
+    return field_dup(f);
+  default:
+    return NULL;
+  }
+}
+
+// Narrow an inferred column type by one observed value
+static AttributeType infer_type(AttributeType current, LoaderField f) {
+  int i;
+  double d;
+  if ((current == ATTR_UNKNOWN || current == ATTR_INT) && field_to_int(f, &i) == 0)
+    return ATTR_INT;
+  if (current != ATTR_STRING && field_to_double(f, &d) == 0)
+    return ATTR_RATIONAL;
+  return ATTR_STRING;
+}
+
+static AttributeType type_from_name(const char *s, size_t len) {
+  if (len == 3 && memcmp(s, "int", 3) == 0)
+    return ATTR_INT;
+  if (len == 8 && memcmp(s, "rational", 8) == 0)
+    return ATTR_RATIONAL;
+  if (len == 6 && memcmp(s, "string", 6) == 0)
+    return ATTR_STRING;
+  return ATTR_UNKNOWN;
+}
+
+// Find the end of the line starting at p, and the start of the next one
+static const char *line_end(const char *p, const char *end, const char **next) {
+  const char *nl = memchr(p, '\n', (size_t)(end - p));
+  *next = nl ? nl + 1 : end;
+  const char *e = nl ? nl : end;
+  if (e > p && e[-1] == '\r')
+    e--;
+  return e;
+}
+
+static void heading_free(LoaderHeading *h) {
+  for (size_t i = 0; i < h->count; i++)
+    free(h->columns[i].name);
+  free(h->columns);
+}
+
+// Parse the heading line: `name` or `name:type` per field
+static int heading_parse(LoaderHeading *h, const char *p, const char *end) {
+  size_t max = 1;
+  for (const char *c = p; c < end; c++)
+    max += *c == h->delimiter;
+  LoaderField *fields = malloc(max * sizeof(LoaderField));
+  h->columns = calloc(max, sizeof(LoaderColumn));
+  long n = fields && h->columns ? split_line(p, end, h->delimiter, fields, max) : -1;
+  if (n <= 0) {
+    free(fields);
+    return -1;
+  }
+
+  for (long i = 0; i < n; i++) {
+    LoaderField f = field_trim(fields[i]);
+    AttributeType type = ATTR_UNKNOWN;
+    // The type follows the last colon, so names may contain colons themselves
+    const char *colon = NULL;
+    for (size_t k = f.len; k > 0 && !colon; k--) {
+      if (f.data[k - 1] == ':')
+        colon = f.data + k - 1;
+    }
+    if (colon) {
+      type = type_from_name(colon + 1, (size_t)(f.data + f.len - colon - 1));
+      if (type != ATTR_UNKNOWN)
+        f.len = (size_t)(colon - f.data);
+    }
+
+    LoaderColumn *column = &h->columns[h->count];
+    column->name = field_dup(f);
+    column->type = type;
+    if (!column->name) {
+      free(fields);
+      return -1;
+    }
+    h->count++;
+    if (f.len == 0) {
+      log_error("loader", "heading has an empty attribute name");
+      free(fields);
+      return -1;
+    }
+    for (size_t j = 0; j + 1 < h->count; j++) {
+      if (strcmp(h->columns[j].name, column->name) == 0) {
+        log_error("loader", "attribute %s appears twice in the heading", column->name);
+        free(fields);
+        return -1;
+      }
+    }
+  }
+  free(fields);
+  return 0;
+}
+
+// Infer the untyped columns from the first rows of the body
+static int heading_infer(LoaderHeading *h, const char *p, const char *end) {
+  LoaderField *fields = malloc((h->count + 1) * sizeof(LoaderField));
+  if (!fields)
+    return -1;
+
+  AttributeType *inferred = calloc(h->count, sizeof(AttributeType));
+  if (!inferred) {
+    free(fields);
+    return -1;
+  }
+  for (size_t c = 0; c < h->count; c++)
+    inferred[c] = ATTR_UNKNOWN;
+
+  for (size_t rows = 0; p < end && rows < LOADER_INFER_ROWS;) {
+    const char *next;
+    const char *e = line_end(p, end, &next);
+    long n = e > p ? split_line(p, e, h->delimiter, fields, h->count) : -1;
+    if (n == (long)h->count) {
+      for (size_t c = 0; c < h->count; c++) {
+        if (h->columns[c].type == ATTR_UNKNOWN && (fields[c].len || fields[c].quoted))
+          inferred[c] = infer_type(inferred[c], fields[c]);
+      }
+      rows++;
+    }
+    p = next;
+  }
+
+  // Columns with no values at all default to strings
+  for (size_t c = 0; c < h->count; c++) {
+    if (h->columns[c].type == ATTR_UNKNOWN)
+      h->columns[c].type = inferred[c] == ATTR_UNKNOWN ? ATTR_STRING : inferred[c];
+  }
+  free(inferred);
+  free(fields);
+  return 0;
+}
+
+// Build the tuple for one line: 1 built, 0 rejected, -1 out of memory
+static int parse_row(const LoaderHeading *h, const char *p, const char *end,
+                     LoaderField *fields, Tuple **out) {
+  if (split_line(p, end, h->delimiter, fields, h->count) != (long)h->count)
+    return 0;
+
+  Tuple *t = tuple_create();
+  if (!t)
+    return -1;
+  for (size_t c = 0; c < h->count; c++) {
+    // An empty unquoted field is a missing attribute
+    if (fields[c].len == 0 && !fields[c].quoted)
+      continue;
+    void *value = field_value(h->columns[c].type, fields[c]);
+    if (!value) {
+      tuple_destroy(t);
+      return 0;
+    }
+    Attribute *attr = attribute_create(h->columns[c].name, h->columns[c].type, value);
+    if (!attr) {
+      free(value);
+      tuple_destroy(t);
+      return -1;
+    }
+    tuple_add_attribute(t, attr);
+  }
+  *out = t;
+  return 1;
+}
+
+// Worker: parse every line of a chunk into tuples
+static void *parse_chunk(void *arg) {
+  LoaderChunk *chunk = (LoaderChunk *)arg;
+  const LoaderHeading *h = chunk->heading;
+  LoaderField *fields = malloc((h->count + 1) * sizeof(LoaderField));
+  if (!fields) {
+    chunk->failed = 1;
+    return NULL;
+  }
+
+  const char *p = chunk->begin;
+  while (p < chunk->end) {
+    const char *next;
+    const char *e = line_end(p, chunk->end, &next);
+    if (e > p) {
+      Tuple *t = NULL;
+      int status = parse_row(h, p, e, fields, &t);
+      if (status < 0) {
+        chunk->failed = 1;
+        break;
+      }
+      if (status == 0) {
+        chunk->rejected++;
+      } else {
+        if (chunk->count == chunk->capacity) {
+          size_t cap = chunk->capacity ? chunk->capacity * 2 : 1024;
+          Tuple **tuples = realloc(chunk->tuples, cap * sizeof(Tuple *));
+          if (!tuples) {
+            tuple_destroy(t);
+            chunk->failed = 1;
+            break;
+          }
+          chunk->tuples = tuples;
+          chunk->capacity = cap;
+        }
+        chunk->tuples[chunk->count++] = t;
+      }
+    }
+    p = next;
+  }
+  free(fields);
+  return NULL;
+}
+
+// Release the tuples of a chunk that were not delivered
+static void chunk_release(LoaderChunk *chunk, size_t from) {
+  for (size_t i = from; i < chunk->count; i++)
+    tuple_destroy(chunk->tuples[i]);
+  free(chunk->tuples);
+  chunk->tuples = NULL;
+  chunk->count = chunk->capacity = 0;
+}
+
+// Advance to the start of the line following p (or to end)
+static const char *next_line(const char *p, const char *end) {
+  if (p >= end)
+    return end;
+  const char *nl = memchr(p, '\n', (size_t)(end - p));
+  return nl ? nl + 1 : end;
+}
+
+// Parse one window with up to `threads` workers and deliver its tuples in order
+static int load_window(const LoaderHeading *h, const char *begin, const char *end,
+                       unsigned threads, size_t batch, LoaderBatchFn sink, void *userdata,
+                       LoaderStats *stats) {
+  size_t span = (size_t)(end - begin);
+  size_t workers = span / LOADER_MIN_CHUNK + 1;
+  if (workers > threads)
+    workers = threads;
+
+  LoaderChunk chunks[LOADER_MAX_THREADS];
+  const char *p = begin;
+  for (size_t i = 0; i < workers; i++) {
+    const char *stop = i + 1 == workers ? end : next_line(begin + span * (i + 1) / workers, end);
+    if (stop < p)
+      stop = p;
+    chunks[i] = (LoaderChunk){.heading = h, .begin = p, .end = stop};
+    p = stop;
+  }
+
+  // The calling thread parses the first chunk itself
+  pthread_t tids[LOADER_MAX_THREADS];
+  int started[LOADER_MAX_THREADS] = {0};
+  for (size_t i = 1; i < workers; i++)
+    started[i] = pthread_create(&tids[i], NULL, parse_chunk, &chunks[i]) == 0;
+  parse_chunk(&chunks[0]);
+  for (size_t i = 1; i < workers; i++) {
+    if (started[i])
+      pthread_join(tids[i], NULL);
+    else
+      parse_chunk(&chunks[i]);
+  }
+
+  int status = 0;
+  for (size_t i = 0; i < workers; i++) {
+    LoaderChunk *chunk = &chunks[i];
+    stats->rejected += chunk->rejected;
+    if (chunk->failed)
+      status = -1;
+    size_t delivered = 0;
+    while (status == 0 && delivered < chunk->count) {
+      size_t n = chunk->count - delivered < batch ? chunk->count - delivered : batch;
+      int result = sink(chunk->tuples + delivered, n, userdata);
+      delivered += n;
+      if (result < 0)
+        status = -1;
+      else
+        stats->rows += n;
+    }
+    chunk_release(chunk, delivered);
+  }
+  return status;
+}
+
+int loader_load(const char *path, const LoaderOptions *options, LoaderBatchFn sink, void *userdata,
+                LoaderStats *stats) {
+  LoaderStats local = {0};
+  if (!stats)
+    stats = &local;
+  *stats = (LoaderStats){0};
+
+  LoaderOptions opts = options ? *options : (LoaderOptions){0};
+  if (!opts.delimiter) {
+    size_t n = strlen(path);
+    opts.delimiter = n >= 4 && strcmp(path + n - 4, ".tsv") == 0 ? '\t' : ',';
+  }
+  if (!opts.threads) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    opts.threads = cpus > 0 ? (unsigned)cpus : 1;
+  }
+  if (opts.threads > LOADER_MAX_THREADS)
+    opts.threads = LOADER_MAX_THREADS;
+  if (!opts.batch_rows)
+    opts.batch_rows = LOADER_DEFAULT_BATCH;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    log_error("loader", "cannot open %s: %s", path, strerror(errno));
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size == 0) {
+    log_error("loader", "%s is empty or unreadable", path);
+    close(fd);
+    return -1;
+  }
+  size_t size = (size_t)st.st_size;
+  char *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    log_error("loader", "cannot map %s: %s", path, strerror(errno));
+    return -1;
+  }
+  madvise(base, size, MADV_SEQUENTIAL);
+
+  const char *end = base + size;
+  const char *body;
+  const char *heading_end = line_end(base, end, &body);
+
+  LoaderHeading heading = {.columns = NULL, .count = 0, .delimiter = opts.delimiter};
+  int status = heading_parse(&heading, base, heading_end);
+  if (status < 0)
+    log_error("loader", "%s has an invalid heading", path);
+  else
+    status = heading_infer(&heading, body, end);
+  stats->columns = heading.count;
+
+  long page = sysconf(_SC_PAGESIZE);
+  const char *p = body;
+  while (status == 0 && p < end) {
+    const char *stop =
+        (size_t)(end - p) <= LOADER_WINDOW ? end : next_line(p + LOADER_WINDOW, end);
+    status = load_window(&heading, p, stop, opts.threads, opts.batch_rows, sink, userdata, stats);
+
+    // Pages behind the window are never read again
+    size_t done = (size_t)(stop - base) / (size_t)page * (size_t)page;
+    if (done)
+      madvise(base, done, MADV_DONTNEED);
+    p = stop;
+  }
+
+  heading_free(&heading);
+  munmap(base, size);
+  return status;
+}
+
+// Sink that links batches straight into a relation
+static int relation_sink(Tuple *const *tuples, size_t count, void *userdata) {
+  if (relation_add_tuples((Relation *)userdata, tuples, count) == 0)
+    return 0;
+  for (size_t i = 0; i < count; i++)
+    tuple_destroy(tuples[i]);
+  return -1;
+}
+
+long loader_load_relation(const char *path, const LoaderOptions *options, Relation *r,
+                          LoaderStats *stats) {
+  LoaderStats local;
+  if (!stats)
+    stats = &local;
+  if (loader_load(path, options, relation_sink, r, stats) < 0)
+    return -1;
+  return (long)stats->rows;
+}
+
+typedef struct {
+  Schema *schema;
+  Relation *relation;
+} SchemaSinkContext;
+
+// Sink that inserts batches through the schema so they reach the WAL
+static int schema_sink(Tuple *const *tuples, size_t count, void *userdata) {
+  SchemaSinkContext *ctx = (SchemaSinkContext *)userdata;
+  if (schema_insert_tuples(ctx->schema, ctx->relation, tuples, count) == 0)
+    return 0;
+  for (size_t i = 0; i < count; i++)
+    tuple_destroy(tuples[i]);
+  return -1;
+}
+
+char *loader_resolve_path(const char *dir, const char *path) {
+  if (path[0] == '/' || path[0] == '\0')
+    return NULL;
+  char *root = realpath(dir, NULL);
+  if (!root)
+    return NULL;
+  size_t root_len = strlen(root);
+  size_t path_len = strlen(path);
+  char *joined = malloc(root_len + path_len + 2);
+  char *resolved = NULL;
+  if (joined) {
+    memcpy(joined, root, root_len);
+    joined[root_len] = '/';
+    memcpy(joined + root_len + 1, path, path_len + 1);
+    resolved = realpath(joined, NULL);
+  }
+  // Require a separator after the root so that /data does not admit /data2
+  if (resolved && (strncmp(resolved, root, root_len) != 0 ||
+                   (resolved[root_len] != '/' && !(root_len == 1 && root[0] == '/')))) {
+    free(resolved);
+    resolved = NULL;
+  }
+  free(joined);
+  free(root);
+  return resolved;
+}
+
+int loader_load_into(Schema *schema, const char *relation, const char *path,
+                     const LoaderOptions *options, LoaderStats *stats) {
+  SchemaSinkContext ctx = {.schema = schema, .relation = schema_find_relation(schema, relation)};
+  if (!ctx.relation && schema_create_relation(schema, relation, &ctx.relation) != 1)
+    return -1;
+  return loader_load(path, options, schema_sink, &ctx, stats);
+}
@@ -0,0 +1,222 @@
+/**
+ * @file log.c
+ * @brief Asynchronous logger: bounded lock-free MPSC ring plus a writer thread.
+ *
+ * The ring follows the sequence-number design of Vyukov's bounded queue:
+ * each slot carries a sequence that tells producers when it is free and the
+ * consumer when it is full, so neither side ever takes a lock.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "log.h"
+
+#define LOG_RING_SIZE 4096 // must be a power of two
+#define LOG_INLINE_MESSAGE 256
+
+typedef struct {
+  atomic_size_t sequence;
+  LogLevel level;
+  struct timespec time;
+  const char *component;
+  char *message; // heap allocated, freed by the writer
+} LogSlot;
+
+static LogSlot ring[LOG_RING_SIZE];
+static atomic_size_t enqueue_pos;
+static size_t dequeue_pos; // only touched by the writer thread
+
+static atomic_int current_level = LOG_LEVEL_INFO;
+static atomic_uint sample_rate = 1;
+static atomic_ulong dropped;
+static atomic_int running;
+static atomic_int stopping;
+static pthread_t writer;
+static FILE *sink;
+
+static const char *level_names[] = {"error", "warn", "info", "debug"};
+
+void log_set_level(LogLevel level) { atomic_store(&current_level, level); }
+
+int log_enabled(LogLevel level) {
+  return (int)level <= atomic_load_explicit(&current_level, memory_order_relaxed);
+}
+
+unsigned long log_dropped(void) { return atomic_load(&dropped); }
+
+int log_sample(atomic_ulong *counter) {
+  unsigned rate = atomic_load_explicit(&sample_rate, memory_order_relaxed);
+  if (rate <= 1)
+    return 1;
+  return atomic_fetch_add_explicit(counter, 1, memory_order_relaxed) % rate == 0;
+}
+
+// Write one formatted record line to the sink
+static void emit(FILE *out, LogLevel level, const struct timespec *ts, const char *component,
+                 const char *message) {
+  struct tm tm;
+  char stamp[32];
+  gmtime_r(&ts->tv_sec, &tm);
+  strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+  fprintf(out, "ts=%s.%03ldZ level=%s component=%s msg=\"%s\"\n", stamp, ts->tv_nsec / 1000000,
+          level_names[level], component, message);
+}
+
+// Try to claim a slot and publish a record; returns 0 if the ring is full
+static int ring_push(LogLevel level, const struct timespec *ts, const char *component,
+                     char *message) {
+  size_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+  for (;;) {
+    LogSlot *slot = &ring[pos & (LOG_RING_SIZE - 1)];
+    size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if (seq == pos) {
+      if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        slot->level = level;
+        slot->time = *ts;
+        slot->component = component;
+        slot->message = message;
+        atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+        return 1;
+      }
+    } else if (seq < pos) {
+      return 0; // full
+    } else {
+      pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    }
+  }
+}
+
+// Pop one record if available (writer thread only)
+static int ring_pop(LogSlot *out) {
+  LogSlot *slot = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+  size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+  if (seq != dequeue_pos + 1)
+    return 0;
+  out->level = slot->level;
+  out->time = slot->time;
+  out->component = slot->component;
+  out->message = slot->message;
+  atomic_store_explicit(&slot->sequence, dequeue_pos + LOG_RING_SIZE, memory_order_release);
+  dequeue_pos++;
+  return 1;
+}
+
+// Drain the ring, writing every pending record; returns the number written
+static size_t drain(void) {
+  LogSlot record;
+  size_t written = 0;
+  while (ring_pop(&record)) {
+    emit(sink, record.level, &record.time, record.component, record.message);
+    free(record.message);
+    written++;
+  }
+  if (written)
+    fflush(sink);
+  return written;
+}
+
+static void *writer_main(void *arg) {
+  (void)arg;
+  const struct timespec idle = {.tv_sec = 0, .tv_nsec = 2000000};
+  while (!atomic_load(&stopping)) {
+    if (drain() == 0)
+      nanosleep(&idle, NULL);
+  }
+  drain();
+  return NULL;
+}
+
+int log_init(LogLevel level, unsigned sample_every) {
+  if (atomic_load(&running))
+    return 0;
+  for (size_t i = 0; i < LOG_RING_SIZE; i++)
+    atomic_store(&ring[i].sequence, i);
+  atomic_store(&enqueue_pos, 0);
+  dequeue_pos = 0;
+  sink = stderr;
+  log_set_level(level);
+  atomic_store(&sample_rate, sample_every ? sample_every : 1);
+  atomic_store(&stopping, 0);
+  if (pthread_create(&writer, NULL, writer_main, NULL) != 0)
+    return -1;
+  atomic_store(&running, 1);
+  return 0;
+}
+
+int log_init_from_env(void) {
+  LogLevel level = LOG_LEVEL_INFO;
+  const char *env = getenv("ALGEBRA_LOG_LEVEL");
+  if (env) {
+    for (int i = LOG_LEVEL_ERROR; i <= LOG_LEVEL_DEBUG; i++) {
+      if (strcmp(env, level_names[i]) == 0)
+        level = (LogLevel)i;
+    }
+  }
+  const char *sample = getenv("ALGEBRA_LOG_SAMPLE");
+  unsigned rate = sample ? (unsigned)strtoul(sample, NULL, 10) : 1;
+  return log_init(level, rate);
+}
+
+void log_shutdown(void) {
+  if (!atomic_load(&running))
+    return;
+  atomic_store(&stopping, 1);
+  pthread_join(writer, NULL);
+  atomic_store(&running, 0);
+}
+
+void log_vwrite(LogLevel level, const char *component, const char *fmt, va_list args) {
+  if (!log_enabled(level))
+    return;
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  char inline_buf[LOG_INLINE_MESSAGE];
+  va_list copy;
+  va_copy(copy, args);
+  int len = vsnprintf(inline_buf, sizeof(inline_buf), fmt, copy);
+  va_end(copy);
+  if (len < 0)
+    return;
+
+  if (!atomic_load_explicit(&running, memory_order_acquire)) {
+    if ((size_t)len < sizeof(inline_buf)) {
+      emit(stderr, level, &ts, component, inline_buf);
+    } else {
+      char *message = malloc((size_t)len + 1);
+      if (!message)
+        return;
+      vsnprintf(message, (size_t)len + 1, fmt, args);
+      emit(stderr, level, &ts, component, message);
+      free(message);
+    }
+    return;
+  }
+
+  char *message = malloc((size_t)len + 1);
+  if (!message) {
+    atomic_fetch_add(&dropped, 1);
+    return;
+  }
+  if ((size_t)len < sizeof(inline_buf))
+    memcpy(message, inline_buf, (size_t)len + 1);
+  else
+    vsnprintf(message, (size_t)len + 1, fmt, args);
+
+  if (!ring_push(level, &ts, component, message)) {
+    free(message);
+    atomic_fetch_add(&dropped, 1);
+  }
+}
+
+void log_write(LogLevel level, const char *component, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  log_vwrite(level, component, fmt, args);
+  va_end(args);
+}
@@ -477,8 +477,83 @@ void arithmetic_relations_example(void) {
   infinite_relation_destroy(div);
 }
 
+#include <time.h>
+
+#include "loader.h"
+#include "log.h"
+#include "schema.h"
+#include "wal.h"
 #include "xml_server.h"
 
+/**
+ * @brief Bulk load a delimited file without starting the server.
+ *
+ * algebra-engine load [--wal PATH] [--snapshot PATH] [--delimiter C] [--threads N]
+ *                     RELATION FILE
+ *
+ * The schema is restored from the snapshot and WAL first. With a snapshot the
+ * result is checkpointed into it; otherwise it is committed to the WAL.
+ *
+ * @return int Exit status code (0 for success).
+ */
+static int load_main(int argc, char *argv[]) {
+  const char *wal_path = getenv("ALGEBRA_WAL");
+  const char *snapshot_path = getenv("ALGEBRA_SNAPSHOT");
+  const char *relation = NULL, *file = NULL;
+  LoaderOptions options = {.delimiter = 0, .threads = 0, .batch_rows = 0};
+
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--wal") == 0 && i + 1 < argc) {
+      wal_path = argv[++i];
+    } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+      snapshot_path = argv[++i];
+    } else if (strcmp(argv[i], "--delimiter") == 0 && i + 1 < argc) {
+      const char *d = argv[++i];
+      options.delimiter = strcmp(d, "\\t") == 0 ? '\t' : d[0];
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      options.threads = (unsigned)atoi(argv[++i]);
+    } else if (!relation) {
+      relation = argv[i];
+    } else {
+      file = argv[i];
+    }
+  }
+  if (!relation || !file) {
+    fprintf(stderr, "usage: %s load [--wal PATH] [--snapshot PATH] [--delimiter C] "
+                    "[--threads N] RELATION FILE\n",
+            argv[0]);
+    return 2;
+  }
+
+  Schema *schema = schema_open(snapshot_path, wal_path);
+  if (!schema)
+    return 1;
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  LoaderStats stats;
+  int status = loader_load_into(schema, relation, file, &options, &stats);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  if (status == 0) {
+    printf("Loaded %lu tuples into %s (%lu rejected, %zu attributes) in %.3fs\n",
+           (unsigned long)stats.rows, relation, (unsigned long)stats.rejected, stats.columns,
+           seconds);
+    if (snapshot_path)
+      status = schema_checkpoint(schema);
+    else if (schema->wal)
+      status = schema_commit(schema);
+    if (status < 0)
+      fprintf(stderr, "Failed to persist %s\n", relation);
+  } else {
+    fprintf(stderr, "Failed to load %s\n", file);
+  }
+
+  schema_destroy(schema);
+  return status == 0 ? 0 : 1;
+}
+
 /**
  * @brief Entry point for the relational algebra engine demo.
  *
@@ -505,11 +580,33 @@ int main(int argc, char *argv[]) {
   arithmetic_relations_example();
   */
 // Example main function
-  int port = 8080;
+  if (argc > 1 && strcmp(argv[1], "load") == 0) {
+    log_init_from_env();
+    int status = load_main(argc, argv);
+    log_shutdown();
+    return status;
+  }
 
-  /* if (argc > 1) { */
-    /* port = atoi(argv[1]); */
-  /* } */
+  ServerOptions options = {.port = 8080,
+                           .wal_path = getenv("ALGEBRA_WAL"),
+                           .snapshot_path = getenv("ALGEBRA_SNAPSHOT"),
+                           .load_dir = getenv("ALGEBRA_LOAD_DIR")};
+
+  // algebra-engine [--wal PATH] [--snapshot PATH] [--load-dir DIR] [PORT]
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--wal") == 0 && i + 1 < argc) {
+      options.wal_path = argv[++i];
+    } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+      options.snapshot_path = argv[++i];
+    } else if (strcmp(argv[i], "--load-dir") == 0 && i + 1 < argc) {
+      options.load_dir = argv[++i];
+    } else {
+      options.port = atoi(argv[i]);
+    }
+  }
 
-  return start_xml_server(port);
+  log_init_from_env();
+  int status = start_server(&options);
+  log_shutdown();
+  return status;
 }
@@ -0,0 +1,291 @@
+/**
+ * @file metrics.c
+ * @brief Per-thread metric blocks, their registry and the text exposition.
+ */
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "metrics.h"
+
+_Thread_local MetricsBlock *metrics_thread_block;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static MetricsBlock *registry;
+static MetricsBlock retired; // totals of threads that exited
+static pthread_key_t exit_key;
+static pthread_once_t exit_key_once = PTHREAD_ONCE_INIT;
+
+static const char *command_names[METRIC_COMMAND_COUNT] = {
+    "CREATE_RELATION", "ADD_TUPLE",  "QUERY_RELATION", "LIST_RELATIONS", "EVALUATE",
+    "LOAD_RELATION",   "CHECKPOINT", "STATS",          "EXPLAIN_ANALYZE", "CREATE_INDEX",
+    "SELECT",          "OTHER"};
+
+static const struct {
+  const char *name;
+  const char *help;
+} counter_info[METRIC_COUNTER_COUNT] = {
+    {"algebra_set_adds_total", "set_add calls"},
+    {"algebra_tuples_created_total", "Tuples allocated"},
+    {"algebra_tuples_generated_total", "Tuples and batch rows produced by infinite generators"},
+    {"algebra_join_pairs_total", "Pairs tested by nested loop joins"},
+    {"algebra_join_matches_total", "Pairs kept by nested loop joins"},
+    {"algebra_infinite_join_attempts_total", "Pairs tested by infinite joins"},
+    {"algebra_infinite_join_matches_total", "Pairs kept by infinite joins"},
+};
+
+const char *metrics_command_name(MetricCommand command) {
+  return command < METRIC_COMMAND_COUNT ? command_names[command] : "OTHER";
+}
+
+uint64_t metrics_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t load(const atomic_uint_fast64_t *v) {
+  return atomic_load_explicit(v, memory_order_relaxed);
+}
+
+static void bump(atomic_uint_fast64_t *v, uint64_t n) {
+  atomic_store_explicit(v, load(v) + n, memory_order_relaxed);
+}
+
+// Add every value of `from` into `into`; the caller holds registry_lock
+static void block_accumulate(MetricsBlock *into, const MetricsBlock *from) {
+  for (size_t i = 0; i < METRIC_COUNTER_COUNT; i++)
+    bump(&into->counters[i], load(&from->counters[i]));
+  for (size_t c = 0; c < METRIC_COMMAND_COUNT; c++) {
+    const MetricsHistogram *h = &from->commands[c];
+    MetricsHistogram *t = &into->commands[c];
+    if (load(&h->count) == 0)
+      continue;
+    bump(&t->count, load(&h->count));
+    bump(&t->errors, load(&h->errors));
+    bump(&t->sum_ns, load(&h->sum_ns));
+    for (size_t k = 0; k < METRICS_HISTOGRAM_BUCKETS; k++)
+      bump(&t->buckets[k], load(&h->buckets[k]));
+  }
+}
+
+// Thread exit: keep the block's counts and drop it from the registry
+static void retire_block(void *arg) {
+  MetricsBlock *b = (MetricsBlock *)arg;
+  pthread_mutex_lock(&registry_lock);
+  block_accumulate(&retired, b);
+  for (MetricsBlock **p = &registry; *p; p = &(*p)->next) {
+    if (*p == b) {
+      *p = b->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&registry_lock);
+  free(b);
+}
+
+static void create_exit_key(void) { pthread_key_create(&exit_key, retire_block); }
+
+MetricsBlock *metrics_register_thread(void) {
+  MetricsBlock *b = calloc(1, sizeof(MetricsBlock));
+  if (!b)
+    return NULL;
+  pthread_once(&exit_key_once, create_exit_key);
+  pthread_setspecific(exit_key, b);
+  pthread_mutex_lock(&registry_lock);
+  b->next = registry;
+  registry = b;
+  pthread_mutex_unlock(&registry_lock);
+  metrics_thread_block = b;
+  return b;
+}
+
+static size_t bucket_index(uint64_t v) {
+  if (v < (1u << METRICS_HISTOGRAM_SUB_BITS))
+    return (size_t)v;
+  unsigned e = 63u - (unsigned)__builtin_clzll(v);
+  unsigned shift = e - METRICS_HISTOGRAM_SUB_BITS;
+  size_t sub = (size_t)(v >> shift) & ((1u << METRICS_HISTOGRAM_SUB_BITS) - 1);
+  return ((size_t)(shift + 1) << METRICS_HISTOGRAM_SUB_BITS) + sub;
+}
+
+// Largest value that falls in bucket `index`
+static uint64_t bucket_upper(size_t index) {
+  size_t group = index >> METRICS_HISTOGRAM_SUB_BITS;
+  if (group == 0)
+    return index;
+  uint64_t sub = index & ((1u << METRICS_HISTOGRAM_SUB_BITS) - 1);
+  unsigned shift = (unsigned)group - 1;
+  uint64_t low = ((1ull << METRICS_HISTOGRAM_SUB_BITS) + sub) << shift;
+  return low + ((1ull << shift) - 1);
+}
+
+void metrics_block_observe(MetricsBlock *b, MetricCommand command, uint64_t ns, int failed) {
+  if (!b)
+    return;
+  if (command >= METRIC_COMMAND_COUNT)
+    command = METRIC_COMMAND_OTHER;
+  MetricsHistogram *h = &b->commands[command];
+  bump(&h->count, 1);
+  if (failed)
+    bump(&h->errors, 1);
+  bump(&h->sum_ns, ns);
+  bump(&h->buckets[bucket_index(ns)], 1);
+}
+
+// Smallest bucket bound below which `q` of the samples fall
+static uint64_t histogram_quantile(const MetricsHistogram *h, uint64_t count, double q) {
+  uint64_t rank = (uint64_t)(q * (double)count + 0.5);
+  if (rank == 0)
+    rank = 1;
+  uint64_t seen = 0;
+  for (size_t k = 0; k < METRICS_HISTOGRAM_BUCKETS; k++) {
+    seen += load(&h->buckets[k]);
+    if (seen >= rank)
+      return bucket_upper(k);
+  }
+  return 0;
+}
+
+void metrics_snapshot(MetricsSnapshot *out) {
+  MetricsBlock *total = calloc(1, sizeof(MetricsBlock));
+  memset(out, 0, sizeof(MetricsSnapshot));
+  if (!total)
+    return;
+  pthread_mutex_lock(&registry_lock);
+  block_accumulate(total, &retired);
+  for (MetricsBlock *b = registry; b; b = b->next)
+    block_accumulate(total, b);
+  pthread_mutex_unlock(&registry_lock);
+
+  for (size_t i = 0; i < METRIC_COUNTER_COUNT; i++)
+    out->counters[i] = load(&total->counters[i]);
+  for (size_t c = 0; c < METRIC_COMMAND_COUNT; c++) {
+    const MetricsHistogram *h = &total->commands[c];
+    uint64_t count = load(&h->count);
+    out->commands[c].count = count;
+    out->commands[c].errors = load(&h->errors);
+    out->commands[c].sum_ns = load(&h->sum_ns);
+    if (count == 0)
+      continue;
+    out->commands[c].p50_ns = histogram_quantile(h, count, 0.5);
+    out->commands[c].p90_ns = histogram_quantile(h, count, 0.9);
+    out->commands[c].p99_ns = histogram_quantile(h, count, 0.99);
+    out->commands[c].max_ns = histogram_quantile(h, count, 1.0);
+  }
+  free(total);
+}
+
+static void block_clear(MetricsBlock *b) {
+  for (size_t i = 0; i < METRIC_COUNTER_COUNT; i++)
+    atomic_store_explicit(&b->counters[i], 0, memory_order_relaxed);
+  for (size_t c = 0; c < METRIC_COMMAND_COUNT; c++) {
+    MetricsHistogram *h = &b->commands[c];
+    atomic_store_explicit(&h->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&h->errors, 0, memory_order_relaxed);
+    atomic_store_explicit(&h->sum_ns, 0, memory_order_relaxed);
+    for (size_t k = 0; k < METRICS_HISTOGRAM_BUCKETS; k++)
+      atomic_store_explicit(&h->buckets[k], 0, memory_order_relaxed);
+  }
+}
+
+void metrics_reset(void) {
+  pthread_mutex_lock(&registry_lock);
+  block_clear(&retired);
+  for (MetricsBlock *b = registry; b; b = b->next)
+    block_clear(b);
+  pthread_mutex_unlock(&registry_lock);
+}
+
+typedef struct {
+  char *data;
+  size_t size;
+  size_t capacity;
+  int failed;
+} TextBuffer;
+
+static void text_printf(TextBuffer *t, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void text_printf(TextBuffer *t, const char *fmt, ...) {
+  if (t->failed)
+    return;
+  for (;;) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(t->data + t->size, t->capacity - t->size, fmt, args);
+    va_end(args);
+    if (n < 0) {
+      t->failed = 1;
+      return;
+    }
+    if ((size_t)n < t->capacity - t->size) {
+      t->size += (size_t)n;
+      return;
+    }
+    size_t cap = t->capacity * 2 > t->size + (size_t)n + 1 ? t->capacity * 2
+                                                           : t->size + (size_t)n + 1;
+    char *grown = realloc(t->data, cap);
+    if (!grown) {
+      t->failed = 1;
+      return;
+    }
+    t->data = grown;
+    t->capacity = cap;
+  }
+}
+
+char *metrics_to_text(void) {
+  MetricsSnapshot s;
+  metrics_snapshot(&s);
+  TextBuffer t = {.data = malloc(4096), .size = 0, .capacity = 4096, .failed = 0};
+  if (!t.data)
+    return NULL;
+  t.data[0] = '\0';
+
+  for (size_t i = 0; i < METRIC_COUNTER_COUNT; i++) {
+    text_printf(&t, "# HELP %s %s.\n# TYPE %s counter\n%s %llu\n", counter_info[i].name,
+                counter_info[i].help, counter_info[i].name, counter_info[i].name,
+                (unsigned long long)s.counters[i]);
+  }
+
+  text_printf(&t, "# HELP algebra_requests_total Server requests by command.\n"
+                  "# TYPE algebra_requests_total counter\n");
+  for (size_t c = 0; c < METRIC_COMMAND_COUNT; c++)
+    text_printf(&t, "algebra_requests_total{command=\"%s\"} %llu\n", command_names[c],
+                (unsigned long long)s.commands[c].count);
+  text_printf(&t, "# HELP algebra_request_errors_total Server requests answered with an error.\n"
+                  "# TYPE algebra_request_errors_total counter\n");
+  for (size_t c = 0; c < METRIC_COMMAND_COUNT; c++)
+    text_printf(&t, "algebra_request_errors_total{command=\"%s\"} %llu\n", command_names[c],
+                (unsigned long long)s.commands[c].errors);
+
+  text_printf(&t, "# HELP algebra_request_duration_seconds Time to execute a request.\n"
+                  "# TYPE algebra_request_duration_seconds summary\n");
+  for (size_t c = 0; c < METRIC_COMMAND_COUNT; c++) {
+    if (s.commands[c].count == 0)
+      continue;
+    const struct {
+      const char *label;
+      uint64_t ns;
+    } quantiles[] = {{"0.5", s.commands[c].p50_ns},
+                     {"0.9", s.commands[c].p90_ns},
+                     {"0.99", s.commands[c].p99_ns},
+                     {"1", s.commands[c].max_ns}};
+    for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++)
+      text_printf(&t, "algebra_request_duration_seconds{command=\"%s\",quantile=\"%s\"} %.9f\n",
+                  command_names[c], quantiles[q].label, (double)quantiles[q].ns / 1e9);
+    text_printf(&t, "algebra_request_duration_seconds_sum{command=\"%s\"} %.9f\n",
+                command_names[c], (double)s.commands[c].sum_ns / 1e9);
+    text_printf(&t, "algebra_request_duration_seconds_count{command=\"%s\"} %llu\n",
+                command_names[c], (unsigned long long)s.commands[c].count);
+  }
+
+  if (t.failed) {
+    free(t.data);
+    return NULL;
+  }
+  return t.data;
+}
@@ -0,0 +1,1399 @@
+/**
+ * @file operator.c
+ * @brief Pull-based query operators.
+ *
+ * Each operator keeps its own state behind the generic Operator handle and
+ * implements the OperatorVTable. Opening and closing recurse into the
+ * inputs before the operator's own hook runs, so an operator's open may
+ * already pull from its inputs (as the buffering operators do).
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hash_map.h"
+#include "metrics.h"
+#include "operator.h"
+
+#define COLLECT_BATCH 1024
+
+// Allocate an operator with zeroed state; takes ownership of the inputs
+static Operator *operator_new(const OperatorVTable *vtable, size_t state_size, Operator *left,
+                              Operator *right, int arity) {
+  Operator *op = malloc(sizeof(Operator));
+  void *state = calloc(1, state_size);
+  if (!op || !state || (arity >= 1 && !left) || (arity >= 2 && !right)) {
+    free(op);
+    free(state);
+    operator_destroy(left);
+    operator_destroy(right);
+    return NULL;
+  }
+  op->vtable = vtable;
+  op->state = state;
+  op->left = left;
+  op->right = right;
+  op->profile = NULL;
+  op->failed = 0;
+  return op;
+}
+
+/* Profiling */
+
+// Clock and counter readings at the start of a profiled call
+typedef struct {
+  uint64_t wall_ns;
+  uint64_t cpu_ns;
+  uint64_t tuples_created;
+  uint64_t set_adds;
+} ProfileMark;
+
+static uint64_t clock_ns(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void profile_start(ProfileMark *m) {
+  m->tuples_created = metrics_thread_counter(METRIC_TUPLES_CREATED);
+  m->set_adds = metrics_thread_counter(METRIC_SET_ADDS);
+  m->cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+  m->wall_ns = clock_ns(CLOCK_MONOTONIC);
+}
+
+static void profile_stop(OperatorProfile *p, const ProfileMark *m) {
+  p->wall_ns += clock_ns(CLOCK_MONOTONIC) - m->wall_ns;
+  p->cpu_ns += clock_ns(CLOCK_THREAD_CPUTIME_ID) - m->cpu_ns;
+  p->tuples_created += metrics_thread_counter(METRIC_TUPLES_CREATED) - m->tuples_created;
+  p->set_adds += metrics_thread_counter(METRIC_SET_ADDS) - m->set_adds;
+}
+
+int operator_profile_enable(Operator *op) {
+  if (!op)
+    return 0;
+  if (!op->profile && !(op->profile = calloc(1, sizeof(OperatorProfile))))
+    return -1;
+  if (operator_profile_enable(op->left) < 0 || operator_profile_enable(op->right) < 0)
+    return -1;
+  return 0;
+}
+
+const OperatorProfile *operator_profile(const Operator *op) { return op ? op->profile : NULL; }
+
+// Count one predicate evaluation or hash probe of a profiled operator
+static void profile_predicate(Operator *op) {
+  if (op->profile)
+    op->profile->predicate_calls++;
+}
+
+/* Execution */
+
+static int open_unprofiled(Operator *op) {
+  op->failed = 0;
+  if (op->left && operator_open(op->left) < 0)
+    return -1;
+  if (op->right && operator_open(op->right) < 0)
+    return -1;
+  return op->vtable->open ? op->vtable->open(op) : 0;
+}
+
+int operator_open(Operator *op) {
+  if (!op->profile)
+    return open_unprofiled(op);
+  ProfileMark m;
+  profile_start(&m);
+  int status = open_unprofiled(op);
+  op->profile->opens++;
+  profile_stop(op->profile, &m);
+  return status;
+}
+
+static Tuple *next_unprofiled(Operator *op) {
+  Tuple *t = op->vtable->next(op);
+  // An input that failed (even while being drained by open) fails its reader
+  if (!t && ((op->left && op->left->failed) || (op->right && op->right->failed)))
+    op->failed = 1;
+  return t;
+}
+
+Tuple *operator_next(Operator *op) {
+  if (!op->profile)
+    return next_unprofiled(op);
+  ProfileMark m;
+  profile_start(&m);
+  Tuple *t = next_unprofiled(op);
+  if (t)
+    op->profile->rows_out++;
+  profile_stop(op->profile, &m);
+  return t;
+}
+
+Tuple *operator_fail(Operator *op) {
+  op->failed = 1;
+  return NULL;
+}
+
+static void close_unprofiled(Operator *op) {
+  if (op->vtable->close)
+    op->vtable->close(op);
+  if (op->left)
+    operator_close(op->left);
+  if (op->right)
+    operator_close(op->right);
+}
+
+void operator_close(Operator *op) {
+  if (!op->profile) {
+    close_unprofiled(op);
+    return;
+  }
+  ProfileMark m;
+  profile_start(&m);
+  close_unprofiled(op);
+  profile_stop(op->profile, &m);
+}
+
+void operator_destroy(Operator *op) {
+  if (!op)
+    return;
+  if (op->vtable->destroy)
+    op->vtable->destroy(op);
+  free(op->profile);
+  free(op->state);
+  operator_destroy(op->left);
+  operator_destroy(op->right);
+  free(op);
+}
+
+Relation *operator_collect(Operator *op, const char *name) {
+  Relation *result = relation_create(name);
+  if (!result)
+    return NULL;
+  if (operator_open(op) < 0) {
+    operator_close(op);
+    relation_destroy(result);
+    return NULL;
+  }
+
+  // Every tuple an operator produces is new, so batches skip membership checks
+  Tuple *batch[COLLECT_BATCH];
+  size_t count = 0;
+  int failed = 0;
+  Tuple *t;
+  while (!failed && (t = operator_next(op)) != NULL) {
+    batch[count++] = t;
+    if (count == COLLECT_BATCH) {
+      failed = relation_add_tuples(result, batch, count) < 0;
+      if (!failed)
+        count = 0;
+    }
+  }
+  // next also returns NULL on error, which must not pass for the end of the stream
+  if (!failed)
+    failed = op->failed || (count && relation_add_tuples(result, batch, count) < 0);
+  operator_close(op);
+
+  if (failed) {
+    for (size_t i = 0; i < count; i++)
+      tuple_destroy(batch[i]);
+    relation_destroy(result);
+    return NULL;
+  }
+  return result;
+}
+
+/* Profile reports */
+
+typedef struct {
+  char *data;
+  size_t len;
+  size_t capacity;
+  int error;
+} ReportBuffer;
+
+static void report_append(ReportBuffer *b, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void report_append(ReportBuffer *b, const char *fmt, ...) {
+  if (b->error)
+    return;
+  for (;;) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(b->data + b->len, b->capacity - b->len, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+      b->error = 1;
+      return;
+    }
+    if ((size_t)n < b->capacity - b->len) {
+      b->len += (size_t)n;
+      return;
+    }
+    size_t cap = (b->capacity + (size_t)n + 1) * 2;
+    char *data = realloc(b->data, cap);
+    if (!data) {
+      b->error = 1;
+      return;
+    }
+    b->data = data;
+    b->capacity = cap;
+  }
+}
+
+static void report_operator(ReportBuffer *b, const Operator *op, int depth) {
+  const OperatorProfile *p = op->profile;
+  uint64_t rows_in = 0, inputs_ns = 0;
+  for (const Operator *in = op->left; in; in = in == op->left ? op->right : NULL) {
+    rows_in += in->profile->rows_out;
+    inputs_ns += in->profile->wall_ns;
+  }
+  uint64_t self_ns = p->wall_ns > inputs_ns ? p->wall_ns - inputs_ns : 0;
+  report_append(b, "%*s%s%s%s rows_in=%llu rows_out=%llu loops=%llu", depth * 2, "",
+                op->vtable->name, p->label[0] ? " " : "", p->label, (unsigned long long)rows_in,
+                (unsigned long long)p->rows_out, (unsigned long long)p->opens);
+  report_append(b, " time=%.3fms self=%.3fms cpu=%.3fms tuples_created=%llu set_adds=%llu",
+                p->wall_ns / 1e6, self_ns / 1e6, p->cpu_ns / 1e6,
+                (unsigned long long)p->tuples_created, (unsigned long long)p->set_adds);
+  if (p->predicate_calls)
+    report_append(b, " predicate_calls=%llu", (unsigned long long)p->predicate_calls);
+  if (p->pairs_tested)
+    report_append(b, " pairs_tested=%llu pairs_per_row=%.1f", (unsigned long long)p->pairs_tested,
+                  p->rows_out ? (double)p->pairs_tested / p->rows_out : 0.0);
+  report_append(b, "\n");
+  if (op->left)
+    report_operator(b, op->left, depth + 1);
+  if (op->right)
+    report_operator(b, op->right, depth + 1);
+}
+
+char *operator_profile_report(const Operator *op) {
+  if (!op || !op->profile)
+    return NULL;
+  ReportBuffer b = {0};
+  report_operator(&b, op, 0);
+  if (b.error || !b.data) {
+    free(b.data);
+    return NULL;
+  }
+  return b.data;
+}
+
+/* Tuple sets used for duplicate elimination, keyed by value */
+
+static uint64_t tuple_key_hash(const void *key) { return tuple_hash((const Tuple *)key); }
+
+static int tuple_key_equals(const void *a, const void *b) {
+  return tuple_equals((Tuple *)a, (Tuple *)b);
+}
+
+static void tuple_key_free(void *key) { tuple_destroy((Tuple *)key); }
+
+static HashMap *tuple_set_create(void) {
+  return hash_map_create(tuple_key_hash, tuple_key_equals, tuple_key_free, NULL);
+}
+
+// Remember a copy of `t`; returns 1 if it was new, 0 if seen before, -1 on error
+static int tuple_set_insert(HashMap *set, const Tuple *t) {
+  if (hash_map_get(set, t))
+    return 0;
+  Tuple *copy = tuple_copy(t);
+  if (!copy)
+    return -1;
+  if (hash_map_put(set, copy, copy) < 0) {
+    tuple_destroy(copy);
+    return -1;
+  }
+  return 1;
+}
+
+// Pull from `input` until a tuple not yet in `seen` appears; errors fail `op`
+static Tuple *next_distinct(Operator *op, Operator *input, HashMap *seen) {
+  Tuple *t;
+  while ((t = operator_next(input)) != NULL) {
+    int status = tuple_set_insert(seen, t);
+    if (status == 1)
+      return t;
+    tuple_destroy(t);
+    if (status < 0)
+      return operator_fail(op);
+  }
+  return NULL;
+}
+
+/* Scan */
+
+typedef struct {
+  const Relation *relation;
+  SetIter it;
+} ScanState;
+
+static int scan_open(Operator *op) {
+  ScanState *s = (ScanState *)op->state;
+  set_iter_init(s->relation->tuples, &s->it);
+  return 0;
+}
+
+static Tuple *scan_next(Operator *op) {
+  ScanState *s = (ScanState *)op->state;
+  Tuple *t = set_iter_next(&s->it);
+  Tuple *copy = t ? tuple_copy(t) : NULL;
+  return t && !copy ? operator_fail(op) : copy;
+}
+
+static const OperatorVTable scan_vtable = {"Scan", scan_open, scan_next, NULL, NULL};
+
+Operator *operator_scan(const Relation *r) {
+  if (!r)
+    return NULL;
+  Operator *op = operator_new(&scan_vtable, sizeof(ScanState), NULL, NULL, 0);
+  if (op)
+    ((ScanState *)op->state)->relation = r;
+  return op;
+}
+
+/* Generator scan */
+
+typedef struct {
+  InfiniteRelation *relation;
+  InfiniteRelationIterator *it;
+  size_t attempts_at_open; // join progress when opened, for profiling
+} GeneratorScanState;
+
+static int generator_scan_open(Operator *op) {
+  GeneratorScanState *s = (GeneratorScanState *)op->state;
+  size_t matches;
+  if (op->profile &&
+      infinite_relation_join_progress(s->relation, &s->attempts_at_open, &matches) < 0)
+    s->attempts_at_open = 0;
+  s->it = infinite_relation_iterator_create(s->relation);
+  return s->it ? 0 : -1;
+}
+
+static Tuple *generator_scan_next(Operator *op) {
+  GeneratorScanState *s = (GeneratorScanState *)op->state;
+  return infinite_relation_iterator_next(s->it);
+}
+
+static void generator_scan_close(Operator *op) {
+  GeneratorScanState *s = (GeneratorScanState *)op->state;
+  size_t attempts, matches;
+  if (op->profile && infinite_relation_join_progress(s->relation, &attempts, &matches) == 0)
+    op->profile->pairs_tested += attempts - s->attempts_at_open;
+  infinite_relation_iterator_destroy(s->it);
+  s->it = NULL;
+}
+
+static const OperatorVTable generator_scan_vtable = {
+    "GeneratorScan", generator_scan_open, generator_scan_next, generator_scan_close, NULL};
+
+Operator *operator_generator_scan(InfiniteRelation *r) {
+  if (!r)
+    return NULL;
+  Operator *op = operator_new(&generator_scan_vtable, sizeof(GeneratorScanState), NULL, NULL, 0);
+  if (op)
+    ((GeneratorScanState *)op->state)->relation = r;
+  return op;
+}
+
+/* Index scan */
+
+typedef struct {
+  const RelationIndex *index;
+  CompareOp op;
+  Tuple *probe; // holds the constant under the indexed attribute's name
+  IndexCursor cursor;
+} IndexScanState;
+
+static int index_scan_open(Operator *op) {
+  IndexScanState *s = (IndexScanState *)op->state;
+  profile_predicate(op);
+  return index_lookup(s->index, s->probe, s->op, &s->cursor);
+}
+
+static Tuple *index_scan_next(Operator *op) {
+  IndexScanState *s = (IndexScanState *)op->state;
+  Tuple *t = index_cursor_next(&s->cursor);
+  Tuple *copy = t ? tuple_copy(t) : NULL;
+  return t && !copy ? operator_fail(op) : copy;
+}
+
+static void index_scan_destroy(Operator *op) {
+  tuple_destroy(((IndexScanState *)op->state)->probe);
+}
+
+static const OperatorVTable index_scan_vtable = {"IndexScan", index_scan_open, index_scan_next,
+                                                 NULL, index_scan_destroy};
+
+Operator *operator_index_scan(const Relation *r, const RelationIndex *index, const char *attr,
+                              CompareOp op, const Attribute *constant) {
+  if (!r || !index || !constant)
+    return NULL;
+  Operator *scan = operator_new(&index_scan_vtable, sizeof(IndexScanState), NULL, NULL, 0);
+  if (!scan)
+    return NULL;
+  IndexScanState *s = (IndexScanState *)scan->state;
+  s->index = index;
+  s->op = op;
+  Attribute *value = attribute_copy(constant);
+  char *name = strdup(attr);
+  s->probe = tuple_create();
+  if (!value || !name || !s->probe) {
+    attribute_destroy(value);
+    free(name);
+    operator_destroy(scan);
+    return NULL;
+  }
+  free(value->name);
+  value->name = name;
+  tuple_add_attribute(s->probe, value);
+  return scan;
+}
+
+/* Select */
+
+typedef struct {
+  TuplePredicateFn predicate;
+  void *userdata;
+} SelectState;
+
+static Tuple *select_next(Operator *op) {
+  SelectState *s = (SelectState *)op->state;
+  Tuple *t;
+  while ((t = operator_next(op->left)) != NULL) {
+    profile_predicate(op);
+    if (s->predicate(t, s->userdata))
+      return t;
+    tuple_destroy(t);
+  }
+  return NULL;
+}
+
+static const OperatorVTable select_vtable = {"Select", NULL, select_next, NULL, NULL};
+
+Operator *operator_select(Operator *child, TuplePredicateFn predicate, void *userdata) {
+  Operator *op = operator_new(&select_vtable, sizeof(SelectState), child, NULL, 1);
+  if (op) {
+    SelectState *s = (SelectState *)op->state;
+    s->predicate = predicate;
+    s->userdata = userdata;
+  }
+  return op;
+}
+
+/* Project */
+
+typedef struct {
+  char **names;
+  size_t count;
+  HashMap *seen;
+} ProjectState;
+
+static int project_open(Operator *op) {
+  ProjectState *s = (ProjectState *)op->state;
+  s->seen = tuple_set_create();
+  return s->seen ? 0 : -1;
+}
+
+static Tuple *project_next(Operator *op) {
+  ProjectState *s = (ProjectState *)op->state;
+  Tuple *t;
+  while ((t = operator_next(op->left)) != NULL) {
+    Tuple *projected = tuple_create();
+    int failed = !projected;
+    for (size_t i = 0; !failed && i < s->count; i++) {
+      Attribute *attr = tuple_find_attribute(t, s->names[i]);
+      Attribute *copy = attr ? attribute_copy(attr) : NULL;
+      if (copy)
+        tuple_add_attribute(projected, copy);
+      failed = attr && !copy;
+    }
+    tuple_destroy(t);
+    int status = failed ? -1 : tuple_set_insert(s->seen, projected);
+    if (status == 1)
+      return projected;
+    tuple_destroy(projected);
+    if (status < 0)
+      return operator_fail(op);
+  }
+  return NULL;
+}
+
+static void project_close(Operator *op) {
+  ProjectState *s = (ProjectState *)op->state;
+  hash_map_destroy(s->seen);
+  s->seen = NULL;
+}
+
+static void project_destroy(Operator *op) {
+  ProjectState *s = (ProjectState *)op->state;
+  hash_map_destroy(s->seen);
+  for (size_t i = 0; s->names && i < s->count; i++)
+    free(s->names[i]);
+  free(s->names);
+}
+
+static const OperatorVTable project_vtable = {"Project", project_open, project_next,
+                                              project_close, project_destroy};
+
+Operator *operator_project(Operator *child, const char **attr_names, size_t num_attrs) {
+  Operator *op = operator_new(&project_vtable, sizeof(ProjectState), child, NULL, 1);
+  if (!op)
+    return NULL;
+  ProjectState *s = (ProjectState *)op->state;
+  s->names = calloc(num_attrs ? num_attrs : 1, sizeof(char *));
+  if (!s->names) {
+    operator_destroy(op);
+    return NULL;
+  }
+  s->count = num_attrs;
+  for (size_t i = 0; i < num_attrs; i++) {
+    if (!(s->names[i] = strdup(attr_names[i]))) {
+      operator_destroy(op);
+      return NULL;
+    }
+  }
+  return op;
+}
+
+/* Rename */
+
+typedef struct {
+  char *from;
+  char *to;
+} RenameState;
+
+static Tuple *rename_next(Operator *op) {
+  RenameState *s = (RenameState *)op->state;
+  Tuple *t = operator_next(op->left);
+  Attribute *attr = t ? tuple_find_attribute(t, s->from) : NULL;
+  if (attr && !tuple_find_attribute(t, s->to)) {
+    char *name = strdup(s->to);
+    if (!name) {
+      tuple_destroy(t);
+      return operator_fail(op);
+    }
+    free(attr->name);
+    attr->name = name;
+  }
+  return t;
+}
+
+static void rename_destroy(Operator *op) {
+  RenameState *s = (RenameState *)op->state;
+  free(s->from);
+  free(s->to);
+}
+
+static const OperatorVTable rename_vtable = {"Rename", NULL, rename_next, NULL, rename_destroy};
+
+Operator *operator_rename(Operator *child, const char *from, const char *to) {
+  Operator *op = operator_new(&rename_vtable, sizeof(RenameState), child, NULL, 1);
+  if (!op)
+    return NULL;
+  RenameState *s = (RenameState *)op->state;
+  s->from = strdup(from);
+  s->to = strdup(to);
+  if (!s->from || !s->to) {
+    operator_destroy(op);
+    return NULL;
+  }
+  return op;
+}
+
+/* Limit */
+
+typedef struct {
+  size_t limit;
+  size_t produced;
+} LimitState;
+
+static int limit_open(Operator *op) {
+  ((LimitState *)op->state)->produced = 0;
+  return 0;
+}
+
+static Tuple *limit_next(Operator *op) {
+  LimitState *s = (LimitState *)op->state;
+  if (s->produced >= s->limit)
+    return NULL;
+  Tuple *t = operator_next(op->left);
+  if (t)
+    s->produced++;
+  return t;
+}
+
+static const OperatorVTable limit_vtable = {"Limit", limit_open, limit_next, NULL, NULL};
+
+Operator *operator_limit(Operator *child, size_t limit) {
+  Operator *op = operator_new(&limit_vtable, sizeof(LimitState), child, NULL, 1);
+  if (op)
+    ((LimitState *)op->state)->limit = limit;
+  return op;
+}
+
+/* Nested loop join */
+
+typedef struct {
+  JoinPredicateFn predicate;
+  void *userdata;
+  Tuple **inner; // buffered right input
+  size_t inner_count;
+  size_t inner_capacity;
+  Tuple *outer; // current left tuple
+  size_t position;
+} JoinState;
+
+static int join_open(Operator *op) {
+  JoinState *s = (JoinState *)op->state;
+  Tuple *t;
+  while ((t = operator_next(op->right)) != NULL) {
+    if (s->inner_count == s->inner_capacity) {
+      size_t cap = s->inner_capacity ? s->inner_capacity * 2 : 64;
+      Tuple **inner = realloc(s->inner, cap * sizeof(Tuple *));
+      if (!inner) {
+        tuple_destroy(t);
+        return -1;
+      }
+      s->inner = inner;
+      s->inner_capacity = cap;
+    }
+    s->inner[s->inner_count++] = t;
+  }
+  return 0;
+}
+
+static Tuple *join_next(Operator *op) {
+  JoinState *s = (JoinState *)op->state;
+  for (;;) {
+    if (!s->outer) {
+      s->outer = operator_next(op->left);
+      s->position = 0;
+      if (!s->outer)
+        return NULL;
+    }
+    while (s->position < s->inner_count) {
+      Tuple *inner = s->inner[s->position++];
+      profile_predicate(op);
+      if (s->predicate(s->outer, inner, s->userdata)) {
+        Tuple *merged = tuple_merge(s->outer, inner);
+        return merged ? merged : operator_fail(op);
+      }
+    }
+    tuple_destroy(s->outer);
+    s->outer = NULL;
+  }
+}
+
+static void join_close(Operator *op) {
+  JoinState *s = (JoinState *)op->state;
+  for (size_t i = 0; i < s->inner_count; i++)
+    tuple_destroy(s->inner[i]);
+  free(s->inner);
+  s->inner = NULL;
+  s->inner_count = s->inner_capacity = 0;
+  tuple_destroy(s->outer);
+  s->outer = NULL;
+}
+
+static const OperatorVTable join_vtable = {"NestedLoopJoin", join_open, join_next, join_close,
+                                           join_close};
+
+Operator *operator_join(Operator *left, Operator *right, JoinPredicateFn predicate,
+                        void *userdata) {
+  Operator *op = operator_new(&join_vtable, sizeof(JoinState), left, right, 2);
+  if (op) {
+    JoinState *s = (JoinState *)op->state;
+    s->predicate = predicate;
+    s->userdata = userdata;
+  }
+  return op;
+}
+
+/* Hash join */
+
+// Right tuples sharing one join value
+typedef struct HashJoinEntry {
+  Tuple *tuple;
+  struct HashJoinEntry *next;
+} HashJoinEntry;
+
+typedef struct {
+  char *left_attr;
+  char *right_attr;
+  HashMap *build; // join Attribute* (inside a right tuple) -> HashJoinEntry chain
+  Tuple *outer;
+  HashJoinEntry *match;
+} HashJoinState;
+
+static uint64_t join_key_hash(const void *key) {
+  return attribute_value_hash((const Attribute *)key);
+}
+
+static int join_key_equals(const void *a, const void *b) {
+  return attribute_value_equals((const Attribute *)a, (const Attribute *)b);
+}
+
+static int hash_join_open(Operator *op) {
+  HashJoinState *s = (HashJoinState *)op->state;
+  s->build = hash_map_create(join_key_hash, join_key_equals, NULL, NULL);
+  if (!s->build)
+    return -1;
+
+  Tuple *t;
+  while ((t = operator_next(op->right)) != NULL) {
+    Attribute *key = tuple_find_attribute(t, s->right_attr);
+    HashJoinEntry *entry = key ? malloc(sizeof(HashJoinEntry)) : NULL;
+    if (!entry) {
+      // Tuples without the join attribute can never match
+      tuple_destroy(t);
+      if (key)
+        return -1;
+      continue;
+    }
+    entry->tuple = t;
+    entry->next = hash_map_get(s->build, key);
+    if (hash_map_put(s->build, key, entry) < 0) {
+      tuple_destroy(t);
+      free(entry);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static Tuple *hash_join_next(Operator *op) {
+  HashJoinState *s = (HashJoinState *)op->state;
+  for (;;) {
+    if (s->match) {
+      HashJoinEntry *entry = s->match;
+      s->match = entry->next;
+      Tuple *merged = tuple_merge(s->outer, entry->tuple);
+      return merged ? merged : operator_fail(op);
+    }
+    tuple_destroy(s->outer);
+    s->outer = operator_next(op->left);
+    if (!s->outer)
+      return NULL;
+    Attribute *key = tuple_find_attribute(s->outer, s->left_attr);
+    profile_predicate(op);
+    s->match = key ? hash_map_get(s->build, key) : NULL;
+  }
+}
+
+static void free_chain_cb(void *key, void *value, void *userdata) {
+  (void)key;
+  (void)userdata;
+  HashJoinEntry *entry = (HashJoinEntry *)value;
+  while (entry) {
+    HashJoinEntry *next = entry->next;
+    tuple_destroy(entry->tuple);
+    free(entry);
+    entry = next;
+  }
+}
+
+static void hash_join_close(Operator *op) {
+  HashJoinState *s = (HashJoinState *)op->state;
+  if (s->build) {
+    hash_map_foreach(s->build, free_chain_cb, NULL);
+    hash_map_destroy(s->build);
+    s->build = NULL;
+  }
+  tuple_destroy(s->outer);
+  s->outer = NULL;
+  s->match = NULL;
+}
+
+static void hash_join_destroy(Operator *op) {
+  HashJoinState *s = (HashJoinState *)op->state;
+  hash_join_close(op);
+  free(s->left_attr);
+  free(s->right_attr);
+}
+
+static const OperatorVTable hash_join_vtable = {"HashJoin", hash_join_open, hash_join_next,
+                                                hash_join_close, hash_join_destroy};
+
+Operator *operator_hash_join(Operator *left, Operator *right, const char *left_attr,
+                             const char *right_attr) {
+  Operator *op = operator_new(&hash_join_vtable, sizeof(HashJoinState), left, right, 2);
+  if (!op)
+    return NULL;
+  HashJoinState *s = (HashJoinState *)op->state;
+  s->left_attr = strdup(left_attr);
+  s->right_attr = strdup(right_attr);
+  if (!s->left_attr || !s->right_attr) {
+    operator_destroy(op);
+    return NULL;
+  }
+  return op;
+}
+
+/* Natural join */
+
+typedef struct {
+  char **attrs;
+  size_t count;
+  HashMap *build; // right tuple restricted to `attrs` (owned) -> HashJoinEntry chain
+  Tuple *outer;
+  HashJoinEntry *match;
+} NaturalJoinState;
+
+// Copy of the attributes of `t` named in `attrs`, or NULL if one is missing
+static Tuple *tuple_restrict(Tuple *t, char **attrs, size_t count) {
+  Tuple *key = tuple_create();
+  for (size_t i = 0; key && i < count; i++) {
+    Attribute *attr = tuple_find_attribute(t, attrs[i]);
+    Attribute *copy = attr ? attribute_copy(attr) : NULL;
+    if (!copy) {
+      tuple_destroy(key);
+      return NULL;
+    }
+    tuple_add_attribute(key, copy);
+  }
+  return key;
+}
+
+static int natural_join_open(Operator *op) {
+  NaturalJoinState *s = (NaturalJoinState *)op->state;
+  s->build = tuple_set_create();
+  if (!s->build)
+    return -1;
+
+  Tuple *t;
+  while ((t = operator_next(op->right)) != NULL) {
+    Tuple *key = tuple_restrict(t, s->attrs, s->count);
+    HashJoinEntry *entry = key ? malloc(sizeof(HashJoinEntry)) : NULL;
+    if (!entry) {
+      // Tuples without every join attribute can never match
+      tuple_destroy(t);
+      tuple_destroy(key);
+      continue;
+    }
+    entry->tuple = t;
+    entry->next = hash_map_get(s->build, key);
+    // A key already present keeps its original copy; this one is freed by the map
+    if (hash_map_put(s->build, key, entry) < 0) {
+      tuple_destroy(t);
+      tuple_destroy(key);
+      free(entry);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static Tuple *natural_join_next(Operator *op) {
+  NaturalJoinState *s = (NaturalJoinState *)op->state;
+  for (;;) {
+    if (s->match) {
+      HashJoinEntry *entry = s->match;
+      s->match = entry->next;
+      Tuple *merged = tuple_natural_merge(s->outer, entry->tuple);
+      return merged ? merged : operator_fail(op);
+    }
+    tuple_destroy(s->outer);
+    s->outer = operator_next(op->left);
+    if (!s->outer)
+      return NULL;
+    Tuple *key = tuple_restrict(s->outer, s->attrs, s->count);
+    profile_predicate(op);
+    s->match = key ? hash_map_get(s->build, key) : NULL;
+    tuple_destroy(key);
+  }
+}
+
+static void natural_join_close(Operator *op) {
+  NaturalJoinState *s = (NaturalJoinState *)op->state;
+  if (s->build) {
+    hash_map_foreach(s->build, free_chain_cb, NULL);
+    hash_map_destroy(s->build);
+    s->build = NULL;
+  }
+  tuple_destroy(s->outer);
+  s->outer = NULL;
+  s->match = NULL;
+}
+
+static void natural_join_destroy(Operator *op) {
+  NaturalJoinState *s = (NaturalJoinState *)op->state;
+  natural_join_close(op);
+  for (size_t i = 0; s->attrs && i < s->count; i++)
+    free(s->attrs[i]);
+  free(s->attrs);
+}
+
+static const OperatorVTable natural_join_vtable = {"NaturalJoin", natural_join_open,
+                                                   natural_join_next, natural_join_close,
+                                                   natural_join_destroy};
+
+Operator *operator_natural_join(Operator *left, Operator *right, const char **attrs,
+                                size_t count) {
+  Operator *op = operator_new(&natural_join_vtable, sizeof(NaturalJoinState), left, right, 2);
+  if (!op)
+    return NULL;
+  NaturalJoinState *s = (NaturalJoinState *)op->state;
+  s->attrs = calloc(count ? count : 1, sizeof(char *));
+  if (!s->attrs) {
+    operator_destroy(op);
+    return NULL;
+  }
+  s->count = count;
+  for (size_t i = 0; i < count; i++) {
+    if (!(s->attrs[i] = strdup(attrs[i]))) {
+      operator_destroy(op);
+      return NULL;
+    }
+  }
+  return op;
+}
+
+/* Semi-join and anti-join */
+
+typedef struct {
+  char **attrs;
+  size_t count;
+  HashMap *build; // distinct right tuples restricted to `attrs`
+  int anti;       // emit the left tuples without a match instead
+} SemiJoinState;
+
+static int semi_join_open(Operator *op) {
+  SemiJoinState *s = (SemiJoinState *)op->state;
+  s->build = tuple_set_create();
+  if (!s->build)
+    return -1;
+
+  // Only the distinct keys are kept: one match decides a left tuple
+  Tuple *t;
+  while ((t = operator_next(op->right)) != NULL) {
+    Tuple *key = tuple_restrict(t, s->attrs, s->count);
+    tuple_destroy(t);
+    int status = !key || hash_map_get(s->build, key) ? 0 : hash_map_put(s->build, key, key);
+    if (status != 1)
+      tuple_destroy(key);
+    if (status < 0)
+      return -1;
+  }
+  return 0;
+}
+
+static Tuple *semi_join_next(Operator *op) {
+  SemiJoinState *s = (SemiJoinState *)op->state;
+  Tuple *t;
+  while ((t = operator_next(op->left)) != NULL) {
+    Tuple *key = tuple_restrict(t, s->attrs, s->count);
+    profile_predicate(op);
+    int matched = key && hash_map_get(s->build, key);
+    tuple_destroy(key);
+    if (matched != s->anti)
+      return t;
+    tuple_destroy(t);
+  }
+  return NULL;
+}
+
+static void semi_join_close(Operator *op) {
+  SemiJoinState *s = (SemiJoinState *)op->state;
+  hash_map_destroy(s->build);
+  s->build = NULL;
+}
+
+static void semi_join_destroy(Operator *op) {
+  SemiJoinState *s = (SemiJoinState *)op->state;
+  semi_join_close(op);
+  for (size_t i = 0; s->attrs && i < s->count; i++)
+    free(s->attrs[i]);
+  free(s->attrs);
+}
+
+static const OperatorVTable semi_join_vtable = {"SemiJoin", semi_join_open, semi_join_next,
+                                                semi_join_close, semi_join_destroy};
+static const OperatorVTable anti_join_vtable = {"AntiJoin", semi_join_open, semi_join_next,
+                                                semi_join_close, semi_join_destroy};
+
+static Operator *semi_join_new(Operator *left, Operator *right, const char **attrs, size_t count,
+                               int anti) {
+  Operator *op = operator_new(anti ? &anti_join_vtable : &semi_join_vtable,
+                              sizeof(SemiJoinState), left, right, 2);
+  if (!op)
+    return NULL;
+  SemiJoinState *s = (SemiJoinState *)op->state;
+  s->anti = anti;
+  s->attrs = calloc(count ? count : 1, sizeof(char *));
+  if (!s->attrs) {
+    operator_destroy(op);
+    return NULL;
+  }
+  s->count = count;
+  for (size_t i = 0; i < count; i++) {
+    if (!(s->attrs[i] = strdup(attrs[i]))) {
+      operator_destroy(op);
+      return NULL;
+    }
+  }
+  return op;
+}
+
+Operator *operator_semi_join(Operator *left, Operator *right, const char **attrs, size_t count) {
+  return semi_join_new(left, right, attrs, count, 0);
+}
+
+Operator *operator_anti_join(Operator *left, Operator *right, const char **attrs, size_t count) {
+  return semi_join_new(left, right, attrs, count, 1);
+}
+
+/* Index join */
+
+typedef struct {
+  const RelationIndex *index;
+  Tuple *outer;
+  IndexCursor cursor;
+} IndexJoinState;
+
+// The index matches numbers by value; a natural join also requires equal types
+static int index_join_matches(const IndexJoinState *s, Tuple *inner) {
+  size_t count;
+  const char *const *attrs = index_attributes(s->index, &count);
+  for (size_t i = 0; i < count; i++) {
+    if (!attribute_value_equals(tuple_find_attribute(s->outer, attrs[i]),
+                                tuple_find_attribute(inner, attrs[i])))
+      return 0;
+  }
+  return 1;
+}
+
+static Tuple *index_join_next(Operator *op) {
+  IndexJoinState *s = (IndexJoinState *)op->state;
+  for (;;) {
+    Tuple *inner;
+    while (s->outer && (inner = index_cursor_next(&s->cursor)) != NULL) {
+      if (index_join_matches(s, inner)) {
+        Tuple *merged = tuple_natural_merge(s->outer, inner);
+        return merged ? merged : operator_fail(op);
+      }
+    }
+    tuple_destroy(s->outer);
+    s->outer = operator_next(op->left);
+    if (!s->outer)
+      return NULL;
+    profile_predicate(op);
+    // Outer tuples without every join attribute match nothing
+    if (index_lookup(s->index, s->outer, CMP_EQ, &s->cursor) < 0)
+      s->cursor.count = s->cursor.position = 0;
+  }
+}
+
+static void index_join_close(Operator *op) {
+  IndexJoinState *s = (IndexJoinState *)op->state;
+  tuple_destroy(s->outer);
+  s->outer = NULL;
+}
+
+static const OperatorVTable index_join_vtable = {"IndexJoin", NULL, index_join_next,
+                                                 index_join_close, index_join_close};
+
+Operator *operator_index_join(Operator *outer, const Relation *r, const RelationIndex *index) {
+  if (!r || !index) {
+    operator_destroy(outer);
+    return NULL;
+  }
+  Operator *op = operator_new(&index_join_vtable, sizeof(IndexJoinState), outer, NULL, 1);
+  if (op)
+    ((IndexJoinState *)op->state)->index = index;
+  return op;
+}
+
+/* Union */
+
+typedef struct {
+  HashMap *seen;
+  int left_done;
+} UnionState;
+
+static int union_open(Operator *op) {
+  UnionState *s = (UnionState *)op->state;
+  s->left_done = 0;
+  s->seen = tuple_set_create();
+  return s->seen ? 0 : -1;
+}
+
+static Tuple *union_next(Operator *op) {
+  UnionState *s = (UnionState *)op->state;
+  if (!s->left_done) {
+    Tuple *t = next_distinct(op, op->left, s->seen);
+    if (t)
+      return t;
+    s->left_done = 1;
+  }
+  return next_distinct(op, op->right, s->seen);
+}
+
+static void union_close(Operator *op) {
+  UnionState *s = (UnionState *)op->state;
+  hash_map_destroy(s->seen);
+  s->seen = NULL;
+}
+
+static const OperatorVTable union_vtable = {"Union", union_open, union_next, union_close,
+                                            union_close};
+
+Operator *operator_union(Operator *left, Operator *right) {
+  return operator_new(&union_vtable, sizeof(UnionState), left, right, 2);
+}
+
+/* Difference */
+
+typedef struct {
+  HashMap *exclude; // right input
+  HashMap *seen;
+} DifferenceState;
+
+static int difference_open(Operator *op) {
+  DifferenceState *s = (DifferenceState *)op->state;
+  s->exclude = tuple_set_create();
+  s->seen = tuple_set_create();
+  if (!s->exclude || !s->seen)
+    return -1;
+
+  Tuple *t;
+  while ((t = operator_next(op->right)) != NULL) {
+    int status = hash_map_get(s->exclude, t) ? 0 : hash_map_put(s->exclude, t, t);
+    if (status != 1)
+      tuple_destroy(t);
+    if (status < 0)
+      return -1;
+  }
+  return 0;
+}
+
+static Tuple *difference_next(Operator *op) {
+  DifferenceState *s = (DifferenceState *)op->state;
+  Tuple *t;
+  while ((t = next_distinct(op, op->left, s->seen)) != NULL) {
+    if (!hash_map_get(s->exclude, t))
+      return t;
+    tuple_destroy(t);
+  }
+  return NULL;
+}
+
+static void difference_close(Operator *op) {
+  DifferenceState *s = (DifferenceState *)op->state;
+  hash_map_destroy(s->exclude);
+  hash_map_destroy(s->seen);
+  s->exclude = s->seen = NULL;
+}
+
+static const OperatorVTable difference_vtable = {"Difference", difference_open, difference_next,
+                                                 difference_close, difference_close};
+
+Operator *operator_difference(Operator *left, Operator *right) {
+  return operator_new(&difference_vtable, sizeof(DifferenceState), left, right, 2);
+}
+
+/* Intersection */
+
+// Same state as a difference: the right input is the set the left tuples must be in
+static Tuple *intersect_next(Operator *op) {
+  DifferenceState *s = (DifferenceState *)op->state;
+  Tuple *t;
+  while ((t = next_distinct(op, op->left, s->seen)) != NULL) {
+    if (hash_map_get(s->exclude, t))
+      return t;
+    tuple_destroy(t);
+  }
+  return NULL;
+}
+
+static const OperatorVTable intersect_vtable = {"Intersect", difference_open, intersect_next,
+                                                difference_close, difference_close};
+
+Operator *operator_intersect(Operator *left, Operator *right) {
+  return operator_new(&intersect_vtable, sizeof(DifferenceState), left, right, 2);
+}
+
+/* Division */
+
+typedef struct DivideGroup {
+  Tuple *quotient; // key of the group in `groups`
+  size_t count;    // distinct divisor tuples paired with it
+  struct DivideGroup *next;
+} DivideGroup;
+
+// A (group, divisor tuple) pair met in the dividend
+typedef struct {
+  const DivideGroup *group;
+  size_t ordinal;
+} DividePair;
+
+typedef struct {
+  char **attrs; // the quotient attributes, then the divisor attributes
+  size_t quotient_count;
+  size_t divisor_count;
+  HashMap *groups;    // quotient values (owned) -> DivideGroup (owned)
+  DivideGroup *first; // groups in the order they were met
+  DivideGroup *last;
+  DivideGroup *cursor;
+  size_t divisor_size; // distinct divisor tuples
+} DivideState;
+
+static uint64_t divide_pair_hash(const void *key) {
+  const DividePair *p = (const DividePair *)key;
+  return hash_combine(hash_bytes(&p->group, sizeof(p->group)), p->ordinal);
+}
+
+static int divide_pair_equals(const void *a, const void *b) {
+  const DividePair *x = (const DividePair *)a, *y = (const DividePair *)b;
+  return x->group == y->group && x->ordinal == y->ordinal;
+}
+
+// Number the distinct divisor tuples from 1 (the map values)
+static int divide_read_divisor(Operator *op, HashMap *divisor) {
+  DivideState *s = (DivideState *)op->state;
+  Tuple *t;
+  while ((t = operator_next(op->right)) != NULL) {
+    Tuple *key = tuple_restrict(t, s->attrs + s->quotient_count, s->divisor_count);
+    tuple_destroy(t);
+    int status = !key || hash_map_get(divisor, key)
+                     ? 0
+                     : hash_map_put(divisor, key, (void *)(uintptr_t)(s->divisor_size + 1));
+    if (status != 1)
+      tuple_destroy(key);
+    if (status < 0)
+      return -1;
+    if (status == 1)
+      s->divisor_size++;
+  }
+  return 0;
+}
+
+// The group of the quotient values of `t`, created on first sight; NULL if `t` lacks one
+static DivideGroup *divide_group(DivideState *s, Tuple *t, int *failed) {
+  Tuple *quotient = tuple_restrict(t, s->attrs, s->quotient_count);
+  if (!quotient)
+    return NULL;
+  DivideGroup *g = hash_map_get(s->groups, quotient);
+  if (g) {
+    tuple_destroy(quotient);
+    return g;
+  }
+  g = calloc(1, sizeof(DivideGroup));
+  if (!g || hash_map_put(s->groups, quotient, g) < 0) {
+    free(g);
+    tuple_destroy(quotient);
+    *failed = 1;
+    return NULL;
+  }
+  g->quotient = quotient;
+  if (s->last)
+    s->last->next = g;
+  else
+    s->first = g;
+  s->last = g;
+  return g;
+}
+
+static int divide_open(Operator *op) {
+  DivideState *s = (DivideState *)op->state;
+  s->first = s->last = s->cursor = NULL;
+  s->divisor_size = 0;
+  s->groups = hash_map_create(tuple_key_hash, tuple_key_equals, tuple_key_free, free);
+  HashMap *divisor = tuple_set_create();
+  HashMap *pairs = hash_map_create(divide_pair_hash, divide_pair_equals, free, NULL);
+  int failed = !s->groups || !divisor || !pairs || divide_read_divisor(op, divisor) < 0;
+
+  // Count, per quotient group, the distinct divisor tuples it is paired with
+  Tuple *t;
+  while (!failed && (t = operator_next(op->left)) != NULL) {
+    DivideGroup *g = divide_group(s, t, &failed);
+    Tuple *key = g ? tuple_restrict(t, s->attrs + s->quotient_count, s->divisor_count) : NULL;
+    tuple_destroy(t);
+    profile_predicate(op);
+    uintptr_t ordinal = key ? (uintptr_t)hash_map_get(divisor, key) : 0;
+    tuple_destroy(key);
+    if (!ordinal)
+      continue;
+    DividePair probe = {.group = g, .ordinal = ordinal};
+    if (hash_map_get(pairs, &probe))
+      continue;
+    DividePair *pair = malloc(sizeof(DividePair));
+    if (pair)
+      *pair = probe;
+    if (!pair || hash_map_put(pairs, pair, pair) < 0) {
+      free(pair);
+      failed = 1;
+      break;
+    }
+    g->count++;
+  }
+  hash_map_destroy(divisor);
+  hash_map_destroy(pairs);
+  s->cursor = s->first;
+  return failed ? -1 : 0;
+}
+
+static Tuple *divide_next(Operator *op) {
+  DivideState *s = (DivideState *)op->state;
+  while (s->cursor) {
+    DivideGroup *g = s->cursor;
+    s->cursor = g->next;
+    if (g->count == s->divisor_size) {
+      Tuple *quotient = tuple_copy(g->quotient);
+      return quotient ? quotient : operator_fail(op);
+    }
+  }
+  return NULL;
+}
+
+static void divide_close(Operator *op) {
+  DivideState *s = (DivideState *)op->state;
+  hash_map_destroy(s->groups);
+  s->groups = NULL;
+  s->first = s->last = s->cursor = NULL;
+}
+
+static void divide_destroy(Operator *op) {
+  DivideState *s = (DivideState *)op->state;
+  divide_close(op);
+  for (size_t i = 0; s->attrs && i < s->quotient_count + s->divisor_count; i++)
+    free(s->attrs[i]);
+  free(s->attrs);
+}
+
+static const OperatorVTable divide_vtable = {"Divide", divide_open, divide_next, divide_close,
+                                             divide_destroy};
+
+Operator *operator_divide(Operator *dividend, Operator *divisor, const char **quotient_attrs,
+                          size_t quotient_count, const char **divisor_attrs,
+                          size_t divisor_count) {
+  Operator *op = operator_new(&divide_vtable, sizeof(DivideState), dividend, divisor, 2);
+  if (!op)
+    return NULL;
+  DivideState *s = (DivideState *)op->state;
+  size_t count = quotient_count + divisor_count;
+  s->attrs = calloc(count ? count : 1, sizeof(char *));
+  if (!s->attrs) {
+    operator_destroy(op);
+    return NULL;
+  }
+  s->quotient_count = quotient_count;
+  s->divisor_count = divisor_count;
+  for (size_t i = 0; i < count; i++) {
+    const char *name = i < quotient_count ? quotient_attrs[i] : divisor_attrs[i - quotient_count];
+    // An attribute cannot be both in the quotient and divided out
+    for (size_t j = 0; i >= quotient_count && j < quotient_count; j++) {
+      if (strcmp(name, s->attrs[j]) == 0) {
+        operator_destroy(op);
+        return NULL;
+      }
+    }
+    if (!(s->attrs[i] = strdup(name))) {
+      operator_destroy(op);
+      return NULL;
+    }
+  }
+  return op;
+}
@@ -0,0 +1,596 @@
+/**
+ * @file predicate.c
+ * @brief Construction and evaluation of predicate bytecode.
+ *
+ * Both evaluators run the same program. The tuple evaluator keeps a stack
+ * of dynamically typed values. The batch evaluator keeps a stack of column
+ * vectors; the type of each vector follows from the batch's column types
+ * and the constants, so every instruction is one typed loop over the rows.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "predicate.h"
+
+typedef enum { TYPE_UNKNOWN, TYPE_INT, TYPE_DOUBLE, TYPE_STRING, TYPE_BOOL } ValueType;
+
+typedef union {
+  int64_t i; // TYPE_INT, and 0/1 for TYPE_BOOL
+  double d;
+  const char *s;
+} Scalar;
+
+typedef struct {
+  ValueType type;
+  Scalar v;
+} Value;
+
+struct Predicate {
+  PredicateInstruction *code;
+  size_t count;
+  size_t capacity;
+  char **slots; // referenced attribute names
+  size_t slot_count;
+  size_t slot_capacity;
+  Value *constants; // strings owned
+  size_t constant_count;
+  size_t constant_capacity;
+  uint8_t *kinds; // construction: 1 where the stack holds a boolean (max_depth entries)
+  size_t depth;
+  size_t max_depth;
+  int finished;
+
+  // Tuple evaluation
+  Value *stack;
+  const Attribute **loaded; // per slot, NULL if missing
+  int *positions;           // per slot, in the last heading
+  size_t *order;            // slots by ascending position
+  int heading_known;        // every slot was found in the last heading
+
+  // Batch evaluation (allocated on first use)
+  Scalar *vectors; // max_depth vectors of BATCH_CAPACITY rows
+  uint8_t *valid;
+  ValueType *vector_types;
+  int *columns; // per slot, column of the current batch or -1
+};
+
+/* Construction */
+
+Predicate *predicate_create(void) { return calloc(1, sizeof(Predicate)); }
+
+void predicate_destroy(Predicate *p) {
+  if (!p)
+    return;
+  for (size_t i = 0; i < p->slot_count; i++)
+    free(p->slots[i]);
+  for (size_t i = 0; i < p->constant_count; i++)
+    if (p->constants[i].type == TYPE_STRING)
+      free((char *)p->constants[i].v.s);
+  free(p->slots);
+  free(p->constants);
+  free(p->code);
+  free(p->kinds);
+  free(p->stack);
+  free(p->loaded);
+  free(p->positions);
+  free(p->order);
+  free(p->vectors);
+  free(p->valid);
+  free(p->vector_types);
+  free(p->columns);
+  free(p);
+}
+
+static int grow(void **items, size_t *capacity, size_t count, size_t size) {
+  if (count < *capacity)
+    return 0;
+  size_t cap = *capacity ? *capacity * 2 : 8;
+  void *grown = realloc(*items, cap * size);
+  if (!grown)
+    return -1;
+  *items = grown;
+  *capacity = cap;
+  return 0;
+}
+
+// Append an instruction popping `pops` operands of kind `operand_kind` and pushing one of `kind`
+static int emit(Predicate *p, PredicateOpcode opcode, uint32_t operand, size_t pops,
+                uint8_t operand_kind, uint8_t kind) {
+  if (p->finished || p->depth < pops)
+    return -1;
+  for (size_t i = 0; i < pops; i++)
+    if (p->kinds[p->depth - 1 - i] != operand_kind)
+      return -1;
+  if (grow((void **)&p->code, &p->capacity, p->count, sizeof(PredicateInstruction)) < 0)
+    return -1;
+  if (p->depth - pops + 1 > p->max_depth) {
+    uint8_t *kinds = realloc(p->kinds, p->max_depth + 1);
+    if (!kinds)
+      return -1;
+    p->kinds = kinds;
+    p->max_depth++;
+  }
+  p->code[p->count++] = (PredicateInstruction){.opcode = opcode, .operand = operand};
+  p->depth -= pops;
+  p->kinds[p->depth++] = kind;
+  return 0;
+}
+
+int predicate_push_attribute(Predicate *p, const char *name) {
+  size_t slot = 0;
+  while (slot < p->slot_count && strcmp(p->slots[slot], name) != 0)
+    slot++;
+  if (slot == p->slot_count) {
+    if (p->finished ||
+        grow((void **)&p->slots, &p->slot_capacity, p->slot_count, sizeof(char *)) < 0)
+      return -1;
+    if (!(p->slots[p->slot_count] = strdup(name)))
+      return -1;
+    p->slot_count++;
+    if (emit(p, PREDICATE_ATTRIBUTE, (uint32_t)slot, 0, 0, 0) < 0) {
+      free(p->slots[--p->slot_count]);
+      return -1;
+    }
+    return 0;
+  }
+  return emit(p, PREDICATE_ATTRIBUTE, (uint32_t)slot, 0, 0, 0);
+}
+
+int predicate_push_constant(Predicate *p, const Attribute *constant) {
+  if (!constant || !constant->value)
+    return -1;
+  Value v;
+  switch (constant->type) {
+  case ATTR_INT:
+    v = (Value){.type = TYPE_INT, .v.i = *(const int *)constant->value};
+    break;
+  case ATTR_RATIONAL:
+    v = (Value){.type = TYPE_DOUBLE, .v.d = *(const double *)constant->value};
+    break;
+  case ATTR_STRING:
+    v = (Value){.type = TYPE_STRING, .v.s = strdup((const char *)constant->value)};
+    if (!v.v.s)
+      return -1;
+    break;
+  default:
+    return -1;
+  }
+  if (grow((void **)&p->constants, &p->constant_capacity, p->constant_count,
+           sizeof(Value)) < 0 ||
+      emit(p, PREDICATE_CONSTANT, (uint32_t)p->constant_count, 0, 0, 0) < 0) {
+    if (v.type == TYPE_STRING)
+      free((char *)v.v.s);
+    return -1;
+  }
+  p->constants[p->constant_count++] = v;
+  return 0;
+}
+
+int predicate_emit(Predicate *p, PredicateOpcode opcode) {
+  switch (opcode) {
+  case PREDICATE_ADD:
+  case PREDICATE_SUB:
+  case PREDICATE_MUL:
+  case PREDICATE_DIV:
+    return emit(p, opcode, 0, 2, 0, 0);
+  case PREDICATE_AND:
+  case PREDICATE_OR:
+    return emit(p, opcode, 0, 2, 1, 1);
+  case PREDICATE_NOT:
+    return emit(p, opcode, 0, 1, 1, 1);
+  default:
+    return -1;
+  }
+}
+
+int predicate_emit_compare(Predicate *p, CompareOp op) {
+  return emit(p, PREDICATE_COMPARE, (uint32_t)op, 2, 0, 1);
+}
+
+int predicate_finish(Predicate *p) {
+  if (p->finished || p->depth != 1 || p->kinds[0] != 1)
+    return -1;
+  size_t slots = p->slot_count ? p->slot_count : 1;
+  p->stack = malloc(p->max_depth * sizeof(Value));
+  p->loaded = calloc(slots, sizeof(Attribute *));
+  p->positions = calloc(slots, sizeof(int));
+  p->order = calloc(slots, sizeof(size_t));
+  if (!p->stack || !p->loaded || !p->positions || !p->order)
+    return -1;
+  p->finished = 1;
+  return 0;
+}
+
+/* Scalar semantics */
+
+// a op b for two ints; -1 on overflow
+static int int_arithmetic(PredicateOpcode opcode, int64_t a, int64_t b, int64_t *out) {
+  switch (opcode) {
+  case PREDICATE_ADD:
+    return __builtin_add_overflow(a, b, out) ? -1 : 0;
+  case PREDICATE_SUB:
+    return __builtin_sub_overflow(a, b, out) ? -1 : 0;
+  default:
+    return __builtin_mul_overflow(a, b, out) ? -1 : 0;
+  }
+}
+
+static double double_arithmetic(PredicateOpcode opcode, double a, double b) {
+  switch (opcode) {
+  case PREDICATE_ADD:
+    return a + b;
+  case PREDICATE_SUB:
+    return a - b;
+  case PREDICATE_MUL:
+    return a * b;
+  default:
+    return a / b;
+  }
+}
+
+static int is_number(ValueType t) { return t == TYPE_INT || t == TYPE_DOUBLE; }
+
+static double as_double(Value v) { return v.type == TYPE_INT ? (double)v.v.i : v.v.d; }
+
+static Value arithmetic(PredicateOpcode opcode, Value a, Value b) {
+  Value unknown = {.type = TYPE_UNKNOWN};
+  if (!is_number(a.type) || !is_number(b.type))
+    return unknown;
+  if (opcode != PREDICATE_DIV && a.type == TYPE_INT && b.type == TYPE_INT) {
+    Value r = {.type = TYPE_INT};
+    return int_arithmetic(opcode, a.v.i, b.v.i, &r.v.i) < 0 ? unknown : r;
+  }
+  if (opcode == PREDICATE_DIV && as_double(b) == 0.0)
+    return unknown;
+  double r = double_arithmetic(opcode, as_double(a), as_double(b));
+  return (Value){.type = TYPE_DOUBLE, .v.d = r};
+}
+
+// Three-way comparison, as attribute_value_compare computes it
+#define CMP3(a, b) (((a) > (b)) - ((a) < (b)))
+
+static Value compare(CompareOp op, Value a, Value b) {
+  int cmp;
+  if (a.type == TYPE_INT && b.type == TYPE_INT)
+    cmp = CMP3(a.v.i, b.v.i);
+  else if (is_number(a.type) && is_number(b.type))
+    cmp = CMP3(as_double(a), as_double(b));
+  else if (a.type == TYPE_STRING && b.type == TYPE_STRING)
+    cmp = strcmp(a.v.s, b.v.s);
+  else
+    return (Value){.type = TYPE_UNKNOWN};
+  return (Value){.type = TYPE_BOOL, .v.i = compare_op_holds(op, cmp)};
+}
+
+// Kleene conjunction or disjunction; an unknown operand has type TYPE_UNKNOWN
+static Value logic(PredicateOpcode opcode, Value a, Value b) {
+  int64_t absorbing = opcode == PREDICATE_OR; // true decides an or, false an and
+  if ((a.type == TYPE_BOOL && a.v.i == absorbing) || (b.type == TYPE_BOOL && b.v.i == absorbing))
+    return (Value){.type = TYPE_BOOL, .v.i = absorbing};
+  if (a.type != TYPE_BOOL || b.type != TYPE_BOOL)
+    return (Value){.type = TYPE_UNKNOWN};
+  return (Value){.type = TYPE_BOOL, .v.i = !absorbing};
+}
+
+/* Tuple evaluation */
+
+static Value attribute_value(const Attribute *a) {
+  if (!a || !a->value)
+    return (Value){.type = TYPE_UNKNOWN};
+  switch (a->type) {
+  case ATTR_INT:
+    return (Value){.type = TYPE_INT, .v.i = *(const int *)a->value};
+  case ATTR_RATIONAL:
+    return (Value){.type = TYPE_DOUBLE, .v.d = *(const double *)a->value};
+  case ATTR_STRING:
+    return (Value){.type = TYPE_STRING, .v.s = (const char *)a->value};
+  default:
+    return (Value){.type = TYPE_UNKNOWN};
+  }
+}
+
+// Load every slot from the positions of the last heading; 0 if one of them has another name
+static int load_by_position(Predicate *p, Tuple *t) {
+  SetIter it;
+  set_iter_init(t, &it);
+  size_t next = 0;
+  int position = 0;
+  for (Attribute *a; next < p->slot_count && (a = set_iter_next(&it)) != NULL; position++) {
+    size_t slot = p->order[next];
+    if (p->positions[slot] != position)
+      continue;
+    if (strcmp(a->name, p->slots[slot]) != 0)
+      return 0;
+    p->loaded[slot] = a;
+    next++;
+  }
+  return next == p->slot_count;
+}
+
+// Load every slot by name and remember where this heading keeps them
+static void load_by_name(Predicate *p, Tuple *t) {
+  size_t found = 0;
+  for (size_t s = 0; s < p->slot_count; s++)
+    p->loaded[s] = NULL;
+  SetIter it;
+  set_iter_init(t, &it);
+  int position = 0;
+  for (Attribute *a; found < p->slot_count && (a = set_iter_next(&it)) != NULL; position++) {
+    for (size_t s = 0; s < p->slot_count; s++) {
+      if (!p->loaded[s] && strcmp(a->name, p->slots[s]) == 0) {
+        p->loaded[s] = a;
+        p->positions[s] = position;
+        // Insertion keeps `order` sorted, as positions only grow
+        p->order[found++] = s;
+        break;
+      }
+    }
+  }
+  p->heading_known = found == p->slot_count;
+}
+
+int predicate_holds(Tuple *t, void *predicate) {
+  Predicate *p = (Predicate *)predicate;
+  if (!p->heading_known || !load_by_position(p, t))
+    load_by_name(p, t);
+
+  Value *stack = p->stack;
+  size_t sp = 0;
+  for (size_t pc = 0; pc < p->count; pc++) {
+    const PredicateInstruction *ins = &p->code[pc];
+    switch (ins->opcode) {
+    case PREDICATE_ATTRIBUTE:
+      stack[sp++] = attribute_value(p->loaded[ins->operand]);
+      break;
+    case PREDICATE_CONSTANT:
+      stack[sp++] = p->constants[ins->operand];
+      break;
+    case PREDICATE_ADD:
+    case PREDICATE_SUB:
+    case PREDICATE_MUL:
+    case PREDICATE_DIV:
+      sp--;
+      stack[sp - 1] = arithmetic(ins->opcode, stack[sp - 1], stack[sp]);
+      break;
+    case PREDICATE_COMPARE:
+      sp--;
+      stack[sp - 1] = compare((CompareOp)ins->operand, stack[sp - 1], stack[sp]);
+      break;
+    case PREDICATE_AND:
+    case PREDICATE_OR:
+      sp--;
+      stack[sp - 1] = logic(ins->opcode, stack[sp - 1], stack[sp]);
+      break;
+    case PREDICATE_NOT:
+      stack[sp - 1].v.i = !stack[sp - 1].v.i; // unknown stays unknown
+      break;
+    }
+  }
+  return stack[0].type == TYPE_BOOL && stack[0].v.i;
+}
+
+/* Batch evaluation */
+
+// One stack entry: distinct entries never overlap, and values never alias validity flags
+typedef struct {
+  Scalar *restrict v;
+  uint8_t *restrict valid;
+  ValueType *type;
+} Vector;
+
+static Vector vector_at(Predicate *p, size_t index) {
+  return (Vector){.v = p->vectors + index * BATCH_CAPACITY,
+                  .valid = p->valid + index * BATCH_CAPACITY,
+                  .type = &p->vector_types[index]};
+}
+
+// Gather the selected rows of a column
+static void load_column(Vector out, const ColumnVector *c, const uint32_t *sel, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    out.valid[i] = c->valid[sel[i]];
+  switch (c->type) {
+  case ATTR_INT:
+    *out.type = TYPE_INT;
+    for (size_t i = 0; i < n; i++)
+      out.v[i].i = ((const int *)c->values)[sel[i]];
+    break;
+  case ATTR_RATIONAL:
+    *out.type = TYPE_DOUBLE;
+    for (size_t i = 0; i < n; i++)
+      out.v[i].d = ((const double *)c->values)[sel[i]];
+    break;
+  case ATTR_STRING:
+    *out.type = TYPE_STRING;
+    for (size_t i = 0; i < n; i++)
+      out.v[i].s = ((char *const *)c->values)[sel[i]];
+    break;
+  default:
+    *out.type = TYPE_UNKNOWN;
+  }
+}
+
+static void broadcast(Vector out, Value value, size_t n) {
+  *out.type = value.type;
+  for (size_t i = 0; i < n; i++) {
+    out.v[i] = value.v;
+    out.valid[i] = 1;
+  }
+}
+
+// A boolean vector with every row unknown
+static void set_unknown(Vector out, size_t n) {
+  *out.type = TYPE_BOOL;
+  memset(out.valid, 0, n);
+  for (size_t i = 0; i < n; i++)
+    out.v[i].i = 0;
+}
+
+static void promote(Vector x, size_t n) {
+  if (*x.type != TYPE_INT)
+    return;
+  for (size_t i = 0; i < n; i++)
+    x.v[i].d = (double)x.v[i].i;
+  *x.type = TYPE_DOUBLE;
+}
+
+static void vector_arithmetic(PredicateOpcode opcode, Vector a, Vector b, size_t n) {
+  if (!is_number(*a.type) || !is_number(*b.type)) {
+    *a.type = TYPE_UNKNOWN;
+    memset(a.valid, 0, n);
+    return;
+  }
+  if (opcode != PREDICATE_DIV && *a.type == TYPE_INT && *b.type == TYPE_INT) {
+    for (size_t i = 0; i < n; i++) {
+      int64_t r;
+      a.valid[i] &= b.valid[i] & (int_arithmetic(opcode, a.v[i].i, b.v[i].i, &r) == 0);
+      a.v[i].i = r;
+    }
+    return;
+  }
+  promote(a, n);
+  promote(b, n);
+  switch (opcode) {
+  case PREDICATE_ADD:
+    for (size_t i = 0; i < n; i++)
+      a.v[i].d += b.v[i].d;
+    break;
+  case PREDICATE_SUB:
+    for (size_t i = 0; i < n; i++)
+      a.v[i].d -= b.v[i].d;
+    break;
+  case PREDICATE_MUL:
+    for (size_t i = 0; i < n; i++)
+      a.v[i].d *= b.v[i].d;
+    break;
+  default:
+    for (size_t i = 0; i < n; i++) {
+      a.valid[i] &= b.v[i].d != 0.0;
+      a.v[i].d /= b.v[i].d;
+    }
+  }
+  for (size_t i = 0; i < n; i++)
+    a.valid[i] &= b.valid[i];
+}
+
+static void vector_compare(CompareOp op, Vector a, Vector b, size_t n) {
+  // Outcome of `op` for each three-way comparison result -1, 0, 1
+  const int64_t holds[3] = {compare_op_holds(op, -1), compare_op_holds(op, 0),
+                            compare_op_holds(op, 1)};
+  if (*a.type == TYPE_INT && *b.type == TYPE_INT) {
+    for (size_t i = 0; i < n; i++)
+      a.v[i].i = holds[CMP3(a.v[i].i, b.v[i].i) + 1];
+  } else if (is_number(*a.type) && is_number(*b.type)) {
+    promote(a, n);
+    promote(b, n);
+    for (size_t i = 0; i < n; i++)
+      a.v[i].i = holds[CMP3(a.v[i].d, b.v[i].d) + 1];
+  } else if (*a.type == TYPE_STRING && *b.type == TYPE_STRING) {
+    for (size_t i = 0; i < n; i++) {
+      // Invalid rows may hold stale pointers
+      int cmp = a.valid[i] && b.valid[i] ? strcmp(a.v[i].s, b.v[i].s) : 0;
+      a.v[i].i = holds[(cmp > 0) - (cmp < 0) + 1];
+    }
+  } else {
+    set_unknown(a, n);
+    return;
+  }
+  *a.type = TYPE_BOOL;
+  for (size_t i = 0; i < n; i++)
+    a.valid[i] &= b.valid[i];
+}
+
+static void vector_logic(PredicateOpcode opcode, Vector a, Vector b, size_t n) {
+  int64_t absorbing = opcode == PREDICATE_OR;
+  for (size_t i = 0; i < n; i++) {
+    uint8_t decided =
+        (a.valid[i] & (a.v[i].i == absorbing)) | (b.valid[i] & (b.v[i].i == absorbing));
+    uint8_t known = decided | (a.valid[i] & b.valid[i]);
+    a.v[i].i = decided ? absorbing : !absorbing;
+    a.valid[i] = known;
+  }
+}
+
+static int prepare_batch(Predicate *p) {
+  if (p->vectors)
+    return 0;
+  size_t rows = p->max_depth * BATCH_CAPACITY;
+  p->vectors = malloc(rows * sizeof(Scalar));
+  p->valid = malloc(rows);
+  p->vector_types = malloc(p->max_depth * sizeof(ValueType));
+  p->columns = malloc((p->slot_count ? p->slot_count : 1) * sizeof(int));
+  if (p->vectors && p->valid && p->vector_types && p->columns)
+    return 0;
+  free(p->vectors);
+  p->vectors = NULL;
+  return -1;
+}
+
+// Run the program over up to BATCH_CAPACITY rows; returns the surviving count
+static size_t select_chunk(Predicate *p, const ColumnBatch *b, const uint32_t *sel, size_t n,
+                           uint32_t *out) {
+  size_t sp = 0;
+  for (size_t pc = 0; pc < p->count; pc++) {
+    const PredicateInstruction *ins = &p->code[pc];
+    switch (ins->opcode) {
+    case PREDICATE_ATTRIBUTE: {
+      Vector v = vector_at(p, sp++);
+      int col = p->columns[ins->operand];
+      if (col < 0) {
+        *v.type = TYPE_UNKNOWN;
+        memset(v.valid, 0, n);
+      } else {
+        load_column(v, &b->columns[col], sel, n);
+      }
+      break;
+    }
+    case PREDICATE_CONSTANT:
+      broadcast(vector_at(p, sp++), p->constants[ins->operand], n);
+      break;
+    case PREDICATE_ADD:
+    case PREDICATE_SUB:
+    case PREDICATE_MUL:
+    case PREDICATE_DIV:
+      sp--;
+      vector_arithmetic(ins->opcode, vector_at(p, sp - 1), vector_at(p, sp), n);
+      break;
+    case PREDICATE_COMPARE:
+      sp--;
+      vector_compare((CompareOp)ins->operand, vector_at(p, sp - 1), vector_at(p, sp), n);
+      break;
+    case PREDICATE_AND:
+    case PREDICATE_OR:
+      sp--;
+      vector_logic(ins->opcode, vector_at(p, sp - 1), vector_at(p, sp), n);
+      break;
+    case PREDICATE_NOT: {
+      Vector v = vector_at(p, sp - 1);
+      for (size_t i = 0; i < n; i++)
+        v.v[i].i = !v.v[i].i;
+      break;
+    }
+    }
+  }
+
+  Vector result = vector_at(p, 0);
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    out[m] = sel[i];
+    m += result.valid[i] & (result.v[i].i != 0);
+  }
+  return m;
+}
+
+size_t predicate_select_batch(Predicate *p, const ColumnBatch *b, const uint32_t *sel, size_t n,
+                              uint32_t *out) {
+  if (prepare_batch(p) < 0)
+    return 0;
+  for (size_t s = 0; s < p->slot_count; s++)
+    p->columns[s] = column_batch_find(b, p->slots[s]);
+  size_t kept = 0;
+  for (size_t done = 0; done < n; done += BATCH_CAPACITY) {
+    size_t chunk = n - done < BATCH_CAPACITY ? n - done : BATCH_CAPACITY;
+    // `out` may alias `sel`, but never runs ahead of the chunk being read
+    kept += select_chunk(p, b, sel + done, chunk, out + kept);
+  }
+  return kept;
+}
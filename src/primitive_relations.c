@@ -1,6 +1,9 @@
+#include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "batch.h"
 #include "primitive_relations.h"
 
 /* Generator for successor relation R = {(x, x+1) | x ∈ N} */
@@ -26,6 +29,100 @@ Tuple *natural_generator(size_t n, void *userdata) {
   return t;
 }
 
+// Append up to `count` empty rows; returns how many fit
+static size_t append_rows(ColumnBatch *out, size_t count) {
+  size_t n = 0;
+  while (n < count && column_batch_append_row(out) >= 0)
+    n++;
+  return n;
+}
+
+// Set `column` to index + offset in the last `n` rows, the first holding index `start`
+static void fill_index_column(ColumnBatch *out, const char *column, size_t start, size_t n,
+                              int offset) {
+  int col = column_batch_find(out, column);
+  if (col < 0 || out->columns[col].type != ATTR_INT)
+    return;
+  ColumnVector *c = &out->columns[col];
+  size_t first = out->rows - n;
+  for (size_t i = 0; i < n; i++) {
+    ((int *)c->values)[first + i] = (int)(start + i) + offset;
+    c->valid[first + i] = 1;
+  }
+}
+
+size_t successor_batch_generator(size_t start, size_t count, ColumnBatch *out, void *userdata) {
+  (void)userdata;
+  size_t n = append_rows(out, count);
+  fill_index_column(out, "in", start, n, 0);
+  fill_index_column(out, "out", start, n, 1);
+  return n;
+}
+
+size_t natural_batch_generator(size_t start, size_t count, ColumnBatch *out, void *userdata) {
+  (void)userdata;
+  size_t n = append_rows(out, count);
+  fill_index_column(out, "n", start, n, 0);
+  return n;
+}
+
+// Indices i whose value i + offset satisfies `value op constant`
+static int monotone_index_range(double offset, CompareOp op, const Attribute *constant,
+                                IndexRange *out) {
+  if (!constant || !constant->value ||
+      (constant->type != ATTR_INT && constant->type != ATTR_RATIONAL))
+    return -1;
+  double c = constant->type == ATTR_INT ? *(int *)constant->value : *(double *)constant->value;
+  if (isnan(c))
+    return -1;
+  double k = c - offset; // the constraint on i itself
+  double limit = (double)SIZE_MAX / 2;
+  double begin = 0, end = INFINITY;
+  switch (op) {
+  case CMP_EQ:
+    begin = floor(k) == k ? k : 0;
+    end = floor(k) == k ? k + 1 : 0;
+    break;
+  case CMP_LT:
+    end = ceil(k);
+    break;
+  case CMP_LE:
+    end = floor(k) + 1;
+    break;
+  case CMP_GT:
+    begin = floor(k) + 1;
+    break;
+  case CMP_GE:
+    begin = ceil(k);
+    break;
+  case CMP_NE:
+    return -1;
+  }
+  begin = begin < 0 ? 0 : begin > limit ? limit : begin;
+  end = end < 0 ? 0 : end;
+  out->begin = (size_t)begin;
+  out->end = end > limit ? SIZE_MAX : (size_t)end;
+  return 0;
+}
+
+int natural_index_range(const char *attribute, CompareOp op, const Attribute *constant,
+                        IndexRange *out, void *userdata) {
+  (void)userdata;
+  if (strcmp(attribute, "n") != 0)
+    return -1;
+  return monotone_index_range(0, op, constant, out);
+}
+
+int successor_index_range(const char *attribute, CompareOp op, const Attribute *constant,
+                          IndexRange *out, void *userdata) {
+  (void)userdata;
+  if (strcmp(attribute, "in") == 0)
+    return monotone_index_range(0, op, constant, out);
+  if (strcmp(attribute, "out") == 0)
+    return monotone_index_range(1, op, constant, out);
+  return -1;
+}
+
 Tuple *integer_generator(size_t n, void *userdata) {
   (void)userdata; // to avoid annoying warning because I don't use it
   Tuple *t = tuple_create();
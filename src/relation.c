@@ -10,7 +10,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "index.h"
+#include "operator.h"
 #include "relation.h"
+#include "statistics.h"
 
 /* Compare tuples by their attributes — for simplicity, we'll compare by pointer equality here.
    Later we could define a real "tuple equal" check. */
@@ -47,9 +50,160 @@ Relation *relation_create(const char *name) {
   r->name = strdup(name);
   r->tuples = set_create(tuple_cmp, tuple_free);
   r->cardinality = cardinality_finite(0);
+  r->statistics = NULL;
+  r->indexes = NULL;
   return r;
 }
 
+/**
+ * @brief Project a relation onto a subset of attributes.
+ *
+ * Runs a scan → project pipeline; duplicate tuples produced by dropping
+ * attributes are eliminated.
+ *
+ * @param r Pointer to the input Relation.
+ * @param attr_names Array of attribute names to keep.
+ * @param num_attrs Number of attribute names in attr_names.
+ * @param new_name Name for the projected relation.
+ * @return Pointer to the new Relation, or NULL on failure.
+ */
+Relation *relation_project(const Relation *r, const char **attr_names, size_t num_attrs,
+                           const char *new_name) {
+  Operator *plan = operator_project(operator_scan(r), attr_names, num_attrs);
+  Relation *result = plan ? operator_collect(plan, new_name) : NULL;
+  operator_destroy(plan);
+  return result;
+}
+
+/* Set algebra */
+
+// Heading of a relation: that of its first tuple, or NULL when it is empty
+static Tuple *relation_heading(const Relation *r) {
+  SetIter it;
+  set_iter_init(r->tuples, &it);
+  return (Tuple *)set_iter_next(&it);
+}
+
+// Whether the inputs of a union, intersection or difference have the same heading
+static int relation_headings_equal(const Relation *a, const Relation *b) {
+  Tuple *ha = relation_heading(a), *hb = relation_heading(b);
+  return !ha || !hb || tuple_heading_equals(ha, hb);
+}
+
+// Run a binary plan over scans of `left` and `right` into a relation of cardinality `card`
+static Relation *relation_combine(Operator *(*combine)(Operator *, Operator *),
+                                  const Relation *left, const Relation *right, Cardinality card,
+                                  const char *new_name) {
+  Operator *plan = combine(operator_scan(left), operator_scan(right));
+  Relation *result = plan ? operator_collect(plan, new_name) : NULL;
+  operator_destroy(plan);
+  // The count of finite inputs is exact; a declared infinite cardinality carries over
+  if (result && !(cardinality_is_finite(left->cardinality) &&
+                  cardinality_is_finite(right->cardinality)))
+    result->cardinality = card;
+  return result;
+}
+
+/**
+ * @brief Union of two relations with the same heading.
+ *
+ * Duplicates are eliminated with a hash set of the tuples seen, so the
+ * union costs O(|left| + |right|).
+ *
+ * @param left First relation.
+ * @param right Second relation.
+ * @param new_name Name for the result.
+ * @return Pointer to the new Relation, or NULL on error or if the headings differ.
+ */
+Relation *relation_union(const Relation *left, const Relation *right, const char *new_name) {
+  if (!relation_headings_equal(left, right))
+    return NULL;
+  return relation_combine(operator_union, left, right,
+                          cardinality_union(left->cardinality, right->cardinality), new_name);
+}
+
+/**
+ * @brief Intersection of two relations with the same heading.
+ *
+ * The right relation is hashed, then the left one probes it.
+ *
+ * @param left First relation.
+ * @param right Second relation (hashed; ideally the smaller).
+ * @param new_name Name for the result.
+ * @return Pointer to the new Relation, or NULL on error or if the headings differ.
+ */
+Relation *relation_intersect(const Relation *left, const Relation *right, const char *new_name) {
+  if (!relation_headings_equal(left, right))
+    return NULL;
+  return relation_combine(operator_intersect, left, right,
+                          cardinality_intersection(left->cardinality, right->cardinality),
+                          new_name);
+}
+
+/**
+ * @brief Difference (left minus right) of two relations with the same heading.
+ *
+ * The right relation is hashed, then the left one probes it.
+ *
+ * @param left Relation whose tuples are kept.
+ * @param right Relation whose tuples are removed.
+ * @param new_name Name for the result.
+ * @return Pointer to the new Relation, or NULL on error or if the headings differ.
+ */
+Relation *relation_difference(const Relation *left, const Relation *right, const char *new_name) {
+  if (!relation_headings_equal(left, right))
+    return NULL;
+  return relation_combine(operator_difference, left, right,
+                          cardinality_difference(left->cardinality, right->cardinality),
+                          new_name);
+}
+
+// Cartesian product plan: a natural join on no attribute
+static Operator *operator_product(Operator *left, Operator *right) {
+  return operator_natural_join(left, right, NULL, 0);
+}
+
+/**
+ * @brief Divide one relation by another by grouping and counting.
+ *
+ * @param dividend Relation holding the quotient and divisor attributes.
+ * @param divisor Relation holding the divisor attributes.
+ * @param quotient_attrs Attributes of the result.
+ * @param quotient_count Number of quotient attributes.
+ * @param divisor_attrs Attributes matched against the divisor.
+ * @param divisor_count Number of divisor attributes.
+ * @param new_name Name for the result.
+ * @return Pointer to the new Relation, or NULL on error.
+ */
+Relation *relation_divide(const Relation *dividend, const Relation *divisor,
+                          const char **quotient_attrs, size_t quotient_count,
+                          const char **divisor_attrs, size_t divisor_count, const char *new_name) {
+  Operator *plan = operator_divide(operator_scan(dividend), operator_scan(divisor), quotient_attrs,
+                                   quotient_count, divisor_attrs, divisor_count);
+  Relation *result = plan ? operator_collect(plan, new_name) : NULL;
+  operator_destroy(plan);
+  return result;
+}
+
+/**
+ * @brief Cartesian product of two relations with disjoint headings.
+ *
+ * The right relation is buffered once and paired with every left tuple, so
+ * the product costs O(|left| + |right|) plus its output.
+ *
+ * @param left First relation.
+ * @param right Second relation (buffered; ideally the smaller).
+ * @param new_name Name for the result.
+ * @return Pointer to the new Relation, or NULL on error or if the headings share an attribute.
+ */
+Relation *relation_product(const Relation *left, const Relation *right, const char *new_name) {
+  Tuple *hl = relation_heading(left), *hr = relation_heading(right);
+  if (hl && hr && !tuple_heading_disjoint(hl, hr))
+    return NULL;
+  return relation_combine(operator_product, left, right,
+                          cardinality_product(left->cardinality, right->cardinality), new_name);
+}
+
 /**
  * @brief Create a new Relation with specified cardinality.
  *
@@ -74,7 +228,9 @@ void relation_destroy(Relation *r) {
   if (!r)
     return;
   free(r->name);
+  relation_indexes_destroy(r);
   set_destroy(r->tuples);
+  statistics_destroy(r->statistics);
   free(r);
 }
 
@@ -91,9 +247,51 @@ int relation_add_tuple(Relation *r, Tuple *t) {
     // Update finite cardinality
     r->cardinality.finite_count = set_size(r->tuples);
   }
+  if (result == 1 && r->statistics)
+    statistics_add_tuple(r->statistics, t);
+  if (result == 1 && r->indexes)
+    relation_indexes_add(r, &t, 1);
   return result;
 }
 
+/**
+ * @brief Add a batch of newly created tuples to a relation.
+ *
+ * Tuples are compared by identity, so tuples that were just created cannot
+ * already be members; the batch is linked in without membership checks.
+ *
+ * @param r Pointer to the Relation.
+ * @param tuples Newly created tuples (ownership is taken on success).
+ * @param count Number of tuples.
+ * @return 0 on success, -1 on error (no tuple is added).
+ */
+int relation_add_tuples(Relation *r, Tuple *const *tuples, size_t count) {
+  if (set_add_batch(r->tuples, (void *const *)tuples, count) < 0)
+    return -1;
+  relation_update_cardinality(r);
+  for (size_t i = 0; r->statistics && i < count; i++)
+    statistics_add_tuple(r->statistics, tuples[i]);
+  if (r->indexes)
+    relation_indexes_add(r, tuples, count);
+  return 0;
+}
+
+/**
+ * @brief Remove a tuple from a relation and its indexes, and destroy it.
+ *
+ * @param r Pointer to the Relation.
+ * @param t Member to remove (compared by identity).
+ * @return 1 if removed, 0 if `t` is not a member.
+ */
+int relation_remove_tuple(Relation *r, Tuple *t) {
+  if (!set_contains(r->tuples, t))
+    return 0;
+  relation_indexes_remove(r, t);
+  set_remove(r->tuples, t);
+  relation_update_cardinality(r);
+  return 1;
+}
+
 /**
  * @brief Update cardinality based on current tuple count.
  *
@@ -165,11 +363,20 @@ static void check_tuple_cb(void *element, void *userdata) {
 /**
  * @brief Find a tuple in a relation matching the target.
  *
+ * Uses an index when the target holds all of its attributes, and scans otherwise.
+ *
  * @param r Pointer to the Relation.
  * @param target Pointer to the Tuple to find.
  * @return Pointer to the found Tuple, or NULL if not found.
  */
 Tuple *relation_find_tuple(Relation *r, Tuple *target) {
+  IndexCursor cursor;
+  if (relation_indexes_probe(r, target, &cursor) == 0) {
+    for (Tuple *t; (t = index_cursor_next(&cursor)) != NULL;)
+      if (tuple_equals(t, target))
+        return t;
+    return NULL;
+  }
   FindTupleContext ctx = {.target = target, .found = NULL};
   set_foreach(r->tuples, check_tuple_cb, &ctx);
   return ctx.found;
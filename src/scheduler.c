@@ -0,0 +1,339 @@
+/**
+ * @file scheduler.c
+ * @brief Work-stealing scheduler: per-worker deques over a fixed thread pool.
+ *
+ * Idle workers sleep on a condition variable. A spawn only takes the idle
+ * lock when some worker is asleep; the `queued` and `sleeping` counters are
+ * sequentially consistent, so either the spawner sees the sleeper or the
+ * sleeper sees the new task, and no wake-up is lost.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "scheduler.h"
+
+typedef struct {
+  TaskFn fn;
+  void *arg;
+  TaskGroup *group;
+} Task;
+
+// Ring buffer: the top (oldest task) is at `head`, the bottom at head + count - 1
+typedef struct {
+  pthread_mutex_t lock;
+  Task *tasks;
+  size_t head;
+  size_t count;
+  size_t capacity;
+} TaskDeque;
+
+typedef struct {
+  Scheduler *scheduler;
+  unsigned index;
+} Worker;
+
+struct Scheduler {
+  unsigned threads; // workers running
+  unsigned deque_count;
+  pthread_t *tids;
+  Worker *workers;
+  TaskDeque *deques;
+  atomic_size_t queued; // tasks in all the deques
+  atomic_uint sleeping;
+  atomic_uint next_deque; // round-robin target of spawns from outside the pool
+  atomic_int stopping;
+  pthread_mutex_t idle_lock;
+  pthread_cond_t idle;
+};
+
+// The worker running on this thread, if any
+static _Thread_local Worker *current_worker;
+
+static int deque_init(TaskDeque *d) {
+  memset(d, 0, sizeof(TaskDeque));
+  return pthread_mutex_init(&d->lock, NULL) == 0 ? 0 : -1;
+}
+
+static void deque_free(TaskDeque *d) {
+  pthread_mutex_destroy(&d->lock);
+  free(d->tasks);
+}
+
+static int deque_push_bottom(TaskDeque *d, Task task) {
+  pthread_mutex_lock(&d->lock);
+  if (d->count == d->capacity) {
+    size_t cap = d->capacity ? d->capacity * 2 : 64;
+    Task *tasks = malloc(cap * sizeof(Task));
+    if (!tasks) {
+      pthread_mutex_unlock(&d->lock);
+      return -1;
+    }
+    for (size_t i = 0; i < d->count; i++)
+      tasks[i] = d->tasks[(d->head + i) % d->capacity];
+    free(d->tasks);
+    d->tasks = tasks;
+    d->head = 0;
+    d->capacity = cap;
+  }
+  d->tasks[(d->head + d->count) % d->capacity] = task;
+  d->count++;
+  pthread_mutex_unlock(&d->lock);
+  return 0;
+}
+
+// The owner takes the newest task
+static int deque_pop_bottom(TaskDeque *d, Task *out) {
+  pthread_mutex_lock(&d->lock);
+  int found = d->count > 0;
+  if (found) {
+    d->count--;
+    *out = d->tasks[(d->head + d->count) % d->capacity];
+  }
+  pthread_mutex_unlock(&d->lock);
+  return found;
+}
+
+// Thieves take the oldest task
+static int deque_steal_top(TaskDeque *d, Task *out) {
+  if (pthread_mutex_trylock(&d->lock) != 0)
+    return 0;
+  int found = d->count > 0;
+  if (found) {
+    *out = d->tasks[d->head];
+    d->head = (d->head + 1) % d->capacity;
+    d->count--;
+  }
+  pthread_mutex_unlock(&d->lock);
+  return found;
+}
+
+// Take the newest task of `group`, wherever it sits in the deque
+static int deque_take_group(TaskDeque *d, TaskGroup *group, Task *out) {
+  if (pthread_mutex_trylock(&d->lock) != 0)
+    return 0;
+  int found = 0;
+  for (size_t i = d->count; i-- > 0;) {
+    if (d->tasks[(d->head + i) % d->capacity].group != group)
+      continue;
+    *out = d->tasks[(d->head + i) % d->capacity];
+    for (size_t j = i + 1; j < d->count; j++)
+      d->tasks[(d->head + j - 1) % d->capacity] = d->tasks[(d->head + j) % d->capacity];
+    d->count--;
+    found = 1;
+    break;
+  }
+  pthread_mutex_unlock(&d->lock);
+  return found;
+}
+
+// Take a task of `group` from any deque, the caller's own first
+static int find_group_task(Scheduler *s, Worker *self, TaskGroup *group, Task *out) {
+  if (atomic_load(&s->queued) == 0)
+    return 0;
+  unsigned start = self ? self->index : 0;
+  for (unsigned i = 0; i < s->threads; i++) {
+    if (deque_take_group(&s->deques[(start + i) % s->threads], group, out)) {
+      atomic_fetch_sub(&s->queued, 1);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Take a task: from the worker's own deque first, then from the others
+static int find_task(Scheduler *s, Worker *self, Task *out) {
+  unsigned start = 0;
+  if (self) {
+    if (deque_pop_bottom(&s->deques[self->index], out))
+      goto found;
+    start = self->index + 1;
+  }
+  if (atomic_load(&s->queued) == 0)
+    return 0;
+  for (unsigned i = 0; i < s->threads; i++) {
+    unsigned victim = (start + i) % s->threads;
+    if ((!self || victim != self->index) && deque_steal_top(&s->deques[victim], out))
+      goto found;
+  }
+  return 0;
+found:
+  atomic_fetch_sub(&s->queued, 1);
+  return 1;
+}
+
+static void run_task(Task *task) {
+  task->fn(task->arg);
+  __atomic_fetch_sub(&task->group->pending, 1, __ATOMIC_RELEASE);
+}
+
+static void *worker_main(void *arg) {
+  Worker *self = (Worker *)arg;
+  Scheduler *s = self->scheduler;
+  current_worker = self;
+  Task task;
+  for (;;) {
+    if (find_task(s, self, &task)) {
+      run_task(&task);
+      continue;
+    }
+    pthread_mutex_lock(&s->idle_lock);
+    if (atomic_load(&s->stopping) && atomic_load(&s->queued) == 0) {
+      pthread_mutex_unlock(&s->idle_lock);
+      break;
+    }
+    atomic_fetch_add(&s->sleeping, 1);
+    while (atomic_load(&s->queued) == 0 && !atomic_load(&s->stopping))
+      pthread_cond_wait(&s->idle, &s->idle_lock);
+    atomic_fetch_sub(&s->sleeping, 1);
+    pthread_mutex_unlock(&s->idle_lock);
+  }
+  current_worker = NULL;
+  return NULL;
+}
+
+Scheduler *scheduler_create(unsigned threads) {
+  if (threads == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = online > 0 ? (unsigned)online : 1;
+  }
+  if (threads > SCHEDULER_MAX_THREADS)
+    threads = SCHEDULER_MAX_THREADS;
+
+  Scheduler *s = calloc(1, sizeof(Scheduler));
+  if (!s)
+    return NULL;
+  s->tids = calloc(threads, sizeof(pthread_t));
+  s->workers = calloc(threads, sizeof(Worker));
+  s->deques = calloc(threads, sizeof(TaskDeque));
+  if (!s->tids || !s->workers || !s->deques) {
+    free(s->tids);
+    free(s->workers);
+    free(s->deques);
+    free(s);
+    return NULL;
+  }
+  pthread_mutex_init(&s->idle_lock, NULL);
+  pthread_cond_init(&s->idle, NULL);
+  for (unsigned i = 0; i < threads; i++) {
+    deque_init(&s->deques[i]);
+    s->workers[i] = (Worker){.scheduler = s, .index = i};
+  }
+  s->deque_count = threads;
+
+  // Deques are in place before any worker may steal from them
+  for (unsigned i = 0; i < threads; i++) {
+    if (pthread_create(&s->tids[i], NULL, worker_main, &s->workers[i]) != 0)
+      break;
+    s->threads = i + 1;
+  }
+  if (s->threads == 0) {
+    scheduler_destroy(s);
+    return NULL;
+  }
+  return s;
+}
+
+void scheduler_destroy(Scheduler *s) {
+  if (!s)
+    return;
+  pthread_mutex_lock(&s->idle_lock);
+  atomic_store(&s->stopping, 1);
+  pthread_cond_broadcast(&s->idle);
+  pthread_mutex_unlock(&s->idle_lock);
+  for (unsigned i = 0; i < s->threads; i++)
+    pthread_join(s->tids[i], NULL);
+  for (unsigned i = 0; i < s->deque_count; i++)
+    deque_free(&s->deques[i]);
+  pthread_cond_destroy(&s->idle);
+  pthread_mutex_destroy(&s->idle_lock);
+  free(s->tids);
+  free(s->workers);
+  free(s->deques);
+  free(s);
+}
+
+unsigned scheduler_threads(const Scheduler *s) { return s->threads; }
+
+int scheduler_spawn(Scheduler *s, TaskGroup *group, TaskFn fn, void *arg) {
+  Worker *self = current_worker && current_worker->scheduler == s ? current_worker : NULL;
+  unsigned target = self ? self->index : atomic_fetch_add(&s->next_deque, 1) % s->threads;
+  Task task = {.fn = fn, .arg = arg, .group = group};
+
+  __atomic_fetch_add(&group->pending, 1, __ATOMIC_SEQ_CST);
+  atomic_fetch_add(&s->queued, 1);
+  if (deque_push_bottom(&s->deques[target], task) < 0) {
+    atomic_fetch_sub(&s->queued, 1);
+    run_task(&task);
+    return -1;
+  }
+  if (atomic_load(&s->sleeping) > 0) {
+    pthread_mutex_lock(&s->idle_lock);
+    pthread_cond_signal(&s->idle);
+    pthread_mutex_unlock(&s->idle_lock);
+  }
+  return 0;
+}
+
+void scheduler_wait(Scheduler *s, TaskGroup *group) {
+  Worker *self = current_worker && current_worker->scheduler == s ? current_worker : NULL;
+  unsigned idle_rounds = 0;
+  Task task;
+  // Only the group's own tasks: a task of another group may need a lock the caller holds
+  while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) > 0) {
+    if (find_group_task(s, self, group, &task)) {
+      run_task(&task);
+      idle_rounds = 0;
+    } else if (++idle_rounds < 64) {
+      sched_yield();
+    } else {
+      // The remaining tasks are running elsewhere; stop competing for the CPU
+      struct timespec pause = {.tv_sec = 0, .tv_nsec = 50000};
+      nanosleep(&pause, NULL);
+    }
+  }
+}
+
+typedef struct {
+  RangeFn body;
+  void *arg;
+  size_t begin;
+  size_t end;
+} RangeTask;
+
+static void range_task(void *arg) {
+  RangeTask *r = (RangeTask *)arg;
+  r->body(r->begin, r->end, r->arg);
+}
+
+int scheduler_parallel_for(Scheduler *s, size_t count, size_t grain, RangeFn body, void *arg) {
+  if (count == 0)
+    return 0;
+  if (grain == 0)
+    grain = 1;
+  size_t ranges = (count + grain - 1) / grain;
+  if (!s || ranges == 1) {
+    body(0, count, arg);
+    return 0;
+  }
+  RangeTask *tasks = malloc(ranges * sizeof(RangeTask));
+  if (!tasks) {
+    body(0, count, arg);
+    return -1;
+  }
+  TaskGroup group = TASK_GROUP_INIT;
+  int status = 0;
+  for (size_t i = 0; i < ranges; i++) {
+    size_t end = (i + 1) * grain < count ? (i + 1) * grain : count;
+    tasks[i] = (RangeTask){.body = body, .arg = arg, .begin = i * grain, .end = end};
+    if (scheduler_spawn(s, &group, range_task, &tasks[i]) < 0)
+      status = -1;
+  }
+  scheduler_wait(s, &group);
+  free(tasks);
+  return status;
+}
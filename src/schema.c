@@ -0,0 +1,366 @@
+/**
+ * @file schema.c
+ * @brief Schema (catalog of named relations) for the Relational Algebra Engine.
+ *
+ * Relations are indexed by name in a hash map, so resolving the relation a
+ * command refers to costs one hash of the name regardless of schema size.
+ * Relations loaded from a snapshot are decoded lazily by the lookups.
+ *
+ * While a WAL is attached, every mutation applied since the last commit is
+ * also recorded in memory, so that schema_commit can undo the batch when the
+ * log fails to make it durable.
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "schema.h"
+#include "snapshot.h"
+#include "statistics.h"
+#include "wal.h"
+
+// Relations are owned by the schema and released with it
+static void relation_free(void *r) { relation_destroy((Relation *)r); }
+
+// A mutation not yet made durable: a tuple added to `relation`, or the
+// creation of `relation` itself when `tuple` is NULL
+typedef struct SchemaChange {
+  Relation *relation;
+  Tuple *tuple;
+} SchemaChange;
+
+// Make room for `count` more changes, so recording them after a mutation cannot fail
+static int reserve_changes(Schema *s, size_t count) {
+  if (!s->wal)
+    return 0;
+  // Nothing pending means the recorded changes were committed through the log directly
+  if (wal_pending(s->wal) == 0)
+    s->change_count = 0;
+  if (s->change_count + count <= s->change_capacity)
+    return 0;
+  size_t cap = s->change_capacity ? s->change_capacity : 64;
+  while (cap < s->change_count + count)
+    cap *= 2;
+  SchemaChange *changes = realloc(s->changes, cap * sizeof(*changes));
+  if (!changes)
+    return -1;
+  s->changes = changes;
+  s->change_capacity = cap;
+  return 0;
+}
+
+static void record_change(Schema *s, Relation *r, Tuple *t) {
+  if (s->wal)
+    s->changes[s->change_count++] = (SchemaChange){.relation = r, .tuple = t};
+}
+
+// Create a new schema
+Schema *schema_create(void) {
+  Schema *s = malloc(sizeof(Schema));
+  if (!s)
+    return NULL;
+  // Keys point at each relation's own name, so only values are freed
+  s->relations = hash_map_create(hash_string, hash_string_equals, NULL, relation_free);
+  if (!s->relations) {
+    free(s);
+    return NULL;
+  }
+  s->wal = NULL;
+  s->snapshot = NULL;
+  s->unmaterialized = NULL;
+  s->snapshot_path = NULL;
+  s->load_dir = NULL;
+  s->materialize_failed = 0;
+  s->changes = NULL;
+  s->change_count = 0;
+  s->change_capacity = 0;
+  return s;
+}
+
+// Create a schema from its snapshot and write-ahead log (either may be absent)
+Schema *schema_open(const char *snapshot_path, const char *wal_path) {
+  Schema *s = schema_create();
+  if (!s)
+    return NULL;
+
+  if (snapshot_path) {
+    s->snapshot_path = strdup(snapshot_path);
+    Snapshot *snap = snapshot_open(snapshot_path);
+    if (snap) {
+      long loaded = schema_load_snapshot(s, snap);
+      if (loaded < 0) {
+        log_error("schema", "failed to load snapshot %s", snapshot_path);
+        schema_destroy(s);
+        return NULL;
+      }
+      log_info("schema", "mapped %ld relations from %s (epoch %lu)", loaded, snapshot_path,
+               (unsigned long)snapshot_epoch(snap));
+    } else if (errno != ENOENT) {
+      log_error("schema", "failed to open snapshot %s: %s", snapshot_path, strerror(errno));
+      schema_destroy(s);
+      return NULL;
+    }
+  }
+  if (!wal_path)
+    return s;
+
+  Wal *wal = wal_open(wal_path);
+  if (!wal) {
+    log_error("schema", "failed to open write-ahead log %s: %s", wal_path, strerror(errno));
+    schema_destroy(s);
+    return NULL;
+  }
+  s->wal = wal;
+
+  long applied = wal_replay(wal, s);
+  if (applied < 0) {
+    log_error("schema", "failed to replay write-ahead log %s", wal_path);
+    schema_destroy(s);
+    return NULL;
+  }
+  log_info("schema", "replayed %ld records from %s", applied, wal_path);
+  return s;
+}
+
+// A name that is not NUL-terminated, used to probe the catalog
+typedef struct {
+  const char *name;
+  size_t len;
+} NameProbe;
+
+static int name_probe_equals(const void *stored, const void *probe) {
+  const char *name = (const char *)stored;
+  const NameProbe *p = (const NameProbe *)probe;
+  // strlen first: the probe may hold a NUL, and name may be shorter than it
+  return strlen(name) == p->len && memcmp(name, p->name, p->len) == 0;
+}
+
+// Drop the rows a failed materialization decoded before it stopped
+static void discard_rows(Relation *r) {
+  size_t count = set_size(r->tuples);
+  Tuple **rows = malloc((count ? count : 1) * sizeof(*rows));
+  if (!rows)
+    return;
+  SetIter it;
+  set_iter_init(r->tuples, &it);
+  for (size_t i = 0; i < count; i++)
+    rows[i] = set_iter_next(&it);
+  for (size_t i = 0; i < count; i++)
+    relation_remove_tuple(r, rows[i]);
+  free(rows);
+}
+
+// Decode a relation's rows from the snapshot the first time it is used.
+// On failure the relation is left empty and still backed by the snapshot,
+// and the lookup fails rather than return a partial relation.
+static Relation *materialize(Schema *s, Relation *r) {
+  if (!r || !s->unmaterialized || hash_map_size(s->unmaterialized) == 0)
+    return r;
+  SnapshotRelation *entry = hash_map_get(s->unmaterialized, r->name);
+  if (!entry)
+    return r;
+  if (snapshot_materialize(entry, r) < 0) {
+    log_error("schema", "failed to decode %s from the snapshot", r->name);
+    s->materialize_failed = 1;
+    discard_rows(r);
+    r->cardinality = cardinality_finite(entry->rows);
+    return NULL;
+  }
+  hash_map_remove(s->unmaterialized, r->name);
+  relation_update_cardinality(r);
+  return r;
+}
+
+// Find a relation in schema by name
+Relation *schema_find_relation(Schema *s, const char *name) {
+  return materialize(s, hash_map_get(s->relations, name));
+}
+
+// Find a relation in schema by a name that need not be NUL-terminated
+Relation *schema_find_relation_n(Schema *s, const char *name, size_t len) {
+  NameProbe probe = {.name = name, .len = len};
+  return materialize(
+      s, hash_map_find(s->relations, hash_bytes(name, len), &probe, name_probe_equals));
+}
+
+// Add a relation to schema
+int schema_add_relation(Schema *s, Relation *r) {
+  if (hash_map_get(s->relations, r->name))
+    return 0;
+  if (relation_enable_statistics(r) < 0)
+    return -1;
+  return hash_map_put(s->relations, r->name, r);
+}
+
+// Create a relation and register it, logging the mutation first when durable
+int schema_create_relation(Schema *s, const char *name, Relation **out) {
+  if (hash_map_get(s->relations, name))
+    return 0;
+  if (reserve_changes(s, 1) < 0)
+    return -1;
+  size_t mark = s->wal ? wal_pending(s->wal) : 0;
+  if (s->wal && wal_log_create_relation(s->wal, name) < 0) {
+    log_error("schema", "failed to log creation of %s", name);
+    wal_rollback(s->wal, mark);
+    return -1;
+  }
+  Relation *r = relation_create(name);
+  if (!r || relation_enable_statistics(r) < 0 || hash_map_put(s->relations, r->name, r) < 0) {
+    relation_destroy(r);
+    if (s->wal)
+      wal_rollback(s->wal, mark);
+    return -1;
+  }
+  record_change(s, r, NULL);
+  if (out)
+    *out = r;
+  return 1;
+}
+
+// Insert a tuple, logging the mutation first when durable
+int schema_insert_tuple(Schema *s, Relation *r, Tuple *t) {
+  if (reserve_changes(s, 1) < 0)
+    return -1;
+  size_t mark = s->wal ? wal_pending(s->wal) : 0;
+  if (s->wal && wal_log_add_tuple(s->wal, r->name, t) < 0) {
+    log_error("schema", "failed to log tuple for %s", r->name);
+    wal_rollback(s->wal, mark);
+    return -1;
+  }
+  int result = relation_add_tuple(r, t);
+  // Duplicates and failed inserts change nothing, so neither may be logged
+  if (result != 1 && s->wal)
+    wal_rollback(s->wal, mark);
+  if (result == 1)
+    record_change(s, r, t);
+  return result;
+}
+
+// Register the relations of a snapshot, deferring their rows
+long schema_load_snapshot(Schema *s, Snapshot *snap) {
+  if (!s->unmaterialized) {
+    // Keys are the relations' own names; entries belong to the snapshot
+    s->unmaterialized = hash_map_create(hash_string, hash_string_equals, NULL, NULL);
+    if (!s->unmaterialized)
+      return -1;
+  }
+  s->snapshot = snap;
+
+  long loaded = 0;
+  for (size_t i = 0; i < snapshot_relation_count(snap); i++) {
+    SnapshotRelation *entry = snapshot_relation_at(snap, i);
+    if (hash_map_get(s->relations, entry->name)) {
+      log_warn("schema", "snapshot lists %s twice; keeping the first", entry->name);
+      continue;
+    }
+    Relation *r = relation_create(entry->name);
+    if (!r || relation_enable_statistics(r) < 0) {
+      relation_destroy(r);
+      return -1;
+    }
+    r->cardinality = cardinality_finite(entry->rows);
+    if (hash_map_put(s->relations, r->name, r) < 0) {
+      relation_destroy(r);
+      return -1;
+    }
+    if (hash_map_put(s->unmaterialized, r->name, entry) < 0)
+      return -1;
+    loaded++;
+  }
+  return loaded;
+}
+
+// Snapshot the schema and start a new log generation
+int schema_checkpoint(Schema *s) {
+  if (!s->snapshot_path)
+    return -1;
+  // A relation that could not be decoded would be written from whatever it holds
+  if (s->materialize_failed) {
+    log_error("schema", "refusing to checkpoint: a relation failed to load from %s",
+              s->snapshot_path);
+    return -1;
+  }
+  if (schema_commit(s) < 0)
+    return -1;
+  uint64_t epoch = (s->wal ? wal_epoch(s->wal) : s->snapshot ? snapshot_epoch(s->snapshot) : 0) + 1;
+  if (snapshot_write(s, s->snapshot_path, epoch) < 0)
+    return -1;
+  if (s->wal && wal_truncate(s->wal, epoch) < 0)
+    return -1;
+  log_info("schema", "checkpoint written to %s at epoch %lu", s->snapshot_path,
+           (unsigned long)epoch);
+  return 0;
+}
+
+// Insert a batch of new tuples, logging each first when durable
+int schema_insert_tuples(Schema *s, Relation *r, Tuple *const *tuples, size_t count) {
+  if (reserve_changes(s, count) < 0)
+    return -1;
+  size_t mark = s->wal ? wal_pending(s->wal) : 0;
+  for (size_t i = 0; s->wal && i < count; i++) {
+    if (wal_log_add_tuple(s->wal, r->name, tuples[i]) < 0) {
+      log_error("schema", "failed to log tuples for %s", r->name);
+      wal_rollback(s->wal, mark);
+      return -1;
+    }
+  }
+  if (relation_add_tuples(r, tuples, count) < 0) {
+    if (s->wal)
+      wal_rollback(s->wal, mark);
+    return -1;
+  }
+  for (size_t i = 0; i < count; i++)
+    record_change(s, r, tuples[i]);
+  return 0;
+}
+
+// Make the logged mutations durable, or undo them (newest first) if the log fails
+int schema_commit(Schema *s) {
+  if (!s->wal)
+    return 0;
+  int status = wal_commit(s->wal);
+  if (status < 0) {
+    log_error("schema", "undoing %zu mutations the log could not commit", s->change_count);
+    while (s->change_count > 0) {
+      SchemaChange *c = &s->changes[--s->change_count];
+      if (c->tuple)
+        relation_remove_tuple(c->relation, c->tuple);
+      else
+        hash_map_remove(s->relations, c->relation->name);
+    }
+  }
+  s->change_count = 0;
+  return status;
+}
+
+typedef struct {
+  SetIterFn fn;
+  void *userdata;
+} SchemaForeachContext;
+
+static void schema_foreach_cb(void *key, void *value, void *userdata) {
+  (void)key;
+  SchemaForeachContext *ctx = (SchemaForeachContext *)userdata;
+  ctx->fn(value, ctx->userdata);
+}
+
+// Iterate over every relation in the schema
+void schema_foreach(Schema *s, SetIterFn fn, void *userdata) {
+  SchemaForeachContext ctx = {.fn = fn, .userdata = userdata};
+  hash_map_foreach(s->relations, schema_foreach_cb, &ctx);
+}
+
+// Destroy schema, its log and all relations
+void schema_destroy(Schema *s) {
+  if (!s)
+    return;
+  wal_close(s->wal);
+  hash_map_destroy(s->relations);
+  hash_map_destroy(s->unmaterialized);
+  snapshot_close(s->snapshot);
+  free(s->snapshot_path);
+  free(s->load_dir);
+  free(s->changes);
+  free(s);
+}
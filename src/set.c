@@ -9,6 +9,8 @@
 #include "set.h"
 #include <stdlib.h>
 
+#include "metrics.h"
+
 typedef struct SetNode {
   void *data;
   struct SetNode *next;
@@ -83,6 +85,7 @@ int set_contains(const Set *set, const void *elem) {
  * @return 1 if added, 0 if already present, -1 on error.
  */
 int set_add(Set *set, void *elem) {
+  metrics_add(METRIC_SET_ADDS, 1);
   if (set_contains(set, elem))
     return 0; // already present
   SetNode *n = malloc(sizeof(SetNode));
@@ -95,6 +98,43 @@ int set_add(Set *set, void *elem) {
   return 1;
 }
 
+/**
+ * @brief Add elements that are known not to be in the Set.
+ *
+ * Skips the linear membership check of set_add, so building a set of n new
+ * elements costs O(n) instead of O(n^2).
+ *
+ * @param set Pointer to the Set.
+ * @param elems Elements to add; distinct from each other and from the members.
+ * @param count Number of elements.
+ * @return 0 on success, -1 on error (the Set is left unchanged).
+ */
+int set_add_batch(Set *set, void *const *elems, size_t count) {
+  SetNode *head = NULL, *tail = NULL;
+  for (size_t i = 0; i < count; i++) {
+    SetNode *n = malloc(sizeof(SetNode));
+    if (!n) {
+      while (head) {
+        SetNode *next = head->next;
+        free(head);
+        head = next;
+      }
+      return -1;
+    }
+    n->data = elems[i];
+    n->next = head;
+    head = n;
+    if (!tail)
+      tail = n;
+  }
+  if (tail) {
+    tail->next = set->head;
+    set->head = head;
+  }
+  set->size += count;
+  return 0;
+}
+
 /**
  * @brief Remove an element from a Set.
  *
@@ -142,3 +182,25 @@ void set_foreach(const Set *set, SetIterFn fn, void *userdata) {
     fn(n->data, userdata);
   }
 }
+
+/**
+ * @brief Position a cursor before the first element of a Set.
+ *
+ * @param set Pointer to the Set.
+ * @param it Cursor to initialise.
+ */
+void set_iter_init(const Set *set, SetIter *it) { it->node = set->head; }
+
+/**
+ * @brief Return the element under a cursor and advance it.
+ *
+ * @param it Cursor (see set_iter_init).
+ * @return The element, or NULL when the Set is exhausted.
+ */
+void *set_iter_next(SetIter *it) {
+  const SetNode *n = (const SetNode *)it->node;
+  if (!n)
+    return NULL;
+  it->node = n->next;
+  return n->data;
+}
@@ -0,0 +1,436 @@
+/**
+ * @file snapshot.c
+ * @brief Writing and lazily loading memory-mapped snapshots.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash_map.h"
+#include "log.h"
+#include "schema.h"
+#include "snapshot.h"
+#include "wire.h"
+
+#define SNAPSHOT_HEADER_SIZE 36
+#define SNAPSHOT_BATCH_ROWS 1024
+
+struct Snapshot {
+  void *base;
+  size_t size;
+  uint64_t epoch;
+  SnapshotRelation *relations;
+  size_t relation_count;
+};
+
+// Copy a wire string view into a NUL-terminated buffer
+static char *string_dup(const char *s, size_t len) {
+  char *copy = malloc(len + 1);
+  if (!copy)
+    return NULL;
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+static void snapshot_relation_free(SnapshotRelation *e) {
+  free(e->name);
+  for (uint16_t i = 0; i < e->column_count; i++)
+    free(e->column_names[i]);
+  free(e->column_names);
+  free(e->column_tags);
+}
+
+// Parse one directory entry; returns 0 on success
+static int read_directory_entry(Snapshot *snap, WireReader *in, SnapshotRelation *e) {
+  size_t len;
+  memset(e, 0, sizeof(*e));
+  const char *name = wire_get_string(in, &len);
+  if (!name || !(e->name = string_dup(name, len)))
+    return -1;
+  e->rows = wire_get_u64(in);
+  e->column_count = wire_get_u16(in);
+  e->column_names = calloc(e->column_count ? e->column_count : 1, sizeof(char *));
+  e->column_tags = calloc(e->column_count ? e->column_count : 1, 1);
+  if (!e->column_names || !e->column_tags)
+    return -1;
+  for (uint16_t i = 0; i < e->column_count; i++) {
+    const char *column = wire_get_string(in, &len);
+    if (!column || !(e->column_names[i] = string_dup(column, len)))
+      return -1;
+    e->column_tags[i] = wire_get_u8(in);
+  }
+  uint64_t offset = wire_get_u64(in);
+  e->block_length = wire_get_u64(in);
+  if (in->error || offset > snap->size || e->block_length > snap->size - offset)
+    return -1;
+  e->block = (const unsigned char *)snap->base + offset;
+  return 0;
+}
+
+Snapshot *snapshot_open(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < SNAPSHOT_HEADER_SIZE) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  size_t size = (size_t)st.st_size;
+  void *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  Snapshot *snap = calloc(1, sizeof(Snapshot));
+  if (!snap) {
+    munmap(base, size);
+    return NULL;
+  }
+  snap->base = base;
+  snap->size = size;
+
+  WireReader header;
+  wire_reader_init(&header, base, SNAPSHOT_HEADER_SIZE);
+  const unsigned char *magic = header.data;
+  header.offset = 4;
+  uint32_t version = wire_get_u32(&header);
+  snap->epoch = wire_get_u64(&header);
+  uint32_t count = wire_get_u32(&header);
+  uint64_t dir_offset = wire_get_u64(&header);
+  uint64_t dir_length = wire_get_u64(&header);
+
+  if (memcmp(magic, SNAPSHOT_MAGIC, 4) != 0 || version != SNAPSHOT_VERSION ||
+      dir_offset > size || dir_length > size - dir_offset) {
+    log_error("snapshot", "%s is not a valid snapshot", path);
+    snapshot_close(snap);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  snap->relations = calloc(count ? count : 1, sizeof(SnapshotRelation));
+  if (!snap->relations) {
+    snapshot_close(snap);
+    return NULL;
+  }
+
+  WireReader dir;
+  wire_reader_init(&dir, (const unsigned char *)base + dir_offset, dir_length);
+  for (uint32_t i = 0; i < count; i++) {
+    int status = read_directory_entry(snap, &dir, &snap->relations[i]);
+    snap->relation_count++;
+    if (status < 0) {
+      log_error("snapshot", "%s has a corrupt directory", path);
+      snapshot_close(snap);
+      errno = EINVAL;
+      return NULL;
+    }
+  }
+
+  // Row blocks are read front to back exactly once when materialized
+  madvise(base, size, MADV_SEQUENTIAL);
+  return snap;
+}
+
+void snapshot_close(Snapshot *snap) {
+  if (!snap)
+    return;
+  for (size_t i = 0; i < snap->relation_count; i++)
+    snapshot_relation_free(&snap->relations[i]);
+  free(snap->relations);
+  munmap(snap->base, snap->size);
+  free(snap);
+}
+
+uint64_t snapshot_epoch(const Snapshot *snap) { return snap->epoch; }
+
+size_t snapshot_relation_count(const Snapshot *snap) { return snap->relation_count; }
+
+SnapshotRelation *snapshot_relation_at(Snapshot *snap, size_t i) {
+  return i < snap->relation_count ? &snap->relations[i] : NULL;
+}
+
+// Hand decoded tuples to the relation in one batch
+static int flush_rows(Relation *r, Tuple **batch, size_t *count) {
+  int status = relation_add_tuples(r, batch, *count);
+  if (status < 0) {
+    for (size_t i = 0; i < *count; i++)
+      tuple_destroy(batch[i]);
+  }
+  *count = 0;
+  return status;
+}
+
+long snapshot_materialize(const SnapshotRelation *entry, Relation *r) {
+  WireReader in;
+  wire_reader_init(&in, entry->block, entry->block_length);
+
+  // Snapshot rows are distinct tuples, so they are inserted without membership checks
+  Tuple *batch[SNAPSHOT_BATCH_ROWS];
+  size_t pending = 0;
+  long added = 0;
+  for (uint64_t row = 0; row < entry->rows; row++) {
+    Tuple *t = tuple_create();
+    for (uint16_t c = 0; c < entry->column_count; c++) {
+      AttributeType type;
+      void *value = wire_get_value(&in, &type);
+      if (in.error) {
+        tuple_destroy(t);
+        flush_rows(r, batch, &pending);
+        return -1;
+      }
+      if (value)
+        tuple_add_attribute(t, attribute_create(entry->column_names[c], type, value));
+    }
+    batch[pending++] = t;
+    if (pending == SNAPSHOT_BATCH_ROWS) {
+      if (flush_rows(r, batch, &pending) < 0)
+        return -1;
+      added += SNAPSHOT_BATCH_ROWS;
+    }
+  }
+  size_t tail = pending;
+  if (flush_rows(r, batch, &pending) < 0)
+    return -1;
+  return added + (long)tail;
+}
+
+// Union of attribute names over a relation's tuples, in first-seen order
+typedef struct {
+  HashMap *index; // name -> (column + 1)
+  const Attribute **columns;
+  size_t count;
+  size_t capacity;
+  int error;
+} HeadingBuilder;
+
+static void heading_attr_cb(void *element, void *userdata) {
+  Attribute *attr = (Attribute *)element;
+  HeadingBuilder *h = (HeadingBuilder *)userdata;
+  if (hash_map_get(h->index, attr->name))
+    return;
+  if (h->count == h->capacity) {
+    size_t cap = h->capacity ? h->capacity * 2 : 8;
+    const Attribute **columns = realloc(h->columns, cap * sizeof(*columns));
+    if (!columns) {
+      h->error = 1;
+      return;
+    }
+    h->columns = columns;
+    h->capacity = cap;
+  }
+  h->columns[h->count++] = attr;
+  if (hash_map_put(h->index, attr->name, (void *)(uintptr_t)h->count) < 0)
+    h->error = 1;
+}
+
+static void heading_tuple_cb(void *element, void *userdata) {
+  set_foreach((Tuple *)element, heading_attr_cb, userdata);
+}
+
+typedef struct {
+  HeadingBuilder *heading;
+  const Attribute **row;
+  WireBuffer *out;
+} RowWriteContext;
+
+static void row_attr_cb(void *element, void *userdata) {
+  Attribute *attr = (Attribute *)element;
+  RowWriteContext *ctx = (RowWriteContext *)userdata;
+  size_t column = (size_t)(uintptr_t)hash_map_get(ctx->heading->index, attr->name);
+  if (column)
+    ctx->row[column - 1] = attr;
+}
+
+// Encode one tuple as a row of heading-ordered values
+static void row_tuple_cb(void *element, void *userdata) {
+  RowWriteContext *ctx = (RowWriteContext *)userdata;
+  memset(ctx->row, 0, ctx->heading->count * sizeof(*ctx->row));
+  set_foreach((Tuple *)element, row_attr_cb, ctx);
+  for (size_t i = 0; i < ctx->heading->count; i++)
+    wire_put_value(ctx->out, ctx->row[i]);
+}
+
+static uint8_t attribute_tag(AttributeType type) {
+  switch (type) {
+  case ATTR_INT:
+    return WIRE_INT;
+  case ATTR_RATIONAL:
+    return WIRE_RATIONAL;
+  case ATTR_STRING:
+    return WIRE_STRING;
+  default:
+    return WIRE_NULL;
+  }
+}
+
+typedef struct {
+  struct Schema *schema;
+  int fd;
+  uint64_t offset;  // where the next block goes
+  WireBuffer block; // scratch for one relation's rows
+  WireBuffer directory;
+  uint32_t count;
+  int error;
+} SnapshotWriter;
+
+static int pwrite_all(int fd, const void *buf, size_t len, uint64_t offset) {
+  const unsigned char *p = (const unsigned char *)buf;
+  while (len > 0) {
+    ssize_t n = pwrite(fd, p, len, (off_t)offset);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+    offset += (uint64_t)n;
+  }
+  return 0;
+}
+
+// Append a block and its directory entry
+static void writer_emit(SnapshotWriter *w, const char *name, uint64_t rows, uint16_t columns,
+                        const char *const *column_names, const uint8_t *column_tags,
+                        const void *block, uint64_t block_length) {
+  if (pwrite_all(w->fd, block, block_length, w->offset) < 0) {
+    w->error = 1;
+    return;
+  }
+  WireBuffer *d = &w->directory;
+  wire_put_string(d, name, strlen(name));
+  wire_put_u64(d, rows);
+  wire_put_u16(d, columns);
+  for (uint16_t i = 0; i < columns; i++) {
+    wire_put_string(d, column_names[i], strlen(column_names[i]));
+    wire_put_u8(d, column_tags[i]);
+  }
+  wire_put_u64(d, w->offset);
+  wire_put_u64(d, block_length);
+  w->offset += block_length;
+  w->count++;
+}
+
+static void write_relation_cb(void *element, void *userdata) {
+  Relation *r = (Relation *)element;
+  SnapshotWriter *w = (SnapshotWriter *)userdata;
+  if (w->error)
+    return;
+
+  // Never-loaded relations are copied straight from the old mapping
+  SnapshotRelation *lazy =
+      w->schema->unmaterialized ? hash_map_get(w->schema->unmaterialized, r->name) : NULL;
+  if (lazy) {
+    writer_emit(w, lazy->name, lazy->rows, lazy->column_count,
+                (const char *const *)lazy->column_names, lazy->column_tags, lazy->block,
+                lazy->block_length);
+    return;
+  }
+
+  HeadingBuilder heading = {.index = hash_map_create(hash_string, hash_string_equals, NULL, NULL)};
+  if (!heading.index) {
+    w->error = 1;
+    return;
+  }
+  set_foreach(r->tuples, heading_tuple_cb, &heading);
+
+  const Attribute **row = calloc(heading.count ? heading.count : 1, sizeof(*row));
+  const char **names = calloc(heading.count ? heading.count : 1, sizeof(*names));
+  uint8_t *tags = calloc(heading.count ? heading.count : 1, 1);
+  if (heading.error || !row || !names || !tags || heading.count > UINT16_MAX) {
+    w->error = 1;
+  } else {
+    for (size_t i = 0; i < heading.count; i++) {
+      names[i] = heading.columns[i]->name;
+      tags[i] = attribute_tag(heading.columns[i]->type);
+    }
+    wire_buffer_reset(&w->block);
+    RowWriteContext ctx = {.heading = &heading, .row = row, .out = &w->block};
+    set_foreach(r->tuples, row_tuple_cb, &ctx);
+    writer_emit(w, r->name, set_size(r->tuples), (uint16_t)heading.count, names, tags,
+                w->block.data, w->block.size);
+  }
+
+  free(row);
+  free(names);
+  free(tags);
+  free(heading.columns);
+  hash_map_destroy(heading.index);
+}
+
+// Make a rename in the directory holding `path` durable
+static int fsync_parent(const char *path) {
+  const char *slash = strrchr(path, '/');
+  size_t len = slash ? (slash == path ? 1 : (size_t)(slash - path)) : 1;
+  char *dir = malloc(len + 1);
+  if (!dir)
+    return -1;
+  memcpy(dir, slash ? path : ".", len);
+  dir[len] = '\0';
+  int fd = open(dir, O_RDONLY | O_DIRECTORY);
+  free(dir);
+  if (fd < 0)
+    return -1;
+  int status = fsync(fd);
+  close(fd);
+  return status;
+}
+
+int snapshot_write(struct Schema *schema, const char *path, uint64_t epoch) {
+  size_t tmp_len = strlen(path) + 5;
+  char *tmp = malloc(tmp_len);
+  if (!tmp)
+    return -1;
+  snprintf(tmp, tmp_len, "%s.tmp", path);
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    free(tmp);
+    return -1;
+  }
+
+  SnapshotWriter w = {.schema = schema, .fd = fd, .offset = SNAPSHOT_HEADER_SIZE};
+  wire_buffer_init(&w.block);
+  wire_buffer_init(&w.directory);
+  schema_foreach(schema, write_relation_cb, &w);
+
+  uint64_t dir_offset = w.offset;
+  if (!w.error && pwrite_all(fd, w.directory.data, w.directory.size, dir_offset) < 0)
+    w.error = 1;
+
+  WireBuffer header;
+  wire_buffer_init(&header);
+  wire_put_bytes(&header, SNAPSHOT_MAGIC, 4);
+  wire_put_u32(&header, SNAPSHOT_VERSION);
+  wire_put_u64(&header, epoch);
+  wire_put_u32(&header, w.count);
+  wire_put_u64(&header, dir_offset);
+  wire_put_u64(&header, w.directory.size);
+  if (!w.error && (header.size != SNAPSHOT_HEADER_SIZE ||
+                   pwrite_all(fd, header.data, header.size, 0) < 0 || fsync(fd) < 0))
+    w.error = 1;
+
+  wire_buffer_free(&header);
+  wire_buffer_free(&w.block);
+  wire_buffer_free(&w.directory);
+  close(fd);
+
+  if (w.error || rename(tmp, path) < 0) {
+    unlink(tmp);
+    free(tmp);
+    return -1;
+  }
+  free(tmp);
+  // Until the directory is synced a crash may bring back the old snapshot
+  return fsync_parent(path);
+}
@@ -0,0 +1,381 @@
+/**
+ * @file statistics.c
+ * @brief Incrementally maintained statistics and selectivity estimation.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "statistics.h"
+
+// Values hashed by attribute_value_hash are FNV-1a; finish them so every bit is usable
+static uint64_t mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static int is_numeric(const Attribute *a) {
+  return a->value && (a->type == ATTR_INT || a->type == ATTR_RATIONAL);
+}
+
+static double numeric_value(const Attribute *a) {
+  return a->type == ATTR_INT ? *(int *)a->value : *(double *)a->value;
+}
+
+// xorshift64*, seeded per relation so sampling is reproducible
+static uint64_t next_random(RelationStatistics *s) {
+  s->seed ^= s->seed >> 12;
+  s->seed ^= s->seed << 25;
+  s->seed ^= s->seed >> 27;
+  return s->seed * 0x2545f4914f6cdd1dULL;
+}
+
+RelationStatistics *statistics_create(void) {
+  RelationStatistics *s = calloc(1, sizeof(RelationStatistics));
+  if (s)
+    s->seed = 0x9e3779b97f4a7c15ULL;
+  return s;
+}
+
+static void attribute_statistics_destroy(AttributeStatistics *a) {
+  free(a->name);
+  free(a->sample);
+  free(a);
+}
+
+void statistics_destroy(RelationStatistics *s) {
+  if (!s)
+    return;
+  for (size_t i = 0; i < s->count; i++)
+    attribute_statistics_destroy(s->attributes[i]);
+  free(s->attributes);
+  free(s);
+}
+
+AttributeStatistics *statistics_attribute(const RelationStatistics *s, const char *name) {
+  for (size_t i = 0; i < s->count; i++) {
+    if (strcmp(s->attributes[i]->name, name) == 0)
+      return s->attributes[i];
+  }
+  return NULL;
+}
+
+// Find or add the statistics of an attribute
+static AttributeStatistics *attribute_statistics(RelationStatistics *s, const char *name) {
+  AttributeStatistics *a = statistics_attribute(s, name);
+  if (a)
+    return a;
+  if (s->count == s->capacity) {
+    size_t cap = s->capacity ? s->capacity * 2 : 8;
+    AttributeStatistics **attributes = realloc(s->attributes, cap * sizeof(*attributes));
+    if (!attributes)
+      return NULL;
+    s->attributes = attributes;
+    s->capacity = cap;
+  }
+  a = calloc(1, sizeof(AttributeStatistics));
+  if (!a || !(a->name = strdup(name))) {
+    free(a);
+    return NULL;
+  }
+  s->attributes[s->count++] = a;
+  return a;
+}
+
+/* Distinct values (HyperLogLog) */
+
+static void hll_add(AttributeStatistics *a, uint64_t hash) {
+  size_t index = hash >> (64 - STATISTICS_HLL_BITS);
+  uint64_t rest = hash << STATISTICS_HLL_BITS;
+  uint8_t rank = 1;
+  while (rank <= 64 - STATISTICS_HLL_BITS && !(rest & (1ULL << 63))) {
+    rest <<= 1;
+    rank++;
+  }
+  if (rank > a->hll[index])
+    a->hll[index] = rank;
+}
+
+static uint64_t hll_estimate(const AttributeStatistics *a) {
+  double m = STATISTICS_HLL_REGISTERS;
+  double sum = 0.0;
+  size_t zeros = 0;
+  for (size_t i = 0; i < STATISTICS_HLL_REGISTERS; i++) {
+    sum += ldexp(1.0, -a->hll[i]);
+    zeros += a->hll[i] == 0;
+  }
+  double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+  // Small cardinalities are counted more accurately by the empty registers
+  if (estimate <= 2.5 * m && zeros > 0)
+    estimate = m * log(m / zeros);
+  uint64_t distinct = (uint64_t)(estimate + 0.5);
+  if (distinct > a->count)
+    distinct = a->count;
+  return distinct ? distinct : (a->count > 0);
+}
+
+/* Most common values (Space-Saving) */
+
+static void mcv_add(AttributeStatistics *a, uint64_t hash) {
+  size_t smallest = 0;
+  for (size_t i = 0; i < a->mcv_count; i++) {
+    if (a->mcv[i].hash == hash) {
+      a->mcv[i].count++;
+      return;
+    }
+    if (a->mcv[i].count < a->mcv[smallest].count)
+      smallest = i;
+  }
+  if (a->mcv_count < STATISTICS_MCV_SIZE) {
+    a->mcv[a->mcv_count++] = (MostCommonValue){.hash = hash, .count = 1, .error = 0};
+    return;
+  }
+  // Evict the least frequent entry; its count bounds how often the newcomer was missed
+  MostCommonValue *victim = &a->mcv[smallest];
+  victim->error = victim->count;
+  victim->count++;
+  victim->hash = hash;
+}
+
+/* Numeric values: range and reservoir sample */
+
+static int numeric_add(RelationStatistics *s, AttributeStatistics *a, double v) {
+  if (a->numeric == 0 || v < a->min)
+    a->min = v;
+  if (a->numeric == 0 || v > a->max)
+    a->max = v;
+  a->numeric++;
+  if (!a->sample) {
+    a->sample = malloc(STATISTICS_SAMPLE_SIZE * sizeof(double));
+    if (!a->sample)
+      return -1;
+  }
+  if (a->sample_count < STATISTICS_SAMPLE_SIZE) {
+    a->sample[a->sample_count++] = v;
+  } else {
+    uint64_t slot = next_random(s) % a->numeric;
+    if (slot < STATISTICS_SAMPLE_SIZE)
+      a->sample[slot] = v;
+  }
+  return 0;
+}
+
+typedef struct {
+  RelationStatistics *stats;
+  int status;
+} AddAttributeContext;
+
+static void add_attribute_cb(void *element, void *userdata) {
+  Attribute *attr = (Attribute *)element;
+  AddAttributeContext *ctx = (AddAttributeContext *)userdata;
+  AttributeStatistics *a = attribute_statistics(ctx->stats, attr->name);
+  if (!a) {
+    ctx->status = -1;
+    return;
+  }
+  a->count++;
+  if (!attr->value)
+    return;
+  uint64_t hash = mix(attribute_value_hash(attr));
+  hll_add(a, hash);
+  mcv_add(a, hash);
+  if (is_numeric(attr) && numeric_add(ctx->stats, a, numeric_value(attr)) < 0)
+    ctx->status = -1;
+}
+
+int statistics_add_tuple(RelationStatistics *s, const Tuple *t) {
+  AddAttributeContext ctx = {.stats = s, .status = 0};
+  s->rows++;
+  set_foreach(t, add_attribute_cb, &ctx);
+  return ctx.status;
+}
+
+/* Estimation */
+
+uint64_t statistics_distinct(const RelationStatistics *s, const char *name) {
+  AttributeStatistics *a = statistics_attribute(s, name);
+  return a ? hll_estimate(a) : 0;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+const EquiDepthHistogram *statistics_histogram(AttributeStatistics *a) {
+  if (a->histogram_numeric == a->numeric)
+    return &a->histogram;
+  EquiDepthHistogram *h = &a->histogram;
+  h->bucket_count = 0;
+  double *sorted = a->sample_count ? malloc(a->sample_count * sizeof(double)) : NULL;
+  if (!sorted)
+    return h;
+  memcpy(sorted, a->sample, a->sample_count * sizeof(double));
+  qsort(sorted, a->sample_count, sizeof(double), compare_doubles);
+  size_t buckets = a->sample_count < STATISTICS_HISTOGRAM_BUCKETS ? a->sample_count
+                                                                  : STATISTICS_HISTOGRAM_BUCKETS;
+  // Every bucket holds the same share of the sample; the outer bounds are the true range
+  h->bounds[0] = a->min;
+  for (size_t i = 1; i < buckets; i++)
+    h->bounds[i] = sorted[i * a->sample_count / buckets];
+  h->bounds[buckets] = a->max;
+  h->bucket_count = buckets;
+  a->histogram_numeric = a->numeric;
+  free(sorted);
+  return h;
+}
+
+// Fraction of the numeric values below `v`, interpolating inside a bucket
+static double histogram_fraction_below(const EquiDepthHistogram *h, double v) {
+  size_t n = h->bucket_count;
+  if (v <= h->bounds[0])
+    return 0.0;
+  if (v > h->bounds[n])
+    return 1.0;
+  for (size_t i = 0; i < n; i++) {
+    double lo = h->bounds[i], hi = h->bounds[i + 1];
+    if (v > hi)
+      continue;
+    double within = hi > lo ? (v - lo) / (hi - lo) : 0.0;
+    return (i + within) / n;
+  }
+  return 1.0;
+}
+
+double selectivity_from_distribution(CompareOp op, double less, double equal) {
+  double s;
+  switch (op) {
+  case CMP_EQ:
+    s = equal;
+    break;
+  case CMP_NE:
+    s = 1.0 - equal;
+    break;
+  case CMP_LT:
+    s = less;
+    break;
+  case CMP_LE:
+    s = less + equal;
+    break;
+  case CMP_GT:
+    s = 1.0 - less - equal;
+    break;
+  default:
+    s = 1.0 - less;
+    break;
+  }
+  return s < 0.0 ? 0.0 : s > 1.0 ? 1.0 : s;
+}
+
+// Fraction of the tuples having the attribute whose value equals `constant`
+static double equal_fraction(const AttributeStatistics *a, const Attribute *constant) {
+  if (a->count == 0)
+    return 0.0;
+  if (is_numeric(constant) && a->numeric == a->count) {
+    double v = numeric_value(constant);
+    if (v < a->min || v > a->max)
+      return 0.0;
+  }
+  uint64_t hash = mix(attribute_value_hash(constant));
+  uint64_t common = 0, found = 0;
+  size_t tracked = 0;
+  for (size_t i = 0; i < a->mcv_count; i++) {
+    uint64_t guaranteed = a->mcv[i].count - a->mcv[i].error;
+    if (a->mcv[i].hash == hash)
+      found = guaranteed;
+    common += guaranteed;
+    tracked++;
+  }
+  // Spread what the common values leave evenly over the other distinct values
+  uint64_t distinct = hll_estimate(a);
+  uint64_t others = distinct > tracked ? distinct - tracked : 1;
+  double average = (double)(a->count - common) / a->count / others;
+  double counted = (double)found / a->count;
+  return counted > average ? counted : average;
+}
+
+double statistics_selectivity(const RelationStatistics *s, const char *name, CompareOp op,
+                              const Attribute *constant) {
+  AttributeStatistics *a = s ? statistics_attribute(s, name) : NULL;
+  if (!a || s->rows == 0 || !constant || !constant->value) {
+    if (op == CMP_EQ)
+      return STATISTICS_DEFAULT_EQ_SELECTIVITY;
+    if (op == CMP_NE)
+      return 1.0 - STATISTICS_DEFAULT_EQ_SELECTIVITY;
+    return STATISTICS_DEFAULT_RANGE_SELECTIVITY;
+  }
+  double present = (double)a->count / s->rows;
+  double equal = equal_fraction(a, constant);
+  if (op == CMP_EQ || op == CMP_NE)
+    return present * selectivity_from_distribution(op, 0.0, equal);
+
+  if (!is_numeric(constant) || a->numeric == 0)
+    return present * STATISTICS_DEFAULT_RANGE_SELECTIVITY;
+  const EquiDepthHistogram *h = statistics_histogram(a);
+  if (h->bucket_count == 0)
+    return present * STATISTICS_DEFAULT_RANGE_SELECTIVITY;
+  double numeric = (double)a->numeric / a->count;
+  double less = histogram_fraction_below(h, numeric_value(constant));
+  if (less + equal > 1.0)
+    less = 1.0 - equal;
+  return present * numeric * selectivity_from_distribution(op, less, equal);
+}
+
+double statistics_join_selectivity(const RelationStatistics *a, const char *left_name,
+                                   const RelationStatistics *b, const char *right_name) {
+  uint64_t da = a ? statistics_distinct(a, left_name) : 0;
+  uint64_t db = b ? statistics_distinct(b, right_name) : 0;
+  if (da == 0 || db == 0)
+    return -1.0;
+  return 1.0 / (double)(da > db ? da : db);
+}
+
+void statistics_print(const RelationStatistics *s) {
+  printf("%lu rows\n", (unsigned long)s->rows);
+  for (size_t i = 0; i < s->count; i++) {
+    AttributeStatistics *a = s->attributes[i];
+    printf("  %s: %lu values, ~%lu distinct", a->name, (unsigned long)a->count,
+           (unsigned long)hll_estimate(a));
+    if (a->numeric > 0)
+      printf(", range [%g, %g]", a->min, a->max);
+    uint64_t top = 0;
+    for (size_t j = 0; j < a->mcv_count; j++) {
+      if (a->mcv[j].count - a->mcv[j].error > top)
+        top = a->mcv[j].count - a->mcv[j].error;
+    }
+    if (top > 1)
+      printf(", most common value seen %lu times", (unsigned long)top);
+    printf("\n");
+  }
+}
+
+typedef struct {
+  RelationStatistics *stats;
+  int status;
+} CollectContext;
+
+static void collect_tuple_cb(void *element, void *userdata) {
+  CollectContext *ctx = (CollectContext *)userdata;
+  if (statistics_add_tuple(ctx->stats, (Tuple *)element) < 0)
+    ctx->status = -1;
+}
+
+int relation_enable_statistics(Relation *r) {
+  if (r->statistics)
+    return 0;
+  CollectContext ctx = {.stats = statistics_create(), .status = 0};
+  if (!ctx.stats)
+    return -1;
+  set_foreach(r->tuples, collect_tuple_cb, &ctx);
+  if (ctx.status < 0) {
+    statistics_destroy(ctx.stats);
+    return -1;
+  }
+  r->statistics = ctx.stats;
+  return 0;
+}
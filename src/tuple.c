@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "metrics.h"
 #include "tuple.h"
 
 /**
@@ -37,7 +38,10 @@ static void attribute_free(void *a) { attribute_destroy((Attribute *)a); }
  *
  * @return Pointer to new Tuple, or NULL on failure.
  */
-Tuple *tuple_create(void) { return set_create(attribute_cmp_name, attribute_free); }
+Tuple *tuple_create(void) {
+  metrics_add(METRIC_TUPLES_CREATED, 1);
+  return set_create(attribute_cmp_name, attribute_free);
+}
 
 /**
  * @brief Destroy a Tuple and free its memory.
@@ -110,33 +114,6 @@ Attribute *tuple_find_attribute(Tuple *t, const char *name) {
   return ctx.found;
 }
 
-/**
- * @brief Check if two Attributes are equal (name and value).
- *
- * @param a Pointer to first Attribute.
- * @param b Pointer to second Attribute.
- * @return 1 if equal, 0 otherwise.
- */
-static int attribute_equals(const Attribute *a, const Attribute *b) {
-  if (a->type != b->type)
-    return 0;
-  if (strcmp(a->name, b->name) != 0)
-    return 0;
-
-  switch (a->type) {
-  case ATTR_INT:
-    return *(int *)a->value == *(int *)b->value;
-  case ATTR_RATIONAL:
-    return *(int *)a->value == *(int *)b->value;
-  case ATTR_STRING:
-    return strcmp((char *)a->value, (char *)b->value) == 0;
-  case ATTR_SET:
-    return set_size((Set *)a->value) == set_size((Set *)b->value);
-  default:
-    return 0;
-  }
-}
-
 typedef struct {
   Tuple *other;
   int matched;
@@ -172,3 +149,100 @@ int tuple_equals(Tuple *a, Tuple *b) {
   set_foreach(a, check_attribute_cb, &ctx);
   return ctx.matched;
 }
+
+/**
+ * @brief Callback to copy an Attribute into another Tuple.
+ *
+ * @param element Pointer to the Attribute.
+ * @param userdata Pointer to the target Tuple.
+ */
+static void copy_attr_cb(void *element, void *userdata) {
+  Attribute *copy = attribute_copy((Attribute *)element);
+  if (copy)
+    tuple_add_attribute((Tuple *)userdata, copy);
+}
+
+/**
+ * @brief Deep-copy a Tuple (see attribute_copy).
+ *
+ * @param t Pointer to the Tuple to copy.
+ * @return Pointer to the new Tuple, or NULL on failure.
+ */
+Tuple *tuple_copy(const Tuple *t) {
+  Tuple *copy = tuple_create();
+  if (copy)
+    set_foreach(t, copy_attr_cb, copy);
+  return copy;
+}
+
+/**
+ * @brief Callback to fold an Attribute's hash into a running sum.
+ *
+ * @param element Pointer to the Attribute.
+ * @param userdata Pointer to the uint64_t accumulator.
+ */
+static void hash_attr_cb(void *element, void *userdata) {
+  *(uint64_t *)userdata += attribute_hash((Attribute *)element);
+}
+
+/**
+ * @brief Hash a Tuple consistently with tuple_equals.
+ *
+ * Attributes are summed so that the hash does not depend on their order.
+ *
+ * @param t Pointer to the Tuple.
+ * @return 64-bit hash.
+ */
+uint64_t tuple_hash(const Tuple *t) {
+  uint64_t h = set_size(t);
+  set_foreach(t, hash_attr_cb, &h);
+  return h;
+}
+
+typedef struct {
+  Tuple *other;
+  int same_type; // 1: the attribute must be in `other` with its type; 0: it must not be there
+  int holds;
+} HeadingContext;
+
+/**
+ * @brief Callback to check one Attribute of a heading against another Tuple.
+ *
+ * @param element Pointer to the Attribute.
+ * @param userdata Pointer to HeadingContext.
+ */
+static void check_heading_cb(void *element, void *userdata) {
+  Attribute *attr = (Attribute *)element;
+  HeadingContext *ctx = (HeadingContext *)userdata;
+  Attribute *other = tuple_find_attribute(ctx->other, attr->name);
+  if (ctx->same_type ? !other || other->type != attr->type : other != NULL)
+    ctx->holds = 0;
+}
+
+/**
+ * @brief Check if two Tuples have the same heading (attribute names and types).
+ *
+ * @param a Pointer to first Tuple.
+ * @param b Pointer to second Tuple.
+ * @return 1 if the headings are equal, 0 otherwise.
+ */
+int tuple_heading_equals(const Tuple *a, const Tuple *b) {
+  if (set_size(a) != set_size(b))
+    return 0;
+  HeadingContext ctx = {.other = (Tuple *)b, .same_type = 1, .holds = 1};
+  set_foreach(a, check_heading_cb, &ctx);
+  return ctx.holds;
+}
+
+/**
+ * @brief Check if two Tuples have no attribute name in common.
+ *
+ * @param a Pointer to first Tuple.
+ * @param b Pointer to second Tuple.
+ * @return 1 if the headings are disjoint, 0 otherwise.
+ */
+int tuple_heading_disjoint(const Tuple *a, const Tuple *b) {
+  HeadingContext ctx = {.other = (Tuple *)b, .same_type = 0, .holds = 1};
+  set_foreach(a, check_heading_cb, &ctx);
+  return ctx.holds;
+}
@@ -0,0 +1,327 @@
+/**
+ * @file wal.c
+ * @brief Write-ahead log with group commit and startup replay.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "schema.h"
+#include "snapshot.h"
+#include "wal.h"
+#include "wire.h"
+
+#define WAL_HEADER_SIZE 16
+#define WAL_RECORD_HEADER 8
+
+struct Wal {
+  int fd;
+  uint64_t epoch;
+  off_t committed; // end of the last durable record; appends start here
+  int failed;      // a failed commit could not be cut back, so the tail is suspect
+  WireBuffer pending; // encoded records awaiting commit
+  size_t pending_records;
+  WireBuffer scratch; // payload being encoded
+};
+
+// Write the whole buffer, retrying on short writes
+static int write_all(int fd, const void *buf, size_t len) {
+  const unsigned char *p = (const unsigned char *)buf;
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static int write_header(int fd, uint64_t epoch) {
+  WireBuffer header;
+  wire_buffer_init(&header);
+  wire_put_bytes(&header, WAL_MAGIC, 4);
+  wire_put_u32(&header, WAL_VERSION);
+  wire_put_u64(&header, epoch);
+  int status = header.size == WAL_HEADER_SIZE ? write_all(fd, header.data, header.size) : -1;
+  wire_buffer_free(&header);
+  return status;
+}
+
+Wal *wal_open(const char *path) {
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (st.st_size == 0 && (write_header(fd, 0) < 0 || fsync(fd) < 0))) {
+    close(fd);
+    return NULL;
+  }
+
+  Wal *wal = malloc(sizeof(Wal));
+  if (!wal) {
+    close(fd);
+    return NULL;
+  }
+  wal->fd = fd;
+  wal->epoch = 0;
+  wal->committed = st.st_size ? st.st_size : WAL_HEADER_SIZE;
+  wal->failed = 0;
+  wire_buffer_init(&wal->pending);
+  wire_buffer_init(&wal->scratch);
+  wal->pending_records = 0;
+  return wal;
+}
+
+// Frame the scratch payload as a record and append it to the pending batch
+static int wal_append_scratch(Wal *wal) {
+  if (wal_pending(wal) == 0)
+    wire_buffer_reset(&wal->pending);
+  if (wire_put_u32(&wal->pending, (uint32_t)wal->scratch.size) < 0 ||
+      wire_put_u32(&wal->pending, wire_crc32(wal->scratch.data, wal->scratch.size)) < 0 ||
+      wire_put_bytes(&wal->pending, wal->scratch.data, wal->scratch.size) < 0)
+    return -1;
+  wal->pending_records++;
+  return 0;
+}
+
+int wal_log_create_relation(Wal *wal, const char *name) {
+  wire_buffer_reset(&wal->scratch);
+  if (wire_put_u8(&wal->scratch, WAL_CREATE_RELATION) < 0 ||
+      wire_put_string(&wal->scratch, name, strlen(name)) < 0)
+    return -1;
+  return wal_append_scratch(wal);
+}
+
+typedef struct {
+  WireBuffer *out;
+  int error;
+} EncodeAttributeContext;
+
+static void encode_attribute_cb(void *element, void *userdata) {
+  Attribute *attr = (Attribute *)element;
+  EncodeAttributeContext *ctx = (EncodeAttributeContext *)userdata;
+  if (wire_put_string(ctx->out, attr->name, strlen(attr->name)) < 0 ||
+      wire_put_value(ctx->out, attr) < 0)
+    ctx->error = 1;
+}
+
+int wal_log_add_tuple(Wal *wal, const char *relation, const Tuple *t) {
+  if (set_size(t) > WAL_MAX_ATTRIBUTES) {
+    log_error("wal", "tuple for %s has %zu attributes; a record holds at most %u", relation,
+              set_size(t), (unsigned)WAL_MAX_ATTRIBUTES);
+    return -1;
+  }
+  wire_buffer_reset(&wal->scratch);
+  if (wire_put_u8(&wal->scratch, WAL_ADD_TUPLE) < 0 ||
+      wire_put_string(&wal->scratch, relation, strlen(relation)) < 0 ||
+      wire_put_u16(&wal->scratch, (uint16_t)set_size(t)) < 0)
+    return -1;
+
+  EncodeAttributeContext ctx = {.out = &wal->scratch, .error = 0};
+  set_foreach(t, encode_attribute_cb, &ctx);
+  if (ctx.error)
+    return -1;
+  return wal_append_scratch(wal);
+}
+
+size_t wal_pending(const Wal *wal) { return wal->pending_records; }
+
+void wal_rollback(Wal *wal, size_t keep) {
+  if (keep > wal->pending_records)
+    keep = wal->pending_records;
+  // Records are length-prefixed, so the first `keep` end at a computable offset
+  size_t offset = 0;
+  for (size_t i = 0; i < keep; i++)
+    offset += WAL_RECORD_HEADER + wire_decode_u32(wal->pending.data + offset);
+  wal->pending.size = offset;
+  wal->pending_records = keep;
+}
+
+int wal_commit(Wal *wal) {
+  if (wal->pending_records == 0)
+    return 0;
+  if (wal->failed) {
+    wal_rollback(wal, 0);
+    return -1;
+  }
+  if (write_all(wal->fd, wal->pending.data, wal->pending.size) < 0 || fdatasync(wal->fd) < 0) {
+    log_error("wal", "commit of %zu records failed: %s", wal->pending_records, strerror(errno));
+    // Cut off whatever part of the batch reached the file, so the next
+    // commit does not append behind a torn record
+    if (ftruncate(wal->fd, wal->committed) < 0 || lseek(wal->fd, wal->committed, SEEK_SET) < 0) {
+      log_error("wal", "cannot cut the log back to its last commit; refusing further commits");
+      wal->failed = 1;
+    }
+    wal_rollback(wal, 0);
+    return -1;
+  }
+  wal->committed += (off_t)wal->pending.size;
+  wire_buffer_reset(&wal->pending);
+  wal->pending_records = 0;
+  return 0;
+}
+
+// Copy a wire string view into a NUL-terminated buffer
+static char *string_dup(const char *s, size_t len) {
+  char *copy = malloc(len + 1);
+  if (!copy)
+    return NULL;
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+// Apply one decoded record to the schema; returns 0 on success, -1 if malformed
+static int wal_apply(struct Schema *schema, WireReader *in) {
+  uint8_t type = wire_get_u8(in);
+  size_t len;
+  const char *s = wire_get_string(in, &len);
+  if (!s)
+    return -1;
+  char *name = string_dup(s, len);
+  if (!name)
+    return -1;
+
+  if (type == WAL_CREATE_RELATION) {
+    int status = schema_create_relation(schema, name, NULL) < 0 ? -1 : 0;
+    free(name);
+    return status;
+  }
+
+  if (type != WAL_ADD_TUPLE) {
+    free(name);
+    return -1;
+  }
+
+  Relation *r = schema_find_relation(schema, name);
+  free(name);
+  if (!r)
+    return -1;
+
+  uint16_t count = wire_get_u16(in);
+  Tuple *t = tuple_create();
+  for (uint16_t i = 0; i < count; i++) {
+    const char *attr_name = wire_get_string(in, &len);
+    AttributeType attr_type;
+    void *value = attr_name ? wire_get_value(in, &attr_type) : NULL;
+    if (!value) {
+      tuple_destroy(t);
+      return -1;
+    }
+    char *n = string_dup(attr_name, len);
+    tuple_add_attribute(t, attribute_create(n, attr_type, value));
+    free(n);
+  }
+  if (schema_insert_tuple(schema, r, t) != 1)
+    tuple_destroy(t);
+  return 0;
+}
+
+long wal_replay(Wal *wal, struct Schema *schema) {
+  struct stat st;
+  if (fstat(wal->fd, &st) < 0)
+    return -1;
+
+  size_t size = (size_t)st.st_size;
+  unsigned char *data = malloc(size ? size : 1);
+  if (!data)
+    return -1;
+  size_t got = 0;
+  while (got < size) {
+    ssize_t n = pread(wal->fd, data + got, size - got, (off_t)got);
+    if (n <= 0) {
+      free(data);
+      return -1;
+    }
+    got += (size_t)n;
+  }
+
+  if (size < WAL_HEADER_SIZE || memcmp(data, WAL_MAGIC, 4) != 0 ||
+      wire_decode_u32(data + 4) != WAL_VERSION) {
+    log_error("wal", "not a write-ahead log (or unsupported version)");
+    free(data);
+    return -1;
+  }
+  WireReader header;
+  wire_reader_init(&header, data + 8, WAL_HEADER_SIZE - 8);
+  wal->epoch = wire_get_u64(&header);
+
+  // A log older than the loaded snapshot is already contained in it
+  if (schema->snapshot && wal->epoch < snapshot_epoch(schema->snapshot)) {
+    free(data);
+    log_info("wal", "log epoch %lu predates snapshot; starting a new generation",
+             (unsigned long)wal->epoch);
+    return wal_truncate(wal, snapshot_epoch(schema->snapshot)) < 0 ? -1 : 0;
+  }
+
+  // Replay must not log the mutations it re-applies
+  Wal *attached = schema->wal;
+  schema->wal = NULL;
+
+  long applied = 0;
+  size_t offset = WAL_HEADER_SIZE;
+  while (size - offset >= WAL_RECORD_HEADER) {
+    uint32_t len = wire_decode_u32(data + offset);
+    uint32_t crc = wire_decode_u32(data + offset + 4);
+    const unsigned char *payload = data + offset + WAL_RECORD_HEADER;
+    if (size - offset - WAL_RECORD_HEADER < len || wire_crc32(payload, len) != crc)
+      break;
+
+    WireReader in;
+    wire_reader_init(&in, payload, len);
+    if (wal_apply(schema, &in) < 0 || in.error) {
+      log_warn("wal", "skipping malformed record at offset %zu", offset);
+    } else {
+      applied++;
+    }
+    offset += WAL_RECORD_HEADER + len;
+  }
+
+  schema->wal = attached;
+  free(data);
+
+  if (offset < size) {
+    log_warn("wal", "discarding %zu bytes of torn log tail", size - offset);
+    if (ftruncate(wal->fd, (off_t)offset) < 0)
+      return -1;
+  }
+  off_t end = lseek(wal->fd, 0, SEEK_END);
+  if (end < 0)
+    return -1;
+  wal->committed = end;
+  return applied;
+}
+
+uint64_t wal_epoch(const Wal *wal) { return wal->epoch; }
+
+int wal_truncate(Wal *wal, uint64_t epoch) {
+  wire_buffer_reset(&wal->pending);
+  wal->pending_records = 0;
+  if (ftruncate(wal->fd, 0) < 0 || lseek(wal->fd, 0, SEEK_SET) < 0)
+    return -1;
+  if (write_header(wal->fd, epoch) < 0 || fsync(wal->fd) < 0)
+    return -1;
+  wal->epoch = epoch;
+  wal->committed = WAL_HEADER_SIZE;
+  wal->failed = 0;
+  return 0;
+}
+
+void wal_close(Wal *wal) {
+  if (!wal)
+    return;
+  wal_commit(wal);
+  close(wal->fd);
+  wire_buffer_free(&wal->pending);
+  wire_buffer_free(&wal->scratch);
+  free(wal);
+}
@@ -0,0 +1,241 @@
+/**
+ * @file wire.c
+ * @brief Binary encoding helpers shared by the binary protocol and persistence code.
+ */
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wire.h"
+
+void wire_buffer_init(WireBuffer *b) {
+  b->data = NULL;
+  b->size = 0;
+  b->capacity = 0;
+}
+
+void wire_buffer_free(WireBuffer *b) {
+  free(b->data);
+  wire_buffer_init(b);
+}
+
+void wire_buffer_reset(WireBuffer *b) { b->size = 0; }
+
+int wire_buffer_reserve(WireBuffer *b, size_t extra) {
+  if (b->size + extra <= b->capacity)
+    return 0;
+  size_t cap = b->capacity ? b->capacity : 256;
+  while (cap < b->size + extra)
+    cap *= 2;
+  unsigned char *data = realloc(b->data, cap);
+  if (!data)
+    return -1;
+  b->data = data;
+  b->capacity = cap;
+  return 0;
+}
+
+int wire_put_bytes(WireBuffer *b, const void *data, size_t len) {
+  if (wire_buffer_reserve(b, len) < 0)
+    return -1;
+  if (len)
+    memcpy(b->data + b->size, data, len);
+  b->size += len;
+  return 0;
+}
+
+int wire_put_u8(WireBuffer *b, uint8_t v) { return wire_put_bytes(b, &v, 1); }
+
+int wire_put_u16(WireBuffer *b, uint16_t v) {
+  unsigned char p[2] = {(unsigned char)(v >> 8), (unsigned char)v};
+  return wire_put_bytes(b, p, sizeof(p));
+}
+
+int wire_put_u32(WireBuffer *b, uint32_t v) {
+  unsigned char p[4] = {(unsigned char)(v >> 24), (unsigned char)(v >> 16),
+                        (unsigned char)(v >> 8), (unsigned char)v};
+  return wire_put_bytes(b, p, sizeof(p));
+}
+
+int wire_put_u64(WireBuffer *b, uint64_t v) {
+  if (wire_put_u32(b, (uint32_t)(v >> 32)) < 0)
+    return -1;
+  return wire_put_u32(b, (uint32_t)v);
+}
+
+int wire_put_i64(WireBuffer *b, int64_t v) { return wire_put_u64(b, (uint64_t)v); }
+
+int wire_put_f64(WireBuffer *b, double v) {
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return wire_put_u64(b, bits);
+}
+
+int wire_put_string(WireBuffer *b, const char *s, size_t len) {
+  if (wire_put_u32(b, (uint32_t)len) < 0)
+    return -1;
+  return wire_put_bytes(b, s, len);
+}
+
+int wire_put_value(WireBuffer *b, const Attribute *attr) {
+  if (!attr || !attr->value)
+    return wire_put_u8(b, WIRE_NULL);
+
+  switch (attr->type) {
+  case ATTR_INT:
+    if (wire_put_u8(b, WIRE_INT) < 0)
+      return -1;
+    return wire_put_i64(b, *(int *)attr->value);
+  case ATTR_RATIONAL:
+    if (wire_put_u8(b, WIRE_RATIONAL) < 0)
+      return -1;
+    return wire_put_f64(b, *(double *)attr->value);
+  case ATTR_STRING: {
+    const char *s = (const char *)attr->value;
+    if (wire_put_u8(b, WIRE_STRING) < 0)
+      return -1;
+    return wire_put_string(b, s, strlen(s));
+  }
+  default:
+    return wire_put_u8(b, WIRE_NULL);
+  }
+}
+
+void wire_patch_u32(WireBuffer *b, size_t offset, uint32_t v) {
+  b->data[offset] = (unsigned char)(v >> 24);
+  b->data[offset + 1] = (unsigned char)(v >> 16);
+  b->data[offset + 2] = (unsigned char)(v >> 8);
+  b->data[offset + 3] = (unsigned char)v;
+}
+
+uint32_t wire_crc32(const void *data, size_t len) {
+  static uint32_t table[256];
+  static int table_ready = 0;
+  if (!table_ready) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+    table_ready = 1;
+  }
+
+  const unsigned char *p = (const unsigned char *)data;
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; i++)
+    crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFFu;
+}
+
+uint32_t wire_decode_u32(const unsigned char *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+void wire_reader_init(WireReader *r, const void *data, size_t size) {
+  r->data = (const unsigned char *)data;
+  r->size = size;
+  r->offset = 0;
+  r->error = 0;
+}
+
+// Reserve `len` bytes from the reader, or flag an error
+static const unsigned char *wire_take(WireReader *r, size_t len) {
+  if (r->error || r->size - r->offset < len) {
+    r->error = 1;
+    return NULL;
+  }
+  const unsigned char *p = r->data + r->offset;
+  r->offset += len;
+  return p;
+}
+
+uint8_t wire_get_u8(WireReader *r) {
+  const unsigned char *p = wire_take(r, 1);
+  return p ? p[0] : 0;
+}
+
+uint16_t wire_get_u16(WireReader *r) {
+  const unsigned char *p = wire_take(r, 2);
+  return p ? (uint16_t)((p[0] << 8) | p[1]) : 0;
+}
+
+uint32_t wire_get_u32(WireReader *r) {
+  const unsigned char *p = wire_take(r, 4);
+  return p ? wire_decode_u32(p) : 0;
+}
+
+uint64_t wire_get_u64(WireReader *r) {
+  uint64_t hi = wire_get_u32(r);
+  uint64_t lo = wire_get_u32(r);
+  return (hi << 32) | lo;
+}
+
+int64_t wire_get_i64(WireReader *r) { return (int64_t)wire_get_u64(r); }
+
+double wire_get_f64(WireReader *r) {
+  uint64_t bits = wire_get_u64(r);
+  double v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+const char *wire_get_string(WireReader *r, size_t *len) {
+  uint32_t n = wire_get_u32(r);
+  const unsigned char *p = wire_take(r, n);
+  if (!p)
+    return NULL;
+  *len = n;
+  return (const char *)p;
+}
+
+void *wire_get_value(WireReader *r, AttributeType *type) {
+  uint8_t tag = wire_get_u8(r);
+  if (r->error)
+    return NULL;
+
+  switch (tag) {
+  case WIRE_NULL:
+    *type = ATTR_UNKNOWN;
+    return NULL;
+  case WIRE_INT: {
+    int64_t v = wire_get_i64(r);
+    // Engine integers are ints; a wider value cannot be stored faithfully
+    if (!r->error && (v < INT_MIN || v > INT_MAX))
+      r->error = 1;
+    if (r->error)
+      return NULL;
+    int *value = malloc(sizeof(int));
+    if (value)
+      *value = (int)v;
+    *type = ATTR_INT;
+    return value;
+  }
+  case WIRE_RATIONAL: {
+    double v = wire_get_f64(r);
+    if (r->error)
+      return NULL;
+    double *value = malloc(sizeof(double));
+    if (value)
+      *value = v;
+    *type = ATTR_RATIONAL;
+    return value;
+  }
+  case WIRE_STRING: {
+    size_t len;
+    const char *s = wire_get_string(r, &len);
+    if (!s)
+      return NULL;
+    char *value = malloc(len + 1);
+    if (value) {
+      memcpy(value, s, len);
+      value[len] = '\0';
+    }
+    *type = ATTR_STRING;
+    return value;
+  }
+  default:
+    r->error = 1;
+    return NULL;
+  }
+}
@@ -0,0 +1,399 @@
+/**
+ * @file xml_parser.c
+ * @brief Single-pass tokenizer and request builder for the XML protocol.
+ *
+ * The tokenizer recognises start tags, end tags, self-closing tags, the XML
+ * declaration and comments. Text is not copied: each leaf element yields a
+ * view spanning its content, which the request builder dispatches on the
+ * element's name and its parent's name. Only text containing entity
+ * references is rewritten, into one decode buffer per request.
+ */
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xml_parser.h"
+
+#define XML_MAX_DEPTH 32
+
+// An open element on the parser stack
+typedef struct {
+  XmlView name;
+  const char *content_start;
+  int has_children;
+} XmlOpenElement;
+
+int xml_view_equals(XmlView v, const char *s) {
+  size_t n = strlen(s);
+  return v.data && v.len == n && memcmp(v.data, s, n) == 0;
+}
+
+char *xml_view_dup(XmlView v) {
+  char *s = malloc(v.len + 1);
+  if (!s)
+    return NULL;
+  if (v.len)
+    memcpy(s, v.data, v.len);
+  s[v.len] = '\0';
+  return s;
+}
+
+// Strip surrounding whitespace from a view
+static XmlView view_trim(XmlView v) {
+  while (v.len && isspace((unsigned char)v.data[0])) {
+    v.data++;
+    v.len--;
+  }
+  while (v.len && isspace((unsigned char)v.data[v.len - 1]))
+    v.len--;
+  return v;
+}
+
+int xml_view_to_int(XmlView v, int *out) {
+  v = view_trim(v);
+  if (!v.data || v.len == 0)
+    return -1;
+
+  size_t i = 0;
+  int negative = 0;
+  if (v.data[0] == '-' || v.data[0] == '+') {
+    negative = v.data[0] == '-';
+    i++;
+  }
+  if (i == v.len)
+    return -1;
+
+  long long value = 0;
+  for (; i < v.len; i++) {
+    if (!isdigit((unsigned char)v.data[i]))
+      return -1;
+    value = value * 10 + (v.data[i] - '0');
+    if (value > (long long)INT_MAX + 1)
+      return -1;
+  }
+  if (negative)
+    value = -value;
+  if (value > INT_MAX || value < INT_MIN)
+    return -1;
+  *out = (int)value;
+  return 0;
+}
+
+int xml_view_to_double(XmlView v, double *out) {
+  v = view_trim(v);
+  if (!v.data || v.len == 0)
+    return -1;
+
+  // Numbers are short; copy onto the stack only to NUL-terminate for strtod
+  char tmp[64];
+  if (v.len >= sizeof(tmp))
+    return -1;
+  memcpy(tmp, v.data, v.len);
+  tmp[v.len] = '\0';
+
+  char *end;
+  *out = strtod(tmp, &end);
+  return (*end == '\0') ? 0 : -1;
+}
+
+// Append an empty attribute slot to the request
+static XmlAttributeView *request_new_attribute(XmlRequest *req) {
+  if (req->attribute_count == req->attribute_capacity) {
+    size_t cap = req->attribute_capacity ? req->attribute_capacity * 2 : 8;
+    XmlAttributeView *attrs = realloc(req->attributes, cap * sizeof(*attrs));
+    if (!attrs)
+      return NULL;
+    req->attributes = attrs;
+    req->attribute_capacity = cap;
+  }
+  XmlAttributeView *attr = &req->attributes[req->attribute_count++];
+  memset(attr, 0, sizeof(*attr));
+  return attr;
+}
+
+// Route the start of an element to the request being built
+static int request_on_start(XmlRequest *req, XmlView name, const XmlOpenElement *parent) {
+  if (xml_view_equals(name, "attributes")) {
+    req->has_attributes = 1;
+  } else if (xml_view_equals(name, "attribute") && parent &&
+             xml_view_equals(parent->name, "attributes")) {
+    if (!request_new_attribute(req))
+      return -1;
+  }
+  return 0;
+}
+
+// Route the text of a leaf element to the request being built
+static void request_on_text(XmlRequest *req, XmlView name, XmlView text,
+                            const XmlOpenElement *parent) {
+  if (!parent)
+    return;
+
+  if (xml_view_equals(parent->name, "attribute") && req->attribute_count > 0) {
+    XmlAttributeView *attr = &req->attributes[req->attribute_count - 1];
+    if (xml_view_equals(name, "name"))
+      attr->name = text;
+    else if (xml_view_equals(name, "type"))
+      attr->type = text;
+    else if (xml_view_equals(name, "value"))
+      attr->value = text;
+    return;
+  }
+
+  if (xml_view_equals(parent->name, "request")) {
+    if (xml_view_equals(name, "command"))
+      req->command = view_trim(text);
+    else if (xml_view_equals(name, "id"))
+      req->id = view_trim(text);
+    else if (xml_view_equals(name, "name"))
+      req->name = text;
+    else if (xml_view_equals(name, "relation"))
+      req->relation = text;
+    else if (xml_view_equals(name, "path"))
+      req->path = view_trim(text);
+    else if (xml_view_equals(name, "expression"))
+      req->expression = view_trim(text);
+    else if (xml_view_equals(name, "kind"))
+      req->kind = view_trim(text);
+    else if (xml_view_equals(name, "predicate"))
+      req->predicate = view_trim(text);
+  }
+}
+
+// Write the UTF-8 encoding of `code`; returns the bytes written, 0 if not a character
+static size_t put_utf8(char *out, unsigned long code) {
+  if (code == 0 || (code >= 0xD800 && code <= 0xDFFF) || code > 0x10FFFF)
+    return 0;
+  if (code < 0x80) {
+    out[0] = (char)code;
+    return 1;
+  }
+  if (code < 0x800) {
+    out[0] = (char)(0xC0 | (code >> 6));
+    out[1] = (char)(0x80 | (code & 0x3F));
+    return 2;
+  }
+  if (code < 0x10000) {
+    out[0] = (char)(0xE0 | (code >> 12));
+    out[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (code & 0x3F));
+    return 3;
+  }
+  out[0] = (char)(0xF0 | (code >> 18));
+  out[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+  out[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+  out[3] = (char)(0x80 | (code & 0x3F));
+  return 4;
+}
+
+// Decode the reference after an '&' at `p`; returns the bytes consumed
+// including the ';', or 0 if it is not a valid reference
+static size_t decode_entity(const char *p, const char *end, char *out, size_t *written) {
+  static const struct {
+    const char *name;
+    char c;
+  } named[] = {{"lt", '<'}, {"gt", '>'}, {"amp", '&'}, {"quot", '"'}, {"apos", '\''}};
+
+  size_t avail = (size_t)(end - p);
+  const char *semi = memchr(p, ';', avail < 12 ? avail : 12);
+  if (!semi || semi == p)
+    return 0;
+  size_t len = (size_t)(semi - p);
+  for (size_t i = 0; i < sizeof(named) / sizeof(named[0]); i++) {
+    if (strlen(named[i].name) == len && memcmp(p, named[i].name, len) == 0) {
+      *out = named[i].c;
+      *written = 1;
+      return len + 1;
+    }
+  }
+
+  // Character references: &#N; and &#xH;
+  if (p[0] != '#')
+    return 0;
+  int hex = len > 1 && p[1] == 'x';
+  const char *digits = p + 1 + hex;
+  if (digits == semi)
+    return 0;
+  unsigned long code = 0;
+  for (const char *d = digits; d < semi; d++) {
+    int digit;
+    if (isdigit((unsigned char)*d))
+      digit = *d - '0';
+    else if (hex && isxdigit((unsigned char)*d))
+      digit = tolower((unsigned char)*d) - 'a' + 10;
+    else
+      return 0;
+    code = code * (hex ? 16 : 10) + (unsigned long)digit;
+    if (code > 0x10FFFF)
+      return 0;
+  }
+  *written = put_utf8(out, code);
+  return *written ? len + 1 : 0;
+}
+
+// Point `v` at a copy with its entity references replaced; returns -1 if one is invalid
+static int view_decode(XmlRequest *req, XmlView *v, size_t doc_len) {
+  if (!v->data || !memchr(v->data, '&', v->len))
+    return 0;
+  // Decoding never lengthens text and the views cover disjoint parts of the
+  // document, so a buffer the size of the document holds all of them
+  if (!req->decoded && !(req->decoded = malloc(doc_len)))
+    return -1;
+
+  char *out = req->decoded + req->decoded_len;
+  size_t n = 0;
+  const char *p = v->data;
+  const char *end = v->data + v->len;
+  while (p < end) {
+    const char *amp = memchr(p, '&', (size_t)(end - p));
+    size_t plain = amp ? (size_t)(amp - p) : (size_t)(end - p);
+    memcpy(out + n, p, plain);
+    n += plain;
+    if (!amp)
+      break;
+    size_t written;
+    size_t used = decode_entity(amp + 1, end, out + n, &written);
+    if (!used)
+      return -1;
+    n += written;
+    p = amp + 1 + used;
+  }
+  v->data = out;
+  v->len = n;
+  req->decoded_len += n;
+  return 0;
+}
+
+// Decode the entity references in every text field of a parsed request
+static int request_decode(XmlRequest *req, size_t doc_len) {
+  XmlView *fields[] = {&req->id,       &req->command,    &req->name, &req->relation,
+                       &req->path,     &req->expression, &req->kind, &req->predicate};
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    if (view_decode(req, fields[i], doc_len) < 0)
+      return -1;
+  }
+  for (size_t i = 0; i < req->attribute_count; i++) {
+    XmlAttributeView *attr = &req->attributes[i];
+    if (view_decode(req, &attr->name, doc_len) < 0 || view_decode(req, &attr->type, doc_len) < 0 ||
+        view_decode(req, &attr->value, doc_len) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+// Find `needle` in [p, end); returns NULL if absent
+static const char *find_seq(const char *p, const char *end, const char *needle) {
+  size_t n = strlen(needle);
+  while (p + n <= end) {
+    const char *hit = memchr(p, needle[0], (size_t)(end - p));
+    if (!hit || hit + n > end)
+      return NULL;
+    if (memcmp(hit, needle, n) == 0)
+      return hit;
+    p = hit + 1;
+  }
+  return NULL;
+}
+
+static int is_name_char(char c) {
+  return isalnum((unsigned char)c) || c == '_' || c == '-' || c == ':' || c == '.';
+}
+
+int xml_parse_request(const char *xml, size_t len, XmlRequest *req) {
+  memset(req, 0, sizeof(*req));
+
+  XmlOpenElement stack[XML_MAX_DEPTH];
+  size_t depth = 0;
+  const char *p = xml;
+  const char *end = xml + len;
+
+  while (p < end) {
+    const char *lt = memchr(p, '<', (size_t)(end - p));
+    if (!lt)
+      break;
+    p = lt + 1;
+    if (p >= end)
+      return -1;
+
+    // Declarations and processing instructions: <? ... ?>
+    if (*p == '?') {
+      const char *close = find_seq(p, end, "?>");
+      if (!close)
+        return -1;
+      p = close + 2;
+      continue;
+    }
+
+    // Comments and other markup declarations: <!-- ... --> / <! ... >
+    if (*p == '!') {
+      const char *close = (end - p >= 3 && memcmp(p, "!--", 3) == 0) ? find_seq(p, end, "-->")
+                                                                      : memchr(p, '>', end - p);
+      if (!close)
+        return -1;
+      p = close + (*close == '-' ? 3 : 1);
+      continue;
+    }
+
+    int closing = 0;
+    if (*p == '/') {
+      closing = 1;
+      p++;
+    }
+
+    XmlView name = {.data = p, .len = 0};
+    while (p < end && is_name_char(*p))
+      p++;
+    name.len = (size_t)(p - name.data);
+    if (name.len == 0)
+      return -1;
+
+    const char *gt = memchr(p, '>', (size_t)(end - p));
+    if (!gt)
+      return -1;
+    int self_closing = !closing && gt > p && gt[-1] == '/';
+    p = gt + 1;
+
+    if (closing) {
+      if (depth == 0)
+        return -1;
+      XmlOpenElement *open = &stack[--depth];
+      if (open->name.len != name.len || memcmp(open->name.data, name.data, name.len) != 0)
+        return -1;
+      if (!open->has_children) {
+        XmlView text = {.data = open->content_start, .len = (size_t)(lt - open->content_start)};
+        request_on_text(req, name, text, depth ? &stack[depth - 1] : NULL);
+      }
+      continue;
+    }
+
+    XmlOpenElement *parent = depth ? &stack[depth - 1] : NULL;
+    if (parent)
+      parent->has_children = 1;
+    if (request_on_start(req, name, parent) < 0)
+      return -1;
+
+    if (self_closing)
+      continue;
+    if (depth == XML_MAX_DEPTH)
+      return -1;
+    stack[depth].name = name;
+    stack[depth].content_start = p;
+    stack[depth].has_children = 0;
+    depth++;
+  }
+
+  if (depth != 0)
+    return -1;
+  return request_decode(req, len);
+}
+
+void xml_request_free(XmlRequest *req) {
+  free(req->decoded);
+  req->decoded = NULL;
+  req->decoded_len = 0;
+  free(req->attributes);
+  req->attributes = NULL;
+  req->attribute_count = 0;
+  req->attribute_capacity = 0;
+}
@@ -17,263 +17,215 @@
 #include <unistd.h>
 
 #include "attribute.h"
+#include "binary_protocol.h"
+#include "expression.h"
+#include "expression_parser.h"
+#include "index.h"
+#include "loader.h"
+#include "log.h"
+#include "metrics.h"
 #include "relation.h"
+#include "schema.h"
 #include "set.h"
 #include "tuple.h"
+#include "wal.h"
+#include "xml_parser.h"
 #include "xml_server.h"
 
-#define MAX_BUFFER 8192
-#define MAX_RESPONSE 16384
+#define RECV_CHUNK 8192
+#define MAX_PENDING_INPUT (64u * 1024u * 1024u)
 
-// Schema: a set of relations
-typedef struct {
-  Set *relations; // Set of Relation*
-} Schema;
-
-// Compare relations by name
-static int relation_cmp(const void *a, const void *b) {
-  const Relation *r1 = (const Relation *)a;
-  const Relation *r2 = (const Relation *)b;
-  return strcmp(r1->name, r2->name);
+// Parse attribute type from a view
+static AttributeType parse_attr_type(XmlView type) {
+  if (xml_view_equals(type, "int"))
+    return ATTR_INT;
+  if (xml_view_equals(type, "string"))
+    return ATTR_STRING;
+  if (xml_view_equals(type, "rational"))
+    return ATTR_RATIONAL;
+  return ATTR_UNKNOWN;
 }
 
-// Don't free relations in schema set (we manage them separately)
-static void relation_no_free(void *r) { (void)r; }
-
-// Create a new schema
-Schema *schema_create(void) {
-  Schema *s = malloc(sizeof(Schema));
-  if (!s)
-    return NULL;
-  s->relations = set_create(relation_cmp, relation_no_free);
-  return s;
+// Resolve the relation named by a view without copying it
+static Relation *find_relation_view(Schema *schema, XmlView name) {
+  return schema_find_relation_n(schema, name.data, name.len);
 }
 
-// Context for finding relation by name
+// Context for building XML into a connection's output buffer
 typedef struct {
-  const char *name;
-  Relation *found;
-} FindRelationContext;
+  WireBuffer *out;
+  int failed; // the response has an error status
+} XmlBuildContext;
 
-static void find_relation_cb(void *element, void *userdata) {
-  Relation *r = (Relation *)element;
-  FindRelationContext *ctx = (FindRelationContext *)userdata;
-  if (strcmp(r->name, ctx->name) == 0) {
-    ctx->found = r;
-  }
+static void append_xml_n(XmlBuildContext *ctx, const char *str, size_t len) {
+  wire_put_bytes(ctx->out, str, len);
 }
 
-// Find a relation in schema by name
-Relation *schema_find_relation(Schema *s, const char *name) {
-  FindRelationContext ctx = {.name = name, .found = NULL};
-  set_foreach(s->relations, find_relation_cb, &ctx);
-  return ctx.found;
+static void append_to_xml(XmlBuildContext *ctx, const char *str) {
+  append_xml_n(ctx, str, strlen(str));
 }
 
-// Add a relation to schema
-int schema_add_relation(Schema *s, Relation *r) { return set_add(s->relations, r); }
-
-// Context for destroying all relations
-static void destroy_relation_cb(void *element, void *userdata) {
-  (void)userdata;
-  relation_destroy((Relation *)element);
+// Append `len` bytes of text or attribute content, escaping the characters XML reserves
+static void append_xml_text_n(XmlBuildContext *ctx, const char *str, size_t len) {
+  for (const char *p = str; p < str + len; p++) {
+    if (*p == '<')
+      append_to_xml(ctx, "&lt;");
+    else if (*p == '>')
+      append_to_xml(ctx, "&gt;");
+    else if (*p == '&')
+      append_to_xml(ctx, "&amp;");
+    else if (*p == '"')
+      append_to_xml(ctx, "&quot;");
+    else
+      append_xml_n(ctx, p, 1);
+  }
 }
 
-// Destroy schema and all relations
-void schema_destroy(Schema *s) {
-  if (!s)
-    return;
-  set_foreach(s->relations, destroy_relation_cb, NULL);
-  set_destroy(s->relations);
-  free(s);
+static void append_xml_text(XmlBuildContext *ctx, const char *str) {
+  append_xml_text_n(ctx, str, strlen(str));
 }
 
-// Simple XML parser helpers
-static char *xml_find_tag(const char *xml, const char *tag, char *out, size_t out_size) {
-  char start_tag[64], end_tag[64];
-  snprintf(start_tag, sizeof(start_tag), "<%s>", tag);
-  snprintf(end_tag, sizeof(end_tag), "</%s>", tag);
-
-  const char *start = strstr(xml, start_tag);
-  if (!start)
-    return NULL;
-  start += strlen(start_tag);
-
-  const char *end = strstr(start, end_tag);
-  if (!end)
-    return NULL;
-
-  size_t len = end - start;
-  if (len >= out_size)
-    len = out_size - 1;
-
-  strncpy(out, start, len);
-  out[len] = '\0';
-  return out;
+// Open an XML response, echoing the request id if the client sent one
+static void response_begin(XmlBuildContext *out, const XmlRequest *req, const char *status,
+                           const char *message) {
+  out->failed = strcmp(status, "error") == 0;
+  append_to_xml(out, "<?xml version=\"1.0\"?>\n<response>\n");
+  if (req && req->id.data) {
+    append_to_xml(out, "  <id>");
+    append_xml_text_n(out, req->id.data, req->id.len);
+    append_to_xml(out, "</id>\n");
+  }
+  append_to_xml(out, "  <status>");
+  append_to_xml(out, status);
+  append_to_xml(out, "</status>\n  <message>");
+  append_xml_text(out, message);
+  append_to_xml(out, "</message>\n");
 }
 
-// Parse attribute type from string
-static AttributeType parse_attr_type(const char *type_str) {
-  if (strcmp(type_str, "int") == 0)
-    return ATTR_INT;
-  if (strcmp(type_str, "string") == 0)
-    return ATTR_STRING;
-  if (strcmp(type_str, "rational") == 0)
-    return ATTR_RATIONAL;
-  return ATTR_UNKNOWN;
-}
+static void response_end(XmlBuildContext *out) { append_to_xml(out, "</response>\n"); }
 
-// Build XML response
-static void build_response(char *response, size_t max_size, const char *status, const char *message,
-                           const char *data) {
-  snprintf(response, max_size,
-           "<?xml version=\"1.0\"?>\n"
-           "<response>\n"
-           "  <status>%s</status>\n"
-           "  <message>%s</message>\n"
-           "%s"
-           "</response>\n",
-           status, message, data ? data : "");
+// Build XML response without data
+static void build_response(XmlBuildContext *out, const XmlRequest *req, const char *status,
+                           const char *message) {
+  response_begin(out, req, status, message);
+  response_end(out);
 }
 
 // Handle CREATE_RELATION command
-static void handle_create_relation(Schema *schema, const char *xml, char *response,
-                                   size_t response_size) {
-  char name[256];
-
-  if (!xml_find_tag(xml, "name", name, sizeof(name))) {
-    build_response(response, response_size, "error", "Missing relation name", NULL);
+static void handle_create_relation(Schema *schema, const XmlRequest *req, XmlBuildContext *out) {
+  if (!req->name.data) {
+    build_response(out, req, "error", "Missing relation name");
     return;
   }
 
   // Check if relation already exists
-  if (schema_find_relation(schema, name)) {
-    build_response(response, response_size, "error", "Relation already exists", NULL);
+  if (find_relation_view(schema, req->name)) {
+    build_response(out, req, "error", "Relation already exists");
     return;
   }
 
-  Relation *r = relation_create(name);
-  if (!r) {
-    build_response(response, response_size, "error", "Failed to create relation", NULL);
+  char *name = xml_view_dup(req->name);
+  int created = name ? schema_create_relation(schema, name, NULL) : -1;
+  free(name);
+  if (created != 1) {
+    build_response(out, req, "error", "Failed to create relation");
     return;
   }
 
-  schema_add_relation(schema, r);
-  build_response(response, response_size, "success", "Relation created", NULL);
+  build_response(out, req, "success", "Relation created");
 }
 
-// Handle ADD_TUPLE command
-static void handle_add_tuple(Schema *schema, const char *xml, char *response,
-                             size_t response_size) {
-  char relation_name[256];
-  if (!xml_find_tag(xml, "relation", relation_name, sizeof(relation_name))) {
-    build_response(response, response_size, "error", "Missing relation name", NULL);
-    return;
+// Convert an attribute value view into the engine representation
+static void *parse_attr_value(AttributeType type, XmlView text) {
+  switch (type) {
+  case ATTR_INT: {
+    int parsed;
+    if (xml_view_to_int(text, &parsed) < 0)
+      return NULL;
+    int *v = malloc(sizeof(int));
+    if (v)
+      *v = parsed;
+    return v;
+  }
+  case ATTR_STRING:
+    return xml_view_dup(text);
+  case ATTR_RATIONAL: {
+    double parsed;
+    if (xml_view_to_double(text, &parsed) < 0)
+      return NULL;
+    double *v = malloc(sizeof(double));
+    if (v)
+      *v = parsed;
+    return v;
+  }
+  default:
+    return NULL;
   }
+}
 
-  Relation *r = schema_find_relation(schema, relation_name);
-  if (!r) {
-    build_response(response, response_size, "error", "Relation not found", NULL);
+// Handle ADD_TUPLE command
+static void handle_add_tuple(Schema *schema, const XmlRequest *req, XmlBuildContext *out) {
+  if (!req->relation.data) {
+    build_response(out, req, "error", "Missing relation name");
     return;
   }
 
-  Tuple *t = tuple_create();
-
-  // Parse attributes
-  const char *attr_start = strstr(xml, "<attributes>");
-  if (!attr_start) {
-    tuple_destroy(t);
-    build_response(response, response_size, "error", "Missing attributes", NULL);
+  Relation *r = find_relation_view(schema, req->relation);
+  if (!r) {
+    build_response(out, req, "error", "Relation not found");
     return;
   }
 
-  const char *attr_end = strstr(attr_start, "</attributes>");
-  if (!attr_end) {
-    tuple_destroy(t);
-    build_response(response, response_size, "error", "Malformed attributes", NULL);
+  if (!req->has_attributes) {
+    build_response(out, req, "error", "Missing attributes");
     return;
   }
 
-  // Parse each <attribute> tag
-  const char *current = attr_start;
-  while ((current = strstr(current, "<attribute>")) && current < attr_end) {
-    current += strlen("<attribute>");
-
-    char attr_name[128], attr_type[32], attr_value[256];
-    const char *attr_tag_end = strstr(current, "</attribute>");
-    if (!attr_tag_end)
-      break;
-
-    size_t attr_len = attr_tag_end - current;
-    char attr_xml[1024];
-    if (attr_len >= sizeof(attr_xml))
-      attr_len = sizeof(attr_xml) - 1;
-    strncpy(attr_xml, current, attr_len);
-    attr_xml[attr_len] = '\0';
+  Tuple *t = tuple_create();
 
-    if (!xml_find_tag(attr_xml, "name", attr_name, sizeof(attr_name)) ||
-        !xml_find_tag(attr_xml, "type", attr_type, sizeof(attr_type)) ||
-        !xml_find_tag(attr_xml, "value", attr_value, sizeof(attr_value))) {
+  for (size_t i = 0; i < req->attribute_count; i++) {
+    const XmlAttributeView *view = &req->attributes[i];
+    if (!view->name.data || !view->type.data || !view->value.data) {
       tuple_destroy(t);
-      build_response(response, response_size, "error", "Malformed attribute", NULL);
+      build_response(out, req, "error", "Malformed attribute");
       return;
     }
 
-    AttributeType type = parse_attr_type(attr_type);
-    void *value = NULL;
-
-    switch (type) {
-    case ATTR_INT: {
-      int *v = malloc(sizeof(int));
-      *v = atoi(attr_value);
-      value = v;
-      break;
-    }
-    case ATTR_STRING:
-      value = strdup(attr_value);
-      break;
-    case ATTR_RATIONAL: {
-      double *v = malloc(sizeof(double));
-      *v = atof(attr_value);
-      value = v;
-      break;
+    AttributeType type = parse_attr_type(view->type);
+    if (type == ATTR_UNKNOWN) {
+      tuple_destroy(t);
+      build_response(out, req, "error", "Unsupported attribute type");
+      return;
     }
-    default:
+
+    void *value = parse_attr_value(type, view->value);
+    char *name = value ? xml_view_dup(view->name) : NULL;
+    if (!name) {
+      free(value);
       tuple_destroy(t);
-      build_response(response, response_size, "error", "Unsupported attribute type", NULL);
+      build_response(out, req, "error", "Invalid attribute value");
       return;
     }
 
-    Attribute *attr = attribute_create(attr_name, type, value);
-    tuple_add_attribute(t, attr);
+    tuple_add_attribute(t, attribute_create(name, type, value));
+    free(name);
+  }
 
-    current = attr_tag_end + strlen("</attribute>");
+  if (schema->wal && set_size(t) > WAL_MAX_ATTRIBUTES) {
+    tuple_destroy(t);
+    build_response(out, req, "error", "Too many attributes");
+    return;
   }
 
-  int result = relation_add_tuple(r, t);
+  int result = schema_insert_tuple(schema, r, t);
   if (result == 1) {
-    build_response(response, response_size, "success", "Tuple added", NULL);
+    build_response(out, req, "success", "Tuple added");
   } else if (result == 0) {
     tuple_destroy(t);
-    build_response(response, response_size, "success", "Tuple already exists", NULL);
+    build_response(out, req, "success", "Tuple already exists");
   } else {
     tuple_destroy(t);
-    build_response(response, response_size, "error", "Failed to add tuple", NULL);
-  }
-}
-
-// Context for building XML from tuples
-typedef struct {
-  char *buffer;
-  size_t size;
-  size_t offset;
-} XmlBuildContext;
-
-static void append_to_xml(XmlBuildContext *ctx, const char *str) {
-  size_t len = strlen(str);
-  if (ctx->offset + len < ctx->size) {
-    strcpy(ctx->buffer + ctx->offset, str);
-    ctx->offset += len;
+    build_response(out, req, "error", "Failed to add tuple");
   }
 }
 
@@ -286,36 +238,38 @@ typedef struct {
 static void attr_to_xml_cb(void *attr_element, void *attr_userdata) {
   Attribute *attr = (Attribute *)attr_element;
   AttrToXmlContext *actx = (AttrToXmlContext *)attr_userdata;
-  char attr_buf[512];
 
   const char *type_str = "?";
-  char value_str[256] = "";
+  const char *value_str = "";
+  char number[64];
 
   switch (attr->type) {
   case ATTR_INT:
     type_str = "int";
-    snprintf(value_str, sizeof(value_str), "%d", *(int *)attr->value);
+    snprintf(number, sizeof(number), "%d", *(int *)attr->value);
+    value_str = number;
     break;
   case ATTR_STRING:
     type_str = "string";
-    snprintf(value_str, sizeof(value_str), "%s", (char *)attr->value);
+    value_str = (const char *)attr->value;
     break;
   case ATTR_RATIONAL:
     type_str = "rational";
-    snprintf(value_str, sizeof(value_str), "%f", *(double *)attr->value);
+    snprintf(number, sizeof(number), "%f", *(double *)attr->value);
+    value_str = number;
     break;
   default:
     break;
   }
 
-  snprintf(attr_buf, sizeof(attr_buf),
-           "      <attribute>\n"
-           "        <name>%s</name>\n"
-           "        <type>%s</type>\n"
-           "        <value>%s</value>\n"
-           "      </attribute>\n",
-           attr->name, type_str, value_str);
-  append_to_xml(actx->xml_ctx, attr_buf);
+  // Names and values may come from CSV or binary clients, so both are escaped
+  append_to_xml(actx->xml_ctx, "      <attribute>\n        <name>");
+  append_xml_text(actx->xml_ctx, attr->name);
+  append_to_xml(actx->xml_ctx, "</name>\n        <type>");
+  append_to_xml(actx->xml_ctx, type_str);
+  append_to_xml(actx->xml_ctx, "</type>\n        <value>");
+  append_xml_text(actx->xml_ctx, value_str);
+  append_to_xml(actx->xml_ctx, "</value>\n      </attribute>\n");
 }
 
 // Callback to convert tuple to XML
@@ -330,132 +284,553 @@ static void tuple_to_xml_cb(void *element, void *userdata) {
   append_to_xml(ctx, "      </tuple>\n");
 }
 
+// Append a <relation> element holding every tuple of `r`
+static void append_relation(XmlBuildContext *out, const Relation *r) {
+  append_to_xml(out, "    <relation>\n");
+  append_to_xml(out, "      <name>");
+  append_xml_text(out, r->name);
+  append_to_xml(out, "</name>\n");
+
+  char card_buf[256];
+  snprintf(card_buf, sizeof(card_buf), "      <cardinality>%zu</cardinality>\n",
+           set_size(r->tuples));
+  append_to_xml(out, card_buf);
+
+  append_to_xml(out, "      <tuples>\n");
+  set_foreach(r->tuples, tuple_to_xml_cb, out);
+  append_to_xml(out, "      </tuples>\n");
+  append_to_xml(out, "    </relation>\n");
+}
+
 // Handle QUERY_RELATION command
-static void handle_query_relation(Schema *schema, const char *xml, char *response,
-                                  size_t response_size) {
-  char relation_name[256];
-  if (!xml_find_tag(xml, "relation", relation_name, sizeof(relation_name))) {
-    build_response(response, response_size, "error", "Missing relation name", NULL);
+static void handle_query_relation(Schema *schema, const XmlRequest *req, XmlBuildContext *out) {
+  if (!req->relation.data) {
+    build_response(out, req, "error", "Missing relation name");
     return;
   }
 
-  Relation *r = schema_find_relation(schema, relation_name);
+  Relation *r = find_relation_view(schema, req->relation);
   if (!r) {
-    build_response(response, response_size, "error", "Relation not found", NULL);
+    build_response(out, req, "error", "Relation not found");
     return;
   }
 
-  char data[MAX_RESPONSE];
-  XmlBuildContext ctx = {.buffer = data, .size = sizeof(data), .offset = 0};
+  response_begin(out, req, "success", "Query executed");
+  append_to_xml(out, "  <data>\n");
+  append_relation(out, r);
+  append_to_xml(out, "  </data>\n");
+  response_end(out);
+}
 
-  append_to_xml(&ctx, "  <data>\n");
-  append_to_xml(&ctx, "    <relation>\n");
-  char name_buf[512];
-  snprintf(name_buf, sizeof(name_buf), "      <name>%s</name>\n", r->name);
-  append_to_xml(&ctx, name_buf);
+// Handle EVALUATE command: parse, optimize and run an algebra expression
+static void handle_evaluate(Schema *schema, const XmlRequest *req, XmlBuildContext *out) {
+  if (!req->expression.data) {
+    build_response(out, req, "error", "Missing expression");
+    return;
+  }
 
-  char card_buf[256];
-  snprintf(card_buf, sizeof(card_buf), "      <cardinality>%zu</cardinality>\n",
-           set_size(r->tuples));
-  append_to_xml(&ctx, card_buf);
+  char error[256] = "Invalid expression";
+  Expression *e =
+      expression_parse(schema, req->expression.data, req->expression.len, error, sizeof(error));
+  if (!e) {
+    build_response(out, req, "error", error);
+    return;
+  }
+  e = expression_optimize(e);
+  char *plan = e ? expression_to_string(e) : NULL;
+  Relation *r = plan ? expression_evaluate(e, "result") : NULL;
+  expression_destroy(e);
+  if (!r) {
+    free(plan);
+    build_response(out, req, "error", "Evaluation failed");
+    return;
+  }
 
-  append_to_xml(&ctx, "      <tuples>\n");
-  set_foreach(r->tuples, tuple_to_xml_cb, &ctx);
-  append_to_xml(&ctx, "      </tuples>\n");
-  append_to_xml(&ctx, "    </relation>\n");
-  append_to_xml(&ctx, "  </data>\n");
+  response_begin(out, req, "success", "Expression evaluated");
+  append_to_xml(out, "  <data>\n    <plan>");
+  append_xml_text(out, plan);
+  append_to_xml(out, "</plan>\n");
+  append_relation(out, r);
+  append_to_xml(out, "  </data>\n");
+  response_end(out);
+  free(plan);
+  relation_destroy(r);
+}
 
-  build_response(response, response_size, "success", "Query executed", data);
+// Handle SELECT command: the tuples of a relation satisfying a predicate
+static void handle_select(Schema *schema, const XmlRequest *req, XmlBuildContext *out) {
+  if (!req->relation.data || !req->predicate.data) {
+    build_response(out, req, "error", "Missing relation or predicate");
+    return;
+  }
+  Relation *r = find_relation_view(schema, req->relation);
+  if (!r) {
+    build_response(out, req, "error", "Relation not found");
+    return;
+  }
+
+  char error[256] = "Invalid predicate";
+  Predicate *p = predicate_parse(req->predicate.data, req->predicate.len, error, sizeof(error));
+  if (!p) {
+    build_response(out, req, "error", error);
+    return;
+  }
+  Operator *plan = operator_select(operator_scan(r), predicate_holds, p);
+  Relation *result = plan ? operator_collect(plan, "result") : NULL;
+  operator_destroy(plan);
+  predicate_destroy(p);
+  if (!result) {
+    build_response(out, req, "error", "Selection failed");
+    return;
+  }
+
+  response_begin(out, req, "success", "Selection executed");
+  append_to_xml(out, "  <data>\n");
+  append_relation(out, result);
+  append_to_xml(out, "  </data>\n");
+  response_end(out);
+  relation_destroy(result);
+}
+
+// Handle EXPLAIN_ANALYZE command: run an expression with per-operator profiling
+static void handle_explain_analyze(Schema *schema, const XmlRequest *req, XmlBuildContext *out) {
+  if (!req->expression.data) {
+    build_response(out, req, "error", "Missing expression");
+    return;
+  }
+
+  char error[256] = "Invalid expression";
+  Expression *e =
+      expression_parse(schema, req->expression.data, req->expression.len, error, sizeof(error));
+  if (!e) {
+    build_response(out, req, "error", error);
+    return;
+  }
+  e = expression_optimize(e);
+  char *plan = e ? expression_to_string(e) : NULL;
+  char *report = NULL;
+  Relation *r = plan ? expression_evaluate_analyze(e, "result", &report) : NULL;
+  expression_destroy(e);
+  if (!r) {
+    free(plan);
+    build_response(out, req, "error", "Evaluation failed");
+    return;
+  }
+
+  char rows[64];
+  snprintf(rows, sizeof(rows), "    <rows>%lu</rows>\n", (unsigned long)set_size(r->tuples));
+  response_begin(out, req, "success", "Expression analyzed");
+  append_to_xml(out, "  <data>\n    <plan>");
+  append_xml_text(out, plan);
+  append_to_xml(out, "</plan>\n");
+  append_to_xml(out, rows);
+  append_to_xml(out, "    <profile>\n");
+  append_xml_text(out, report);
+  append_to_xml(out, "    </profile>\n  </data>\n");
+  response_end(out);
+  free(plan);
+  free(report);
+  relation_destroy(r);
 }
 
 // Callback for listing relations
 static void list_rel_cb(void *element, void *userdata) {
   Relation *r = (Relation *)element;
   XmlBuildContext *lctx = (XmlBuildContext *)userdata;
-  char buf[512];
-  snprintf(buf, sizeof(buf), "      <relation name=\"%s\" size=\"%zu\"/>\n", r->name,
-           set_size(r->tuples));
+  char buf[64];
+  append_to_xml(lctx, "      <relation name=\"");
+  append_xml_text(lctx, r->name);
+  // The cardinality is known without materializing snapshot relations
+  snprintf(buf, sizeof(buf), "\" size=\"%lu\"/>\n", (unsigned long)r->cardinality.finite_count);
   append_to_xml(lctx, buf);
 }
 
 // Handle LIST_RELATIONS command
-static void handle_list_relations(Schema *schema, const char *xml, char *response,
-                                  size_t response_size) {
-  (void)xml; // unused
+static void handle_list_relations(Schema *schema, const XmlRequest *req, XmlBuildContext *out) {
+  (void)req; // unused
+
+  response_begin(out, req, "success", "Relations listed");
+  append_to_xml(out, "  <data>\n");
+  append_to_xml(out, "    <relations>\n");
 
-  char data[MAX_RESPONSE];
-  XmlBuildContext ctx = {.buffer = data, .size = sizeof(data), .offset = 0};
+  schema_foreach(schema, list_rel_cb, out);
 
-  append_to_xml(&ctx, "  <data>\n");
-  append_to_xml(&ctx, "    <relations>\n");
+  append_to_xml(out, "    </relations>\n");
+  append_to_xml(out, "  </data>\n");
+  response_end(out);
+}
+
+// Handle LOAD_RELATION command
+static void handle_load_relation(Schema *schema, const XmlRequest *req, XmlBuildContext *out) {
+  if (!req->relation.data || !req->path.data) {
+    build_response(out, req, "error", "Missing relation or path");
+    return;
+  }
 
-  set_foreach(schema->relations, list_rel_cb, &ctx);
+  if (!schema->load_dir) {
+    build_response(out, req, "error", "No load directory configured");
+    return;
+  }
 
-  append_to_xml(&ctx, "    </relations>\n");
-  append_to_xml(&ctx, "  </data>\n");
+  char *requested = xml_view_dup(req->path);
+  char *path = requested ? loader_resolve_path(schema->load_dir, requested) : NULL;
+  free(requested);
+  if (!path) {
+    build_response(out, req, "error", "Path is not a file in the load directory");
+    return;
+  }
 
-  build_response(response, response_size, "success", "Relations listed", data);
+  char *relation = xml_view_dup(req->relation);
+  LoaderStats stats;
+  int status = relation ? loader_load_into(schema, relation, path, NULL, &stats) : -1;
+  free(relation);
+  free(path);
+  if (status < 0) {
+    build_response(out, req, "error", "Failed to load relation");
+    return;
+  }
+
+  char message[128];
+  snprintf(message, sizeof(message), "Loaded %lu tuples (%lu rejected)",
+           (unsigned long)stats.rows, (unsigned long)stats.rejected);
+  build_response(out, req, "success", message);
+}
+
+// Handle CHECKPOINT command
+static void handle_checkpoint(Schema *schema, const XmlRequest *req, XmlBuildContext *out) {
+  if (!schema->snapshot_path) {
+    build_response(out, req, "error", "No snapshot path configured");
+  } else if (schema_checkpoint(schema) < 0) {
+    build_response(out, req, "error", "Checkpoint failed");
+  } else {
+    build_response(out, req, "success", "Checkpoint written");
+  }
 }
 
-// Process incoming XML command
-static void process_command(Schema *schema, const char *xml, char *response,
-                            size_t response_size) {
-  char command[64];
-  if (!xml_find_tag(xml, "command", command, sizeof(command))) {
-    build_response(response, response_size, "error", "Missing command", NULL);
+// Handle CREATE_INDEX command: index a relation on the attributes named in <attributes>
+static void handle_create_index(Schema *schema, const XmlRequest *req, XmlBuildContext *out) {
+  if (!req->relation.data || req->attribute_count == 0) {
+    build_response(out, req, "error", "Missing relation or attributes");
     return;
   }
-  
-  if (strcmp(command, "CREATE_RELATION") == 0) {
-    handle_create_relation(schema, xml, response, response_size);
-  } else if (strcmp(command, "ADD_TUPLE") == 0) {
-    handle_add_tuple(schema, xml, response, response_size);
-  } else if (strcmp(command, "QUERY_RELATION") == 0) {
-    handle_query_relation(schema, xml, response, response_size);
-  } else if (strcmp(command, "LIST_RELATIONS") == 0) {
-    handle_list_relations(schema, xml, response, response_size);
+  IndexKind kind = INDEX_HASH;
+  if (req->kind.data && xml_view_equals(req->kind, "ordered")) {
+    kind = INDEX_ORDERED;
+  } else if (req->kind.data && !xml_view_equals(req->kind, "hash")) {
+    build_response(out, req, "error", "Unknown index kind");
+    return;
+  }
+  Relation *r = find_relation_view(schema, req->relation);
+  if (!r) {
+    build_response(out, req, "error", "Relation not found");
+    return;
+  }
+
+  char **attrs = calloc(req->attribute_count, sizeof(char *));
+  int failed = !attrs;
+  for (size_t i = 0; !failed && i < req->attribute_count; i++)
+    failed = !req->attributes[i].name.data || !(attrs[i] = xml_view_dup(req->attributes[i].name));
+  RelationIndex *index =
+      failed ? NULL
+             : relation_create_index(r, kind, (const char *const *)attrs, req->attribute_count);
+  for (size_t i = 0; attrs && i < req->attribute_count; i++)
+    free(attrs[i]);
+  free(attrs);
+  if (!index) {
+    build_response(out, req, "error", "Failed to create index (it may already exist)");
+    return;
+  }
+
+  char message[128];
+  snprintf(message, sizeof(message), "Index created on %lu tuples",
+           (unsigned long)index_size(index));
+  build_response(out, req, "success", message);
+}
+
+// Handle STATS command
+static void handle_stats(Schema *schema, const XmlRequest *req, XmlBuildContext *out) {
+  (void)schema; // unused
+#ifdef ALGEBRA_NO_METRICS
+  build_response(out, req, "error", "Metrics are disabled in this build");
+#else
+  char *text = metrics_to_text();
+  if (!text) {
+    build_response(out, req, "error", "Failed to collect metrics");
+    return;
+  }
+  response_begin(out, req, "success", "Metrics collected");
+  append_to_xml(out, "  <data>\n    <metrics format=\"prometheus\">\n");
+  append_to_xml(out, text);
+  append_to_xml(out, "    </metrics>\n  </data>\n");
+  response_end(out);
+  free(text);
+#endif
+}
+
+void xml_process_request(Schema *schema, const char *xml, size_t len, WireBuffer *response) {
+  XmlBuildContext out_ctx = {.out = response, .failed = 0};
+  XmlBuildContext *out = &out_ctx;
+  uint64_t started = metrics_now_ns();
+
+  XmlRequest req;
+  if (xml_parse_request(xml, len, &req) < 0) {
+    xml_request_free(&req);
+    build_response(out, NULL, "error", "Malformed request");
+    metrics_observe(METRIC_COMMAND_OTHER, metrics_now_ns() - started, 1);
+    return;
+  }
+
+  log_sampled(LOG_LEVEL_INFO, "server", "command=%.*s bytes=%zu", (int)req.command.len,
+              req.command.data ? req.command.data : "", len);
+
+  MetricCommand command = METRIC_COMMAND_OTHER;
+  if (!req.command.data) {
+    build_response(out, &req, "error", "Missing command");
+  } else if (xml_view_equals(req.command, "CREATE_RELATION")) {
+    command = METRIC_COMMAND_CREATE_RELATION;
+    handle_create_relation(schema, &req, out);
+  } else if (xml_view_equals(req.command, "ADD_TUPLE")) {
+    command = METRIC_COMMAND_ADD_TUPLE;
+    handle_add_tuple(schema, &req, out);
+  } else if (xml_view_equals(req.command, "QUERY_RELATION")) {
+    command = METRIC_COMMAND_QUERY_RELATION;
+    handle_query_relation(schema, &req, out);
+  } else if (xml_view_equals(req.command, "LIST_RELATIONS")) {
+    command = METRIC_COMMAND_LIST_RELATIONS;
+    handle_list_relations(schema, &req, out);
+  } else if (xml_view_equals(req.command, "EVALUATE")) {
+    command = METRIC_COMMAND_EVALUATE;
+    handle_evaluate(schema, &req, out);
+  } else if (xml_view_equals(req.command, "LOAD_RELATION")) {
+    command = METRIC_COMMAND_LOAD_RELATION;
+    handle_load_relation(schema, &req, out);
+  } else if (xml_view_equals(req.command, "CHECKPOINT")) {
+    command = METRIC_COMMAND_CHECKPOINT;
+    handle_checkpoint(schema, &req, out);
+  } else if (xml_view_equals(req.command, "SELECT")) {
+    command = METRIC_COMMAND_SELECT;
+    handle_select(schema, &req, out);
+  } else if (xml_view_equals(req.command, "CREATE_INDEX")) {
+    command = METRIC_COMMAND_CREATE_INDEX;
+    handle_create_index(schema, &req, out);
+  } else if (xml_view_equals(req.command, "EXPLAIN_ANALYZE")) {
+    command = METRIC_COMMAND_EXPLAIN_ANALYZE;
+    handle_explain_analyze(schema, &req, out);
+  } else if (xml_view_equals(req.command, "STATS")) {
+    command = METRIC_COMMAND_STATS;
+    handle_stats(schema, &req, out);
   } else {
-    build_response(response, response_size, "error", "Cannot discern command", NULL);
+    build_response(out, &req, "error", "Cannot discern command");
   }
+
+  xml_request_free(&req);
+  metrics_observe(command, metrics_now_ns() - started, out->failed);
 }
 
-// Handle client connection
-static void handle_client(int client_fd, Schema *schema) {
-  char buffer[MAX_BUFFER];
-  char response[MAX_RESPONSE];
+typedef enum { PROTOCOL_UNKNOWN, PROTOCOL_XML, PROTOCOL_BINARY } Protocol;
 
-  while (1) {
-    memset(buffer, 0, sizeof(buffer));
-    ssize_t bytes_read = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
+// Per-connection state: buffered input, pending responses and framing progress
+typedef struct {
+  int fd;
+  Protocol protocol;
+  WireBuffer in;
+  WireBuffer out;
+  size_t consumed;    // bytes of `in` already processed
+  size_t scanned;     // bytes of `in` already searched for a frame end
+  size_t batch_start; // offset of the first request processed since the last commit
+} Connection;
+
+// Decide the protocol from the first bytes; returns PROTOCOL_UNKNOWN until decidable
+static Protocol detect_protocol(const Connection *c) {
+  size_t n = c->in.size < BINARY_PROTOCOL_MAGIC_LEN ? c->in.size : BINARY_PROTOCOL_MAGIC_LEN;
+  if (memcmp(c->in.data, BINARY_PROTOCOL_MAGIC, n) != 0)
+    return PROTOCOL_XML;
+  return n == BINARY_PROTOCOL_MAGIC_LEN ? PROTOCOL_BINARY : PROTOCOL_UNKNOWN;
+}
 
-    if (bytes_read <= 0) {
-      break; // Connection closed or error
+// Length of the next complete XML request (ending in </request>), 0 if incomplete
+static size_t next_xml_frame(Connection *c) {
+  static const char terminator[] = "</request>";
+  const size_t term_len = sizeof(terminator) - 1;
+  const char *base = (const char *)c->in.data + c->consumed;
+  size_t avail = c->in.size - c->consumed;
+  size_t from = c->scanned > c->consumed ? c->scanned - c->consumed : 0;
+
+  while (from + term_len <= avail) {
+    const char *hit = memchr(base + from, '<', avail - from);
+    if (!hit || (size_t)(hit - base) + term_len > avail)
+      break;
+    if (memcmp(hit, terminator, term_len) == 0) {
+      c->scanned = 0;
+      return (size_t)(hit - base) + term_len;
+    }
+    from = (size_t)(hit - base) + 1;
+  }
+
+  // Resume later from the last position that could still start a terminator
+  c->scanned = c->consumed + (avail >= term_len ? avail - term_len + 1 : 0);
+  return 0;
+}
+
+// Execute every complete request buffered on the connection, in order
+static int process_frames(Connection *c, Schema *schema) {
+  if (c->protocol == PROTOCOL_UNKNOWN) {
+    c->protocol = detect_protocol(c);
+    if (c->protocol == PROTOCOL_UNKNOWN)
+      return 0;
+    if (c->protocol == PROTOCOL_BINARY)
+      c->consumed = BINARY_PROTOCOL_MAGIC_LEN;
+  }
+  c->batch_start = c->consumed;
+
+  while (c->consumed < c->in.size) {
+    const unsigned char *frame = c->in.data + c->consumed;
+    size_t avail = c->in.size - c->consumed;
+    size_t out_start = c->out.size;
+
+    if (c->protocol == PROTOCOL_BINARY) {
+      long frame_len = binary_frame_size(frame, avail);
+      if (frame_len < 0)
+        return -1;
+      if (frame_len == 0)
+        break;
+      log_sampled(LOG_LEVEL_INFO, "server", "binary frame bytes=%ld", frame_len);
+      if (binary_process_request(schema, frame + 4, (size_t)frame_len - 4, &c->out) < 0)
+        return -1;
+      c->consumed += (size_t)frame_len;
+    } else {
+      size_t frame_len = next_xml_frame(c);
+      if (frame_len == 0)
+        break;
+      // Full payload dumps are opt-in (ALGEBRA_LOG_LEVEL=debug)
+      log_debug("server", "received command: %.*s", (int)frame_len, (const char *)frame);
+      xml_process_request(schema, (const char *)frame, frame_len, &c->out);
+      log_debug("server", "sent response: %.*s", (int)(c->out.size - out_start),
+                (const char *)c->out.data + out_start);
+      c->consumed += frame_len;
+    }
+  }
+  return 0;
+}
+
+// Length of the XML request at the start of `data`, up to its </request>
+static size_t xml_frame_length(const char *data, size_t avail) {
+  static const char terminator[] = "</request>";
+  const size_t term_len = sizeof(terminator) - 1;
+  for (size_t i = 0; i + term_len <= avail; i++) {
+    if (data[i] == '<' && memcmp(data + i, terminator, term_len) == 0)
+      return i + term_len;
+  }
+  return avail;
+}
+
+// Replace the responses of the requests processed since the last commit
+// with errors: their mutations could not be logged and have been undone
+static void reject_batch(Connection *c, const char *message) {
+  wire_buffer_reset(&c->out);
+  size_t offset = c->batch_start;
+  while (offset < c->consumed) {
+    const unsigned char *frame = c->in.data + offset;
+    size_t avail = c->consumed - offset;
+    if (c->protocol == PROTOCOL_BINARY) {
+      size_t frame_len = (size_t)binary_frame_size(frame, avail);
+      binary_reject_request(frame + 4, frame_len - 4, message, &c->out);
+      offset += frame_len;
+    } else {
+      size_t frame_len = xml_frame_length((const char *)frame, avail);
+      XmlBuildContext out = {.out = &c->out, .failed = 0};
+      XmlRequest req;
+      int parsed = xml_parse_request((const char *)frame, frame_len, &req) == 0;
+      build_response(&out, parsed ? &req : NULL, "error", message);
+      xml_request_free(&req);
+      offset += frame_len;
     }
+  }
+}
+
+// Drop processed input so the buffer only holds the partial next request
+static int compact_input(Connection *c) {
+  if (c->consumed > 0) {
+    size_t rest = c->in.size - c->consumed;
+    memmove(c->in.data, c->in.data + c->consumed, rest);
+    c->in.size = rest;
+    c->scanned = c->scanned > c->consumed ? c->scanned - c->consumed : 0;
+    c->consumed = 0;
+  }
+  return c->in.size > MAX_PENDING_INPUT ? -1 : 0;
+}
 
-    printf("Received command:\n%s\n", buffer);
+// Write all pending responses
+static int flush_responses(Connection *c) {
+  size_t sent = 0;
+  while (sent < c->out.size) {
+    ssize_t n = send(c->fd, c->out.data + sent, c->out.size - sent, 0);
+    if (n <= 0)
+      return -1;
+    sent += (size_t)n;
+  }
+  wire_buffer_reset(&c->out);
+  return 0;
+}
 
-    memset(response, 0, sizeof(response));
-    process_command(schema, buffer, response, sizeof(response));
+// Handle client connection
+static void handle_client(int client_fd, Schema *schema) {
+  Connection c = {
+      .fd = client_fd, .protocol = PROTOCOL_UNKNOWN, .consumed = 0, .scanned = 0, .batch_start = 0};
+  wire_buffer_init(&c.in);
+  wire_buffer_init(&c.out);
 
-    send(client_fd, response, strlen(response), 0);
-    printf("Sent response:\n%s\n", response);
+  // Requests may arrive back-to-back; each read executes every complete one
+  // and the responses go out together in request order.
+  while (1) {
+    if (wire_buffer_reserve(&c.in, RECV_CHUNK) < 0)
+      break;
+    ssize_t bytes_read = recv(client_fd, c.in.data + c.in.size, RECV_CHUNK, 0);
+    if (bytes_read <= 0)
+      break; // Connection closed or error
+    c.in.size += (size_t)bytes_read;
+
+    int status = process_frames(&c, schema);
+
+    // Group commit: one fsync covers every mutation in this batch, and no
+    // response is sent before the mutations it acknowledges are durable.
+    // When the commit fails the batch's mutations are undone and every
+    // request of the batch is answered with an error instead.
+    if (schema_commit(schema) < 0)
+      reject_batch(&c, "Write-ahead log commit failed; request rolled back");
+    if (compact_input(&c) < 0)
+      status = -1;
+    if (flush_responses(&c) < 0 || status < 0)
+      break;
   }
 
+  wire_buffer_free(&c.in);
+  wire_buffer_free(&c.out);
   close(client_fd);
 }
 
-// Main server function
 int start_xml_server(int port) {
+  ServerOptions options = {.port = port, .wal_path = NULL, .snapshot_path = NULL, .load_dir = NULL};
+  return start_server(&options);
+}
+
+// Main server function
+int start_server(const ServerOptions *options) {
   int server_fd, client_fd;
   struct sockaddr_in address;
   int opt = 1;
   socklen_t addrlen = sizeof(address);
+  int port = options->port;
 
-  Schema *schema = schema_create();
+  Schema *schema = schema_open(options->snapshot_path, options->wal_path);
   if (!schema) {
     fprintf(stderr, "Failed to create schema\n");
     return 1;
   }
+  if (options->load_dir && !(schema->load_dir = strdup(options->load_dir))) {
+    schema_destroy(schema);
+    return 1;
+  }
 
   // Create socket
   if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
@@ -498,18 +873,27 @@ int start_xml_server(int port) {
   printf("  - ADD_TUPLE: Add a tuple to a relation\n");
   printf("  - QUERY_RELATION: Query all tuples in a relation\n");
   printf("  - LIST_RELATIONS: List all relations in schema\n");
+  printf("  - EVALUATE: Optimize and run an algebra expression (see expression_parser.h)\n");
+  printf("  - LOAD_RELATION: Bulk load a CSV/TSV file into a relation\n");
+  printf("  - CHECKPOINT: Write a snapshot and restart the write-ahead log\n");
+  printf("  - SELECT: Filter a relation with a predicate (see expression_parser.h)\n");
+  printf("  - EXPLAIN_ANALYZE: Run an expression and report per-operator timings\n");
+  printf("  - CREATE_INDEX: Build a hash or ordered index on attributes of a relation\n");
+  printf("  - STATS: Report runtime metrics (Prometheus text format)\n");
+  printf("\nBinary protocol: open the connection with \"%s\" (see binary_protocol.h)\n",
+         BINARY_PROTOCOL_MAGIC);
   printf("\n");
 
   // Accept connections
   while (1) {
     if ((client_fd = accept(server_fd, (struct sockaddr *)&address, &addrlen)) < 0) {
-      perror("accept");
+      log_error("server", "accept: %s", strerror(errno));
       continue;
     }
 
-    printf("New client connected\n");
+    log_info("server", "client connected fd=%d", client_fd);
     handle_client(client_fd, schema);
-    printf("Client disconnected\n");
+    log_info("server", "client disconnected fd=%d", client_fd);
   }
 
   close(server_fd);
@@ -0,0 +1,149 @@
+/**
+ * @file expression.c
+ * @brief Tests of the expression optimizer: rewritten plans must return the
+ *        same relation as the expressions they came from.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attribute.h"
+#include "expression.h"
+#include "expression_parser.h"
+#include "relation.h"
+#include "schema.h"
+#include "set.h"
+#include "test.h"
+#include "tuple.h"
+
+#define PEOPLE 120
+#define CITIES 6
+#define ORDERS 200
+
+static Attribute *int_attribute(const char *name, int value) {
+  int *v = malloc(sizeof(int));
+  *v = value;
+  return attribute_create(name, ATTR_INT, v);
+}
+
+static Attribute *string_attribute(const char *name, const char *fmt, int n) {
+  char *s = malloc(32);
+  snprintf(s, 32, fmt, n);
+  return attribute_create(name, ATTR_STRING, s);
+}
+
+// People(name, age, city), Cities(city, cname), Orders(name, item, qty) with
+// deterministic contents; the skew gives the join reordering something to do
+static Schema *create_schema(void) {
+  Schema *schema = schema_create();
+  Relation *people, *cities, *orders;
+  if (!schema || schema_create_relation(schema, "People", &people) != 1 ||
+      schema_create_relation(schema, "Cities", &cities) != 1 ||
+      schema_create_relation(schema, "Orders", &orders) != 1) {
+    schema_destroy(schema);
+    return NULL;
+  }
+  uint64_t state = 42;
+  for (int i = 0; i < PEOPLE; i++) {
+    state = state * 6364136223846793005u + 1442695040888963407u;
+    Tuple *t = tuple_create();
+    tuple_add_attribute(t, string_attribute("name", "p%d", i));
+    tuple_add_attribute(t, int_attribute("age", 18 + (int)((state >> 33) % 60)));
+    tuple_add_attribute(t, int_attribute("city", (int)((state >> 40) % CITIES)));
+    schema_insert_tuple(schema, people, t);
+  }
+  for (int i = 0; i < CITIES; i++) {
+    Tuple *t = tuple_create();
+    tuple_add_attribute(t, int_attribute("city", i));
+    tuple_add_attribute(t, string_attribute("cname", "c%d", i));
+    schema_insert_tuple(schema, cities, t);
+  }
+  for (int i = 0; i < ORDERS; i++) {
+    state = state * 6364136223846793005u + 1442695040888963407u;
+    Tuple *t = tuple_create();
+    tuple_add_attribute(t, string_attribute("name", "p%d", (int)((state >> 33) % (PEOPLE / 2))));
+    tuple_add_attribute(t, string_attribute("item", "i%d", (int)((state >> 45) % 4)));
+    tuple_add_attribute(t, int_attribute("qty", 1 + (int)((state >> 52) % 9)));
+    if (schema_insert_tuple(schema, orders, t) != 1)
+      tuple_destroy(t);
+  }
+  return schema;
+}
+
+// Occurrences of a tuple (by value) in a relation
+static size_t count_equal(const Relation *r, Tuple *t) {
+  size_t n = 0;
+  SetIter it;
+  set_iter_init(r->tuples, &it);
+  for (Tuple *u; (u = set_iter_next(&it));)
+    n += tuple_equals(t, u) ? 1 : 0;
+  return n;
+}
+
+// Same tuples, counted by value
+static int relations_equal(const Relation *a, const Relation *b) {
+  if (set_size(a->tuples) != set_size(b->tuples))
+    return 0;
+  SetIter it;
+  set_iter_init(a->tuples, &it);
+  for (Tuple *t; (t = set_iter_next(&it));) {
+    if (count_equal(a, t) != count_equal(b, t))
+      return 0;
+  }
+  return 1;
+}
+
+static void optimized_plans_are_equivalent(void) {
+  static const char *queries[] = {
+      "(select (= cname \"c2\") (join (scan People) (scan Cities)))",
+      "(project (name item) (select (and (ge age 30) (lt qty 5))"
+      " (join (join (scan Orders) (scan People)) (scan Cities))))",
+      "(project (cname item) (join (scan Cities) (join (scan People) (scan Orders))))",
+      "(select (lt qty city) (join (scan People) (scan Orders)))",
+      "(select (gt age 40) (union (select (= city 1) (scan People)) (select (= city 2) (scan People))))",
+      "(select (le age 50) (difference (scan People) (select (= city 1) (scan People))))",
+      "(project (name) (project (name age) (select (ne city 3) (scan People))))",
+      "(project (name age city) (scan People))",
+      "(select (= town 2) (rename city town (scan People)))",
+      "(select (ge qty 3) (join (rename city qty (scan Cities)) (scan Orders)))",
+      "(divide (name) (item) (project (name item) (scan Orders))"
+      " (project (item) (select (lt qty 3) (scan Orders))))",
+  };
+
+  Schema *schema = create_schema();
+  if (!CHECK(schema != NULL))
+    return;
+  for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+    char error[256] = "";
+    size_t len = strlen(queries[i]);
+    Expression *plain = expression_parse(schema, queries[i], len, error, sizeof(error));
+    Expression *optimized =
+        expression_optimize(expression_parse(schema, queries[i], len, error, sizeof(error)));
+    if (!CHECK(plain && optimized)) {
+      fprintf(stderr, "  query %zu: %s\n", i, error);
+      expression_destroy(plain);
+      expression_destroy(optimized);
+      continue;
+    }
+    Relation *expected = expression_evaluate(plain, "plain");
+    Relation *actual = expression_evaluate(optimized, "optimized");
+    // Every query is chosen to return rows, so an empty result is a bug as well
+    CHECK(expected && set_size(expected->tuples) > 0);
+    if (!CHECK(expected && actual && relations_equal(expected, actual))) {
+      char *plan = expression_to_string(optimized);
+      fprintf(stderr, "  query %zu: %s\n  plan: %s\n  rows: %zu vs %zu\n", i, queries[i],
+              plan ? plan : "?", expected ? set_size(expected->tuples) : 0,
+              actual ? set_size(actual->tuples) : 0);
+      free(plan);
+    }
+    relation_destroy(expected);
+    relation_destroy(actual);
+    expression_destroy(plain);
+    expression_destroy(optimized);
+  }
+  schema_destroy(schema);
+}
+
+void test_expression(void) {
+  test_run("optimized_plans_are_equivalent", optimized_plans_are_equivalent);
+}
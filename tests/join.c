@@ -0,0 +1,105 @@
+/**
+ * @file join.c
+ * @brief Tests of infinite join enumeration.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "join.h"
+#include "primitive_relations.h"
+#include "scheduler.h"
+#include "test.h"
+
+static int int_value(Tuple *t, const char *name) {
+  Attribute *a = tuple_find_attribute(t, name);
+  return a ? *(int *)a->value : -1;
+}
+
+static int inner_equal(Tuple *left, Tuple *right, void *userdata) {
+  (void)userdata;
+  return int_value(left, "n") == int_value(right, "n");
+}
+
+// Matches the inner join's tuple (k, k) with k of the third input
+static int outer_equal(Tuple *left, Tuple *right, void *userdata) {
+  (void)userdata;
+  return int_value(left, "left_n") == int_value(right, "n");
+}
+
+// (N1 ⋈ N2) ⋈ N3 on one scheduler: the outer join's range tasks read the inner
+// join while the inner join enumerates its own ranges on the same workers
+static void nested_parallel_join(void) {
+  Scheduler *scheduler = scheduler_create(4);
+  if (!CHECK(scheduler != NULL))
+    return;
+  for (int run = 0; run < 20; run++) {
+    InfiniteRelation *n1 = infinite_relation_create("N1", natural_generator, NULL);
+    InfiniteRelation *n2 = infinite_relation_create("N2", natural_generator, NULL);
+    InfiniteRelation *n3 = infinite_relation_create("N3", natural_generator, NULL);
+    Cardinality aleph0 = cardinality_infinite(CARD_ALEPH_0);
+    InfiniteRelation *inner =
+        infinite_relation_join_parallel(n1, n2, inner_equal, NULL, "J1", aleph0, scheduler);
+    InfiniteRelation *outer =
+        infinite_relation_join_parallel(inner, n3, outer_equal, NULL, "J2", aleph0, scheduler);
+    if (!CHECK(outer != NULL))
+      break;
+    // The k-th match pairs the k-th diagonal tuple with k
+    for (size_t k = 0; k < 12; k++) {
+      Tuple *t = infinite_relation_tuple_at(outer, k);
+      CHECK(t != NULL);
+      if (!t)
+        break;
+      CHECK(int_value(t, "left_left_n") == (int)k);
+      CHECK(int_value(t, "left_right_n") == (int)k);
+      CHECK(int_value(t, "right_n") == (int)k);
+      tuple_destroy(t);
+    }
+    infinite_relation_destroy(outer);
+    infinite_relation_destroy(inner);
+    infinite_relation_destroy(n1);
+    infinite_relation_destroy(n2);
+    infinite_relation_destroy(n3);
+  }
+  scheduler_destroy(scheduler);
+}
+
+// Tuple n is {w: "w<n>"}
+static Tuple *word_generator(size_t n, void *userdata) {
+  (void)userdata;
+  char *w = malloc(24);
+  snprintf(w, 24, "w%zu", n);
+  Tuple *t = tuple_create();
+  tuple_add_attribute(t, attribute_create("w", ATTR_STRING, w));
+  return t;
+}
+
+// Strings bound nothing, so the infinite side is enumerated rather than skipped
+static void finite_join_on_strings(void) {
+  Relation *finite = relation_create("F");
+  const char *words[] = {"w3", "w7"};
+  for (size_t i = 0; i < 2; i++) {
+    Tuple *t = tuple_create();
+    tuple_add_attribute(t, attribute_create("w", ATTR_STRING, strdup(words[i])));
+    relation_add_tuple(finite, t);
+  }
+  InfiniteRelation *all = infinite_relation_create("W", word_generator, NULL);
+  InfiniteRelation *joined =
+      infinite_relation_join_finite(finite, "w", CMP_EQ, all, "w", "FW", NULL);
+  if (CHECK(joined != NULL)) {
+    for (size_t k = 0; k < 2; k++) {
+      Tuple *t = infinite_relation_tuple_at(joined, k);
+      Attribute *a = t ? tuple_find_attribute(t, "right_w") : NULL;
+      CHECK(a && strcmp(a->value, words[k]) == 0);
+      tuple_destroy(t);
+    }
+  }
+  infinite_relation_destroy(joined);
+  infinite_relation_destroy(all);
+  relation_destroy(finite);
+}
+
+void test_join(void) {
+  test_run("nested_parallel_join", nested_parallel_join);
+  test_run("finite_join_on_strings", finite_join_on_strings);
+}
@@ -0,0 +1,81 @@
+/**
+ * @file main.c
+ * @brief Entry point of the test suite (see `make test`).
+ *
+ * algebra-test [--filter NAME]
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "test.h"
+
+// A deadlock must fail the run rather than hang it
+#define TEST_TIMEOUT_SECONDS 120
+
+static const char *filter;
+static char tmp_dir[] = "/tmp/algebra-test-XXXXXX";
+static size_t tests_run, tests_failed;
+static int current_failed;
+
+int test_check(int ok, const char *expr, const char *file, int line) {
+  if (!ok) {
+    fprintf(stderr, "  %s:%d: CHECK(%s) failed\n", file, line, expr);
+    current_failed = 1;
+  }
+  return ok;
+}
+
+void test_run(const char *name, void (*fn)(void)) {
+  if (filter && !strstr(name, filter))
+    return;
+  current_failed = 0;
+  fn();
+  tests_run++;
+  if (current_failed)
+    tests_failed++;
+  fprintf(stderr, "%s %s\n", current_failed ? "FAIL" : "ok  ", name);
+}
+
+const char *test_tmp_dir(void) { return tmp_dir; }
+
+static void on_timeout(int sig) {
+  (void)sig;
+  static const char message[] = "test run timed out (deadlock?)\n";
+  (void)!write(STDERR_FILENO, message, sizeof(message) - 1);
+  _exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      filter = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--filter NAME]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (!mkdtemp(tmp_dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  // Failures are provoked on purpose; only errors are worth a log line
+  log_set_level(LOG_LEVEL_ERROR);
+  signal(SIGALRM, on_timeout);
+  alarm(TEST_TIMEOUT_SECONDS);
+
+  test_expression();
+  test_join();
+  test_persistence();
+  test_xml();
+
+  char command[64];
+  snprintf(command, sizeof(command), "rm -rf %s", tmp_dir);
+  if (system(command) != 0)
+    fprintf(stderr, "could not remove %s\n", tmp_dir);
+  fprintf(stderr, "%zu tests, %zu failed\n", tests_run, tests_failed);
+  return tests_failed ? 1 : 0;
+}
@@ -0,0 +1,269 @@
+/**
+ * @file persistence.c
+ * @brief Tests of the write-ahead log and snapshots.
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "attribute.h"
+#include "schema.h"
+#include "set.h"
+#include "test.h"
+#include "tuple.h"
+#include "wal.h"
+
+// Path of `name` in this run's temporary directory
+static const char *tmp_path(char *buf, size_t size, const char *name) {
+  snprintf(buf, size, "%s/%s", test_tmp_dir(), name);
+  remove(buf);
+  return buf;
+}
+
+static Tuple *int_tuple(const char *name, int value) {
+  int *v = malloc(sizeof(int));
+  *v = value;
+  Tuple *t = tuple_create();
+  tuple_add_attribute(t, attribute_create(name, ATTR_INT, v));
+  return t;
+}
+
+// Sum of attribute `name` over a relation, or -1 if it is missing
+static long sum_ints(Schema *schema, const char *relation, const char *name) {
+  Relation *r = schema_find_relation(schema, relation);
+  if (!r)
+    return -1;
+  long sum = 0;
+  SetIter it;
+  set_iter_init(r->tuples, &it);
+  for (Tuple *t; (t = set_iter_next(&it));) {
+    Attribute *a = tuple_find_attribute(t, name);
+    if (!a)
+      return -1;
+    sum += *(int *)a->value;
+  }
+  return sum;
+}
+
+// Create R(n) with n = 1..count through the schema, committing the log
+static void fill(Schema *schema, int count) {
+  Relation *r = NULL;
+  CHECK(schema_create_relation(schema, "R", &r) == 1);
+  for (int i = 1; r && i <= count; i++)
+    CHECK(schema_insert_tuple(schema, r, int_tuple("n", i)) == 1);
+  CHECK(schema_commit(schema) == 0);
+}
+
+static void wal_round_trip(void) {
+  char wal[512];
+  tmp_path(wal, sizeof(wal), "round_trip.wal");
+
+  Schema *schema = schema_open(NULL, wal);
+  if (!CHECK(schema != NULL))
+    return;
+  fill(schema, 10);
+  schema_destroy(schema);
+
+  schema = schema_open(NULL, wal);
+  if (!CHECK(schema != NULL))
+    return;
+  Relation *r = schema_find_relation(schema, "R");
+  CHECK(r && set_size(r->tuples) == 10);
+  CHECK(sum_ints(schema, "R", "n") == 55);
+  schema_destroy(schema);
+}
+
+// A batch whose write fails must not be replayed, nor corrupt the commits after it
+static void wal_failed_commit_is_discarded(void) {
+  char wal[512];
+  tmp_path(wal, sizeof(wal), "failed_commit.wal");
+
+  Schema *schema = schema_open(NULL, wal);
+  if (!CHECK(schema != NULL))
+    return;
+  fill(schema, 3);
+  Relation *r = schema_find_relation(schema, "R");
+
+  // Let only part of the next batch reach the file
+  struct stat st;
+  struct rlimit saved, limit;
+  CHECK(stat(wal, &st) == 0 && getrlimit(RLIMIT_FSIZE, &saved) == 0);
+  limit = saved;
+  limit.rlim_cur = (rlim_t)st.st_size + 40;
+  void (*previous)(int) = signal(SIGXFSZ, SIG_IGN);
+  CHECK(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+  for (int i = 10; r && i < 20; i++)
+    CHECK(schema_insert_tuple(schema, r, int_tuple("n", i)) == 1);
+  CHECK(wal_commit(schema->wal) < 0);
+  CHECK(wal_pending(schema->wal) == 0);
+  CHECK(setrlimit(RLIMIT_FSIZE, &saved) == 0);
+  signal(SIGXFSZ, previous);
+
+  struct stat after;
+  CHECK(stat(wal, &after) == 0 && after.st_size == st.st_size);
+  CHECK(r && schema_insert_tuple(schema, r, int_tuple("n", 100)) == 1);
+  CHECK(schema_commit(schema) == 0);
+  schema_destroy(schema);
+
+  schema = schema_open(NULL, wal);
+  if (!CHECK(schema != NULL))
+    return;
+  r = schema_find_relation(schema, "R");
+  CHECK(r && set_size(r->tuples) == 4);
+  CHECK(sum_ints(schema, "R", "n") == 106);
+  schema_destroy(schema);
+}
+
+// Mutations whose commit fails are undone in memory too
+static void failed_commit_undoes_mutations(void) {
+  char wal[512];
+  tmp_path(wal, sizeof(wal), "undo.wal");
+
+  Schema *schema = schema_open(NULL, wal);
+  if (!CHECK(schema != NULL))
+    return;
+  fill(schema, 3);
+  Relation *r = schema_find_relation(schema, "R");
+
+  struct stat st;
+  struct rlimit saved, limit;
+  CHECK(stat(wal, &st) == 0 && getrlimit(RLIMIT_FSIZE, &saved) == 0);
+  limit = saved;
+  limit.rlim_cur = (rlim_t)st.st_size;
+  void (*previous)(int) = signal(SIGXFSZ, SIG_IGN);
+  CHECK(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+  Relation *s = NULL;
+  CHECK(schema_create_relation(schema, "S", &s) == 1);
+  for (int i = 10; r && s && i < 20; i++) {
+    CHECK(schema_insert_tuple(schema, r, int_tuple("n", i)) == 1);
+    CHECK(schema_insert_tuple(schema, s, int_tuple("n", i)) == 1);
+  }
+  CHECK(schema_commit(schema) < 0);
+  CHECK(setrlimit(RLIMIT_FSIZE, &saved) == 0);
+  signal(SIGXFSZ, previous);
+
+  CHECK(schema_find_relation(schema, "S") == NULL);
+  CHECK(r && set_size(r->tuples) == 3);
+  CHECK(sum_ints(schema, "R", "n") == 6);
+
+  // The schema keeps working once the log does
+  CHECK(schema_create_relation(schema, "S", &s) == 1);
+  CHECK(s && schema_insert_tuple(schema, s, int_tuple("n", 7)) == 1);
+  CHECK(schema_commit(schema) == 0);
+  schema_destroy(schema);
+
+  schema = schema_open(NULL, wal);
+  if (!CHECK(schema != NULL))
+    return;
+  CHECK(sum_ints(schema, "R", "n") == 6);
+  CHECK(sum_ints(schema, "S", "n") == 7);
+  schema_destroy(schema);
+}
+
+// An ADD_TUPLE record counts attributes in a u16; a wider tuple must be refused, not truncated
+static void wal_rejects_wide_tuple(void) {
+  char wal[512];
+  tmp_path(wal, sizeof(wal), "wide.wal");
+
+  Schema *schema = schema_open(NULL, wal);
+  if (!CHECK(schema != NULL))
+    return;
+  fill(schema, 3);
+  Relation *r = schema_find_relation(schema, "R");
+
+  size_t width = (size_t)WAL_MAX_ATTRIBUTES + 1;
+  Attribute **attrs = malloc(width * sizeof(*attrs));
+  Tuple *t = tuple_create();
+  if (!CHECK(r && attrs && t))
+    return;
+  for (size_t i = 0; i < width; i++) {
+    char name[16];
+    snprintf(name, sizeof(name), "a%zu", i);
+    int *v = malloc(sizeof(int));
+    *v = (int)i;
+    attrs[i] = attribute_create(name, ATTR_INT, v);
+  }
+  CHECK(set_add_batch(t, (void *const *)attrs, width) == 0);
+  free(attrs);
+
+  CHECK(schema_insert_tuple(schema, r, t) < 0);
+  CHECK(wal_pending(schema->wal) == 0);
+  CHECK(set_size(r->tuples) == 3);
+  tuple_destroy(t);
+  schema_destroy(schema);
+
+  schema = schema_open(NULL, wal);
+  CHECK(schema && sum_ints(schema, "R", "n") == 6);
+  schema_destroy(schema);
+}
+
+static void snapshot_round_trip(void) {
+  char snap[512], wal[512];
+  tmp_path(snap, sizeof(snap), "round_trip.snap");
+  tmp_path(wal, sizeof(wal), "round_trip_snap.wal");
+
+  Schema *schema = schema_open(snap, wal);
+  if (!CHECK(schema != NULL))
+    return;
+  fill(schema, 10);
+  CHECK(schema_checkpoint(schema) == 0);
+  // Logged after the checkpoint, so only the log has it
+  Relation *r = schema_find_relation(schema, "R");
+  CHECK(r && schema_insert_tuple(schema, r, int_tuple("n", 100)) == 1);
+  CHECK(schema_commit(schema) == 0);
+  schema_destroy(schema);
+
+  schema = schema_open(snap, wal);
+  if (!CHECK(schema != NULL))
+    return;
+  r = schema_find_relation(schema, "R");
+  CHECK(r && set_size(r->tuples) == 11);
+  CHECK(sum_ints(schema, "R", "n") == 155);
+  schema_destroy(schema);
+}
+
+// A relation whose snapshot rows do not decode must not be served or re-checkpointed
+static void malformed_snapshot_fails_lookup(void) {
+  char snap[512];
+  tmp_path(snap, sizeof(snap), "malformed.snap");
+
+  Schema *schema = schema_open(snap, NULL);
+  if (!CHECK(schema != NULL))
+    return;
+  fill(schema, 3);
+  CHECK(schema_checkpoint(schema) == 0);
+  schema_destroy(schema);
+
+  // Rows of R(n) are (u8 tag, i64) each, right after the 36-byte header:
+  // give the third row an unknown tag, so two rows decode before the error
+  FILE *f = fopen(snap, "r+b");
+  if (!CHECK(f != NULL))
+    return;
+  CHECK(fseek(f, 36 + 2 * 9, SEEK_SET) == 0 && fputc(0x7F, f) == 0x7F);
+  fclose(f);
+
+  schema = schema_open(snap, NULL);
+  if (!CHECK(schema != NULL))
+    return;
+  CHECK(schema_find_relation(schema, "R") == NULL);
+  CHECK(schema_find_relation(schema, "R") == NULL);
+  CHECK(schema_checkpoint(schema) < 0);
+  schema_destroy(schema);
+
+  // The refused checkpoint left the snapshot as it was
+  schema = schema_open(snap, NULL);
+  CHECK(schema && schema_find_relation(schema, "R") == NULL);
+  schema_destroy(schema);
+}
+
+void test_persistence(void) {
+  test_run("wal_round_trip", wal_round_trip);
+  test_run("wal_failed_commit_is_discarded", wal_failed_commit_is_discarded);
+  test_run("failed_commit_undoes_mutations", failed_commit_undoes_mutations);
+  test_run("wal_rejects_wide_tuple", wal_rejects_wide_tuple);
+  test_run("snapshot_round_trip", snapshot_round_trip);
+  test_run("malformed_snapshot_fails_lookup", malformed_snapshot_fails_lookup);
+}
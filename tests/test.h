@@ -0,0 +1,53 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stddef.h>
+
+/**
+ * @file test.h
+ * @brief Minimal behavioral test harness (see `make test`).
+ *
+ * Each source file defines one group of tests and registers them with
+ * test_run; a test reports failures with CHECK and keeps going, so one run
+ * lists every broken expectation. The runner exits non-zero if any check
+ * failed, and a watchdog aborts a run that hangs.
+ *
+ * Example usage:
+ * @code{.c}
+ *   static void relation_starts_empty(void) {
+ *     Relation *r = relation_create("R");
+ *     CHECK(set_size(r->tuples) == 0);
+ *     relation_destroy(r);
+ *   }
+ *
+ *   void test_relation(void) { test_run("relation_starts_empty", relation_starts_empty); }
+ * @endcode
+ */
+
+/** Record a failure (with its location) unless `cond` holds */
+#define CHECK(cond) test_check((cond) != 0, #cond, __FILE__, __LINE__)
+
+/**
+ * @brief Run one test if it is selected by the filter, and report it.
+ */
+void test_run(const char *name, void (*fn)(void));
+
+/**
+ * @brief Record the outcome of one expectation.
+ * @return `ok`, so tests can stop early with `if (!CHECK(...)) return;`.
+ */
+int test_check(int ok, const char *expr, const char *file, int line);
+
+/**
+ * @brief Directory for the files a test writes (created by the runner).
+ */
+const char *test_tmp_dir(void);
+
+/* Test groups (one per source file) */
+
+void test_expression(void);
+void test_join(void);
+void test_persistence(void);
+void test_xml(void);
+
+#endif // TEST_H
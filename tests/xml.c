@@ -0,0 +1,92 @@
+/**
+ * @file xml.c
+ * @brief Tests of the XML protocol.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "attribute.h"
+#include "relation.h"
+#include "schema.h"
+#include "set.h"
+#include "test.h"
+#include "tuple.h"
+#include "wire.h"
+#include "xml_parser.h"
+#include "xml_server.h"
+
+// Run one request; returns the NUL-terminated response (caller frees)
+static char *request(Schema *schema, const char *xml) {
+  WireBuffer response;
+  wire_buffer_init(&response);
+  xml_process_request(schema, xml, strlen(xml), &response);
+  char *text = malloc(response.size + 1);
+  if (text) {
+    memcpy(text, response.data, response.size);
+    text[response.size] = '\0';
+  }
+  wire_buffer_free(&response);
+  return text;
+}
+
+static void parser_decodes_entities(void) {
+  const char *xml = "<request><command>EVALUATE</command>"
+                    "<expression>&lt;&gt;&amp;&quot;&apos;&#65;&#x42;&#xE9;</expression></request>";
+  XmlRequest req;
+  CHECK(xml_parse_request(xml, strlen(xml), &req) == 0);
+  CHECK(xml_view_equals(req.expression, "<>&\"'AB\xC3\xA9"));
+  CHECK(xml_view_equals(req.command, "EVALUATE"));
+  xml_request_free(&req);
+
+  const char *bad[] = {"<request><name>a & b</name></request>",
+                       "<request><name>&nbsp;</name></request>",
+                       "<request><name>&#0;</name></request>",
+                       "<request><name>&#x110000;</name></request>",
+                       "<request><name>&amp</name></request>"};
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    CHECK(xml_parse_request(bad[i], strlen(bad[i]), &req) < 0);
+    xml_request_free(&req);
+  }
+}
+
+// A value holding the characters XML reserves is stored decoded and sent back escaped once
+static void reserved_characters_round_trip(void) {
+  Schema *schema = schema_create();
+  if (!CHECK(schema != NULL))
+    return;
+
+  char *response = request(schema, "<request><command>CREATE_RELATION</command>"
+                                   "<name>Notes</name></request>");
+  CHECK(response && strstr(response, "success"));
+  free(response);
+
+  response = request(schema, "<request><id>a&amp;1</id><command>ADD_TUPLE</command>"
+                             "<relation>Notes</relation><attributes><attribute>"
+                             "<name>text</name><type>string</type>"
+                             "<value>fish &amp; chips &lt;hot&gt;</value>"
+                             "</attribute></attributes></request>");
+  CHECK(response && strstr(response, "success"));
+  CHECK(response && strstr(response, "<id>a&amp;1</id>"));
+  free(response);
+
+  Relation *notes = schema_find_relation(schema, "Notes");
+  if (CHECK(notes && set_size(notes->tuples) == 1)) {
+    SetIter it;
+    set_iter_init(notes->tuples, &it);
+    Attribute *text = tuple_find_attribute(set_iter_next(&it), "text");
+    CHECK(text && text->type == ATTR_STRING && strcmp(text->value, "fish & chips <hot>") == 0);
+  }
+
+  response = request(schema, "<request><command>QUERY_RELATION</command>"
+                             "<relation>Notes</relation></request>");
+  CHECK(response && strstr(response, "fish &amp; chips &lt;hot&gt;"));
+  CHECK(response && !strstr(response, "&amp;amp;"));
+  free(response);
+
+  schema_destroy(schema);
+}
+
+void test_xml(void) {
+  test_run("parser_decodes_entities", parser_decodes_entities);
+  test_run("reserved_characters_round_trip", reserved_characters_round_trip);
+}